@@ -48,6 +48,8 @@
   *    
   *        Using this configuration file, user can change the following settings:
   *          - Use RGB888 or ARGB8888 or RGB565 by setting the constant JPEG_RGB_FORMAT respectively to JPEG_RGB888, JPEG_ARGB8888 JPEG_RGB565.
+  *            This is only the default; "JPEG_SetDecodeOutputFormat" selects the decoder output at runtime
+  *            (ARGB8888, RGB888, dithered RGB565 or dithered L8 with a user CLUT).
   *          - Swap RED, and Blue offsets if user needs to change the color order to BGR (instead of RGB) by setting:
   *             #define JPEG_SWAP_RB     1
   *          - Enable or disable the decoding post-processing functions (YCbCr to RGB conversion functions) by setting the define USE_JPEG_DECODER 
@@ -173,6 +175,7 @@ typedef struct __JPEG_MCU_RGB_ConvertorTypeDef
 #if (JPEG_RGB_FORMAT == JPEG_ARGB8888)
   #define JPEG_GREEN_OFFSET        8       /* Offset of the GREEN color in a pixel         */    
   #define JPEG_ALPHA_OFFSET        24      /* Offset of the Transparency Alpha in a pixel  */
+  #define JPEG_ALPHA_OPAQUE        (0xFFUL << JPEG_ALPHA_OFFSET) /* Alpha of every decoded pixel */
   #define JPEG_BYTES_PER_PIXEL     4       /* Number of bytes in a pixel                   */
   #if (JPEG_SWAP_RB == 0)
     #define JPEG_RED_OFFSET        16      /* Offset of the RED color in a pixel           */
@@ -242,6 +245,36 @@ typedef struct __JPEG_MCU_RGB_ConvertorTypeDef
 
 static JPEG_MCU_RGB_ConvertorTypeDef JPEG_ConvertorParams;
 
+#if (USE_JPEG_DECODER == 1)
+/* Runtime output format, see JPEG_SetDecodeOutputFormat() */
+typedef void (* JPEG_RGB_LineStore_Function)(uint8_t *pOutAddr,
+                                      uint32_t x, uint32_t y, uint32_t count,
+                                      const uint8_t *pRed,
+                                      const uint8_t *pGreen,
+                                      const uint8_t *pBlue);
+
+static uint32_t JPEG_OutputFormat = JPEG_RGB_FORMAT;
+static uint32_t JPEG_OutputBytesPerPixel = JPEG_BYTES_PER_PIXEL;
+static JPEG_RGB_LineStore_Function JPEG_OutputLineStore = NULL;
+
+/* Inverse color map for L8 output : 4 bits per component -> CLUT index */
+#define JPEG_ICMAP_BITS            4
+#define JPEG_ICMAP_SIZE            (1 << (3 * JPEG_ICMAP_BITS))
+
+static const uint32_t *JPEG_OutputCLUT = NULL;
+static uint32_t JPEG_OutputCLUTSize = 0;
+static uint8_t JPEG_InverseCMap[JPEG_ICMAP_SIZE];
+
+/* 4x4 Bayer ordered dither thresholds, 0..15 */
+static const uint8_t JPEG_DITHER_LUT[4][4] =
+{
+  { 0,  8,  2, 10},
+  {12,  4, 14,  6},
+  { 3, 11,  1,  9},
+  {15,  7, 13,  5},
+};
+#endif /* USE_JPEG_DECODER == 1 */
+
 #if (USE_JPEG_DECODER == 1)
 static int32_t CR_RED_LUT[256];           /* Cr to Red color conversion Look Up Table  */
 static int32_t CB_BLUE_LUT[256];          /* Cb to Blue color conversion Look Up Table */
@@ -412,6 +445,11 @@ static uint32_t JPEG_MCU_YCCK_ARGB_ConvertBlocks(uint8_t *pInBuffer,
                                       uint32_t BlockIndex,
                                       uint32_t DataCount,
                                       uint32_t *ConvertedDataCount);
+static uint32_t JPEG_MCU_Any_RGB_ConvertBlocks(uint8_t *pInBuffer, 
+                                      uint8_t *pOutBuffer, 
+                                      uint32_t BlockIndex,
+                                      uint32_t DataCount,
+                                      uint32_t *ConvertedDataCount);
 static void JPEG_InitPostProcColorTables(void);
 #endif /* USE_JPEG_DECODER == 1 */
 
@@ -1183,14 +1221,14 @@ static uint32_t JPEG_MCU_YCbCr420_ARGB_ConvertBlocks(uint8_t *pInBuffer,
             *(__IO uint32_t *)pOutAddr = 
               (CLAMP(ycomp + c_red) << JPEG_RED_OFFSET)     | \
               (CLAMP( ycomp + c_green) << JPEG_GREEN_OFFSET) | \
-              (CLAMP(ycomp + c_blue) << JPEG_BLUE_OFFSET);
+              (CLAMP(ycomp + c_blue) << JPEG_BLUE_OFFSET) | JPEG_ALPHA_OPAQUE;
             /**********/
             ycomp = (int32_t)(*(pLum +j +1));
             
             *((__IO uint32_t *)(pOutAddr + 4)) = 
               (CLAMP(ycomp + c_red) << JPEG_RED_OFFSET)     | \
               (CLAMP( ycomp + c_green) << JPEG_GREEN_OFFSET) | \
-              (CLAMP(ycomp + c_blue) << JPEG_BLUE_OFFSET);
+              (CLAMP(ycomp + c_blue) << JPEG_BLUE_OFFSET) | JPEG_ALPHA_OPAQUE;
             
             /**********/
             ycomp = (int32_t)(*(pLum +j +8));
@@ -1198,7 +1236,7 @@ static uint32_t JPEG_MCU_YCbCr420_ARGB_ConvertBlocks(uint8_t *pInBuffer,
             *(__IO uint32_t *)pOutAddr2 = 
               (CLAMP(ycomp + c_red) << JPEG_RED_OFFSET)     | \
               (CLAMP( ycomp + c_green) << JPEG_GREEN_OFFSET) | \
-              (CLAMP(ycomp + c_blue) << JPEG_BLUE_OFFSET);
+              (CLAMP(ycomp + c_blue) << JPEG_BLUE_OFFSET) | JPEG_ALPHA_OPAQUE;
             
             /**********/
             ycomp = (int32_t)(*(pLum +j +8 +1));
@@ -1206,7 +1244,7 @@ static uint32_t JPEG_MCU_YCbCr420_ARGB_ConvertBlocks(uint8_t *pInBuffer,
             *((__IO uint32_t *)(pOutAddr2 +4)) = 
               (CLAMP(ycomp + c_red) << JPEG_RED_OFFSET)     | \
               (CLAMP( ycomp + c_green) << JPEG_GREEN_OFFSET) | \
-              (CLAMP(ycomp + c_blue) << JPEG_BLUE_OFFSET);
+              (CLAMP(ycomp + c_blue) << JPEG_BLUE_OFFSET) | JPEG_ALPHA_OPAQUE;
 
             
 #elif (JPEG_RGB_FORMAT == JPEG_RGB888)
@@ -1361,14 +1399,14 @@ static uint32_t JPEG_MCU_YCbCr422_ARGB_ConvertBlocks(uint8_t *pInBuffer,
             *(__IO uint32_t *)pOutAddr = 
               (CLAMP(ycomp + c_red) << JPEG_RED_OFFSET)     | \
               (CLAMP( ycomp + c_green) << JPEG_GREEN_OFFSET) | \
-              (CLAMP(ycomp + c_blue) << JPEG_BLUE_OFFSET);
+              (CLAMP(ycomp + c_blue) << JPEG_BLUE_OFFSET) | JPEG_ALPHA_OPAQUE;
             /**********/
             ycomp = (int32_t)(*(pLum +j +1));
             
             *((__IO uint32_t *)(pOutAddr + 4)) = 
               (CLAMP(ycomp + c_red) << JPEG_RED_OFFSET)     | \
               (CLAMP( ycomp + c_green) << JPEG_GREEN_OFFSET) | \
-              (CLAMP(ycomp + c_blue) << JPEG_BLUE_OFFSET);         
+              (CLAMP(ycomp + c_blue) << JPEG_BLUE_OFFSET) | JPEG_ALPHA_OPAQUE;         
             
 #elif (JPEG_RGB_FORMAT == JPEG_RGB888)
           
@@ -1490,7 +1528,7 @@ static uint32_t JPEG_MCU_YCbCr444_ARGB_ConvertBlocks(uint8_t *pInBuffer,
             *(__IO uint32_t *)pOutAddr = 
               (CLAMP(ycomp + c_red) << JPEG_RED_OFFSET)     | \
               (CLAMP( ycomp + c_green) << JPEG_GREEN_OFFSET) | \
-              (CLAMP(ycomp + c_blue) << JPEG_BLUE_OFFSET);       
+              (CLAMP(ycomp + c_blue) << JPEG_BLUE_OFFSET) | JPEG_ALPHA_OPAQUE;       
             
 #elif (JPEG_RGB_FORMAT == JPEG_RGB888)
             
@@ -1576,7 +1614,7 @@ static uint32_t JPEG_MCU_Gray_ARGB_ConvertBlocks(uint8_t *pInBuffer,
 
 #if (JPEG_RGB_FORMAT == JPEG_ARGB8888)
           
-          *(__IO uint32_t *)pOutAddr = ySample |  (ySample << 8) | (ySample << 16);
+          *(__IO uint32_t *)pOutAddr = ySample |  (ySample << 8) | (ySample << 16) | JPEG_ALPHA_OPAQUE;
           
 #elif (JPEG_RGB_FORMAT == JPEG_RGB888)
           
@@ -1665,7 +1703,7 @@ static uint32_t JPEG_MCU_YCCK_ARGB_ConvertBlocks(uint8_t *pInBuffer,
           *(__IO uint32_t *)pOutAddr = 
             (c_red << JPEG_RED_OFFSET) | \
             (c_green << JPEG_GREEN_OFFSET) | \
-            (c_blue << JPEG_BLUE_OFFSET);     
+            (c_blue << JPEG_BLUE_OFFSET) | JPEG_ALPHA_OPAQUE;
             
 #elif (JPEG_RGB_FORMAT == JPEG_RGB888)
             
@@ -1696,6 +1734,324 @@ static uint32_t JPEG_MCU_YCCK_ARGB_ConvertBlocks(uint8_t *pInBuffer,
   return numberMCU;
 }
 
+/**
+  * @brief  Store one line of RGB components as opaque ARGB8888 pixels
+  * @param  pOutAddr : pointer to the first output pixel.
+  * @param  x, y     : position of the first pixel in the image.
+  * @param  count    : number of pixels to store.
+  * @param  pRed, pGreen, pBlue : pointers to the color components.
+  * @retval None
+  */
+static void JPEG_LineStore_ARGB8888(uint8_t *pOutAddr, uint32_t x, uint32_t y, uint32_t count,
+                                    const uint8_t *pRed, const uint8_t *pGreen, const uint8_t *pBlue)
+{
+  uint32_t *pOut = (uint32_t *)pOutAddr;
+  uint32_t i;
+
+  for(i = 0; i < count; i++)
+  {
+    pOut[i] = 0xFF000000UL | (pRed[i] << 16) | (pGreen[i] << 8) | pBlue[i];
+  }
+}
+
+/**
+  * @brief  Store one line of RGB components as RGB888 pixels
+  * @param  See JPEG_LineStore_ARGB8888.
+  * @retval None
+  */
+static void JPEG_LineStore_RGB888(uint8_t *pOutAddr, uint32_t x, uint32_t y, uint32_t count,
+                                  const uint8_t *pRed, const uint8_t *pGreen, const uint8_t *pBlue)
+{
+  uint32_t i;
+
+  for(i = 0; i < count; i++)
+  {
+    pOutAddr[0] = pBlue[i];
+    pOutAddr[1] = pGreen[i];
+    pOutAddr[2] = pRed[i];
+    pOutAddr += 3;
+  }
+}
+
+/**
+  * @brief  Store one line of RGB components as RGB565 pixels with 4x4 ordered dithering.
+  *         The dither threshold is scaled to the quantization step of each component,
+  *         so the average error is the same as rounding, but banding is broken up.
+  * @param  See JPEG_LineStore_ARGB8888.
+  * @retval None
+  */
+static void JPEG_LineStore_RGB565(uint8_t *pOutAddr, uint32_t x, uint32_t y, uint32_t count,
+                                  const uint8_t *pRed, const uint8_t *pGreen, const uint8_t *pBlue)
+{
+  uint16_t *pOut = (uint16_t *)pOutAddr;
+  const uint8_t *pDither = JPEG_DITHER_LUT[y & 0x3];
+  uint32_t i, d, red, green, blue;
+
+  for(i = 0; i < count; i++)
+  {
+    d = pDither[(x + i) & 0x3];
+
+    red   = pRed[i] + (d >> 1);
+    green = pGreen[i] + (d >> 2);
+    blue  = pBlue[i] + (d >> 1);
+
+    red   = (red > 255) ? 255 : red;
+    green = (green > 255) ? 255 : green;
+    blue  = (blue > 255) ? 255 : blue;
+
+    pOut[i] = ((red >> 3) << 11) | ((green >> 2) << 5) | (blue >> 3);
+  }
+}
+
+/**
+  * @brief  Store one line of RGB components as L8 (CLUT index) pixels with 4x4 ordered dithering.
+  *         Index is taken from the precomputed inverse color map, see JPEG_BuildInverseCMap.
+  * @param  See JPEG_LineStore_ARGB8888.
+  * @retval None
+  */
+static void JPEG_LineStore_L8(uint8_t *pOutAddr, uint32_t x, uint32_t y, uint32_t count,
+                              const uint8_t *pRed, const uint8_t *pGreen, const uint8_t *pBlue)
+{
+  const uint8_t *pDither = JPEG_DITHER_LUT[y & 0x3];
+  uint32_t i, d, red, green, blue;
+
+  for(i = 0; i < count; i++)
+  {
+    d = pDither[(x + i) & 0x3];
+
+    red   = pRed[i] + d;
+    green = pGreen[i] + d;
+    blue  = pBlue[i] + d;
+
+    red   = (red > 255) ? 255 : red;
+    green = (green > 255) ? 255 : green;
+    blue  = (blue > 255) ? 255 : blue;
+
+    pOutAddr[i] = JPEG_InverseCMap[((red >> (8 - JPEG_ICMAP_BITS)) << (2 * JPEG_ICMAP_BITS)) |
+                                   ((green >> (8 - JPEG_ICMAP_BITS)) << JPEG_ICMAP_BITS) |
+                                    (blue >> (8 - JPEG_ICMAP_BITS))];
+  }
+}
+
+/**
+  * @brief  Precompute the inverse color map : nearest CLUT entry for every
+  *         cell of the 4:4:4 bits RGB cube.
+  * @param  pCLUT    : pointer to 0x00RRGGBB color table.
+  * @param  CLUTSize : number of entries in the table (1..256).
+  * @retval None
+  */
+static void JPEG_BuildInverseCMap(const uint32_t *pCLUT, uint32_t CLUTSize)
+{
+  const int32_t step = 1 << (8 - JPEG_ICMAP_BITS);
+  int32_t red, green, blue, dr, dg, db;
+  uint32_t idx, i, best, dist, bestdist;
+
+  for(idx = 0; idx < JPEG_ICMAP_SIZE; idx++)
+  {
+    red   = ((idx >> (2 * JPEG_ICMAP_BITS)) & (step - 1)) * step + step / 2;
+    green = ((idx >> JPEG_ICMAP_BITS) & (step - 1)) * step + step / 2;
+    blue  = (idx & (step - 1)) * step + step / 2;
+
+    best = 0;
+    bestdist = 0xffffffff;
+    for(i = 0; i < CLUTSize; i++)
+    {
+      dr = red   - (int32_t)((pCLUT[i] >> 16) & 0xff);
+      dg = green - (int32_t)((pCLUT[i] >> 8) & 0xff);
+      db = blue  - (int32_t)(pCLUT[i] & 0xff);
+
+      /* weighted to follow the eye sensitivity a bit : 3/4/2 */
+      dist = (uint32_t)(3 * dr * dr + 4 * dg * dg + 2 * db * db);
+      if(dist < bestdist)
+      {
+        bestdist = dist;
+        best = i;
+        if(dist == 0)
+        {
+          break;
+        }
+      }
+    }
+    JPEG_InverseCMap[idx] = (uint8_t)best;
+  }
+}
+
+/**
+  * @brief  Convert any supported MCU layout (YCbCr 4:2:0/4:2:2/4:4:4, Gray, CMYK)
+  *         to the runtime selected output format.
+  *         Pixels are converted line by line into component buffers,
+  *         then packed by the output line store function.
+  * @param  pInBuffer  : pointer to input MCU blocks buffer.
+  * @param  pOutBuffer : pointer to output frame buffer.
+  * @param  BlockIndex : index of the input buffer first block in the final image.
+  * @param  DataCount  : number of bytes in the input buffer .
+  * @param  ConvertedDataCount  : number of converted bytes from input buffer.  
+  * @retval Number of blcoks converted
+  */
+static uint32_t JPEG_MCU_Any_RGB_ConvertBlocks(uint8_t *pInBuffer, 
+                                      uint8_t *pOutBuffer, 
+                                      uint32_t BlockIndex,
+                                      uint32_t DataCount,
+                                      uint32_t *ConvertedDataCount)
+{
+  uint32_t numberMCU, currentMCU, xRef, yRef;
+  uint32_t i, j, count, hBlocks, vBlocks, cShift;
+  int32_t ycomp, cbcomp, crcomp, color_k;
+  int32_t c_red, c_blue, c_green;
+  const uint32_t hFactor = JPEG_ConvertorParams.H_factor;
+  const uint32_t vFactor = JPEG_ConvertorParams.V_factor;
+  uint8_t *pLum, *pCb, *pCr, *pChrom;
+  uint8_t red[16], green[16], blue[16];
+
+  numberMCU = DataCount / JPEG_ConvertorParams.BlockSize;
+  currentMCU = BlockIndex;
+
+  hBlocks = hFactor / 8;
+  vBlocks = vFactor / 8;
+  cShift = (hFactor == 16) ? 1 : 0;
+
+  while(currentMCU < (numberMCU + BlockIndex))
+  {
+    xRef = ((currentMCU * hFactor) / JPEG_ConvertorParams.WidthExtend) * vFactor;
+
+    yRef = ((currentMCU * hFactor) % JPEG_ConvertorParams.WidthExtend);
+
+    currentMCU++;
+
+    count = hFactor;
+    if((yRef + count) > JPEG_ConvertorParams.ImageWidth)
+    {
+      count = JPEG_ConvertorParams.ImageWidth - yRef;
+    }
+
+    for(i = 0; (i < vFactor) && ((xRef + i) < JPEG_ConvertorParams.ImageHeight); i++)
+    {
+      if(JPEG_ConvertorParams.ColorSpace == JPEG_CMYK_COLORSPACE)
+      {
+        pChrom = pInBuffer + i * 8;
+        for(j = 0; j < count; j++)
+        {
+          color_k = (int32_t)pChrom[j + 192];
+          red[j]   = (color_k * (int32_t)pChrom[j]) / 255;
+          green[j] = (color_k * (int32_t)pChrom[j + 64]) / 255;
+          blue[j]  = (color_k * (int32_t)pChrom[j + 128]) / 255;
+        }
+      }
+      else
+      {
+        pLum = pInBuffer + (i / 8) * hBlocks * 64 + (i % 8) * 8;
+        pCb = pInBuffer + hBlocks * vBlocks * 64 + ((i * 8) / vFactor) * 8;
+        pCr = pCb + 64;
+
+        for(j = 0; j < count; j++)
+        {
+          ycomp = (int32_t)pLum[(j / 8) * 64 + (j % 8)];
+
+          if(JPEG_ConvertorParams.ColorSpace == JPEG_GRAYSCALE_COLORSPACE)
+          {
+            red[j] = green[j] = blue[j] = (uint8_t)ycomp;
+            continue;
+          }
+          cbcomp = (int32_t)pCb[j >> cShift];
+          crcomp = (int32_t)pCr[j >> cShift];
+
+          c_blue = (int32_t)(*(CB_BLUE_LUT + cbcomp));
+          c_red = (int32_t)(*(CR_RED_LUT + crcomp));
+          c_green = ((int32_t)(*(CR_GREEN_LUT + crcomp)) + (int32_t)(*(CB_GREEN_LUT + cbcomp))) >> 16;
+
+          red[j]   = CLAMP(ycomp + c_red);
+          green[j] = CLAMP(ycomp + c_green);
+          blue[j]  = CLAMP(ycomp + c_blue);
+        }
+      }
+
+#if (JPEG_SWAP_RB == 1)
+      /* L8 looks up the true color in the CLUT, only direct color formats are swapped */
+      if(JPEG_OutputFormat != JPEG_L8)
+      {
+        JPEG_OutputLineStore(pOutBuffer + ((xRef + i) * JPEG_ConvertorParams.ImageWidth + yRef) * JPEG_OutputBytesPerPixel,
+                             yRef, xRef + i, count, blue, green, red);
+        continue;
+      }
+#endif /* JPEG_SWAP_RB */
+      JPEG_OutputLineStore(pOutBuffer + ((xRef + i) * JPEG_ConvertorParams.ImageWidth + yRef) * JPEG_OutputBytesPerPixel,
+                           yRef, xRef + i, count, red, green, blue);
+    }
+
+    pInBuffer += JPEG_ConvertorParams.BlockSize;
+  }
+  return numberMCU;
+}
+
+/**
+  * @brief  Select output pixel format for the following decodes.
+  *         The format given by JPEG_RGB_FORMAT uses the dedicated converters,
+  *         any other goes through the generic converter above.
+  * @param  OutputFormat : JPEG_ARGB8888, JPEG_RGB888, JPEG_RGB565 (dithered) or JPEG_L8 (dithered).
+  * @param  pCLUT    : 0x00RRGGBB color table, used only by JPEG_L8.
+  * @param  CLUTSize : number of entries in pCLUT (1..256).
+  * @retval HAL status : HAL_OK or HAL_ERROR.
+  */
+HAL_StatusTypeDef JPEG_SetDecodeOutputFormat(uint32_t OutputFormat, const uint32_t *pCLUT, uint32_t CLUTSize)
+{
+  switch(OutputFormat)
+  {
+    case JPEG_ARGB8888:
+      JPEG_OutputLineStore = JPEG_LineStore_ARGB8888;
+      JPEG_OutputBytesPerPixel = 4;
+    break;
+    case JPEG_RGB888:
+      JPEG_OutputLineStore = JPEG_LineStore_RGB888;
+      JPEG_OutputBytesPerPixel = 3;
+    break;
+    case JPEG_RGB565:
+      JPEG_OutputLineStore = JPEG_LineStore_RGB565;
+      JPEG_OutputBytesPerPixel = 2;
+    break;
+    case JPEG_L8:
+      if((pCLUT == NULL) || (CLUTSize == 0) || (CLUTSize > 256))
+      {
+        return HAL_ERROR;
+      }
+      /* Inverse map is expensive to build, keep it while the table is the same */
+      if((pCLUT != JPEG_OutputCLUT) || (CLUTSize != JPEG_OutputCLUTSize))
+      {
+        JPEG_BuildInverseCMap(pCLUT, CLUTSize);
+        JPEG_OutputCLUT = pCLUT;
+        JPEG_OutputCLUTSize = CLUTSize;
+      }
+      JPEG_OutputLineStore = JPEG_LineStore_L8;
+      JPEG_OutputBytesPerPixel = 1;
+    break;
+    default:
+      return HAL_ERROR;
+  }
+  JPEG_OutputFormat = OutputFormat;
+  return HAL_OK;
+}
+
+/**
+  * @brief  Forget cached inverse color map, must be called if the CLUT
+  *         content was changed in place.
+  * @param  None
+  * @retval None
+  */
+void JPEG_InvalidateDecodeCLUT(void)
+{
+  JPEG_OutputCLUT = NULL;
+  JPEG_OutputCLUTSize = 0;
+}
+
+/**
+  * @brief  Bytes per pixel of the current output format.
+  * @param  None
+  * @retval Bytes per pixel
+  */
+uint32_t JPEG_GetDecodeBytesPerPixel(void)
+{
+  return JPEG_OutputBytesPerPixel;
+}
+
 /**
   * @brief  Retrive Decoding YCbCr to RGB color conversion function and block number  
   * @param  pJpegInfo  : JPEG_ConfTypeDef that contains the JPEG image informations.
@@ -1712,7 +2068,7 @@ HAL_StatusTypeDef JPEG_GetDecodeColorConvertFunc(JPEG_ConfTypeDef *pJpegInfo, JP
   JPEG_ConvertorParams.ColorSpace = pJpegInfo->ColorSpace;
   JPEG_ConvertorParams.ImageWidth = pJpegInfo->ImageWidth;
   JPEG_ConvertorParams.ImageHeight = pJpegInfo->ImageHeight;
-  JPEG_ConvertorParams.ImageSize_Bytes = pJpegInfo->ImageWidth * pJpegInfo->ImageHeight * JPEG_BYTES_PER_PIXEL;
+  JPEG_ConvertorParams.ImageSize_Bytes = pJpegInfo->ImageWidth * pJpegInfo->ImageHeight * JPEG_OutputBytesPerPixel;
   
   JPEG_ConvertorParams.ChromaSubsampling = pJpegInfo->ChromaSubsampling;  
   if(JPEG_ConvertorParams.ColorSpace == JPEG_YCBCR_COLORSPACE)
@@ -1720,6 +2076,7 @@ HAL_StatusTypeDef JPEG_GetDecodeColorConvertFunc(JPEG_ConfTypeDef *pJpegInfo, JP
     if(JPEG_ConvertorParams.ChromaSubsampling == JPEG_420_SUBSAMPLING)
     {
       *pFunction = JPEG_MCU_YCbCr420_ARGB_ConvertBlocks;
+      JPEG_ConvertorParams.BlockSize = YCBCR_420_BLOCK_SIZE;
 
       JPEG_ConvertorParams.LineOffset = JPEG_ConvertorParams.ImageWidth % 16;
       
@@ -1733,6 +2090,7 @@ HAL_StatusTypeDef JPEG_GetDecodeColorConvertFunc(JPEG_ConfTypeDef *pJpegInfo, JP
     else if(JPEG_ConvertorParams.ChromaSubsampling == JPEG_422_SUBSAMPLING)
     {
       *pFunction =  JPEG_MCU_YCbCr422_ARGB_ConvertBlocks;
+      JPEG_ConvertorParams.BlockSize = YCBCR_422_BLOCK_SIZE;
 
       JPEG_ConvertorParams.LineOffset = JPEG_ConvertorParams.ImageWidth % 16;
       
@@ -1746,6 +2104,7 @@ HAL_StatusTypeDef JPEG_GetDecodeColorConvertFunc(JPEG_ConfTypeDef *pJpegInfo, JP
     else /*4:4:4*/
     {
       *pFunction =  JPEG_MCU_YCbCr444_ARGB_ConvertBlocks;
+      JPEG_ConvertorParams.BlockSize = YCBCR_444_BLOCK_SIZE;
 
       JPEG_ConvertorParams.LineOffset = JPEG_ConvertorParams.ImageWidth % 8;
       
@@ -1760,6 +2119,7 @@ HAL_StatusTypeDef JPEG_GetDecodeColorConvertFunc(JPEG_ConfTypeDef *pJpegInfo, JP
   else if(JPEG_ConvertorParams.ColorSpace == JPEG_GRAYSCALE_COLORSPACE)
   {
     *pFunction =  JPEG_MCU_Gray_ARGB_ConvertBlocks;
+    JPEG_ConvertorParams.BlockSize = GRAY_444_BLOCK_SIZE;
 
     JPEG_ConvertorParams.LineOffset = JPEG_ConvertorParams.ImageWidth % 8;
       
@@ -1773,6 +2133,7 @@ HAL_StatusTypeDef JPEG_GetDecodeColorConvertFunc(JPEG_ConfTypeDef *pJpegInfo, JP
   else if(JPEG_ConvertorParams.ColorSpace == JPEG_CMYK_COLORSPACE)
   {
     *pFunction =  JPEG_MCU_YCCK_ARGB_ConvertBlocks;
+    JPEG_ConvertorParams.BlockSize = CMYK_444_BLOCK_SIZE;
 
     JPEG_ConvertorParams.LineOffset = JPEG_ConvertorParams.ImageWidth % 8;
       
@@ -1789,7 +2150,7 @@ HAL_StatusTypeDef JPEG_GetDecodeColorConvertFunc(JPEG_ConfTypeDef *pJpegInfo, JP
   }
  
   JPEG_ConvertorParams.WidthExtend = JPEG_ConvertorParams.ImageWidth + JPEG_ConvertorParams.LineOffset;
-  JPEG_ConvertorParams.ScaledWidth = JPEG_BYTES_PER_PIXEL * JPEG_ConvertorParams.ImageWidth; 
+  JPEG_ConvertorParams.ScaledWidth = JPEG_OutputBytesPerPixel * JPEG_ConvertorParams.ImageWidth; 
   
   hMCU = (JPEG_ConvertorParams.ImageWidth / JPEG_ConvertorParams.H_factor);
   if((JPEG_ConvertorParams.ImageWidth % JPEG_ConvertorParams.H_factor) != 0)
@@ -1805,6 +2166,11 @@ HAL_StatusTypeDef JPEG_GetDecodeColorConvertFunc(JPEG_ConfTypeDef *pJpegInfo, JP
   JPEG_ConvertorParams.MCU_Total_Nb = (hMCU * vMCU);
   *ImageNbMCUs = JPEG_ConvertorParams.MCU_Total_Nb;
 
+  if(JPEG_OutputFormat != JPEG_RGB_FORMAT)
+  {
+    *pFunction = JPEG_MCU_Any_RGB_ConvertBlocks;
+  }
+
   return HAL_OK;
 }
 
@@ -1845,6 +2211,7 @@ void JPEG_InitColorTables(void)
 
 #if (USE_JPEG_DECODER == 1)
   JPEG_InitPostProcColorTables();
+  JPEG_SetDecodeOutputFormat(JPEG_RGB_FORMAT, NULL, 0);
 #endif
 
 }
@@ -101,6 +101,9 @@ void JPEG_InitColorTables(void);
 
 #if (USE_JPEG_DECODER == 1)
 HAL_StatusTypeDef JPEG_GetDecodeColorConvertFunc(JPEG_ConfTypeDef *pJpegInfo, JPEG_YCbCrToRGB_Convert_Function *pFunction, uint32_t *ImageNbMCUs);
+HAL_StatusTypeDef JPEG_SetDecodeOutputFormat(uint32_t OutputFormat, const uint32_t *pCLUT, uint32_t CLUTSize);
+void JPEG_InvalidateDecodeCLUT(void);
+uint32_t JPEG_GetDecodeBytesPerPixel(void);
 #endif
 
 #if (USE_JPEG_ENCODER == 1)
@@ -121,6 +124,11 @@ HAL_StatusTypeDef JPEG_GetEncodeColorConvertFunc(JPEG_ConfTypeDef *pJpegInfo, JP
 int JPEG_UserInit_HAL (void);
 int JPEG_Info_HAL (jpeg_info_t *info);
 int JPEG_Decode_HAL (jpeg_info_t *info, void *tempbuf, void *data, uint32_t size);
+int JPEG_Decode_HAL_Fmt (jpeg_info_t *info, void *tempbuf, void *data, uint32_t size,
+                         uint32_t outformat, const uint32_t *clut, uint32_t clutsize);
+int JPEG_Decode_HAL_Start (void *tempbuf, void *data, uint32_t size,
+                           uint32_t outformat, const uint32_t *clut, uint32_t clutsize);
+int JPEG_Decode_HAL_Poll (jpeg_info_t *info);
 
 #endif /* __JPEG_UTILS_H */
 
@@ -0,0 +1,212 @@
+#include <string.h>
+#include <arena.h>
+#include <misc_utils.h>
+#include <debug.h>
+
+int arena_region_init (arena_region_t *reg, void *base, uint32_t size,
+                           void *org, uint32_t bank_size)
+{
+    uintptr_t start = (uintptr_t)base, end = start + size, bstart, bend, o = (uintptr_t)org;
+    uint32_t b;
+
+    d_memset(reg, 0, sizeof(*reg));
+    if (bank_size & (ARENA_ALIGN - 1)) {
+        return -1;
+    }
+    if (!bank_size) {
+        bank_size = end - o;
+    }
+    start = ARENA_ALIGN_UP(start);
+    if (start < o || start >= end || (end - o - 1) / bank_size >= ARENA_BANK_MAX) {
+        return -1;
+    }
+    reg->base = (uint8_t *)start;
+    reg->size = end - start;
+    reg->bank_size = bank_size;
+    for (b = 0; b < ARENA_BANK_MAX; b++) {
+        bstart = o + b * bank_size;
+        bend = bstart + bank_size;
+        if (bend <= start || bstart >= end) {
+            continue;
+        }
+        reg->top[b] = (bstart > start ? bstart : start) - start;
+        reg->end[b] = ((bend < end ? bend : end) - start) & ~(ARENA_ALIGN - 1);
+    }
+    return 0;
+}
+
+uint32_t arena_region_room (arena_region_t *reg, uint8_t bank)
+{
+    if (bank >= ARENA_BANK_MAX) {
+        return 0;
+    }
+    return reg->end[bank] - reg->top[bank];
+}
+
+int arena_create (arena_region_t *reg, arena_t *a, const char *name,
+                     uint32_t size, uint8_t bank)
+{
+    arena_t **pp;
+    uint32_t b;
+
+    size = ARENA_ALIGN_UP(size);
+    if (!size) {
+        return -1;
+    }
+    if (bank == ARENA_BANK_ANY) {
+        for (b = 0; b < ARENA_BANK_MAX; b++) {
+            if (bank == ARENA_BANK_ANY || arena_region_room(reg, b) > arena_region_room(reg, bank)) {
+                bank = b;
+            }
+        }
+    }
+    if (arena_region_room(reg, bank) < size) {
+        dprintf("arena \'%s\' : no room for %u bytes in bank %u\n", name, size, bank);
+        return -1;
+    }
+    d_memset(a, 0, sizeof(*a));
+    a->name = name;
+    a->base = reg->base + reg->top[bank];
+    a->size = size;
+    a->bank = bank;
+    reg->top[bank] += size;
+
+    for (pp = &reg->list; *pp; pp = &(*pp)->next) {}
+    *pp = a;
+    return 0;
+}
+
+int arena_release (arena_region_t *reg, arena_t *a)
+{
+    arena_t **pp;
+
+    if (a->base + a->size != reg->base + reg->top[a->bank]) {
+        return -1;
+    }
+    for (pp = &reg->list; *pp && *pp != a; pp = &(*pp)->next) {}
+    if (!*pp) {
+        return -1;
+    }
+    *pp = a->next;
+    reg->top[a->bank] -= a->size;
+    a->size = 0;
+    a->used = 0;
+    return 0;
+}
+
+arena_t *arena_find (arena_region_t *reg, const char *name)
+{
+    arena_t *a;
+
+    for (a = reg->list; a; a = a->next) {
+        if (!strcmp(a->name, name)) {
+            return a;
+        }
+    }
+    return NULL;
+}
+
+void arena_region_dump (arena_region_t *reg)
+{
+    uint32_t b, room = 0;
+    arena_t *a;
+
+    for (b = 0; b < ARENA_BANK_MAX; b++) {
+        room += arena_region_room(reg, b);
+    }
+    dprintf("region <%p> : %u bytes, carved %u, free %u\n",
+            reg->base, reg->size, reg->size - room, room);
+    for (b = 0; b < ARENA_BANK_MAX; b++) {
+        if (reg->end[b] == reg->top[b] && !reg->top[b]) {
+            continue;
+        }
+        dprintf("bank %u : <%p> free %u bytes\n", b, reg->base + reg->top[b],
+                arena_region_room(reg, b));
+    }
+    dprintf("%-12s %4s %10s %10s %10s %10s %8s %6s\n",
+            "name", "bank", "base", "size", "used", "peak", "allocs", "fails");
+    for (a = reg->list; a; a = a->next) {
+        dprintf("%-12s %4u %10p %10u %10u %10u %8u %6u\n",
+                a->name, a->bank, a->base, a->size, a->used, a->peak, a->allocs, a->fails);
+    }
+}
+
+#if defined(BSP_DRIVER)
+
+#include <stm32f769i_discovery_sdram.h>
+#include <bsp_cmd.h>
+#include <heap.h>
+
+/*Internal banks of the board SDRAM, see arena.h*/
+#define SDRAM_BANK_SIZE (SDRAM_DEVICE_SIZE / 4)
+
+static arena_region_t sdram_arena_reg;
+static d_bool sdram_arena_ready = d_false;
+
+static int sdram_arena_cmd (int argc, const char **argv);
+
+/*Heap block inside the window : SDRAM_HEAP_LIMIT doesn't match the heap*/
+static d_bool sdram_heap_clash (void)
+{
+    uint8_t *window = (uint8_t *)(SDRAM_DEVICE_ADDR + SDRAM_ARENA_OFFSET);
+    uint8_t *p = heap_malloc(ARENA_ALIGN);
+    d_bool clash = p && p >= window && p < window + SDRAM_ARENA_SIZE;
+
+    if (clash) {
+        dprintf("arena : heap <%p> inside the window, limit %u\n", p, SDRAM_HEAP_LIMIT);
+    }
+    if (p) {
+        heap_free(p);
+    }
+    return clash;
+}
+
+arena_region_t *sdram_region (void)
+{
+    if (!sdram_arena_ready) {
+        if (SDRAM_ARENA_OFFSET + SDRAM_ARENA_SIZE > SDRAM_DEVICE_SIZE) {
+            dprintf("arena : window out of sdram\n");
+            return NULL;
+        }
+        if (sdram_heap_clash()) {
+            return NULL;
+        }
+        if (arena_region_init(&sdram_arena_reg,
+                              (void *)(SDRAM_DEVICE_ADDR + SDRAM_ARENA_OFFSET), SDRAM_ARENA_SIZE,
+                              (void *)SDRAM_DEVICE_ADDR, SDRAM_BANK_SIZE) < 0) {
+            return NULL;
+        }
+        cmd_register_func(sdram_arena_cmd, "arena");
+        sdram_arena_ready = d_true;
+    }
+    return &sdram_arena_reg;
+}
+
+int sdram_arena_create (arena_t *a, const char *name, uint32_t size, uint8_t bank)
+{
+    arena_region_t *reg = sdram_region();
+
+    if (!reg) {
+        return -1;
+    }
+    return arena_create(reg, a, name, size, bank);
+}
+
+/*arena [reset] - usage report, reset clears peak and counters*/
+static int sdram_arena_cmd (int argc, const char **argv)
+{
+    arena_t *a;
+
+    if (argc > 0 && !strcmp(argv[0], "reset")) {
+        for (a = sdram_arena_reg.list; a; a = a->next) {
+            a->peak = a->used;
+            a->allocs = 0;
+            a->fails = 0;
+        }
+        return 0;
+    }
+    arena_region_dump(&sdram_arena_reg);
+    return 0;
+}
+
+#endif /*BSP_DRIVER*/
@@ -0,0 +1,304 @@
+#include <string.h>
+#include <audio_adpcm.h>
+#include <audio_mix.h>
+
+static const int16_t a_adpcm_step[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+    11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+    32767
+};
+
+static const int8_t a_adpcm_index[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+static inline int32_t
+a_adpcm_nibble (int32_t *pred, int8_t *index, uint32_t nib)
+{
+    int32_t step = a_adpcm_step[*index];
+    int32_t diff = step >> 3;
+    int32_t p;
+
+    if (nib & 4) diff += step;
+    if (nib & 2) diff += step >> 1;
+    if (nib & 1) diff += step >> 2;
+    p = *pred + ((nib & 8) ? -diff : diff);
+    if (p > INT16_MAX) {
+        p = INT16_MAX;
+    } else if (p < INT16_MIN) {
+        p = INT16_MIN;
+    }
+    *pred = p;
+    p = *index + a_adpcm_index[nib];
+    *index = (int8_t)(p < 0 ? 0 : (p > 88 ? 88 : p));
+    return *pred;
+}
+
+static inline const uint8_t *
+a_adpcm_block (a_adpcm_t *st, uint32_t blk)
+{
+    return st->data + blk * A_ADPCM_BLOCK;
+}
+
+/*Loads channel headers of block, position is at the header frame*/
+static void
+a_adpcm_load (a_adpcm_t *st, uint32_t blk)
+{
+    const uint8_t *p = a_adpcm_block(st, blk);
+    int c;
+
+    for (c = 0; c < st->chans; c++) {
+        st->pred[c] = (int16_t)(p[0] | (p[1] << 8));
+        st->index[c] = (int8_t)(p[2] > 88 ? 88 : p[2]);
+        p += 4;
+    }
+    st->p = p;
+    st->bpos = 0;
+}
+
+int
+a_adpcm_init (a_adpcm_t *st, const void *asset)
+{
+    a_adpcm_hdr_t hdr;
+
+    memcpy(&hdr, asset, sizeof(hdr));
+    if (hdr.magic != A_ADPCM_MAGIC || hdr.blocksize != A_ADPCM_BLOCK ||
+        hdr.chans < 1 || hdr.chans > 2 || !hdr.frames) {
+        return -1;
+    }
+    memset(st, 0, sizeof(*st));
+    st->data = (const uint8_t *)asset + sizeof(hdr);
+    st->frames = hdr.frames;
+    st->loopstart = hdr.loopstart < hdr.frames ? hdr.loopstart : A_ADPCM_NOLOOP;
+    st->chans = hdr.chans;
+    a_adpcm_load(st, 0);
+    return 0;
+}
+
+void
+a_adpcm_seek (a_adpcm_t *st, uint32_t frame)
+{
+    const uint32_t bf = A_ADPCM_BLOCK_FRAMES(st->chans);
+    uint32_t skip;
+
+    if (frame >= st->frames) {
+        st->pos = st->frames;
+        return;
+    }
+    a_adpcm_load(st, frame / bf);
+    st->pos = frame;
+    skip = frame % bf;
+    if (!skip) {
+        return;
+    }
+    /*Header frame is the value of frame 0, decode up to 'frame - 1'*/
+    st->bpos = 1;
+    while (--skip) {
+        if (st->chans == 2) {
+            uint32_t b = *st->p++;
+            a_adpcm_nibble(&st->pred[0], &st->index[0], b & 0xf);
+            a_adpcm_nibble(&st->pred[1], &st->index[1], b >> 4);
+        } else if (st->bpos & 1) {
+            a_adpcm_nibble(&st->pred[0], &st->index[0], *st->p & 0xf);
+        } else {
+            a_adpcm_nibble(&st->pred[0], &st->index[0], *st->p++ >> 4);
+        }
+        st->bpos++;
+    }
+}
+
+int
+a_adpcm_done (a_adpcm_t *st)
+{
+    return st->pos >= st->frames;
+}
+
+static int
+a_adpcm_mix_run (a_adpcm_t *st, int32_t *acc, int16_t left, int16_t right, int frames)
+{
+    const uint32_t bf = A_ADPCM_BLOCK_FRAMES(st->chans);
+    const uint8_t *p;
+    int32_t l, r;
+    uint32_t bpos, n, left_in_blk;
+    int done = 0;
+
+    while (frames > 0 && st->pos < st->frames) {
+        if (st->bpos == bf) {
+            a_adpcm_load(st, st->pos / bf);
+        }
+        if (st->bpos == 0) {
+            /*Header frame*/
+            l = st->pred[0];
+            r = st->pred[st->chans - 1];
+            acc[0] += (l * left) >> 15;
+            acc[1] += (r * right) >> 15;
+            acc += 2;
+            st->bpos = 1;
+            st->pos++;
+            frames--;
+            done++;
+            continue;
+        }
+        left_in_blk = bf - st->bpos;
+        n = st->frames - st->pos;
+        if (n > left_in_blk) {
+            n = left_in_blk;
+        }
+        if (n > (uint32_t)frames) {
+            n = frames;
+        }
+        p = st->p;
+        bpos = st->bpos;
+        st->pos += n;
+        st->bpos += n;
+        frames -= n;
+        done += n;
+        if (st->chans == 2) {
+            int32_t pl = st->pred[0], pr = st->pred[1];
+            int8_t il = st->index[0], ir = st->index[1];
+            uint32_t b;
+
+            while (n--) {
+                b = *p++;
+                l = a_adpcm_nibble(&pl, &il, b & 0xf);
+                r = a_adpcm_nibble(&pr, &ir, b >> 4);
+                acc[0] += (l * left) >> 15;
+                acc[1] += (r * right) >> 15;
+                acc += 2;
+            }
+            st->pred[0] = pl;
+            st->pred[1] = pr;
+            st->index[0] = il;
+            st->index[1] = ir;
+        } else {
+            int32_t pm = st->pred[0];
+            int8_t im = st->index[0];
+
+            /*bpos 1 is the low nibble of first data byte*/
+            while (n--) {
+                l = a_adpcm_nibble(&pm, &im, (bpos & 1) ? (*p & 0xf) : (*p++ >> 4));
+                acc[0] += (l * left) >> 15;
+                acc[1] += (l * right) >> 15;
+                acc += 2;
+                bpos++;
+            }
+            st->pred[0] = pm;
+            st->index[0] = im;
+        }
+        st->p = p;
+    }
+    return done;
+}
+
+int
+a_adpcm_mix (a_adpcm_t *st, int32_t *acc, int16_t left, int16_t right, int frames)
+{
+    int done = 0, n;
+
+    while (frames > 0) {
+        n = a_adpcm_mix_run(st, acc, left, right, frames);
+        done += n;
+        frames -= n;
+        acc += n * 2;
+        if (st->pos < st->frames || st->loopstart == A_ADPCM_NOLOOP) {
+            break;
+        }
+        a_adpcm_seek(st, st->loopstart);
+    }
+    a_mix_count(done * 2);
+    return done;
+}
+
+uint32_t
+a_adpcm_encoded_size (uint32_t frames, int chans)
+{
+    const uint32_t bf = A_ADPCM_BLOCK_FRAMES(chans);
+
+    return sizeof(a_adpcm_hdr_t) + ((frames + bf - 1) / bf) * A_ADPCM_BLOCK;
+}
+
+static uint32_t
+a_adpcm_enc_nibble (int32_t *pred, int8_t *index, int32_t s)
+{
+    int32_t step = a_adpcm_step[*index], diff = s - *pred;
+    uint32_t nib = 0;
+
+    if (diff < 0) {
+        nib = 8;
+        diff = -diff;
+    }
+    if (diff >= step) {
+        nib |= 4;
+        diff -= step;
+    }
+    step >>= 1;
+    if (diff >= step) {
+        nib |= 2;
+        diff -= step;
+    }
+    step >>= 1;
+    if (diff >= step) {
+        nib |= 1;
+    }
+    /*Track decoder state exactly*/
+    a_adpcm_nibble(pred, index, nib);
+    return nib;
+}
+
+uint32_t
+a_adpcm_encode (const int16_t *pcm, uint32_t frames, int chans,
+                            uint32_t samplerate, uint32_t loopstart, void *out)
+{
+    const uint32_t bf = A_ADPCM_BLOCK_FRAMES(chans);
+    uint8_t *o = (uint8_t *)out, *blk, *p;
+    a_adpcm_hdr_t hdr;
+    int32_t pred[2] = {0, 0};
+    int8_t index[2] = {0, 0};
+    uint32_t f, i, n, nib;
+    int32_t s, d;
+    int c, k;
+
+    hdr.magic = A_ADPCM_MAGIC;
+    hdr.samplerate = samplerate;
+    hdr.frames = frames;
+    hdr.loopstart = loopstart;
+    hdr.chans = chans;
+    hdr.blocksize = A_ADPCM_BLOCK;
+    memcpy(o, &hdr, sizeof(hdr));
+    blk = o + sizeof(hdr);
+
+    for (f = 0; f < frames; f += bf, blk += A_ADPCM_BLOCK) {
+        memset(blk, 0, A_ADPCM_BLOCK);
+        n = frames - f < bf ? frames - f : bf;
+        p = blk;
+        for (c = 0; c < chans; c++) {
+            pred[c] = pcm[f * chans + c];
+            /*Index for the first step from the local slope*/
+            d = n > 1 ? pcm[(f + 1) * chans + c] - pred[c] : 0;
+            d = d < 0 ? -d : d;
+            for (k = 0; k < 88 && a_adpcm_step[k] < d; k++) {}
+            index[c] = (int8_t)k;
+            p[0] = pred[c] & 0xff;
+            p[1] = (pred[c] >> 8) & 0xff;
+            p[2] = index[c];
+            p[3] = 0;
+            p += 4;
+        }
+        for (i = 1; i < n; i++) {
+            for (c = 0; c < chans; c++) {
+                s = pcm[(f + i) * chans + c];
+                nib = a_adpcm_enc_nibble(&pred[c], &index[c], s);
+                if (chans == 2) {
+                    p[i - 1] |= nib << (c * 4);
+                } else {
+                    p[(i - 1) >> 1] |= nib << (((i - 1) & 1) * 4);
+                }
+            }
+        }
+    }
+    return blk - o;
+}
@@ -0,0 +1,166 @@
+#include <string.h>
+#include <math.h>
+#include <audio_dsp.h>
+
+void
+a_dsp_db2gain (float db, int16_t *frac, int8_t *shift)
+{
+    float g = powf(10.0f, db / 20.0f);
+    int8_t s = 0;
+    int32_t f;
+
+    while (g >= 1.0f && s < 15) {
+        g *= 0.5f;
+        s++;
+    }
+    f = (int32_t)(g * 32768.0f + 0.5f);
+    *frac = f > INT16_MAX ? INT16_MAX : (int16_t)f;
+    *shift = s;
+}
+
+#if A_DSP_CMSIS
+
+void
+a_dsp_biquad_init (a_dsp_biquad_t *bq, int stages, int32_t *coefs,
+                        int32_t *state, int postshift)
+{
+    arm_biquad_cascade_df1_init_q31(bq, stages, coefs, state, postshift);
+}
+
+void
+a_dsp_biquad (const a_dsp_biquad_t *bq, int32_t *src, int32_t *dst, int samples)
+{
+    arm_biquad_cascade_df1_q31(bq, src, dst, samples);
+}
+
+void
+a_dsp_scale (int16_t *src, int16_t frac, int shift, int16_t *dst, int samples)
+{
+    arm_scale_q15(src, frac, shift, dst, samples);
+}
+
+void
+a_dsp_add (int16_t *a, int16_t *b, int16_t *dst, int samples)
+{
+    arm_add_q15(a, b, dst, samples);
+}
+
+void
+a_dsp_offset (int16_t *src, int16_t offset, int16_t *dst, int samples)
+{
+    arm_offset_q15(src, offset, dst, samples);
+}
+
+int16_t
+a_dsp_mean (int16_t *src, int samples)
+{
+    int16_t mean;
+
+    arm_mean_q15(src, samples, &mean);
+    return mean;
+}
+
+#else /*A_DSP_CMSIS*/
+
+static inline int16_t
+a_dsp_sat16 (int64_t v)
+{
+    if (v > INT16_MAX) {
+        return INT16_MAX;
+    } else if (v < INT16_MIN) {
+        return INT16_MIN;
+    }
+    return (int16_t)v;
+}
+
+void
+a_dsp_biquad_init (a_dsp_biquad_t *bq, int stages, int32_t *coefs,
+                        int32_t *state, int postshift)
+{
+    bq->numStages = stages;
+    bq->postShift = postshift;
+    bq->pCoeffs = coefs;
+    bq->pState = state;
+    memset(state, 0, stages * A_DSP_BQ_STATE * sizeof(*state));
+}
+
+void
+a_dsp_biquad (const a_dsp_biquad_t *bq, int32_t *src, int32_t *dst, int samples)
+{
+    const int32_t *c = bq->pCoeffs;
+    int32_t *st = bq->pState, *in = src;
+    int shift = 31 - bq->postShift;
+    uint32_t stage;
+    int32_t x1, x2, y1, y2, x;
+    int64_t acc;
+    int i;
+
+    for (stage = 0; stage < bq->numStages; stage++) {
+        x1 = st[0];
+        x2 = st[1];
+        y1 = st[2];
+        y2 = st[3];
+        for (i = 0; i < samples; i++) {
+            x = in[i];
+            acc = (int64_t)c[0] * x;
+            acc += (int64_t)c[1] * x1;
+            acc += (int64_t)c[2] * x2;
+            acc += (int64_t)c[3] * y1;
+            acc += (int64_t)c[4] * y2;
+            x2 = x1;
+            x1 = x;
+            y2 = y1;
+            /*no saturation, as CMSIS*/
+            y1 = (int32_t)(acc >> shift);
+            dst[i] = y1;
+        }
+        st[0] = x1;
+        st[1] = x2;
+        st[2] = y1;
+        st[3] = y2;
+        st += A_DSP_BQ_STATE;
+        c += A_DSP_BQ_COEFS;
+        /*next stage works in place*/
+        in = dst;
+    }
+}
+
+void
+a_dsp_scale (int16_t *src, int16_t frac, int shift, int16_t *dst, int samples)
+{
+    int kshift = 15 - shift;
+
+    while (samples-- > 0) {
+        *dst++ = a_dsp_sat16(((int32_t)*src++ * frac) >> kshift);
+    }
+}
+
+void
+a_dsp_add (int16_t *a, int16_t *b, int16_t *dst, int samples)
+{
+    while (samples-- > 0) {
+        *dst++ = a_dsp_sat16((int32_t)*a++ + *b++);
+    }
+}
+
+void
+a_dsp_offset (int16_t *src, int16_t offset, int16_t *dst, int samples)
+{
+    while (samples-- > 0) {
+        *dst++ = a_dsp_sat16((int32_t)*src++ + offset);
+    }
+}
+
+int16_t
+a_dsp_mean (int16_t *src, int samples)
+{
+    int32_t sum = 0;
+    int i;
+
+    for (i = 0; i < samples; i++) {
+        sum += src[i];
+    }
+    return (int16_t)(sum / samples);
+}
+
+#endif /*A_DSP_CMSIS*/
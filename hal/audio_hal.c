@@ -4,10 +4,14 @@
 #include <audio_int.h>
 #include <wm8994.h>
 #include <nvic.h>
+#include <audio_ring.h>
+#include <audio_mic.h>
 
 #include <audio_main.h>
 #include <debug.h>
 #include <config.h>
+#include <heap.h>
+#include <bsp_cmd.h>
 
 #if AUDIO_MODULE_PRESENT
 
@@ -18,19 +22,71 @@ int g_audio_isr_pend[A_ISR_MAX] = {0};
 
 d_bool g_audio_proc_isr = d_true;
 
+a_voice_pool_t g_audio_voices = A_VOICE_POOL_INIT(AUDIO_MAX_VOICES);
+
+/*Periods are mixed ahead in thread context, isr only moves them to the dma buffer*/
+d_bool g_audio_proc_ring = d_false;
+
+static a_ring_t a_mix_ring;
+static void *a_mix_ring_mem = NULL;
+static int a_mix_ring_samples = 0;
+static a_ring_stat_t a_mix_ring_stat;
+/*Per block, block holds an old period and must be cleared before the mix*/
+static d_bool a_mix_ring_dirty[A_RING_DEPTH_MAX];
+
+/*Runtime sized dma buffer, NULL - master from a_get_master_base*/
+static snd_sample_t *a_hal_dmabuf = NULL;
+static a_period_t a_hal_period;
+
+static a_tel_t a_hal_tel_blk;
+static d_bool a_hal_cmd_ready = d_false;
+
+#define A_TEL_NOW() (DWT->CYCCNT)
+
+static void
+a_hal_master4idx (a_buf_t *master, int idx)
+{
+    if (a_hal_dmabuf) {
+        master->buf = a_hal_dmabuf + idx * a_hal_period.samples;
+        master->samples = a_hal_period.samples;
+        master->dirty = NULL;
+    } else {
+        a_get_master4idx(master, idx);
+    }
+}
+
 static void
 __DMA_on_tx_complete_isr (isr_status_e status)
 {
     a_buf_t master;
+    uint32_t t;
+
     g_audio_isr_status = status;
-    a_get_master4idx(&master, status == A_ISR_HALF ? 0 : 1);
+    a_hal_master4idx(&master, status == A_ISR_HALF ? 0 : 1);
+    t = A_TEL_NOW();
     a_paint_buff_helper(&master);
+    a_post_process(master.buf, master.samples);
+    a_tel_mix(&a_hal_tel_blk, t, A_TEL_NOW());
+    a_tel_voices(&a_hal_tel_blk, a_mix_voices_taken(master.samples));
+}
+
+static void
+__DMA_on_tx_complete_ring (isr_status_e status)
+{
+    a_buf_t master;
+
+    g_audio_isr_status = status;
+    a_hal_master4idx(&master, status == A_ISR_HALF ? 0 : 1);
+    a_ring_play(&a_mix_ring, &a_mix_ring_stat, master.buf);
 }
 
 static void
 __DMA_on_tx_complete_dsr (isr_status_e status)
 {
     g_audio_isr_status = status;
+    if (g_audio_isr_pend[status]) {
+        a_hal_tel_blk.missed++;
+    }
     g_audio_isr_pend[status]++;
     a_dsr_hung_fuse(status);
 }
@@ -38,38 +94,377 @@ __DMA_on_tx_complete_dsr (isr_status_e status)
 static void
 __DMA_on_tx_complete (isr_status_e status)
 {
-    if (g_audio_proc_isr) {
+    a_tel_callback(&a_hal_tel_blk, A_TEL_NOW());
+    if (g_audio_proc_ring) {
+        __DMA_on_tx_complete_ring(status);
+    } else if (g_audio_proc_isr) {
         __DMA_on_tx_complete_isr(status);
     } else {
         __DMA_on_tx_complete_dsr(status);
     }
 }
 
+static void a_hal_tel_start (const a_intcfg_t *cfg);
+static int a_hal_ring_check (int depth);
+static void a_hal_ring_start (void *mem, int depth);
+
+/*
+ * Allocates dma buffer for new period size, and the period ring if ring
+ * mode was asked for (a_hal_ring_init) : otherwise the isr keeps painting
+ * and nothing else would drain the ring. Previous ones are released only
+ * when all are in place, on error nothing is changed. Dma must be stopped.
+ */
+static int
+a_hal_period_install (a_intcfg_t *cfg, uint32_t frames, uint32_t periods)
+{
+    a_period_t period;
+    snd_sample_t *buf;
+    void *ring = NULL;
+    d_bool ringmode = a_mix_ring_mem != NULL;
+
+    if (a_period_calc(cfg->samplerate, cfg->channels, cfg->samplebits,
+                      frames, periods, &period) < 0 ||
+        (ringmode && a_hal_ring_check(period.ringdepth) < 0)) {
+        dprintf("%s() : invalid period= %u x %u\n", __func__, frames, periods);
+        return -1;
+    }
+    buf = heap_alloc_shared(period.dmasize);
+    if (!buf) {
+        return -1;
+    }
+    if (ringmode) {
+        ring = heap_malloc(AUDIO_SAMPLES_2_BYTES(period.samples) * period.ringdepth);
+        if (!ring) {
+            heap_free(buf);
+            return -1;
+        }
+    }
+    d_memset(buf, 0, period.dmasize);
+
+    a_hal_ring_deinit();
+    if (a_hal_dmabuf) {
+        heap_free(a_hal_dmabuf);
+    }
+    a_hal_dmabuf = buf;
+    a_hal_period = period;
+    if (ring) {
+        /*Mixer paints only into the ring, its own master buffer is not used*/
+        a_hal_ring_start(ring, period.ringdepth);
+    }
+    a_hal_period_info(&period);
+    dprintf("audio period : %u frames, %u us, ring %d, latency %u us\n",
+            period.frames, period.period_us, period.ringdepth, period.latency_us);
+    return 0;
+}
+
+int
+a_hal_set_period (a_intcfg_t *cfg, uint32_t frames, uint32_t periods)
+{
+    a_period_t period;
+    a_buf_t master;
+
+    if (cfg->sink != A_SINK_SAI ||
+        a_period_calc(cfg->samplerate, cfg->channels, cfg->samplebits,
+                      frames, periods, &period) < 0) {
+        return -1;
+    }
+    /*No callbacks after this, buffers may be swapped*/
+    HAL_SAI_DMAStop(&haudio_out_sai);
+    if (a_hal_period_install(cfg, frames, periods) < 0) {
+        /*Nothing was changed, keep playing what was there*/
+        if (a_hal_dmabuf) {
+            BSP_AUDIO_OUT_ChangeBuffer((uint16_t *)a_hal_dmabuf,
+                                       DMA_MAX(a_hal_period.dmasize / AUDIODATA_SIZE));
+        } else {
+            a_get_master_base(&master);
+            BSP_AUDIO_OUT_ChangeBuffer((uint16_t *)master.buf,
+                                       DMA_MAX(AUDIO_SAMPLES_2_BYTES(master.samples) / AUDIODATA_SIZE));
+        }
+        return -1;
+    }
+    BSP_AUDIO_OUT_ChangeBuffer((uint16_t *)a_hal_dmabuf,
+                               DMA_MAX(a_hal_period.dmasize / AUDIODATA_SIZE));
+    cfg->periodsize = frames;
+    cfg->periods = periods;
+    a_hal_tel_start(cfg);
+    return 0;
+}
+
+int
+a_hal_set_latency (a_intcfg_t *cfg, a_latency_e preset)
+{
+    uint32_t frames, periods;
+
+    a_period_preset(preset, &frames, &periods);
+    if (!frames) {
+        return -1;
+    }
+    return a_hal_set_period(cfg, frames, periods);
+}
+
+void
+a_hal_period_info (a_period_t *period)
+{
+    a_buf_t master;
+
+    if (a_hal_dmabuf) {
+        *period = a_hal_period;
+    } else {
+        a_get_master4idx(&master, 0);
+        d_memset(period, 0, sizeof(*period));
+        period->samples = master.samples;
+        period->bytes = AUDIO_SAMPLES_2_BYTES(master.samples);
+        period->dmasize = period->bytes * 2;
+    }
+    /*What runs now : isr painting (one period ahead) or the ring*/
+    period->ringdepth = a_mix_ring_mem ? a_mix_ring.depth : 0;
+    period->latency_us = period->period_us * (period->ringdepth + 1);
+}
+
+static void
+a_hal_tel_start (const a_intcfg_t *cfg)
+{
+    a_period_t period;
+    uint32_t frames;
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->LAR = 0xC5ACCE55;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    a_hal_period_info(&period);
+    frames = period.samples / cfg->channels;
+    a_tel_reset(&a_hal_tel_blk,
+                (uint32_t)(((uint64_t)SystemCoreClock * frames) / cfg->samplerate),
+                SystemCoreClock);
+}
+
+void
+a_hal_tel (a_tel_t *tel)
+{
+    irqmask_t irq_flags;
+
+    irq_save(&irq_flags);
+    *tel = a_hal_tel_blk;
+    irq_restore(irq_flags);
+}
+
+void
+a_hal_tel_reset (void)
+{
+    irqmask_t irq_flags;
+
+    irq_save(&irq_flags);
+    a_tel_reset(&a_hal_tel_blk, a_hal_tel_blk.period, a_hal_tel_blk.clock);
+    irq_restore(irq_flags);
+}
+
+void
+a_hal_tel_dump (void)
+{
+    a_tel_t tel;
+    a_ring_stat_t ring;
+    uint32_t avg;
+
+    a_hal_tel(&tel);
+    dprintf("audio : period= %u us, late= %u, missed= %u, voices= %u (max %u)\n",
+            a_tel_us(&tel, tel.period), tel.late, tel.missed, tel.voices, tel.voicesmax);
+    avg = tel.interval.cnt ? (uint32_t)(tel.interval.total / tel.interval.cnt) : 0;
+    dprintf("dma interval us : avg= %u, min= %u, max= %u\n",
+            a_tel_us(&tel, avg), a_tel_us(&tel, tel.interval.min), a_tel_us(&tel, tel.interval.max));
+    avg = tel.mix.cnt ? (uint32_t)(tel.mix.total / tel.mix.cnt) : 0;
+    dprintf("mix us : avg= %u, max= %u, last= %u, load= %u%% (max %u%%)\n",
+            a_tel_us(&tel, avg), a_tel_us(&tel, tel.mix.max), a_tel_us(&tel, tel.mix.last),
+            tel.period ? (avg * 100) / tel.period : 0,
+            tel.period ? (tel.mix.max * 100) / tel.period : 0);
+    if (a_mix_ring_mem) {
+        a_hal_ring_stat(&ring);
+        dprintf("ring : depth= %d, lead= %d, minlead= %d, underruns= %u\n",
+                ring.depth, ring.lead, ring.minlead, ring.underruns);
+    }
+}
+
+static int
+a_hal_tel_cmd (int argc, const char **argv)
+{
+    if (argc > 0 && !strcmp(argv[0], "reset")) {
+        a_hal_tel_reset();
+        a_hal_ring_stat_reset();
+        return 0;
+    }
+    a_hal_tel_dump();
+    return 0;
+}
+
 void
 a_hal_configure (a_intcfg_t *cfg)
 {
   a_buf_t master;
   irqmask_t irq_flags;
+
+  a_post_init(cfg->samplerate);
+#if USE_REVERB
+  a_rev_init();
+#endif
+  if (cfg->sink != A_SINK_SAI) {
+      if (a_sink_configure(cfg) < 0) {
+          error_handle();
+      }
+      return;
+  }
   irq_bmap(&irq_flags);
   BSP_AUDIO_OUT_Init(OUTPUT_DEVICE_AUTO, cfg->volume, cfg->samplerate);
   BSP_AUDIO_OUT_SetAudioFrameSlot(CODEC_AUDIOFRAME_SLOT_02);
 
-  a_get_master_base(&master);
-  BSP_AUDIO_OUT_Play((uint16_t *)master.buf, AUDIO_SAMPLES_2_BYTES(master.samples));
+  if (cfg->periodsize && a_hal_period_install(cfg, cfg->periodsize, cfg->periods) == 0) {
+      BSP_AUDIO_OUT_Play((uint16_t *)a_hal_dmabuf, a_hal_period.dmasize);
+  } else {
+      cfg->periodsize = 0;
+      a_get_master_base(&master);
+      BSP_AUDIO_OUT_Play((uint16_t *)master.buf, AUDIO_SAMPLES_2_BYTES(master.samples));
+  }
+  a_hal_tel_start(cfg);
+  if (!a_hal_cmd_ready) {
+      cmd_register_func(a_hal_tel_cmd, "audiostat");
+      a_hal_cmd_ready = d_true;
+  }
   irq_bmap(&cfg->irq);
   cfg->irq = cfg->irq & (~irq_flags);
 }
 
 void a_hal_shutdown (void)
 {
+    if (a_get_conf()->sink != A_SINK_SAI) {
+        a_sink_close();
+        return;
+    }
     BSP_AUDIO_OUT_Stop(CODEC_PDWN_SW);
 }
 
+static int
+a_hal_ring_check (int depth)
+{
+    if (depth <= 0 || (depth & (depth - 1)) || depth > A_RING_DEPTH_MAX) {
+        dprintf("%s() : invalid depth= %d\n", __func__, depth);
+        return -1;
+    }
+    return 0;
+}
+
+int
+a_hal_ring_init (int depth)
+{
+    a_buf_t master;
+    void *mem;
+
+    if (a_hal_ring_check(depth) < 0) {
+        return -1;
+    }
+    a_hal_ring_deinit();
+
+    a_hal_master4idx(&master, 0);
+    mem = heap_malloc(AUDIO_SAMPLES_2_BYTES(master.samples) * depth);
+    if (!mem) {
+        return -1;
+    }
+    a_hal_ring_start(mem, depth);
+    return 0;
+}
+
+/*'mem' holds 'depth' master periods, old ring must be released*/
+static void
+a_hal_ring_start (void *mem, int depth)
+{
+    a_buf_t master;
+    uint32_t blksize;
+    irqmask_t irq_flags;
+    int i;
+
+    a_hal_master4idx(&master, 0);
+    a_mix_ring_samples = master.samples;
+    blksize = AUDIO_SAMPLES_2_BYTES(master.samples);
+    a_mix_ring_mem = mem;
+    a_ring_init(&a_mix_ring, a_mix_ring_mem, blksize, depth);
+    for (i = 0; i < depth; i++) {
+        a_mix_ring_dirty[i] = d_true;
+    }
+    /*
+     * Isr must stop painting before the mixer runs here : from now on
+     * it only takes blocks from the ring, silence until the first one
+     */
+    irq_save(&irq_flags);
+    g_audio_proc_ring = d_true;
+    irq_restore(irq_flags);
+    /*Pre-roll : start with full lead*/
+    a_hal_ring_mix();
+
+    irq_save(&irq_flags);
+    a_hal_ring_stat_reset();
+    irq_restore(irq_flags);
+}
+
+void
+a_hal_ring_deinit (void)
+{
+    irqmask_t irq_flags;
+
+    if (!a_mix_ring_mem) {
+        return;
+    }
+    irq_save(&irq_flags);
+    g_audio_proc_ring = d_false;
+    irq_restore(irq_flags);
+    heap_free(a_mix_ring_mem);
+    a_mix_ring_mem = NULL;
+}
+
+/*Called from thread context, mixes periods until ring is full*/
+int
+a_hal_ring_mix (void)
+{
+    a_buf_t abuf;
+    uint32_t t;
+    int cnt = 0;
+
+    if (!a_mix_ring_mem) {
+        return 0;
+    }
+    while ((abuf.buf = a_ring_wr_block(&a_mix_ring)) != NULL) {
+        abuf.samples = a_mix_ring_samples;
+        abuf.dirty = &a_mix_ring_dirty[a_mix_ring.wr & (a_mix_ring.depth - 1)];
+        t = A_TEL_NOW();
+        a_paint_buff_helper(&abuf);
+        a_post_process(abuf.buf, abuf.samples);
+        a_tel_mix(&a_hal_tel_blk, t, A_TEL_NOW());
+        a_tel_voices(&a_hal_tel_blk, a_mix_voices_taken(abuf.samples));
+        a_ring_wr_commit(&a_mix_ring);
+        a_mix_ring_stat.produced++;
+        cnt++;
+    }
+    return cnt;
+}
+
+void
+a_hal_ring_stat (a_ring_stat_t *stat)
+{
+    *stat = a_mix_ring_stat;
+}
+
+void
+a_hal_ring_stat_reset (void)
+{
+    a_ring_stat_reset(&a_mix_ring, &a_mix_ring_stat);
+}
+
 void
 a_hal_deinit(void)
 {
   BSP_AUDIO_OUT_DeInit();
   BSP_AUDIO_OUT_DeInit();
+  a_hal_ring_deinit();
+  if (a_hal_dmabuf) {
+      heap_free(a_hal_dmabuf);
+      a_hal_dmabuf = NULL;
+  }
 }
 
 void BSP_AUDIO_OUT_HalfTransfer_CallBack(void)
@@ -90,6 +485,9 @@ void BSP_AUDIO_OUT_Error_CallBack(void)
 
 void AUDIO_OUT_SAIx_DMAx_IRQHandler(void)
 {
+  if (a_mic_dma_irq(AUDIO_OUT_SAIx_DMAx_STREAM)) {
+    return;
+  }
   HAL_DMA_IRQHandler(haudio_out_sai.hdmatx);
 }
 
@@ -0,0 +1,336 @@
+#include <string.h>
+#include <math.h>
+
+#include <audio_mic.h>
+
+#define A_MIC_SOUND_UM_PER_S (343000000.0f)
+
+static const int32_t a_mic_xy[A_MIC_MAX][2] = {
+    [A_MIC_TOP_LEFT]        = {-A_MIC_PITCH_X_UM / 2,  A_MIC_PITCH_Y_UM / 2},
+    [A_MIC_TOP_RIGHT]       = { A_MIC_PITCH_X_UM / 2,  A_MIC_PITCH_Y_UM / 2},
+    [A_MIC_BOTTOM_LEFT]     = {-A_MIC_PITCH_X_UM / 2, -A_MIC_PITCH_Y_UM / 2},
+    [A_MIC_BOTTOM_RIGHT]    = { A_MIC_PITCH_X_UM / 2, -A_MIC_PITCH_Y_UM / 2},
+};
+
+int
+a_mic_init (a_mic_t *mic, uint32_t samplerate, int chans, int period,
+                void *ringmem, int depth)
+{
+    if ((chans != 2 && chans != A_MIC_MAX) ||
+        period <= 0 || period > A_MIC_PERIOD_MAX ||
+        depth <= 0 || depth > A_RING_DEPTH_MAX || (depth & (depth - 1))) {
+        return -1;
+    }
+    memset(mic, 0, sizeof(*mic));
+    mic->samplerate = samplerate;
+    mic->chans = chans;
+    mic->period = period;
+    mic->gainfrac = INT16_MAX;
+    a_ring_init(&mic->ring, ringmem, period * sizeof(int16_t), depth);
+    a_mic_steer(mic, A_MIC_STEER_BROADSIDE);
+    return 0;
+}
+
+void
+a_mic_gain (a_mic_t *mic, float db)
+{
+    a_dsp_db2gain(db, &mic->gainfrac, &mic->gainshift);
+}
+
+/*
+ * Plane wave from 'azimuth' reaches mic 'i' earlier by (p[i] . u) / c,
+ * so mic 'i' is delayed by that lead relative to the latest one.
+ * Called from thread context, each delay is a single store.
+ */
+void
+a_mic_steer (a_mic_t *mic, int azimuth)
+{
+    float proj[A_MIC_MAX], pmin = 0.0f, a, d;
+    const float dmax = (float)((A_MIC_HIST - 1) << A_MIC_DELAY_FRAC);
+    int i;
+
+    mic->steer = azimuth;
+    if (azimuth == A_MIC_STEER_BROADSIDE) {
+        for (i = 0; i < A_MIC_MAX; i++) {
+            mic->delay[i] = 0;
+        }
+        return;
+    }
+    a = (float)azimuth * 3.14159265f / 180.0f;
+    for (i = 0; i < mic->chans; i++) {
+        proj[i] = a_mic_xy[i][0] * cosf(a) + a_mic_xy[i][1] * sinf(a);
+        if (!i || proj[i] < pmin) {
+            pmin = proj[i];
+        }
+    }
+    for (i = 0; i < mic->chans; i++) {
+        d = (proj[i] - pmin) * mic->samplerate / A_MIC_SOUND_UM_PER_S;
+        d = d * (1 << A_MIC_DELAY_FRAC) + 0.5f;
+        mic->delay[i] = (uint16_t)(d > dmax ? dmax : d);
+    }
+}
+
+static void
+a_mic_condition (a_mic_t *mic, const int16_t *in, int ch)
+{
+    int16_t *line = mic->line[ch] + A_MIC_HIST;
+    int32_t mean;
+    int i;
+
+    for (i = 0; i < mic->period; i++) {
+        line[i] = in[i * mic->chans + ch];
+    }
+    mean = a_dsp_mean(line, mic->period) * (1 << 16);
+    if (!mic->stat.periods) {
+        mic->dc[ch] = mean;
+    } else {
+        mic->dc[ch] += (mean - mic->dc[ch]) >> A_MIC_DC_SHIFT;
+    }
+    mic->stat.dc[ch] = (mic->dc[ch] + 0x8000) >> 16;
+    a_dsp_offset(line, -mic->stat.dc[ch], line, mic->period);
+    a_dsp_scale(line, mic->gainfrac, mic->gainshift, line, mic->period);
+}
+
+/*Fractional delay by linear interpolation, each channel weighted 1/chans*/
+static void
+a_mic_beam (a_mic_t *mic, int16_t *out)
+{
+    int16_t *src, w0, w1;
+    const int32_t wone = (1 << 15) / mic->chans;
+    uint32_t frac;
+    int ch;
+
+    memset(out, 0, mic->period * sizeof(*out));
+    for (ch = 0; ch < mic->chans; ch++) {
+        src = mic->line[ch] + A_MIC_HIST - (mic->delay[ch] >> A_MIC_DELAY_FRAC);
+        frac = mic->delay[ch] & ((1 << A_MIC_DELAY_FRAC) - 1);
+        w0 = (int16_t)((wone * ((1 << A_MIC_DELAY_FRAC) - frac)) >> A_MIC_DELAY_FRAC);
+        w1 = (int16_t)((wone * frac) >> A_MIC_DELAY_FRAC);
+
+        a_dsp_scale(src, w0, 0, mic->tmp, mic->period);
+        a_dsp_add(out, mic->tmp, out, mic->period);
+        if (w1) {
+            a_dsp_scale(src - 1, w1, 0, mic->tmp, mic->period);
+            a_dsp_add(out, mic->tmp, out, mic->period);
+        }
+    }
+}
+
+int
+a_mic_process (a_mic_t *mic, const int16_t *in)
+{
+    int16_t *out = (int16_t *)a_ring_wr_block(&mic->ring);
+    int32_t peak = 0, v;
+    int ch, i;
+
+    for (ch = 0; ch < mic->chans; ch++) {
+        a_mic_condition(mic, in, ch);
+    }
+    if (out) {
+        a_mic_beam(mic, out);
+        for (i = 0; i < mic->period; i++) {
+            v = out[i] < 0 ? -(int32_t)out[i] : out[i];
+            if (v > peak) {
+                peak = v;
+            }
+        }
+        /*|INT16_MIN| does not fit the stat*/
+        if (peak > INT16_MAX) {
+            peak = INT16_MAX;
+        }
+        if (peak > mic->stat.peak) {
+            mic->stat.peak = (int16_t)peak;
+        }
+        a_ring_wr_commit(&mic->ring);
+    } else {
+        mic->stat.overruns++;
+    }
+    for (ch = 0; ch < mic->chans; ch++) {
+        memcpy(mic->line[ch], mic->line[ch] + mic->period, A_MIC_HIST * sizeof(int16_t));
+    }
+    mic->stat.periods++;
+    return out ? 0 : -1;
+}
+
+#if defined(BSP_DRIVER)
+
+#include "stm32f769i_discovery_audio.h"
+#include <config.h>
+#include <misc_utils.h>
+#include <debug.h>
+#include <heap.h>
+
+extern DFSDM_Filter_HandleTypeDef hAudioInTopLeftFilter;
+extern DFSDM_Filter_HandleTypeDef hAudioInTopRightFilter;
+extern DFSDM_Filter_HandleTypeDef hAudioInButtomLeftFilter;
+extern DFSDM_Filter_HandleTypeDef hAudioInButtomRightFilter;
+
+static a_mic_t a_mic;
+static int16_t *a_mic_recbuf = NULL;
+static int32_t *a_mic_scratch = NULL;
+static void *a_mic_ringmem = NULL;
+static volatile d_bool a_mic_running = d_false;
+
+static void
+a_mic_free (void)
+{
+    if (a_mic_recbuf) {
+        heap_free(a_mic_recbuf);
+        a_mic_recbuf = NULL;
+    }
+    if (a_mic_scratch) {
+        heap_free(a_mic_scratch);
+        a_mic_scratch = NULL;
+    }
+    if (a_mic_ringmem) {
+        heap_free(a_mic_ringmem);
+        a_mic_ringmem = NULL;
+    }
+}
+
+/*
+ * Filters 0 - 3 go to DMA2 streams 4, 1, 6, 7 (jpeg out, -, sai out, uart tx).
+ * Their alternatives are taken too (0 - sd rx, 2 - uart rx / qspi,
+ * 3 - jpeg in, 5 - sd tx), so there is nothing to remap to : capture
+ * refuses to start while another driver has one of its streams set up.
+ * A configured stream has its request channel selected, a released one
+ * is reset to 0 by HAL_DMA_DeInit.
+ */
+static DMA_Stream_TypeDef *const a_mic_stream[A_MIC_MAX] = {
+    AUDIO_DFSDMx_DMAx_TOP_LEFT_STREAM, AUDIO_DFSDMx_DMAx_TOP_RIGHT_STREAM,
+    AUDIO_DFSDMx_DMAx_BUTTOM_LEFT_STREAM, AUDIO_DFSDMx_DMAx_BUTTOM_RIGHT_STREAM,
+};
+
+static int
+a_mic_streams_busy (int chans)
+{
+    uint32_t cr;
+    int i;
+
+    for (i = 0; i < chans; i++) {
+        cr = a_mic_stream[i]->CR;
+        if (cr && (cr & DMA_SxCR_CHSEL) != AUDIO_DFSDMx_DMAx_CHANNEL) {
+            dprintf("%s() : dma2 stream of mic %d is owned\n", __func__, i);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Record buffer holds 2 periods : each DFSDM half transfer
+ * completes exactly one period of interleaved frames.
+ * Scratch is written by DMA, taken from shared (non cached) memory.
+ */
+int
+a_mic_start (uint32_t samplerate, int chans, int period, int depth)
+{
+    uint32_t recsize = 2 * period * chans;
+
+    if (a_mic_running || (chans != 2 && chans != A_MIC_MAX) ||
+        a_mic_streams_busy(chans)) {
+        return -1;
+    }
+    a_mic_ringmem = heap_malloc(period * sizeof(int16_t) * depth);
+    a_mic_recbuf = heap_malloc(recsize * sizeof(int16_t));
+    a_mic_scratch = heap_alloc_shared(recsize * sizeof(int32_t));
+    if (!a_mic_ringmem || !a_mic_recbuf || !a_mic_scratch) {
+        a_mic_free();
+        return -1;
+    }
+    if (a_mic_init(&a_mic, samplerate, chans, period, a_mic_ringmem, depth) < 0) {
+        a_mic_free();
+        return -1;
+    }
+    if (BSP_AUDIO_IN_InitEx(INPUT_DEVICE_DIGITAL_MIC, samplerate,
+                            DEFAULT_AUDIO_IN_BIT_RESOLUTION, chans) != AUDIO_OK) {
+        dprintf("%s() : BSP_AUDIO_IN_InitEx fail\n", __func__);
+        a_mic_free();
+        return -1;
+    }
+    BSP_AUDIO_IN_AllocScratch(a_mic_scratch, recsize);
+    a_mic_running = d_true;
+    if (BSP_AUDIO_IN_Record((uint16_t *)a_mic_recbuf, recsize) != AUDIO_OK) {
+        dprintf("%s() : BSP_AUDIO_IN_Record fail\n", __func__);
+        a_mic_running = d_false;
+        BSP_AUDIO_IN_DeInit();
+        a_mic_free();
+        return -1;
+    }
+    dprintf("mic : %u Hz, %d ch, period %d x %d, dsp \'%s\'\n",
+            samplerate, chans, period, depth, A_DSP_ARCH);
+    return 0;
+}
+
+void
+a_mic_stop (void)
+{
+    if (!a_mic_running) {
+        return;
+    }
+    BSP_AUDIO_IN_Stop();
+    a_mic_running = d_false;
+    BSP_AUDIO_IN_DeInit();
+    a_mic_free();
+}
+
+a_mic_t *
+a_mic_get (void)
+{
+    return a_mic_running ? &a_mic : NULL;
+}
+
+int
+a_mic_dma_irq (void *stream)
+{
+    DFSDM_Filter_HandleTypeDef *flt[A_MIC_MAX] = {
+        &hAudioInTopLeftFilter, &hAudioInTopRightFilter,
+        &hAudioInButtomLeftFilter, &hAudioInButtomRightFilter,
+    };
+    int i;
+
+    if (!a_mic_running) {
+        return 0;
+    }
+    for (i = 0; i < a_mic.chans; i++) {
+        if (flt[i]->hdmaReg && flt[i]->hdmaReg->Instance == stream) {
+            HAL_DMA_IRQHandler(flt[i]->hdmaReg);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void BSP_AUDIO_IN_HalfTransfer_CallBack(void)
+{
+    a_mic_process(&a_mic, a_mic_recbuf);
+}
+
+void BSP_AUDIO_IN_TransferComplete_CallBack(void)
+{
+    a_mic_process(&a_mic, a_mic_recbuf + a_mic.period * a_mic.chans);
+}
+
+void BSP_AUDIO_IN_Error_CallBack(void)
+{
+    a_mic.stat.errors++;
+}
+
+/*
+ * Streams 4, 6 and 7 have their vectors in jpeg_hal.c, audio_hal.c and
+ * uart_hal.c, those offer the irq here first; the top right one is ours
+ */
+void AUDIO_DFSDMx_DMAx_TOP_RIGHT_IRQHandler(void)
+{
+    a_mic_dma_irq(AUDIO_DFSDMx_DMAx_TOP_RIGHT_STREAM);
+}
+
+#if !SERIAL_TTY_HAS_DMA
+/*Otherwise shared with uart tx, see uart_hal.c*/
+void AUDIO_DFSDMx_DMAx_BUTTOM_RIGHT_IRQHandler(void)
+{
+    a_mic_dma_irq(AUDIO_DFSDMx_DMAx_BUTTOM_RIGHT_STREAM);
+}
+#endif
+
+#endif /*BSP_DRIVER*/
@@ -0,0 +1,439 @@
+#include <string.h>
+#include <audio_mix.h>
+
+#if (defined(__ARM_FEATURE_DSP) && __ARM_FEATURE_DSP) || defined(__TARGET_FEATURE_DSPMUL)
+#include "stm32f7xx.h"
+#define A_MIX_DSP 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define A_MIX_SSE2 1
+#endif
+
+static inline int16_t
+a_mix_sat16 (int32_t v)
+{
+    if (v > INT16_MAX) {
+        return INT16_MAX;
+    } else if (v < INT16_MIN) {
+        return INT16_MIN;
+    }
+    return (int16_t)v;
+}
+
+static inline uint32_t
+a_mix_ld32 (const int16_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline void
+a_mix_st32 (int16_t *p, uint32_t v)
+{
+    memcpy(p, &v, sizeof(v));
+}
+
+/*Voice samples added since a_mix_voices_taken()*/
+static uint32_t a_mix_samples;
+
+void
+a_mix_clear (int32_t *acc, int samples)
+{
+    memset(acc, 0, samples * sizeof(*acc));
+}
+
+#if A_MIX_DSP
+
+void
+a_mix_voice_lr (int32_t *acc, const int16_t *src, int16_t left, int16_t right, int samples)
+{
+    uint32_t gl = (uint16_t)left, gr = (uint16_t)right, s;
+
+    a_mix_samples += samples;
+    while (samples > 0) {
+        s = a_mix_ld32(src);
+        acc[0] += (int32_t)__SMUAD(s & 0xffff, gl) >> 15;
+        acc[1] += (int32_t)__SMUADX(s & 0xffff0000, gr) >> 15;
+        src += 2;
+        acc += 2;
+        samples -= 2;
+    }
+}
+
+void
+a_mix_voice2 (int32_t *acc, const int16_t *src0, int16_t gain0,
+                    const int16_t *src1, int16_t gain1, int samples)
+{
+    /*[g1 : g0]*/
+    uint32_t g = __PKHBT((uint16_t)gain0, (uint32_t)gain1, 16);
+    uint32_t a, b;
+
+    a_mix_samples += samples * 2;
+    while (samples > 0) {
+        a = a_mix_ld32(src0);
+        b = a_mix_ld32(src1);
+        /*[L1 : L0] and [R1 : R0], two voices per SMLAD*/
+        acc[0] += (int32_t)__SMLAD(__PKHBT(a, b, 16), g, 0) >> 15;
+        acc[1] += (int32_t)__SMLAD(__PKHTB(b, a, 16), g, 0) >> 15;
+        src0 += 2;
+        src1 += 2;
+        acc += 2;
+        samples -= 2;
+    }
+}
+
+void
+a_mix_resolve (int16_t *dst, const int32_t *acc, int samples)
+{
+    uint32_t l, r;
+
+    while (samples > 0) {
+        l = (uint16_t)__SSAT(acc[0], 16);
+        r = (uint32_t)__SSAT(acc[1], 16);
+        a_mix_st32(dst, __PKHBT(l, r, 16));
+        dst += 2;
+        acc += 2;
+        samples -= 2;
+    }
+}
+
+void
+a_mix_add_sat (int16_t *dst, const int16_t *src, int samples)
+{
+    while (samples > 0) {
+        a_mix_st32(dst, __QADD16(a_mix_ld32(dst), a_mix_ld32(src)));
+        dst += 2;
+        src += 2;
+        samples -= 2;
+    }
+}
+
+#elif A_MIX_SSE2
+
+static inline void
+a_mix_madd8 (int32_t *acc, __m128i a, __m128i b, __m128i g)
+{
+    __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi16(a, b), g);
+    __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi16(a, b), g);
+    __m128i *p = (__m128i *)acc;
+
+    _mm_storeu_si128(p, _mm_add_epi32(_mm_loadu_si128(p), _mm_srai_epi32(lo, 15)));
+    _mm_storeu_si128(p + 1, _mm_add_epi32(_mm_loadu_si128(p + 1), _mm_srai_epi32(hi, 15)));
+}
+
+void
+a_mix_voice2 (int32_t *acc, const int16_t *src0, int16_t gain0,
+                    const int16_t *src1, int16_t gain1, int samples)
+{
+    __m128i g = _mm_set1_epi32(((uint32_t)(uint16_t)gain1 << 16) | (uint16_t)gain0);
+    int i;
+
+    a_mix_samples += samples * 2;
+    for (i = 0; i + 8 <= samples; i += 8) {
+        a_mix_madd8(acc + i, _mm_loadu_si128((const __m128i *)(src0 + i)),
+                    _mm_loadu_si128((const __m128i *)(src1 + i)), g);
+    }
+    for (; i < samples; i++) {
+        acc[i] += (src0[i] * gain0 + src1[i] * gain1) >> 15;
+    }
+}
+
+void
+a_mix_voice_lr (int32_t *acc, const int16_t *src, int16_t left, int16_t right, int samples)
+{
+    __m128i g = _mm_set_epi32((uint16_t)right, (uint16_t)left, (uint16_t)right, (uint16_t)left);
+    __m128i z = _mm_setzero_si128();
+    int i;
+
+    a_mix_samples += samples;
+    for (i = 0; i + 8 <= samples; i += 8) {
+        a_mix_madd8(acc + i, _mm_loadu_si128((const __m128i *)(src + i)), z, g);
+    }
+    for (; i < samples; i += 2) {
+        acc[i] += (src[i] * left) >> 15;
+        acc[i + 1] += (src[i + 1] * right) >> 15;
+    }
+}
+
+void
+a_mix_resolve (int16_t *dst, const int32_t *acc, int samples)
+{
+    int i;
+
+    for (i = 0; i + 8 <= samples; i += 8) {
+        __m128i lo = _mm_loadu_si128((const __m128i *)(acc + i));
+        __m128i hi = _mm_loadu_si128((const __m128i *)(acc + i + 4));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_packs_epi32(lo, hi));
+    }
+    for (; i < samples; i++) {
+        dst[i] = a_mix_sat16(acc[i]);
+    }
+}
+
+void
+a_mix_add_sat (int16_t *dst, const int16_t *src, int samples)
+{
+    int i;
+
+    for (i = 0; i + 8 <= samples; i += 8) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(dst + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(src + i));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_adds_epi16(a, b));
+    }
+    for (; i < samples; i++) {
+        dst[i] = a_mix_sat16(dst[i] + src[i]);
+    }
+}
+
+#else /*A_MIX_DSP*/
+
+void
+a_mix_voice_lr (int32_t *acc, const int16_t *src, int16_t left, int16_t right, int samples)
+{
+    int i;
+
+    a_mix_samples += samples;
+    for (i = 0; i < samples; i += 2) {
+        acc[i] += (src[i] * left) >> 15;
+        acc[i + 1] += (src[i + 1] * right) >> 15;
+    }
+}
+
+void
+a_mix_voice2 (int32_t *acc, const int16_t *src0, int16_t gain0,
+                    const int16_t *src1, int16_t gain1, int samples)
+{
+    int i;
+
+    a_mix_samples += samples * 2;
+    for (i = 0; i < samples; i++) {
+        acc[i] += (src0[i] * gain0 + src1[i] * gain1) >> 15;
+    }
+}
+
+void
+a_mix_resolve (int16_t *dst, const int32_t *acc, int samples)
+{
+    int i;
+
+    for (i = 0; i < samples; i++) {
+        dst[i] = a_mix_sat16(acc[i]);
+    }
+}
+
+void
+a_mix_add_sat (int16_t *dst, const int16_t *src, int samples)
+{
+    int i;
+
+    for (i = 0; i < samples; i++) {
+        dst[i] = a_mix_sat16(dst[i] + src[i]);
+    }
+}
+
+#endif /*A_MIX_DSP*/
+
+void
+a_mix_voice (int32_t *acc, const int16_t *src, int16_t gain, int samples)
+{
+    a_mix_voice_lr(acc, src, gain, gain, samples);
+}
+
+void
+a_mix_count (int samples)
+{
+    a_mix_samples += samples;
+}
+
+uint32_t
+a_mix_voices_taken (int samples)
+{
+    uint32_t n = a_mix_samples;
+
+    a_mix_samples = 0;
+    return samples > 0 ? (n + samples - 1) / samples : 0;
+}
+
+static a_mix_resolve_t a_mix_resolver = a_mix_resolve;
+static a_mix_bus_t a_mix_bus = NULL;
+
+void
+a_mix_set_resolve (a_mix_resolve_t resolve)
+{
+    a_mix_resolver = resolve ? resolve : a_mix_resolve;
+}
+
+void
+a_mix_set_bus (a_mix_bus_t bus)
+{
+    a_mix_bus = bus;
+}
+
+void
+a_mix_voices (int16_t *dst, int32_t *acc, const int16_t **src,
+                    const int16_t *gain, int cnt, int samples)
+{
+    int i;
+
+    a_mix_clear(acc, samples);
+    for (i = 0; i + 1 < cnt; i += 2) {
+        a_mix_voice2(acc, src[i], gain[i], src[i + 1], gain[i + 1], samples);
+    }
+    if (i < cnt) {
+        a_mix_voice(acc, src[i], gain[i], samples);
+    }
+    if (a_mix_bus) {
+        a_mix_bus(acc, samples);
+    }
+    a_mix_resolver(dst, acc, samples);
+}
+
+void
+a_mix_voices_ref (int16_t *dst, int32_t *acc, const int16_t **src,
+                    const int16_t *gain, int cnt, int samples)
+{
+    int i, j;
+    int32_t v;
+
+    for (j = 0; j < samples; j++) {
+        v = 0;
+        for (i = 0; i + 1 < cnt; i += 2) {
+            v += (src[i][j] * gain[i] + src[i + 1][j] * gain[i + 1]) >> 15;
+        }
+        if (i < cnt) {
+            v += (src[i][j] * gain[i]) >> 15;
+        }
+        acc[j] = v;
+        dst[j] = a_mix_sat16(v);
+    }
+}
+
+/*sin(x), x = [0 : pi/2], Q15*/
+static const int16_t a_mix_qsin[65] = {
+    0x0000, 0x0324, 0x0648, 0x096a, 0x0c8c, 0x0fab, 0x12c8, 0x15e2,
+    0x18f9, 0x1c0b, 0x1f1a, 0x2223, 0x2528, 0x2826, 0x2b1f, 0x2e11,
+    0x30fb, 0x33df, 0x36ba, 0x398c, 0x3c56, 0x3f17, 0x41ce, 0x447a,
+    0x471c, 0x49b4, 0x4c3f, 0x4ebf, 0x5133, 0x539b, 0x55f5, 0x5842,
+    0x5a82, 0x5cb3, 0x5ed7, 0x60eb, 0x62f1, 0x64e8, 0x66cf, 0x68a6,
+    0x6a6d, 0x6c23, 0x6dc9, 0x6f5e, 0x70e2, 0x7254, 0x73b5, 0x7504,
+    0x7641, 0x776b, 0x7884, 0x7989, 0x7a7c, 0x7b5c, 0x7c29, 0x7ce3,
+    0x7d89, 0x7e1d, 0x7e9c, 0x7f09, 0x7f61, 0x7fa6, 0x7fd8, 0x7ff5,
+    0x7fff
+};
+
+static a_pan_law_e a_mix_pan = A_PAN_CONST_POWER;
+static int a_mix_ramp_frames = A_MIX_RAMP_DEFAULT;
+
+void
+a_mix_pan_law (a_pan_law_e law)
+{
+    a_mix_pan = law;
+}
+
+void
+a_mix_ramp_len (int frames)
+{
+    if (frames < 1) {
+        frames = 1;
+    } else if (frames > UINT16_MAX) {
+        frames = UINT16_MAX;
+    }
+    a_mix_ramp_frames = frames;
+}
+
+void
+a_mix_pan_gains (uint8_t pan, int16_t gain, int16_t *left, int16_t *right)
+{
+    int32_t l, r;
+
+    if (a_mix_pan == A_PAN_LINEAR) {
+        r = (pan * 0x7fff) / 255;
+        l = 0x7fff - r;
+    } else {
+        /*pan -> [0 : 64] quarter sine index, 128 maps to 32*/
+        int i = (pan * 64 + 127) / 255;
+        r = a_mix_qsin[i];
+        l = a_mix_qsin[64 - i];
+    }
+    /*0x7fff is unity : hard left/right keep the full gain*/
+    *left = (int16_t)((l * gain) / 0x7fff);
+    *right = (int16_t)((r * gain) / 0x7fff);
+}
+
+void
+a_mix_ramp_init (a_mix_ramp_t *ramp, int16_t left, int16_t right)
+{
+    ramp->target[0] = left;
+    ramp->target[1] = right;
+    ramp->cur[0] = (int32_t)left << 16;
+    ramp->cur[1] = (int32_t)right << 16;
+    ramp->step[0] = ramp->step[1] = 0;
+    ramp->left = 0;
+}
+
+void
+a_mix_ramp_set (a_mix_ramp_t *ramp, int16_t left, int16_t right)
+{
+    int n = a_mix_ramp_frames;
+
+    if (left == ramp->target[0] && right == ramp->target[1]) {
+        return;
+    }
+    ramp->target[0] = left;
+    ramp->target[1] = right;
+    /*Continue from where the previous ramp is now*/
+    ramp->step[0] = (((int32_t)left << 16) - ramp->cur[0]) / n;
+    ramp->step[1] = (((int32_t)right << 16) - ramp->cur[1]) / n;
+    ramp->left = n;
+}
+
+void
+a_mix_voice_ramp (int32_t *acc, const int16_t *src, int chans,
+                    a_mix_ramp_t *ramp, int frames)
+{
+    const int rs = chans - 1;
+    int32_t gl, gr;
+    int n;
+
+    /*
+     * Ramp part, gains change every frame. The step is rounded down,
+     * so the last ramp frame is not stepped into : it takes the target.
+     */
+    n = ramp->left ? ramp->left - 1 : 0;
+    n = frames < n ? frames : n;
+    frames -= n;
+    a_mix_samples += n * 2;
+    ramp->left -= n;
+    while (n--) {
+        ramp->cur[0] += ramp->step[0];
+        ramp->cur[1] += ramp->step[1];
+        gl = ramp->cur[0] >> 16;
+        gr = ramp->cur[1] >> 16;
+        acc[0] += (src[0] * gl) >> 15;
+        acc[1] += (src[rs] * gr) >> 15;
+        acc += 2;
+        src += chans;
+    }
+    if (ramp->left == 1 && frames) {
+        ramp->left = 0;
+    }
+    if (!ramp->left) {
+        ramp->cur[0] = (int32_t)ramp->target[0] << 16;
+        ramp->cur[1] = (int32_t)ramp->target[1] << 16;
+    }
+    /*Steady part*/
+    gl = ramp->target[0];
+    gr = ramp->target[1];
+    if (chans == 2) {
+        a_mix_voice_lr(acc, src, (int16_t)gl, (int16_t)gr, frames * 2);
+        return;
+    }
+    a_mix_samples += frames * 2;
+    while (frames--) {
+        acc[0] += (src[0] * gl) >> 15;
+        acc[1] += (src[rs] * gr) >> 15;
+        acc += 2;
+        src += chans;
+    }
+}
@@ -0,0 +1,521 @@
+#include <string.h>
+#include <math.h>
+
+#include <audio_mix.h>
+#include <audio_post.h>
+
+/*Slot handoff, LDREX/STREX on the M7 : built slot is released, the one taken acquired*/
+#define A_POST_XCHG(p, v) __atomic_exchange_n(p, v, __ATOMIC_ACQ_REL)
+
+#define A_POST_CFG_SLOTS (3)
+/*Slot index in 'mid' is newer than the audio side one*/
+#define A_POST_FRESH (0x80U)
+#define A_POST_ONE (0x7fff)
+/*int16 <-> chain Q31*/
+#define A_POST_SHIFT (16 - A_POST_HEADROOM)
+
+typedef struct {
+    uint32_t samplerate;
+    a_post_dev_e dev;
+    int bypass;
+    a_post_profile_t profile[A_POST_DEV_MAX];
+    /*
+     * Triple buffer of slot indices : thread owns 'back' and builds into it,
+     * audio side owns 'front', 'mid' changes hands only by atomic exchange.
+     * No slot is rebuilt while read, whichever context runs the chain
+     * (isr, or thread with the period ring) and wherever it is preempted.
+     */
+    a_post_cfg_t slot[A_POST_CFG_SLOTS];
+    uint32_t back;
+    uint32_t mid;
+    uint32_t front;
+    /*thread side : last published*/
+    a_post_cfg_t *pub;
+    /*audio side : chain in use, NULL - none yet*/
+    a_post_cfg_t *cur;
+} a_post_ctl_t;
+
+/*Audio side state*/
+typedef struct {
+    a_dsp_biquad_t bq[2];
+    int32_t bqstate[2][A_POST_BANDS_MAX * A_DSP_BQ_STATE];
+    int32_t ch[2][A_POST_BLOCK];
+    /*delay line, wide samples*/
+    int32_t delay[A_POST_LOOK_MAX][2];
+    /*sliding minimum of required gain, monotonic queue*/
+    int32_t minval[A_POST_LOOK_MAX];
+    uint32_t minidx[A_POST_LOOK_MAX];
+    uint32_t minhead, mintail;
+    /*box average of release smoothed gain*/
+    int32_t box[A_POST_LOOK_MAX];
+    int32_t boxsum;
+    /*Q23*/
+    int32_t rel;
+    uint32_t n;
+    /*period was resolved through the chain, skip a_post_process() once*/
+    uint8_t resolved;
+    a_post_stat_t stat;
+} a_post_run_t;
+
+static a_post_ctl_t a_post_ctl = {
+    .samplerate = 48000,
+    .dev = A_POST_SPEAKER,
+    .back = 0,
+    .mid = 1,
+    .front = 2,
+    .profile = {
+        [A_POST_SPEAKER] = {
+            /*small speaker can't reproduce lows, keep them out of limiter*/
+            .band = {{A_EQ_HIGHPASS, 150.0f, 0.0f, 0.707f}},
+            .bands = 1,
+            .lim = {1, -1.0f, 1.0f, 80.0f},
+        },
+        [A_POST_HEADPHONE] = {
+            .bands = 0,
+            .lim = {1, -0.5f, 1.0f, 80.0f},
+        },
+    },
+};
+
+static a_post_run_t a_post_run;
+
+static void
+a_post_band_coefs (const a_eq_band_t *band, uint32_t rate, double *c)
+{
+    double A = pow(10.0, band->gain / 40.0);
+    double w0 = 2.0 * M_PI * band->freq / rate;
+    double cs = cos(w0), sn = sin(w0);
+    double q = band->q > 0.01f ? band->q : 0.707;
+    double alpha = sn / (2.0 * q);
+    double sq = 2.0 * sqrt(A) * alpha;
+    double b0, b1, b2, a0, a1, a2;
+
+    switch (band->type) {
+        case A_EQ_LOWSHELF:
+            b0 = A * ((A + 1) - (A - 1) * cs + sq);
+            b1 = 2 * A * ((A - 1) - (A + 1) * cs);
+            b2 = A * ((A + 1) - (A - 1) * cs - sq);
+            a0 = (A + 1) + (A - 1) * cs + sq;
+            a1 = -2 * ((A - 1) + (A + 1) * cs);
+            a2 = (A + 1) + (A - 1) * cs - sq;
+        break;
+        case A_EQ_HIGHSHELF:
+            b0 = A * ((A + 1) + (A - 1) * cs + sq);
+            b1 = -2 * A * ((A - 1) + (A + 1) * cs);
+            b2 = A * ((A + 1) + (A - 1) * cs - sq);
+            a0 = (A + 1) - (A - 1) * cs + sq;
+            a1 = 2 * ((A - 1) - (A + 1) * cs);
+            a2 = (A + 1) - (A - 1) * cs - sq;
+        break;
+        case A_EQ_LOWPASS:
+            b0 = (1 - cs) / 2;
+            b1 = 1 - cs;
+            b2 = (1 - cs) / 2;
+            a0 = 1 + alpha;
+            a1 = -2 * cs;
+            a2 = 1 - alpha;
+        break;
+        case A_EQ_HIGHPASS:
+            b0 = (1 + cs) / 2;
+            b1 = -(1 + cs);
+            b2 = (1 + cs) / 2;
+            a0 = 1 + alpha;
+            a1 = -2 * cs;
+            a2 = 1 - alpha;
+        break;
+        default:
+            b0 = 1 + alpha * A;
+            b1 = -2 * cs;
+            b2 = 1 - alpha * A;
+            a0 = 1 + alpha / A;
+            a1 = -2 * cs;
+            a2 = 1 - alpha / A;
+        break;
+    }
+    /*CMSIS form : {b0, b1, b2, -a1, -a2}*/
+    c[0] = b0 / a0;
+    c[1] = b1 / a0;
+    c[2] = b2 / a0;
+    c[3] = -a1 / a0;
+    c[4] = -a2 / a0;
+}
+
+static int
+a_post_build (a_post_cfg_t *cfg, const a_post_profile_t *prof, uint32_t rate)
+{
+    double c[A_POST_BANDS_MAX][A_DSP_BQ_COEFS], cmax = 0.0, boost = 0.0, scale;
+    float look;
+    int i, k, bits = 0;
+
+    memset(cfg, 0, sizeof(*cfg));
+    if (prof->bands < 0 || prof->bands > A_POST_BANDS_MAX) {
+        return -1;
+    }
+    for (i = 0; i < prof->bands; i++) {
+        if (prof->band[i].freq <= 0.0f || prof->band[i].freq >= rate / 2) {
+            return -1;
+        }
+        a_post_band_coefs(&prof->band[i], rate, c[i]);
+        for (k = 0; k < A_DSP_BQ_COEFS; k++) {
+            if (fabs(c[i][k]) > cmax) {
+                cmax = fabs(c[i][k]);
+            }
+        }
+        if (prof->band[i].type <= A_EQ_HIGHSHELF && prof->band[i].gain > 0.0f) {
+            boost += prof->band[i].gain;
+        }
+    }
+    if (boost > A_POST_BOOST_MAX) {
+        return -1;
+    }
+    cfg->stages = prof->bands;
+    /*smallest post shift which keeps all coefficients in range*/
+    cfg->postshift = 1;
+    while (cmax >= (double)(1 << cfg->postshift) && cfg->postshift < 4) {
+        cfg->postshift++;
+    }
+    scale = (double)(1U << (31 - cfg->postshift));
+    for (i = 0; i < prof->bands; i++) {
+        for (k = 0; k < A_DSP_BQ_COEFS; k++) {
+            double v = floor(c[i][k] * scale + 0.5);
+            if (v > INT32_MAX) {
+                v = INT32_MAX;
+            } else if (v < INT32_MIN) {
+                v = INT32_MIN;
+            }
+            cfg->coefs[i * A_DSP_BQ_COEFS + k] = (int32_t)v;
+        }
+    }
+    /*boosted accumulator must stay below 1/2 of Q31*/
+    while (boost > bits * 6.0206) {
+        bits++;
+    }
+    cfg->accmax = (1 << (30 - A_POST_SHIFT - bits)) - 1;
+
+    cfg->limit = prof->lim.enable;
+    cfg->threshold = (int32_t)(pow(10.0, prof->lim.threshold / 20.0) * A_POST_ONE);
+    if (cfg->threshold > A_POST_ONE) {
+        cfg->threshold = A_POST_ONE;
+    } else if (cfg->threshold < 1) {
+        cfg->threshold = 1;
+    }
+    look = prof->lim.lookahead * rate / 1000.0f;
+    cfg->look = look < 1.0f ? 1 : (look > A_POST_LOOK_MAX ? A_POST_LOOK_MAX : (uint8_t)look);
+    cfg->lookinv = (1 << 16) / cfg->look;
+    cfg->release = (int32_t)((1.0 - exp(-1000.0 / (prof->lim.release * rate + 1.0))) * (1 << 15));
+    if (cfg->release < 1) {
+        cfg->release = 1;
+    }
+    return 0;
+}
+
+static int
+a_post_publish (const a_post_profile_t *prof)
+{
+    a_post_cfg_t *cfg = &a_post_ctl.slot[a_post_ctl.back];
+
+    if (a_post_build(cfg, prof, a_post_ctl.samplerate) < 0) {
+        return -1;
+    }
+    a_post_ctl.pub = cfg;
+    /*Back to build next : the old mid, which the audio side did not take or has left*/
+    a_post_ctl.back = A_POST_XCHG(&a_post_ctl.mid, a_post_ctl.back | A_POST_FRESH) & ~A_POST_FRESH;
+    return 0;
+}
+
+void
+a_post_init (uint32_t samplerate)
+{
+    a_post_ctl.samplerate = samplerate;
+    a_post_publish(&a_post_ctl.profile[a_post_ctl.dev]);
+    a_mix_set_resolve(a_post_resolve);
+}
+
+int
+a_post_profile (a_post_dev_e dev, const a_post_profile_t *profile)
+{
+    a_post_cfg_t test;
+
+    if (dev >= A_POST_DEV_MAX || a_post_build(&test, profile, a_post_ctl.samplerate) < 0) {
+        return -1;
+    }
+    a_post_ctl.profile[dev] = *profile;
+    if (dev == a_post_ctl.dev) {
+        return a_post_publish(profile);
+    }
+    return 0;
+}
+
+void
+a_post_profile_get (a_post_dev_e dev, a_post_profile_t *profile)
+{
+    *profile = a_post_ctl.profile[dev < A_POST_DEV_MAX ? dev : A_POST_SPEAKER];
+}
+
+int
+a_post_device (a_post_dev_e dev)
+{
+    if (dev >= A_POST_DEV_MAX) {
+        return -1;
+    }
+    a_post_ctl.dev = dev;
+    return a_post_publish(&a_post_ctl.profile[dev]);
+}
+
+void
+a_post_bypass (int bypass)
+{
+    a_post_ctl.bypass = bypass;
+}
+
+/*Audio side : adopt published chain*/
+static a_post_cfg_t *
+a_post_adopt (void)
+{
+    a_post_cfg_t *cfg, *prev = a_post_ctl.cur;
+    a_post_run_t *run = &a_post_run;
+    int stages = -1, look = -1;
+    int ch;
+
+    if (!(__atomic_load_n(&a_post_ctl.mid, __ATOMIC_RELAXED) & A_POST_FRESH)) {
+        return prev;
+    }
+    /*Previous front may be rebuilt as soon as it is handed over*/
+    if (prev) {
+        stages = prev->stages;
+        look = prev->look;
+    }
+    a_post_ctl.front = A_POST_XCHG(&a_post_ctl.mid, a_post_ctl.front) & ~A_POST_FRESH;
+    cfg = &a_post_ctl.slot[a_post_ctl.front];
+    for (ch = 0; ch < 2; ch++) {
+        if (stages != cfg->stages) {
+            a_dsp_biquad_init(&run->bq[ch], cfg->stages, cfg->coefs,
+                              run->bqstate[ch], cfg->postshift);
+        } else {
+            /*same layout - keep filter history, no click*/
+            run->bq[ch].pCoeffs = cfg->coefs;
+            run->bq[ch].postShift = cfg->postshift;
+        }
+    }
+    if (look != cfg->look) {
+        memset(run->delay, 0, sizeof(run->delay));
+        run->minhead = run->mintail = 0;
+        for (ch = 0; ch < A_POST_LOOK_MAX; ch++) {
+            run->box[ch] = A_POST_ONE;
+        }
+        run->boxsum = A_POST_ONE * cfg->look;
+        run->rel = A_POST_ONE << 8;
+    }
+    a_post_ctl.cur = cfg;
+    return cfg;
+}
+
+/*Chain Q31 -> int16 scale, rounded, not saturated*/
+static inline int32_t
+a_post_wide (int32_t v)
+{
+    return (v + (1 << (A_POST_SHIFT - 1))) >> A_POST_SHIFT;
+}
+
+static inline int16_t
+a_post_sat16 (int32_t v)
+{
+    if (v > INT16_MAX) {
+        return INT16_MAX;
+    } else if (v < INT16_MIN) {
+        return INT16_MIN;
+    }
+    return (int16_t)v;
+}
+
+/*
+ * Gain for the frame leaving the delay line is a box average (length 'look')
+ * of release smoothed sliding minimum (length 'look') of the required gain.
+ * Every term of the average is <= gain required by that frame,
+ * so output never exceeds the threshold, and gain moves in linear ramps.
+ */
+static void
+a_post_limit (a_post_cfg_t *cfg, int16_t *dst, const int32_t *l, const int32_t *r,
+                  int frames)
+{
+    a_post_run_t *run = &a_post_run;
+    const uint32_t mask = A_POST_LOOK_MAX - 1;
+    int32_t xl, xr, peak, req, hold, g;
+    uint32_t n, tail;
+    int i;
+
+    for (i = 0; i < frames; i++) {
+        n = run->n++;
+        xl = a_post_wide(l[i]);
+        xr = a_post_wide(r[i]);
+        peak = xl < 0 ? -xl : xl;
+        if (xr > peak || -xr > peak) {
+            peak = xr < 0 ? -xr : xr;
+        }
+        req = peak > cfg->threshold ? (cfg->threshold << 15) / peak : A_POST_ONE;
+
+        if (run->mintail != run->minhead &&
+            n - run->minidx[run->minhead & mask] >= cfg->look) {
+            run->minhead++;
+        }
+        while (run->mintail != run->minhead &&
+                run->minval[(run->mintail - 1) & mask] >= req) {
+            run->mintail--;
+        }
+        tail = run->mintail++ & mask;
+        run->minval[tail] = req;
+        run->minidx[tail] = n;
+        hold = run->minval[run->minhead & mask];
+
+        /*instant attack, exponential release*/
+        if ((hold << 8) <= run->rel) {
+            run->rel = hold << 8;
+        } else {
+            run->rel += (int32_t)(((int64_t)((hold << 8) - run->rel) * cfg->release) >> 15) + 1;
+            /*within 1 lsb - done*/
+            if (run->rel > (hold << 8) - (1 << 8)) {
+                run->rel = hold << 8;
+            }
+        }
+        run->boxsum += (run->rel >> 8) - run->box[n % cfg->look];
+        run->box[n % cfg->look] = run->rel >> 8;
+        if (run->boxsum >= A_POST_ONE * cfg->look) {
+            g = A_POST_ONE;
+        } else {
+            g = (int32_t)(((uint64_t)run->boxsum * cfg->lookinv) >> 16);
+        }
+
+        run->delay[n & mask][0] = xl;
+        run->delay[n & mask][1] = xr;
+        n = (n - cfg->look + 1) & mask;
+        if (g >= A_POST_ONE) {
+            dst[2 * i] = a_post_sat16(run->delay[n][0]);
+            dst[2 * i + 1] = a_post_sat16(run->delay[n][1]);
+        } else {
+            dst[2 * i] = a_post_sat16((int32_t)(((int64_t)run->delay[n][0] * g) >> 15));
+            dst[2 * i + 1] = a_post_sat16((int32_t)(((int64_t)run->delay[n][1] * g) >> 15));
+            run->stat.limited++;
+            if (g < run->stat.mingain) {
+                run->stat.mingain = g;
+            }
+        }
+    }
+}
+
+static void
+a_post_chain (a_post_cfg_t *cfg, int16_t *dst, int frames)
+{
+    a_post_run_t *run = &a_post_run;
+    int i;
+
+    if (cfg->stages) {
+        a_dsp_biquad(&run->bq[0], run->ch[0], run->ch[0], frames);
+        a_dsp_biquad(&run->bq[1], run->ch[1], run->ch[1], frames);
+    }
+    if (cfg->limit) {
+        a_post_limit(cfg, dst, run->ch[0], run->ch[1], frames);
+    } else {
+        for (i = 0; i < frames; i++) {
+            dst[2 * i] = a_post_sat16(a_post_wide(run->ch[0][i]));
+            dst[2 * i + 1] = a_post_sat16(a_post_wide(run->ch[1][i]));
+        }
+    }
+    run->stat.frames += frames;
+}
+
+void
+a_post_process (int16_t *buf, int samples)
+{
+    a_post_cfg_t *cfg = a_post_adopt();
+    a_post_run_t *run = &a_post_run;
+    int frames, i;
+
+    if (run->resolved) {
+        run->resolved = 0;
+        return;
+    }
+    if (!cfg || a_post_ctl.bypass || (!cfg->stages && !cfg->limit)) {
+        return;
+    }
+    while (samples > 0) {
+        frames = samples / 2 > A_POST_BLOCK ? A_POST_BLOCK : samples / 2;
+        for (i = 0; i < frames; i++) {
+            run->ch[0][i] = buf[2 * i] * (1 << A_POST_SHIFT);
+            run->ch[1][i] = buf[2 * i + 1] * (1 << A_POST_SHIFT);
+        }
+        a_post_chain(cfg, buf, frames);
+        buf += 2 * frames;
+        samples -= 2 * frames;
+    }
+}
+
+void
+a_post_resolve (int16_t *dst, const int32_t *acc, int samples)
+{
+    a_post_cfg_t *cfg = a_post_adopt();
+    a_post_run_t *run = &a_post_run;
+    int32_t v;
+    int frames, i;
+
+    run->resolved = 1;
+    if (!cfg || a_post_ctl.bypass) {
+        a_mix_resolve(dst, acc, samples);
+        return;
+    }
+    while (samples > 0) {
+        frames = samples / 2 > A_POST_BLOCK ? A_POST_BLOCK : samples / 2;
+        for (i = 0; i < frames; i++) {
+            v = acc[2 * i];
+            v = v > cfg->accmax ? cfg->accmax : (v < -cfg->accmax ? -cfg->accmax : v);
+            run->ch[0][i] = v * (1 << A_POST_SHIFT);
+            v = acc[2 * i + 1];
+            v = v > cfg->accmax ? cfg->accmax : (v < -cfg->accmax ? -cfg->accmax : v);
+            run->ch[1][i] = v * (1 << A_POST_SHIFT);
+        }
+        a_post_chain(cfg, dst, frames);
+        acc += 2 * frames;
+        dst += 2 * frames;
+        samples -= 2 * frames;
+    }
+}
+
+void
+a_post_stat (a_post_stat_t *stat)
+{
+    *stat = a_post_run.stat;
+}
+
+void
+a_post_stat_reset (void)
+{
+    memset(&a_post_run.stat, 0, sizeof(a_post_run.stat));
+    a_post_run.stat.mingain = A_POST_ONE;
+}
+
+/*Evaluates quantized coefficients, includes post shift*/
+float
+a_post_response (float freq)
+{
+    a_post_cfg_t *cfg = a_post_ctl.pub;
+    double w, re, im, nr, ni, dr, di, mag = 1.0, scale;
+    const int32_t *c;
+    int i;
+
+    if (!cfg) {
+        return 0.0f;
+    }
+    w = 2.0 * M_PI * freq / a_post_ctl.samplerate;
+    re = cos(w);
+    im = -sin(w);
+    scale = 1.0 / (1U << (31 - cfg->postshift));
+    for (i = 0; i < cfg->stages; i++) {
+        c = &cfg->coefs[i * A_DSP_BQ_COEFS];
+        /*H = (b0 + b1 z^-1 + b2 z^-2) / (1 - a1 z^-1 - a2 z^-2)*/
+        nr = c[0] * scale + c[1] * scale * re + c[2] * scale * (re * re - im * im);
+        ni = c[1] * scale * im + c[2] * scale * 2 * re * im;
+        dr = 1.0 - c[3] * scale * re - c[4] * scale * (re * re - im * im);
+        di = -c[3] * scale * im - c[4] * scale * 2 * re * im;
+        mag *= sqrt((nr * nr + ni * ni) / (dr * dr + di * di));
+    }
+    return (float)(20.0 * log10(mag));
+}
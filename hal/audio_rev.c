@@ -0,0 +1,290 @@
+#include <string.h>
+#include <audio_rev.h>
+
+#define A_REV_COMB_SIZE (1 << A_REV_COMB_LOG2)
+#define A_REV_ALLPASS_SIZE (1 << A_REV_ALLPASS_LOG2)
+/*Freeverb tuning at 44.1 kHz, right side is spread by 23 samples*/
+#define A_REV_SPREAD (23)
+#define A_REV_REF_RATE (44100)
+/*Input attenuation, keeps comb sums in range*/
+#define A_REV_IN_SHIFT (3)
+
+typedef struct {
+    uint16_t pos;
+    uint16_t len;
+    int16_t filt;
+} a_rev_line_t;
+
+typedef struct {
+    a_rev_line_t comb[A_REV_COMBS];
+    a_rev_line_t ap[A_REV_ALLPASS];
+} a_rev_side_t;
+
+static const uint16_t a_rev_comb_tune[A_REV_COMBS] = {1116, 1277, 1422, 1557};
+static const uint16_t a_rev_ap_tune[A_REV_ALLPASS] = {556, 441};
+
+static int16_t a_rev_comb_buf[2][A_REV_COMBS][A_REV_COMB_SIZE] A_DTCM;
+static int16_t a_rev_ap_buf[2][A_REV_ALLPASS][A_REV_ALLPASS_SIZE] A_DTCM;
+static a_rev_side_t a_rev_side[2];
+static a_rev_param_t a_rev_cfg;
+static int16_t a_rev_wet1, a_rev_wet2;
+static uint8_t a_rev_ready = 0;
+
+/*Mixer send bus of the current period, see a_rev_voice*/
+static int32_t a_rev_bus_buf[A_REV_BUS_FRAMES] A_DTCM;
+/*frames holding sends, 0 - bus is empty*/
+static int a_rev_bus_frames = 0;
+/*Frames for the tail to die out after the last send*/
+static uint32_t a_rev_tail_len = 0;
+static uint32_t a_rev_tail_left = 0;
+
+static inline int16_t
+a_rev_sat16 (int32_t v)
+{
+    if (v > INT16_MAX) {
+        return INT16_MAX;
+    } else if (v < INT16_MIN) {
+        return INT16_MIN;
+    }
+    return (int16_t)v;
+}
+
+static uint16_t
+a_rev_scale (uint32_t len, uint32_t rate, uint32_t max)
+{
+    len = (len * rate) / A_REV_REF_RATE;
+    if (len >= max) {
+        len = max - 1;
+    }
+    return len ? len : 1;
+}
+
+void
+a_rev_param_default (a_rev_param_t *param, uint8_t decay)
+{
+    /*room size 0.7 .. 0.98 by decay*/
+    param->feedback = (int16_t)(22938 + (decay * (32112 - 22938)) / 255);
+    param->damp = 0x4000 / 2;
+    param->wet = 0x7fff / 3;
+    param->width = 0x7fff;
+}
+
+/*
+ * Silence needed for any state to reach zero : comb loop gain is at most
+ * 'feedback' per pass of the longest line (the damping low-pass has unity
+ * dc gain, Q15 products round toward zero), then the all-passes halve
+ * their content every pass.
+ */
+static uint32_t
+a_rev_tail_frames (int16_t feedback)
+{
+    uint32_t len = 0, passes = 1;
+    int32_t g = INT16_MAX;
+    int s, i;
+
+    for (s = 0; s < 2; s++) {
+        for (i = 0; i < A_REV_COMBS; i++) {
+            if (a_rev_side[s].comb[i].len > len) {
+                len = a_rev_side[s].comb[i].len;
+            }
+        }
+    }
+    while (g > 0 && feedback > 0) {
+        g = (g * feedback) >> 15;
+        passes++;
+    }
+    return passes * len + 16 * A_REV_ALLPASS_SIZE;
+}
+
+void
+a_rev_param (const a_rev_param_t *param)
+{
+    a_rev_cfg = *param;
+    a_rev_tail_len = a_rev_tail_frames(param->feedback);
+    /*Freeverb : wet1 = wet * (width / 2 + 0.5), wet2 = wet * (1 - width) / 2*/
+    a_rev_wet1 = (int16_t)((param->wet * ((param->width >> 1) + 0x4000)) >> 15);
+    a_rev_wet2 = (int16_t)((param->wet * ((0x7fff - param->width) >> 1)) >> 15);
+}
+
+void
+a_rev_clear (void)
+{
+    int s, i;
+
+    memset(a_rev_comb_buf, 0, sizeof(a_rev_comb_buf));
+    memset(a_rev_ap_buf, 0, sizeof(a_rev_ap_buf));
+    for (s = 0; s < 2; s++) {
+        for (i = 0; i < A_REV_COMBS; i++) {
+            a_rev_side[s].comb[i].pos = 0;
+            a_rev_side[s].comb[i].filt = 0;
+        }
+        for (i = 0; i < A_REV_ALLPASS; i++) {
+            a_rev_side[s].ap[i].pos = 0;
+        }
+    }
+    memset(a_rev_bus_buf, 0, sizeof(a_rev_bus_buf));
+    a_rev_bus_frames = 0;
+    a_rev_tail_left = 0;
+}
+
+int
+a_rev_setup (uint32_t rate, const a_rev_param_t *param)
+{
+    int s, i, spread;
+
+    if (!rate || rate > 48000) {
+        return -1;
+    }
+    for (s = 0; s < 2; s++) {
+        spread = s ? A_REV_SPREAD : 0;
+        for (i = 0; i < A_REV_COMBS; i++) {
+            a_rev_side[s].comb[i].len = a_rev_scale(a_rev_comb_tune[i] + spread,
+                                                    rate, A_REV_COMB_SIZE);
+        }
+        for (i = 0; i < A_REV_ALLPASS; i++) {
+            a_rev_side[s].ap[i].len = a_rev_scale(a_rev_ap_tune[i] + spread,
+                                                  rate, A_REV_ALLPASS_SIZE);
+        }
+    }
+    a_rev_param(param);
+    a_rev_clear();
+    a_rev_ready = 1;
+    return 0;
+}
+
+void
+a_rev_send (int32_t *send, const int16_t *src, int16_t gain, int frames)
+{
+    while (frames--) {
+        *send++ += (((src[0] + src[1]) >> 1) * gain) >> 15;
+        src += 2;
+    }
+}
+
+/*
+ * Q15 scaling in the recursive paths rounds toward zero : with flooring
+ * shifts a decaying tail never reaches zero, it sticks at -1 LSB.
+ */
+static inline int32_t
+a_rev_q15 (int32_t v)
+{
+    return (v + ((v >> 31) & 0x7fff)) >> 15;
+}
+
+/*
+ * Delay line of length 'len' is read 'len' samples behind the write position,
+ * rings are power of 2 so wrap is a mask.
+ */
+static inline int16_t
+a_rev_comb (a_rev_line_t *line, int16_t *buf, int16_t in,
+                int16_t feedback, int16_t damp1, int16_t damp2)
+{
+    uint16_t rd = (line->pos - line->len) & (A_REV_COMB_SIZE - 1);
+    int16_t out = buf[rd];
+
+    line->filt = (int16_t)a_rev_q15(out * damp2 + line->filt * damp1);
+    buf[line->pos] = a_rev_sat16(in + a_rev_q15(line->filt * feedback));
+    line->pos = (line->pos + 1) & (A_REV_COMB_SIZE - 1);
+    return out;
+}
+
+static inline int16_t
+a_rev_allpass (a_rev_line_t *line, int16_t *buf, int16_t in)
+{
+    uint16_t rd = (line->pos - line->len) & (A_REV_ALLPASS_SIZE - 1);
+    int16_t bufout = buf[rd];
+
+    buf[line->pos] = a_rev_sat16(in + bufout / 2);
+    line->pos = (line->pos + 1) & (A_REV_ALLPASS_SIZE - 1);
+    return a_rev_sat16(bufout - in);
+}
+
+static inline int16_t
+a_rev_side_tick (int side, int16_t in)
+{
+    a_rev_side_t *rs = &a_rev_side[side];
+    const int16_t fb = a_rev_cfg.feedback;
+    const int16_t damp1 = a_rev_cfg.damp, damp2 = 0x7fff - a_rev_cfg.damp;
+    int32_t out = 0;
+    int i;
+
+    for (i = 0; i < A_REV_COMBS; i++) {
+        out += a_rev_comb(&rs->comb[i], a_rev_comb_buf[side][i], in, fb, damp1, damp2);
+    }
+    out = a_rev_sat16(out);
+    for (i = 0; i < A_REV_ALLPASS; i++) {
+        out = a_rev_allpass(&rs->ap[i], a_rev_ap_buf[side][i], (int16_t)out);
+    }
+    return (int16_t)out;
+}
+
+void
+a_rev_process (const int32_t *send, int32_t *acc, int frames)
+{
+    int16_t in, l, r;
+
+    if (!a_rev_ready) {
+        return;
+    }
+    while (frames--) {
+        in = a_rev_sat16(*send++ >> A_REV_IN_SHIFT);
+        l = a_rev_side_tick(0, in);
+        r = a_rev_side_tick(1, in);
+        acc[0] += ((l * a_rev_wet1) >> 15) + ((r * a_rev_wet2) >> 15);
+        acc[1] += ((r * a_rev_wet1) >> 15) + ((l * a_rev_wet2) >> 15);
+        acc += 2;
+    }
+}
+
+void
+a_rev_voice (const int16_t *src, int chans, uint8_t effect, int frames)
+{
+    int16_t gain = A_REV_SEND_GAIN(effect);
+    int32_t *send = a_rev_bus_buf;
+
+    if (!effect || !a_rev_ready) {
+        return;
+    }
+    /*longer periods send their head only*/
+    if (frames > A_REV_BUS_FRAMES) {
+        frames = A_REV_BUS_FRAMES;
+    }
+    if (frames > a_rev_bus_frames) {
+        a_rev_bus_frames = frames;
+    }
+    if (chans == 2) {
+        a_rev_send(send, src, gain, frames);
+    } else {
+        while (frames--) {
+            *send++ += (*src++ * gain) >> 15;
+        }
+    }
+}
+
+void
+a_rev_return (int32_t *acc, int samples)
+{
+    int frames = samples / 2;
+
+    if (frames > A_REV_BUS_FRAMES) {
+        frames = A_REV_BUS_FRAMES;
+    }
+    if (a_rev_bus_frames) {
+        /*tail counts from the end of this period*/
+        a_rev_tail_left = a_rev_tail_len + frames;
+    } else if (!a_rev_tail_left) {
+        return;
+    }
+    a_rev_process(a_rev_bus_buf, acc, frames);
+    if (a_rev_bus_frames) {
+        memset(a_rev_bus_buf, 0, a_rev_bus_frames * sizeof(a_rev_bus_buf[0]));
+        a_rev_bus_frames = 0;
+    }
+    a_rev_tail_left = a_rev_tail_left > (uint32_t)frames ? a_rev_tail_left - frames : 0;
+}
+
+uint32_t
+a_rev_tail (void)
+{
+    return a_rev_tail_left;
+}
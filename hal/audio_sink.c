@@ -0,0 +1,326 @@
+#include <string.h>
+
+#include <audio_int.h>
+#include <audio_sink.h>
+
+#include <debug.h>
+#include <config.h>
+
+#if AUDIO_MODULE_PRESENT
+
+#define A_SINK_WAV_HDR (44)
+
+typedef struct {
+    a_sink_e type;
+    const a_sink_ops_t *ops;
+    uint32_t samplerate;
+    uint32_t channels;
+    uint32_t samplebits;
+    int idx;
+    a_sink_stat_t stat;
+    uint32_t (*us) (void);
+} a_sink_t;
+
+static a_sink_t a_sink;
+
+static void
+a_sink_le32 (uint8_t *p, uint32_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static void
+a_sink_le16 (uint8_t *p, uint16_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static int
+a_sink_wav_hdr (uint32_t datalen)
+{
+    uint8_t hdr[A_SINK_WAV_HDR];
+    uint32_t align = a_sink.channels * a_sink.samplebits / 8;
+
+    d_memcpy(hdr, "RIFF", 4);
+    a_sink_le32(hdr + 4, datalen + A_SINK_WAV_HDR - 8);
+    d_memcpy(hdr + 8, "WAVEfmt ", 8);
+    a_sink_le32(hdr + 16, 16);
+    a_sink_le16(hdr + 20, 1);
+    a_sink_le16(hdr + 22, a_sink.channels);
+    a_sink_le32(hdr + 24, a_sink.samplerate);
+    a_sink_le32(hdr + 28, a_sink.samplerate * align);
+    a_sink_le16(hdr + 32, align);
+    a_sink_le16(hdr + 34, a_sink.samplebits);
+    d_memcpy(hdr + 36, "data", 4);
+    a_sink_le32(hdr + 40, datalen);
+    if (a_sink.ops->seek(a_sink.ops->ctx, 0) < 0) {
+        return -1;
+    }
+    return a_sink.ops->write(a_sink.ops->ctx, hdr, sizeof(hdr)) == sizeof(hdr) ? 0 : -1;
+}
+
+#if defined(BSP_DRIVER)
+
+#include "../../ulib/io/fs/FatFs/src/ff.h"
+
+static FIL a_sink_file;
+
+static int
+a_sink_file_write (void *ctx, const void *buf, uint32_t size)
+{
+    UINT bw = 0;
+
+    if (f_write((FIL *)ctx, buf, size, &bw) != FR_OK) {
+        return -1;
+    }
+    return bw;
+}
+
+static int
+a_sink_file_seek (void *ctx, uint32_t offset)
+{
+    return f_lseek((FIL *)ctx, offset) == FR_OK ? 0 : -1;
+}
+
+static void
+a_sink_file_close (void *ctx)
+{
+    f_close((FIL *)ctx);
+}
+
+static int
+a_sink_file_open (const char *path)
+{
+    return f_open(&a_sink_file, path, FA_WRITE | FA_CREATE_ALWAYS) == FR_OK ? 0 : -1;
+}
+
+static uint32_t
+a_sink_default_us (void)
+{
+    return d_time() * 1000;
+}
+
+#else /*BSP_DRIVER*/
+
+#include <stdio.h>
+#include <time.h>
+
+static FILE *a_sink_file;
+
+static int
+a_sink_file_write (void *ctx, const void *buf, uint32_t size)
+{
+    return fwrite(buf, 1, size, *(FILE **)ctx);
+}
+
+static int
+a_sink_file_seek (void *ctx, uint32_t offset)
+{
+    return fseek(*(FILE **)ctx, offset, SEEK_SET);
+}
+
+static void
+a_sink_file_close (void *ctx)
+{
+    fclose(*(FILE **)ctx);
+}
+
+static int
+a_sink_file_open (const char *path)
+{
+    a_sink_file = fopen(path, "wb");
+    return a_sink_file ? 0 : -1;
+}
+
+static uint32_t
+a_sink_default_us (void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000U + ts.tv_nsec / 1000;
+}
+
+/*Host build : this file replaces audio_hal.c*/
+
+isr_status_e g_audio_isr_status = A_ISR_NONE;
+int g_audio_isr_pend[A_ISR_MAX] = {0};
+d_bool g_audio_proc_isr = d_true;
+a_voice_pool_t g_audio_voices = A_VOICE_POOL_INIT(AUDIO_MAX_VOICES);
+
+void
+a_hal_configure (a_intcfg_t *cfg)
+{
+    a_post_init(cfg->samplerate);
+#if USE_REVERB
+    a_rev_init();
+#endif
+    if (a_sink_configure(cfg) < 0) {
+        error_handle();
+    }
+}
+
+void a_hal_shutdown (void)
+{
+    a_sink_close();
+}
+
+void
+a_hal_deinit (void)
+{
+    a_sink_close();
+}
+
+void
+a_hal_check_cfg (a_intcfg_t *cfg)
+{
+    if (cfg->sink == A_SINK_SAI) {
+        cfg->sink = A_SINK_NULL;
+    }
+    cfg->volume = cfg->volume & MAX_VOL;
+}
+
+#endif /*BSP_DRIVER*/
+
+#if USE_REVERB
+
+void
+a_rev_init (void)
+{
+    a_rev_param_t param;
+
+    a_rev_param_default(&param, REVERB_DECAY);
+    if (a_rev_setup(a_get_conf()->samplerate, &param) < 0) {
+        dprintf("%s() : unsupported rate= %u\n", __func__, a_get_conf()->samplerate);
+        a_mix_set_bus(NULL);
+        return;
+    }
+    a_mix_set_bus(a_rev_return);
+}
+
+#endif /*USE_REVERB*/
+
+static const a_sink_ops_t a_sink_file_ops =
+{
+    a_sink_file_write,
+    a_sink_file_seek,
+    a_sink_file_close,
+    &a_sink_file,
+};
+
+void
+a_sink_clock (uint32_t (*us) (void))
+{
+    a_sink.us = us ? us : a_sink_default_us;
+}
+
+int
+a_sink_configure (const a_intcfg_t *cfg)
+{
+    a_buf_t master;
+
+    a_sink_close();
+    d_memset(&a_sink, 0, sizeof(a_sink));
+    a_sink.type = cfg->sink;
+    a_sink.samplerate = cfg->samplerate;
+    a_sink.channels = cfg->channels;
+    a_sink.samplebits = cfg->samplebits;
+    a_sink.us = a_sink_default_us;
+    a_sink.stat.min = (uint32_t)-1;
+
+    a_get_master4idx(&master, 0);
+    a_sink.stat.budget = (uint32_t)(((uint64_t)master.samples * 1000000U) /
+                        (cfg->samplerate * cfg->channels));
+
+    if (cfg->sink == A_SINK_FILE) {
+        if (!cfg->path || a_sink_file_open(cfg->path) < 0) {
+            dprintf("%s() : can't open \'%s\'\n", __func__, cfg->path ? cfg->path : "");
+            a_sink.type = A_SINK_NULL;
+            return -1;
+        }
+        a_sink.ops = &a_sink_file_ops;
+        if (a_sink_wav_hdr(0) < 0) {
+            a_sink_close();
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int
+a_sink_render (int periods)
+{
+    a_buf_t master;
+    uint32_t t, size;
+    int i;
+
+    if (a_sink.type == A_SINK_SAI) {
+        return -1;
+    }
+    for (i = 0; i < periods; i++) {
+        g_audio_isr_status = a_sink.idx ? A_ISR_COMP : A_ISR_HALF;
+        a_get_master4idx(&master, a_sink.idx);
+        t = a_sink.us();
+        a_paint_buff_helper(&master);
+        a_post_process(master.buf, master.samples);
+        t = a_sink.us() - t;
+        a_sink.idx ^= 1;
+
+        a_sink.stat.periods++;
+        a_sink.stat.samples += master.samples;
+        a_sink.stat.total += t;
+        if (t > a_sink.stat.max) {
+            a_sink.stat.max = t;
+        }
+        if (t < a_sink.stat.min) {
+            a_sink.stat.min = t;
+        }
+        if (a_sink.ops) {
+            size = AUDIO_SAMPLES_2_BYTES(master.samples);
+            if (a_sink.ops->write(a_sink.ops->ctx, master.buf, size) != (int)size) {
+                a_sink.stat.errors++;
+                return -1;
+            }
+            a_sink.stat.bytes += size;
+        }
+    }
+    return i;
+}
+
+void
+a_sink_close (void)
+{
+    if (!a_sink.ops) {
+        return;
+    }
+    if (a_sink_wav_hdr(a_sink.stat.bytes) < 0) {
+        a_sink.stat.errors++;
+    }
+    a_sink.ops->close(a_sink.ops->ctx);
+    a_sink.ops = NULL;
+}
+
+void
+a_sink_stat (a_sink_stat_t *stat)
+{
+    *stat = a_sink.stat;
+}
+
+void
+a_sink_stat_dump (void)
+{
+    a_sink_stat_t *s = &a_sink.stat;
+    uint32_t avg = s->periods ? s->total / s->periods : 0;
+
+    dprintf("audio sink : periods= %u, samples= %u, bytes= %u, errors= %u\n",
+            s->periods, s->samples, s->bytes, s->errors);
+    dprintf("mix us : avg= %u, min= %u, max= %u, budget= %u, load= %u%%\n",
+            avg, s->periods ? s->min : 0, s->max, s->budget,
+            s->budget ? (avg * 100) / s->budget : 0);
+}
+
+#endif /*AUDIO_MODULE_PRESENT*/
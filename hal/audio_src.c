@@ -0,0 +1,357 @@
+#include <string.h>
+#include <math.h>
+#include <audio_src.h>
+
+#if (defined(__ARM_FEATURE_DSP) && __ARM_FEATURE_DSP) || defined(__TARGET_FEATURE_DSPMUL)
+#include "stm32f7xx.h"
+#define A_SRC_DSP 1
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define A_SRC_HALF (A_SRC_TAPS / 2)
+#define A_SRC_CUTOFF_Q (64)
+#define A_SRC_PHASE_SHIFT (A_SRC_FRAC_BITS - A_SRC_PHASES_LOG2)
+/*Nearest phase*/
+#define A_SRC_PHASE(frac) \
+    (((frac) + (1 << (A_SRC_PHASE_SHIFT - 1))) >> A_SRC_PHASE_SHIFT)
+
+typedef struct {
+    /*Extra phase - next input frame, for rounding phase index up*/
+    int16_t coef[A_SRC_PHASES + 1][A_SRC_TAPS];
+    int cutoff;
+} a_src_tbl_t;
+
+static a_src_tbl_t a_src_tbl[A_SRC_TBL_MAX];
+static int a_src_tbl_cnt = 0;
+
+static void
+a_src_tbl_build (a_src_tbl_t *tbl, int cutoff)
+{
+    float fc = (float)cutoff / A_SRC_CUTOFF_Q;
+    float h[A_SRC_TAPS], sum, t, x;
+    int p, k, q, qsum;
+
+    for (p = 0; p <= A_SRC_PHASES; p++) {
+        sum = 0.0f;
+        for (k = 0; k < A_SRC_TAPS; k++) {
+            t = (float)(k - (A_SRC_HALF - 1)) - (float)p / A_SRC_PHASES;
+            x = (float)M_PI * fc * t;
+            h[k] = fabsf(x) < 1e-6f ? fc : fc * sinf(x) / x;
+            /*Blackman over [-TAPS/2 : TAPS/2]*/
+            x = (float)M_PI * t / A_SRC_HALF;
+            h[k] *= 0.42f + 0.5f * cosf(x) + 0.08f * cosf(2.0f * x);
+            sum += h[k];
+        }
+        /*Unity DC gain for every phase*/
+        qsum = 0;
+        for (k = 0; k < A_SRC_TAPS; k++) {
+            q = (int)lrintf(h[k] / sum * 32767.0f);
+            tbl->coef[p][k] = (int16_t)q;
+            qsum += q;
+        }
+        tbl->coef[p][A_SRC_HALF - 1 + (p >= A_SRC_PHASES / 2)] += (int16_t)(32767 - qsum);
+    }
+    tbl->cutoff = cutoff;
+}
+
+/*Cutoff for the input to output step : passband scaled down when decimating*/
+static int
+a_src_cutoff (uint32_t step)
+{
+    int cutoff = A_SRC_CUTOFF_Q * 9 / 10;
+
+    if (step > A_SRC_ONE) {
+        cutoff = (int)(((uint64_t)cutoff << A_SRC_FRAC_BITS) / step);
+    }
+    if (cutoff < 1) {
+        cutoff = 1;
+    }
+    return cutoff;
+}
+
+/*
+ * Nearest table not above 'cutoff', built when there is room,
+ * otherwise the closest one below (or the lowest one) is shared.
+ */
+static const int16_t *
+a_src_tbl_get (int cutoff)
+{
+    a_src_tbl_t *best = NULL;
+    int i;
+
+    for (i = 0; i < a_src_tbl_cnt; i++) {
+        if (a_src_tbl[i].cutoff == cutoff) {
+            return a_src_tbl[i].coef[0];
+        }
+    }
+    if (a_src_tbl_cnt < A_SRC_TBL_MAX) {
+        a_src_tbl_build(&a_src_tbl[a_src_tbl_cnt], cutoff);
+        return a_src_tbl[a_src_tbl_cnt++].coef[0];
+    }
+    for (i = 0; i < a_src_tbl_cnt; i++) {
+        if (a_src_tbl[i].cutoff <= cutoff && (!best || a_src_tbl[i].cutoff > best->cutoff)) {
+            best = &a_src_tbl[i];
+        }
+    }
+    if (!best) {
+        best = &a_src_tbl[0];
+        for (i = 1; i < a_src_tbl_cnt; i++) {
+            if (a_src_tbl[i].cutoff < best->cutoff) {
+                best = &a_src_tbl[i];
+            }
+        }
+    }
+    return best->coef[0];
+}
+
+int
+a_src_rate_supported (uint32_t inrate, uint32_t outrate)
+{
+    if (!inrate || !outrate) {
+        return 0;
+    }
+    return ((uint64_t)inrate << A_SRC_FRAC_BITS) / outrate <= A_SRC_STEP_MAX;
+}
+
+int
+a_src_init (a_src_t *src, uint32_t inrate, uint32_t outrate,
+                    int chans, a_src_mode_e mode)
+{
+    if (!a_src_rate_supported(inrate, outrate) || chans < 1 || chans > 2) {
+        return -1;
+    }
+    memset(src, 0, sizeof(*src));
+    src->basestep = (uint32_t)(((uint64_t)inrate << A_SRC_FRAC_BITS) / outrate);
+    src->step = src->basestep;
+    src->chans = chans;
+    src->mode = mode;
+    if (mode == A_SRC_POLY) {
+        src->coef = a_src_tbl_get(a_src_cutoff(src->basestep));
+    }
+    return 0;
+}
+
+void
+a_src_pitch (a_src_t *src, uint32_t pitch)
+{
+    uint64_t step = ((uint64_t)src->basestep * pitch) >> A_SRC_FRAC_BITS;
+    int cutoff, grid;
+
+    if (step > A_SRC_STEP_MAX) {
+        step = A_SRC_STEP_MAX;
+    } else if (!step) {
+        step = 1;
+    }
+    src->step = (uint32_t)step;
+    if (src->mode != A_SRC_POLY) {
+        return;
+    }
+    cutoff = a_src_cutoff(src->step);
+    if (src->step != src->basestep) {
+        /*Half octave grid, so a pitch sweep doesn't use up the tables*/
+        grid = a_src_cutoff(A_SRC_ONE);
+        while (grid > cutoff && grid > 1) {
+            grid = grid * 181 / 256;
+        }
+        cutoff = grid;
+    }
+    src->coef = a_src_tbl_get(cutoff);
+}
+
+void
+a_src_seek (a_src_t *src, uint32_t frame)
+{
+    src->pos = (int32_t)frame;
+    src->frac = 0;
+}
+
+static inline int32_t
+a_src_gain (int32_t v, int16_t gain)
+{
+    return (v * gain) >> 15;
+}
+
+/*Frame 'i' of the block, < 0 - from history, zero past the end*/
+static inline int16_t
+a_src_at (const a_src_t *src, const int16_t *in, int inframes, int32_t i, int c)
+{
+    if (i < 0) {
+        return src->hist[A_SRC_TAPS + i][c];
+    }
+    if (i < inframes) {
+        return in[i * src->chans + c];
+    }
+    return 0;
+}
+
+/*Block is over : its tail goes to history, position - to the next block*/
+static void
+a_src_next_block (a_src_t *src, const int16_t *in, int inframes)
+{
+    int16_t hist[A_SRC_TAPS][2];
+    int k, c;
+
+    for (k = 0; k < A_SRC_TAPS; k++) {
+        for (c = 0; c < 2; c++) {
+            hist[k][c] = a_src_at(src, in, inframes, inframes - A_SRC_TAPS + k,
+                                  c & (src->chans - 1));
+        }
+    }
+    memcpy(src->hist, hist, sizeof(hist));
+    src->pos -= inframes;
+}
+
+static int
+a_src_mix_linear (a_src_t *src, int32_t *acc, int16_t gain,
+                    const int16_t *in, int inframes, int outframes)
+{
+    const int ch = src->chans;
+    /*next frame must be in the block*/
+    const int32_t end = in ? inframes - 1 : 0;
+    int32_t pos = src->pos;
+    uint32_t frac = src->frac;
+    int32_t f, l0, l1, r0, r1;
+    int n = 0;
+
+    while (n < outframes && pos < end) {
+        /*Q15 fraction*/
+        f = frac >> (A_SRC_FRAC_BITS - 15);
+        if (pos >= 0) {
+            const int16_t *s = in + pos * ch;
+
+            l0 = s[0];
+            r0 = s[ch - 1];
+            l1 = s[ch];
+            r1 = s[ch + ch - 1];
+        } else {
+            l0 = a_src_at(src, in, inframes, pos, 0);
+            r0 = a_src_at(src, in, inframes, pos, ch - 1);
+            l1 = a_src_at(src, in, inframes, pos + 1, 0);
+            r1 = a_src_at(src, in, inframes, pos + 1, ch - 1);
+        }
+        acc[0] += a_src_gain(l0 + (((l1 - l0) * f) >> 15), gain);
+        acc[1] += a_src_gain(r0 + (((r1 - r0) * f) >> 15), gain);
+        acc += 2;
+        n++;
+        frac += src->step;
+        pos += frac >> A_SRC_FRAC_BITS;
+        frac &= A_SRC_ONE - 1;
+    }
+    src->pos = pos;
+    src->frac = frac;
+    return n;
+}
+
+#if A_SRC_DSP
+
+static inline int32_t
+a_src_dot (const int16_t *s, const int16_t *h)
+{
+    uint32_t a, b;
+    int32_t sum = 0;
+    int k;
+
+    for (k = 0; k < A_SRC_TAPS; k += 2) {
+        memcpy(&a, s + k, sizeof(a));
+        memcpy(&b, h + k, sizeof(b));
+        sum = __SMLAD(a, b, sum);
+    }
+    return sum;
+}
+
+#else
+
+static inline int32_t
+a_src_dot (const int16_t *s, const int16_t *h)
+{
+    int32_t sum = 0;
+    int k;
+
+    for (k = 0; k < A_SRC_TAPS; k++) {
+        sum += s[k] * h[k];
+    }
+    return sum;
+}
+
+#endif /*A_SRC_DSP*/
+
+/*Gather taps of one channel into contiguous array, history before the block*/
+static inline void
+a_src_taps (int16_t *dst, const a_src_t *src, const int16_t *in, int c,
+                    int32_t first, int inframes)
+{
+    const int ch = src->chans;
+    int k;
+
+    if (first >= 0 && first + A_SRC_TAPS <= inframes) {
+        in += first * ch + c;
+        for (k = 0; k < A_SRC_TAPS; k++) {
+            dst[k] = in[k * ch];
+        }
+        return;
+    }
+    for (k = 0; k < A_SRC_TAPS; k++) {
+        dst[k] = a_src_at(src, in, inframes, first + k, c);
+    }
+}
+
+static int
+a_src_mix_poly (a_src_t *src, int32_t *acc, int16_t gain,
+                    const int16_t *in, int inframes, int outframes)
+{
+    const int ch = src->chans;
+    /*last tap must be in the block*/
+    const int32_t end = in ? inframes - A_SRC_HALF : 0;
+    int32_t pos = src->pos;
+    uint32_t frac = src->frac;
+    int16_t tl[A_SRC_TAPS], tr[A_SRC_TAPS];
+    const int16_t *h;
+    int32_t first, l, r;
+    int n = 0;
+
+    while (n < outframes && pos < end) {
+        h = src->coef + A_SRC_PHASE(frac) * A_SRC_TAPS;
+        first = pos - (A_SRC_HALF - 1);
+        a_src_taps(tl, src, in, 0, first, inframes);
+        if (ch > 1) {
+            a_src_taps(tr, src, in, 1, first, inframes);
+            l = a_src_dot(tl, h) >> 15;
+            r = a_src_dot(tr, h) >> 15;
+        } else {
+            l = r = a_src_dot(tl, h) >> 15;
+        }
+        acc[0] += a_src_gain(l, gain);
+        acc[1] += a_src_gain(r, gain);
+        acc += 2;
+        n++;
+        frac += src->step;
+        pos += frac >> A_SRC_FRAC_BITS;
+        frac &= A_SRC_ONE - 1;
+    }
+    src->pos = pos;
+    src->frac = frac;
+    return n;
+}
+
+int
+a_src_mix (a_src_t *src, int32_t *acc, int16_t gain,
+                    const int16_t *in, int inframes, int outframes)
+{
+    int n;
+
+    if (!in) {
+        inframes = 0;
+    }
+    if (src->mode == A_SRC_POLY) {
+        n = a_src_mix_poly(src, acc, gain, in, inframes, outframes);
+    } else {
+        n = a_src_mix_linear(src, acc, gain, in, inframes, outframes);
+    }
+    if (n < outframes) {
+        a_src_next_block(src, in, inframes);
+    }
+    return n;
+}
@@ -0,0 +1,289 @@
+#include <string.h>
+#include <audio_stream.h>
+#include <audio_ring.h>
+#include <audio_mix.h>
+
+static uint32_t
+a_stream_le32 (const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t
+a_stream_le16 (const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static int
+a_stream_rd (a_stream_t *st, void *buf, uint32_t size)
+{
+    return st->src->read(st->src->ctx, buf, size) == (int)size ? 0 : -1;
+}
+
+/*Finds 'fmt ' and 'data' chunks, only 16 bit stereo pcm is accepted*/
+static int
+a_stream_parse_wav (a_stream_t *st)
+{
+    uint8_t hdr[16];
+    uint32_t pos = 12, len;
+    int fmt = 0;
+
+    if (st->src->seek(st->src->ctx, 0) < 0 || a_stream_rd(st, hdr, 12) < 0) {
+        return -1;
+    }
+    if (memcmp(hdr, "RIFF", 4) || memcmp(hdr + 8, "WAVE", 4)) {
+        return -1;
+    }
+    for (;;) {
+        if (a_stream_rd(st, hdr, 8) < 0) {
+            return -1;
+        }
+        len = a_stream_le32(hdr + 4);
+        pos += 8;
+        if (!memcmp(hdr, "fmt ", 4)) {
+            if (len < 16 || a_stream_rd(st, hdr, 16) < 0) {
+                return -1;
+            }
+            if (a_stream_le16(hdr) != 1 || a_stream_le16(hdr + 2) != 2 ||
+                a_stream_le16(hdr + 14) != 16) {
+                return -1;
+            }
+            st->samplerate = a_stream_le32(hdr + 4);
+            fmt = 1;
+        } else if (!memcmp(hdr, "data", 4)) {
+            if (!fmt) {
+                return -1;
+            }
+            st->dataoff = pos;
+            st->datalen = len & ~(A_STREAM_FRAME - 1);
+            return 0;
+        }
+        /*chunks are word aligned*/
+        pos += (len + 1) & ~1;
+        if (st->src->seek(st->src->ctx, pos) < 0) {
+            return -1;
+        }
+    }
+}
+
+static inline uint32_t
+a_stream_fill_bytes (a_stream_t *st)
+{
+    return st->wr - st->rd;
+}
+
+int
+a_stream_fill (a_stream_t *st)
+{
+    uint32_t space, off, btr, total = 0;
+    int br;
+
+    while (!st->eof) {
+        space = st->size - a_stream_fill_bytes(st);
+        off = st->wr & (st->size - 1);
+        /*
+         * Up to the next chunk boundary of the file, so the next read starts
+         * sector aligned : first read after open or a loop is short.
+         * Never past the ring end.
+         */
+        btr = st->chunk - ((st->dataoff + st->filepos) & (st->chunk - 1));
+        if (btr > st->size - off) {
+            btr = st->size - off;
+        }
+        if (btr > st->datalen - st->filepos) {
+            btr = st->datalen - st->filepos;
+        }
+        if (btr > space) {
+            break;
+        }
+        br = st->src->read(st->src->ctx, st->ring + off, btr);
+        if (br <= 0) {
+            /*Error, or file is shorter than its header says*/
+            st->stat.errors++;
+            st->eof = 1;
+            break;
+        }
+        st->stat.reads++;
+        st->stat.bytes += br;
+        st->filepos += br;
+        total += br;
+        A_RING_BARRIER();
+        st->wr = st->wr + br;
+        if (br < (int)btr) {
+            /*Throttled source, rest of the chunk next time*/
+            break;
+        }
+        if (st->filepos < st->datalen) {
+            continue;
+        }
+        if (st->loopstart == A_STREAM_NOLOOP ||
+            st->src->seek(st->src->ctx, st->dataoff + st->loopstart) < 0) {
+            st->eof = 1;
+            break;
+        }
+        st->filepos = st->loopstart;
+        st->stat.loops++;
+    }
+    return total;
+}
+
+int
+a_stream_open (a_stream_t *st, const a_stream_src_t *src, void *ring,
+                        uint32_t size, uint32_t chunk, uint32_t loopstart,
+                        uint32_t outrate)
+{
+    if ((size & (size - 1)) || (chunk & (chunk - 1)) || chunk > size ||
+        chunk < A_STREAM_FRAME) {
+        return -1;
+    }
+    memset(st, 0, sizeof(*st));
+    st->src = src;
+    st->ring = (uint8_t *)ring;
+    st->size = size;
+    st->chunk = chunk;
+    if (a_stream_parse_wav(st) < 0 || !st->datalen) {
+        return -1;
+    }
+    /*Mixed as is, no rate conversion*/
+    if (st->samplerate != outrate) {
+        return -1;
+    }
+    if (loopstart != A_STREAM_NOLOOP) {
+        loopstart *= A_STREAM_FRAME;
+        if (loopstart >= st->datalen) {
+            loopstart = 0;
+        }
+    }
+    st->loopstart = loopstart;
+    st->stat.size = size;
+    /*Ring follows the file offset, ring end falls on a file chunk boundary*/
+    st->wr = st->rd = st->dataoff & (chunk - 1) & ~(A_STREAM_FRAME - 1);
+    a_stream_fill(st);
+    st->stat.lowwater = a_stream_fill_bytes(st);
+    return 0;
+}
+
+void
+a_stream_close (a_stream_t *st)
+{
+    if (st->src && st->src->close) {
+        st->src->close(st->src->ctx);
+    }
+    st->src = NULL;
+    st->eof = 1;
+}
+
+int
+a_stream_mix (a_stream_t *st, int32_t *acc, int16_t gain, int frames)
+{
+    uint32_t avail, off, n;
+    int done = 0;
+
+    avail = a_stream_fill_bytes(st) / A_STREAM_FRAME;
+    A_RING_BARRIER();
+    if (avail < (uint32_t)frames && !st->eof) {
+        st->stat.underruns++;
+        st->stat.starved += frames - avail;
+    }
+    while (frames > 0 && avail) {
+        off = st->rd & (st->size - 1);
+        /*Contiguous part up to ring end*/
+        n = (st->size - off) / A_STREAM_FRAME;
+        if (n > avail) {
+            n = avail;
+        }
+        if (n > (uint32_t)frames) {
+            n = frames;
+        }
+        a_mix_voice(acc, (const int16_t *)(st->ring + off), gain, n * 2);
+        acc += n * 2;
+        avail -= n;
+        frames -= n;
+        done += n;
+        A_RING_BARRIER();
+        st->rd = st->rd + n * A_STREAM_FRAME;
+    }
+    n = a_stream_fill_bytes(st);
+    st->stat.fill = n;
+    if (n < st->stat.lowwater && !st->eof) {
+        st->stat.lowwater = n;
+    }
+    return done;
+}
+
+int
+a_stream_done (a_stream_t *st)
+{
+    return st->eof && !a_stream_fill_bytes(st);
+}
+
+void
+a_stream_stat (a_stream_t *st, a_stream_stat_t *stat)
+{
+    *stat = st->stat;
+    stat->fill = a_stream_fill_bytes(st);
+}
+
+#if defined(BSP_DRIVER)
+
+#include "../../ulib/io/fs/FatFs/src/ff.h"
+#include <heap.h>
+
+static int
+a_stream_file_read (void *ctx, void *buf, uint32_t size)
+{
+    UINT br = 0;
+
+    if (f_read((FIL *)ctx, buf, size, &br) != FR_OK) {
+        return -1;
+    }
+    return br;
+}
+
+static int
+a_stream_file_seek (void *ctx, uint32_t offset)
+{
+    return f_lseek((FIL *)ctx, offset) == FR_OK ? 0 : -1;
+}
+
+static void
+a_stream_file_close (void *ctx)
+{
+    f_close((FIL *)ctx);
+    heap_free(ctx);
+}
+
+typedef struct {
+    /*first : 'ctx' is the whole object*/
+    FIL file;
+    a_stream_src_t src;
+} a_stream_file_t;
+
+int
+a_stream_open_file (a_stream_t *st, const char *path, void *ring,
+                        uint32_t size, uint32_t chunk, uint32_t loopstart,
+                        uint32_t outrate)
+{
+    a_stream_file_t *f = heap_malloc(sizeof(*f));
+
+    if (!f) {
+        return -1;
+    }
+    if (f_open(&f->file, path, FA_READ) != FR_OK) {
+        heap_free(f);
+        return -1;
+    }
+    f->src.read = a_stream_file_read;
+    f->src.seek = a_stream_file_seek;
+    f->src.close = a_stream_file_close;
+    f->src.ctx = f;
+    if (a_stream_open(st, &f->src, ring, size, chunk, loopstart, outrate) < 0) {
+        f_close(&f->file);
+        heap_free(f);
+        return -1;
+    }
+    return 0;
+}
+
+#endif /*BSP_DRIVER*/
@@ -0,0 +1,139 @@
+#include <string.h>
+#include <audio_voice.h>
+
+void
+a_voice_pool_init (a_voice_pool_t *pool, int size)
+{
+    memset(pool, 0, sizeof(*pool));
+    if (size > A_VOICE_MAX) {
+        size = A_VOICE_MAX;
+    }
+    pool->size = size;
+    pool->free = A_VOICE_MASK(size);
+}
+
+static inline void
+a_voice_link (a_voice_pool_t *pool, int voice, uint8_t prio)
+{
+    int lvl = A_VOICE_LEVEL(prio);
+
+    pool->prio[voice] = prio;
+    pool->level[lvl] |= 1U << voice;
+    pool->levels |= 1U << lvl;
+}
+
+static inline void
+a_voice_unlink (a_voice_pool_t *pool, int voice)
+{
+    int lvl = A_VOICE_LEVEL(pool->prio[voice]);
+
+    pool->level[lvl] &= ~(1U << voice);
+    if (!pool->level[lvl]) {
+        pool->levels &= ~(1U << lvl);
+    }
+}
+
+/*Lowest exact priority of the level, lowest index among equals*/
+static inline int
+a_voice_victim (const a_voice_pool_t *pool, int lvl)
+{
+    uint32_t bits = pool->level[lvl];
+    int voice, best = A_VOICE_CTZ(bits);
+
+    for (bits &= bits - 1; bits; bits &= bits - 1) {
+        voice = A_VOICE_CTZ(bits);
+        if (pool->prio[voice] < pool->prio[best]) {
+            best = voice;
+        }
+    }
+    return best;
+}
+
+int
+a_voice_alloc (a_voice_pool_t *pool, uint8_t prio)
+{
+    int voice, lvl;
+
+    if (pool->free) {
+        voice = A_VOICE_CTZ(pool->free);
+        pool->free &= ~(1U << voice);
+        a_voice_link(pool, voice, prio);
+        if (!pool->used++ && pool->first_link_handle) {
+            pool->first_link_handle(pool);
+        }
+        return voice;
+    }
+    if (!pool->levels) {
+        return A_VOICE_NONE;
+    }
+    lvl = A_VOICE_CTZ(pool->levels);
+    if (lvl > A_VOICE_LEVEL(prio)) {
+        pool->refused++;
+        return A_VOICE_NONE;
+    }
+    voice = a_voice_victim(pool, lvl);
+    if (pool->prio[voice] > prio) {
+        pool->refused++;
+        return A_VOICE_NONE;
+    }
+    a_voice_unlink(pool, voice);
+    if (pool->remove_handle) {
+        pool->remove_handle(pool, voice);
+    }
+    a_voice_link(pool, voice, prio);
+    pool->steals++;
+    return voice;
+}
+
+void
+a_voice_free (a_voice_pool_t *pool, int voice)
+{
+    if (voice < 0 || voice >= pool->size || (pool->free & (1U << voice))) {
+        return;
+    }
+    a_voice_unlink(pool, voice);
+    pool->free |= 1U << voice;
+    if (pool->remove_handle) {
+        pool->remove_handle(pool, voice);
+    }
+    if (!--pool->used && pool->empty_handle) {
+        pool->empty_handle(pool);
+    }
+}
+
+void
+a_voice_set_prio (a_voice_pool_t *pool, int voice, uint8_t prio)
+{
+    if (voice < 0 || voice >= pool->size || (pool->free & (1U << voice))) {
+        return;
+    }
+    a_voice_unlink(pool, voice);
+    a_voice_link(pool, voice, prio);
+}
+
+int
+a_voice_reject_below (a_voice_pool_t *pool, uint8_t prio)
+{
+    const int top = A_VOICE_LEVEL(prio);
+    /*Levels below, and the level of 'prio' itself, checked per voice*/
+    uint32_t mask = pool->levels & ((2U << top) - 1);
+    uint32_t bits;
+    int lvl, voice, cnt = 0;
+
+    /*Bounded by number of voices, not by list length*/
+    while (mask) {
+        lvl = A_VOICE_CTZ(mask);
+        mask &= mask - 1;
+        bits = pool->level[lvl];
+        while (bits) {
+            voice = A_VOICE_CTZ(bits);
+            bits &= bits - 1;
+            if (lvl == top && pool->prio[voice] >= prio) {
+                continue;
+            }
+            a_voice_free(pool, voice);
+            cnt++;
+        }
+    }
+    return cnt;
+}
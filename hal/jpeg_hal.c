@@ -20,6 +20,8 @@
 /* Includes ------------------------------------------------------------------*/
 #include <jpeg_utils.h>
 #include <jpeg.h>
+#include <jpeg_pipe.h>
+#include <audio_mic.h>
 
 
 #include <misc_utils.h>
@@ -83,7 +85,8 @@ typedef struct {
     uint32_t input_paused: 1,
              output_paused: 1,
              hw_end: 1,
-             reserved: 29;
+             busy: 1,
+             reserved: 28;
 } jpeg_hal_ctxt_t;
 
 static jpeg_hal_ctxt_t jpeg_hal_ctxt = {0};
@@ -107,25 +110,103 @@ static void *bytestream_move (byte_stream_t *stream, uint32_t *len)
 
 int JPEG_Decode_HAL (jpeg_info_t *info, void *tempbuf, void *data, uint32_t size)
 {
-    int err, done;
+    return JPEG_Decode_HAL_Fmt(info, tempbuf, data, size, JPEG_RGB_FORMAT, NULL, 0);
+}
 
-    err = JPEG_Decode_DMA(&jpeg_hal_ctxt.hal_jpeg, data, size, (uint32_t)tempbuf);
+/*
+ * Decode straight into the output format of the destination layer :
+ * JPEG_RGB565 and JPEG_L8 are ordered-dithered, JPEG_L8 needs the layer CLUT.
+ */
+int JPEG_Decode_HAL_Fmt (jpeg_info_t *info, void *tempbuf, void *data, uint32_t size,
+                         uint32_t outformat, const uint32_t *clut, uint32_t clutsize)
+{
+    int done;
 
-    if (err < 0) return -1;
+    if (JPEG_Decode_HAL_Start(tempbuf, data, size, outformat, clut, clutsize) < 0) {
+        return -1;
+    }
+    do {
+        done = JPEG_Decode_HAL_Poll(info);
+    } while (done == 0);
 
-    do
-    {
-      JPEG_InputHandler(&jpeg_hal_ctxt.hal_jpeg);
-      done = JPEG_OutputHandler(&jpeg_hal_ctxt.hal_jpeg);
-    } while(done == 0);
+    return done < 0 ? -1 : 0;
+}
+
+/*
+ * Non-blocking variant : start the codec, then call JPEG_Decode_HAL_Poll()
+ * until it returns non-zero; codec DMA keeps running between the polls,
+ * so the caller may do other work (see jpeg_pipe.c).
+ */
+int JPEG_Decode_HAL_Start (void *tempbuf, void *data, uint32_t size,
+                           uint32_t outformat, const uint32_t *clut, uint32_t clutsize)
+{
+    if (jpeg_hal_ctxt.busy) {
+        return -1;
+    }
+    if (JPEG_SetDecodeOutputFormat(outformat, clut, clutsize) != HAL_OK) {
+        return -1;
+    }
+    if (JPEG_Decode_DMA(&jpeg_hal_ctxt.hal_jpeg, data, size, (uint32_t)tempbuf) < 0) {
+        JPEG_SetDecodeOutputFormat(JPEG_RGB_FORMAT, NULL, 0);
+        return -1;
+    }
+    jpeg_hal_ctxt.busy = 1;
+    return 0;
+}
+
+int JPEG_Decode_HAL_Poll (jpeg_info_t *info)
+{
+    if (!jpeg_hal_ctxt.busy) {
+        return -1;
+    }
+    JPEG_InputHandler(&jpeg_hal_ctxt.hal_jpeg);
+    if (JPEG_OutputHandler(&jpeg_hal_ctxt.hal_jpeg) == 0) {
+        return 0;
+    }
 
     heap_free(jpeg_hal_ctxt.outtab[0].DataBuffer);
 
     JPEG_Info_HAL(info);
     JPEG_Abort(&jpeg_hal_ctxt.hal_jpeg);
+    JPEG_SetDecodeOutputFormat(JPEG_RGB_FORMAT, NULL, 0);
+    jpeg_hal_ctxt.busy = 0;
+    return 1;
+}
+
+static int jpeg_pipe_decode_start (void *ctx, jpeg_pipe_job_t *job)
+{
+    if (JPEG_Decode_HAL_Start(job->tempbuf, job->data, job->size,
+                              job->outformat, job->clut, job->clutsize) < 0) {
+        if (job->owndata) {
+            heap_free(job->data);
+            job->data = NULL;
+            job->owndata = 0;
+        }
+        return -1;
+    }
     return 0;
 }
 
+static int jpeg_pipe_decode_poll (void *ctx, jpeg_pipe_job_t *job)
+{
+    int done = JPEG_Decode_HAL_Poll(&job->info);
+
+    if (done && job->owndata) {
+        heap_free(job->data);
+        job->data = NULL;
+        job->owndata = 0;
+    }
+    return done;
+}
+
+const jpeg_pipe_stage_ops_t jpeg_pipe_decode_ops =
+{
+    jpeg_pipe_decode_start,
+    jpeg_pipe_decode_poll,
+    NULL,
+    /*codec stalls once its in/out buffers are not served*/
+    1,
+};
 
 /**
   * @brief  Decode_DMA
@@ -473,6 +554,9 @@ void DMA2_Stream3_IRQHandler(void)
 
 void DMA2_Stream4_IRQHandler(void)
 {
+  if (a_mic_dma_irq(DMA2_Stream4)) {
+    return;
+  }
   HAL_DMA_IRQHandler(jpeg_hal_ctxt.hal_jpeg.hdmaout);
 }
 
@@ -0,0 +1,333 @@
+#include <string.h>
+
+#include <jpeg_pipe.h>
+#include <misc_utils.h>
+#include <debug.h>
+
+static const char *jpeg_pipe_stage_name[JPEG_PIPE_STAGE_MAX] =
+{
+    [JPEG_PIPE_READ] = "read",
+    [JPEG_PIPE_DECODE] = "decode",
+    [JPEG_PIPE_CONVERT] = "convert",
+};
+
+static inline int
+jpeg_pipe_q_fill (jpeg_pipe_queue_t *q)
+{
+    return (uint16_t)(q->wr - q->rd);
+}
+
+static int
+jpeg_pipe_q_push (jpeg_pipe_queue_t *q, jpeg_pipe_job_t *job)
+{
+    int fill = jpeg_pipe_q_fill(q);
+
+    if (fill >= q->depth) {
+        return -1;
+    }
+    q->buf[q->wr++ & (JPEG_PIPE_QUEUE_MAX - 1)] = job;
+    fill++;
+    if (fill > q->maxfill) {
+        q->maxfill = fill;
+    }
+    return 0;
+}
+
+static jpeg_pipe_job_t *
+jpeg_pipe_q_pop (jpeg_pipe_queue_t *q)
+{
+    if (q->wr == q->rd) {
+        return NULL;
+    }
+    return q->buf[q->rd++ & (JPEG_PIPE_QUEUE_MAX - 1)];
+}
+
+void jpeg_pipe_init (jpeg_pipe_t *pipe, const jpeg_pipe_stage_ops_t **ops,
+                          int depth, uint32_t (*time) (void))
+{
+    int i;
+
+    assert(time);
+    if (depth <= 0 || depth > JPEG_PIPE_QUEUE_MAX) {
+        depth = JPEG_PIPE_QUEUE_MAX;
+    }
+    d_memset(pipe, 0, sizeof(*pipe));
+    for (i = 0; i < JPEG_PIPE_STAGE_MAX; i++) {
+        /*NULL ops - pass-through stage*/
+        pipe->stage[i].ops = ops[i];
+    }
+    for (i = 0; i < arrlen(pipe->queue); i++) {
+        pipe->queue[i].depth = depth;
+    }
+    pipe->time = time;
+    pipe->tlast = pipe->tbegin = time();
+}
+
+int jpeg_pipe_submit (jpeg_pipe_t *pipe, jpeg_pipe_job_t *job)
+{
+    job->err = 0;
+    d_memset(job->tstart, 0, sizeof(job->tstart));
+    d_memset(job->tend, 0, sizeof(job->tend));
+    if (jpeg_pipe_q_push(&pipe->queue[JPEG_PIPE_READ], job) < 0) {
+        return -1;
+    }
+    pipe->inflight++;
+    return 0;
+}
+
+jpeg_pipe_job_t *jpeg_pipe_collect (jpeg_pipe_t *pipe)
+{
+    return jpeg_pipe_q_pop(&pipe->queue[JPEG_PIPE_STAGE_MAX]);
+}
+
+static void
+jpeg_pipe_stage_start (jpeg_pipe_t *pipe, jpeg_pipe_stage_t *stage,
+                             jpeg_pipe_stat_t *stat, uint32_t now)
+{
+    jpeg_pipe_job_t *job = stage->job;
+    int idx = stage - pipe->stage;
+    int err;
+
+    job->tstart[idx] = now;
+    /*failed job is carried to the end, to be reported*/
+    if (job->err || !stage->ops) {
+        stage->done = 1;
+        return;
+    }
+    err = stage->ops->start(stage->ops->ctx, job);
+    if (err < 0) {
+        job->err = err;
+        stat->errors++;
+        stage->done = 1;
+    }
+}
+
+static void
+jpeg_pipe_stage_poll (jpeg_pipe_t *pipe, jpeg_pipe_stage_t *stage,
+                            jpeg_pipe_stat_t *stat, uint32_t now)
+{
+    jpeg_pipe_job_t *job = stage->job;
+    int idx = stage - pipe->stage;
+    int ret;
+
+    ret = stage->ops->poll(stage->ops->ctx, job);
+    if (ret == 0) {
+        return;
+    }
+    if (ret < 0) {
+        job->err = ret;
+        stat->errors++;
+    }
+    stage->done = 1;
+    job->tend[idx] = now;
+    if (now - job->tstart[idx] > stat->maxlatency) {
+        stat->maxlatency = now - job->tstart[idx];
+    }
+}
+
+/*Serve busy urgent stages, between the polls of the others*/
+static void
+jpeg_pipe_serve_urgent (jpeg_pipe_t *pipe, uint32_t now)
+{
+    jpeg_pipe_stage_t *stage;
+    int i;
+
+    for (i = 0; i < JPEG_PIPE_STAGE_MAX; i++) {
+        stage = &pipe->stage[i];
+        if (stage->job && !stage->done && stage->ops->urgent) {
+            jpeg_pipe_stage_poll(pipe, stage, &pipe->stat[i], now);
+        }
+    }
+}
+
+/*
+ * One scheduler pass. Stages are served from the last one to the first,
+ * so a stage sees the space freed downstream within the same pass.
+ * Returns number of jobs not yet finished.
+ */
+int jpeg_pipe_tick (jpeg_pipe_t *pipe)
+{
+    uint32_t now = pipe->time();
+    uint32_t dt = now - pipe->tlast;
+    jpeg_pipe_stage_t *stage;
+    jpeg_pipe_stat_t *stat;
+    jpeg_pipe_queue_t *out;
+    int i;
+
+    pipe->tlast = now;
+
+    for (i = JPEG_PIPE_STAGE_MAX - 1; i >= 0; i--) {
+        stage = &pipe->stage[i];
+        stat = &pipe->stat[i];
+        out = &pipe->queue[i + 1];
+
+        if (!stage->job) {
+            stat->starved += dt;
+        } else if (stage->done) {
+            stat->blocked += dt;
+        } else {
+            stat->busy += dt;
+            jpeg_pipe_stage_poll(pipe, stage, stat, now);
+            if (!stage->ops->urgent) {
+                jpeg_pipe_serve_urgent(pipe, now);
+            }
+        }
+
+        if (stage->job && stage->done) {
+            if (i == JPEG_PIPE_STAGE_MAX - 1 && pipe->complete) {
+                pipe->complete(stage->job);
+            } else if (jpeg_pipe_q_push(out, stage->job) < 0) {
+                continue;
+            }
+            if (i == JPEG_PIPE_STAGE_MAX - 1) {
+                pipe->inflight--;
+            }
+            stage->job = NULL;
+            stage->done = 0;
+            stat->jobs++;
+        }
+
+        if (!stage->job) {
+            stage->job = jpeg_pipe_q_pop(&pipe->queue[i]);
+            if (stage->job) {
+                jpeg_pipe_stage_start(pipe, stage, stat, now);
+            }
+        }
+    }
+    return pipe->inflight;
+}
+
+/*
+ * Push 'cnt' jobs through the pipe and wait for all of them.
+ * Finished jobs not taken by the 'complete' callback are dropped
+ * from the output queue, their status stays in 'job->err'.
+ * Returns number of failed jobs.
+ */
+int jpeg_pipe_run (jpeg_pipe_t *pipe, jpeg_pipe_job_t *jobs, int cnt)
+{
+    jpeg_pipe_job_t *job;
+    int next = 0, errors = 0;
+
+    while (next < cnt || pipe->inflight) {
+        while (next < cnt && jpeg_pipe_submit(pipe, &jobs[next]) == 0) {
+            next++;
+        }
+        jpeg_pipe_tick(pipe);
+        while ((job = jpeg_pipe_collect(pipe)) != NULL) {
+            if (job->err) {
+                errors++;
+            }
+        }
+    }
+    return errors;
+}
+
+void jpeg_pipe_stat_reset (jpeg_pipe_t *pipe)
+{
+    int i;
+
+    d_memset(pipe->stat, 0, sizeof(pipe->stat));
+    for (i = 0; i < arrlen(pipe->queue); i++) {
+        pipe->queue[i].maxfill = jpeg_pipe_q_fill(&pipe->queue[i]);
+    }
+    pipe->tlast = pipe->tbegin = pipe->time();
+}
+
+void jpeg_pipe_stat_dump (jpeg_pipe_t *pipe)
+{
+    uint32_t total = pipe->tlast - pipe->tbegin;
+    jpeg_pipe_stat_t *stat;
+    int i;
+
+    if (!total) {
+        total = 1;
+    }
+    dprintf("%s() : total %u\n", __func__, total);
+    for (i = 0; i < JPEG_PIPE_STAGE_MAX; i++) {
+        stat = &pipe->stat[i];
+        dprintf("%8s : busy %3u%%, starved %3u%%, blocked %3u%%, jobs %u, errors %u, max %u, queue max %u/%u\n",
+                jpeg_pipe_stage_name[i],
+                (uint32_t)((uint64_t)stat->busy * 100 / total),
+                (uint32_t)((uint64_t)stat->starved * 100 / total),
+                (uint32_t)((uint64_t)stat->blocked * 100 / total),
+                stat->jobs, stat->errors, stat->maxlatency,
+                pipe->queue[i].maxfill, pipe->queue[i].depth);
+    }
+}
+
+#if defined(BSP_DRIVER)
+
+#include "../../ulib/io/fs/FatFs/src/ff.h"
+#include <heap.h>
+
+/*
+ * FatFs reads are blocking and run on the thread which serves the codec.
+ * Read one chunk per poll : a whole number of sectors at a sector aligned
+ * file offset, so FatFs transfers it straight into the job buffer as one
+ * multi-sector read, and the (urgent) decode stage is polled between the
+ * chunks : the read of image N+1 overlaps the decode of image N.
+ * 16K keeps the card streaming, one sector per command would not.
+ */
+#define JPEG_PIPE_READ_CHUNK (16 * 1024)
+
+#if (JPEG_PIPE_READ_CHUNK % _MAX_SS)
+#error "JPEG_PIPE_READ_CHUNK must be a multiple of the sector size"
+#endif
+
+typedef struct {
+    FIL file;
+    uint32_t pos;
+} jpeg_pipe_read_ctx_t;
+
+static jpeg_pipe_read_ctx_t jpeg_pipe_read_ctx;
+
+static int jpeg_pipe_read_start (void *_ctx, jpeg_pipe_job_t *job)
+{
+    jpeg_pipe_read_ctx_t *ctx = (jpeg_pipe_read_ctx_t *)_ctx;
+
+    if (f_open(&ctx->file, job->path, FA_READ) != FR_OK) {
+        return -1;
+    }
+    job->size = f_size(&ctx->file);
+    job->data = heap_alloc_shared(job->size);
+    if (!job->data) {
+        f_close(&ctx->file);
+        return -1;
+    }
+    job->owndata = 1;
+    ctx->pos = 0;
+    return 0;
+}
+
+static int jpeg_pipe_read_poll (void *_ctx, jpeg_pipe_job_t *job)
+{
+    jpeg_pipe_read_ctx_t *ctx = (jpeg_pipe_read_ctx_t *)_ctx;
+    UINT btr = job->size - ctx->pos, br = 0;
+
+    if (btr > JPEG_PIPE_READ_CHUNK) {
+        btr = JPEG_PIPE_READ_CHUNK;
+    }
+    if (f_read(&ctx->file, (uint8_t *)job->data + ctx->pos, btr, &br) != FR_OK || br != btr) {
+        f_close(&ctx->file);
+        heap_free(job->data);
+        job->data = NULL;
+        job->owndata = 0;
+        return -1;
+    }
+    ctx->pos += br;
+    if (ctx->pos < job->size) {
+        return 0;
+    }
+    f_close(&ctx->file);
+    return 1;
+}
+
+const jpeg_pipe_stage_ops_t jpeg_pipe_read_ops =
+{
+    jpeg_pipe_read_start,
+    jpeg_pipe_read_poll,
+    &jpeg_pipe_read_ctx,
+    0,
+};
+
+#endif /*BSP_DRIVER*/
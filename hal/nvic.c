@@ -44,6 +44,8 @@ static void NVIC_init_table (void)
     Sys tick timer is used everywere by HAL to handle timeouts\delays,
     But i have to disable ALL non-fatal interrupts to let SD card op's be atomic.
     SDMMC may report a Rx overrun error if interrupted during FIFO reading.
+    SD read/write now go through DMA and don't mask irqs; this is left
+    for the polled fallback (SD_MODE_DMA_RO/WO = 0).
     FIXME : avoid disabling sys tick irq
 */
 static inline void NVIC_SysTickIrqCtrl (d_bool disable)
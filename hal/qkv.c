@@ -0,0 +1,988 @@
+#include <string.h>
+#include <qkv.h>
+#include <qpak.h>
+#include <misc_utils.h>
+#include <debug.h>
+
+#define QKV_ALIGN4(x) (((x) + 3) & ~3)
+#define QKV_MEM_ALIGN(x) (((x) + 7) & ~7)
+
+static inline uint32_t
+qkv_hsize (uint32_t keys)
+{
+    uint32_t size = 1;
+
+    while (size < keys) {
+        size <<= 1;
+    }
+    return size;
+}
+
+uint32_t qkv_memsize (uint16_t nsect, uint16_t maxkeys)
+{
+    return QKV_MEM_ALIGN(nsect * sizeof(qkv_sect_t)) +
+           QKV_MEM_ALIGN(maxkeys * sizeof(qkv_node_t)) +
+           QKV_MEM_ALIGN(qkv_hsize(maxkeys) * sizeof(uint16_t)) +
+           QKV_MEM_ALIGN(nsect * sizeof(uint16_t)) +
+           QKV_SECTOR + 8;
+}
+
+/*FNV-1a*/
+static uint32_t
+qkv_hash (const char *key, uint32_t klen)
+{
+    uint32_t hash = 0x811c9dc5;
+
+    while (klen--) {
+        hash ^= (uint8_t)*key++;
+        hash *= 0x01000193;
+    }
+    return hash;
+}
+
+static inline uint32_t
+qkv_rec_size (const qkv_rec_hdr_t *rec)
+{
+    return QKV_ALIGN4(sizeof(*rec) + rec->klen + (rec->vlen == QKV_TOMB ? 0 : rec->vlen));
+}
+
+static inline const qkv_rec_hdr_t *
+qkv_rec (qkv_t *kv, uint32_t off)
+{
+    return (const qkv_rec_hdr_t *)(kv->base + off);
+}
+
+static inline const char *
+qkv_rec_key (const qkv_rec_hdr_t *rec)
+{
+    return (const char *)(rec + 1);
+}
+
+static inline const uint8_t *
+qkv_rec_val (const qkv_rec_hdr_t *rec)
+{
+    return (const uint8_t *)(rec + 1) + rec->klen;
+}
+
+/*Flash update section, see qkv_ops_t*/
+static int
+qkv_begin (qkv_t *kv)
+{
+    if (kv->ops->begin && kv->ops->begin(kv->ops->hw) < 0) {
+        kv->stat.busy++;
+        return -1;
+    }
+    return 0;
+}
+
+static inline void
+qkv_end (qkv_t *kv)
+{
+    if (kv->ops->end) {
+        kv->ops->end(kv->ops->hw);
+    }
+}
+
+/*Read of the mapped region, see qkv_ops_t*/
+static inline int
+qkv_pin (qkv_t *kv)
+{
+    if (kv->ops->pin && kv->ops->pin(kv->ops->hw) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+static inline void
+qkv_unpin (qkv_t *kv)
+{
+    if (kv->ops->unpin) {
+        kv->ops->unpin(kv->ops->hw);
+    }
+}
+
+/*Zeroed torn write*/
+static inline d_bool
+qkv_rec_pad (const qkv_rec_hdr_t *rec)
+{
+    return *(const uint32_t *)rec == 0;
+}
+
+static uint32_t
+qkv_rec_crc (const qkv_rec_hdr_t *rec, const void *key, const void *val)
+{
+    uint32_t crc;
+
+    crc = qpak_crc32(0, &rec->klen, sizeof(*rec) - 1 - sizeof(rec->crc));
+    crc = qpak_crc32(crc, key, rec->klen);
+    if (rec->vlen != QKV_TOMB) {
+        crc = qpak_crc32(crc, val, rec->vlen);
+    }
+    return crc;
+}
+
+static d_bool
+qkv_blank (const uint8_t *p, uint32_t size)
+{
+    const uint32_t *w = (const uint32_t *)p;
+
+    for (size /= sizeof(*w); size; size--) {
+        if (*w++ != 0xffffffff) {
+            return d_false;
+        }
+    }
+    return d_true;
+}
+
+static inline uint16_t *
+qkv_bucket (qkv_t *kv, uint32_t hash)
+{
+    return &kv->hash[hash & kv->hmask];
+}
+
+static uint16_t
+qkv_lookup (qkv_t *kv, const char *key, uint32_t klen, uint32_t hash)
+{
+    const qkv_rec_hdr_t *rec;
+    uint16_t idx = *qkv_bucket(kv, hash);
+
+    while (idx != QKV_NIL) {
+        if (kv->node[idx].hash == hash) {
+            rec = qkv_rec(kv, kv->node[idx].off);
+            if (rec->klen == klen && !memcmp(qkv_rec_key(rec), key, klen)) {
+                break;
+            }
+        }
+        idx = kv->node[idx].next;
+    }
+    return idx;
+}
+
+static inline void
+qkv_live_add (qkv_t *kv, uint32_t off, int32_t size)
+{
+    kv->sect[off / QKV_SECTOR].live += size;
+}
+
+/*Record at 'off' becomes the value of its key*/
+static int
+qkv_index_put (qkv_t *kv, uint32_t off)
+{
+    const qkv_rec_hdr_t *rec = qkv_rec(kv, off);
+    uint32_t hash = qkv_hash(qkv_rec_key(rec), rec->klen);
+    uint16_t idx = qkv_lookup(kv, qkv_rec_key(rec), rec->klen, hash);
+    qkv_node_t *node;
+
+    if (idx == QKV_NIL) {
+        if (kv->freelist == QKV_NIL) {
+            return -1;
+        }
+        idx = kv->freelist;
+        node = &kv->node[idx];
+        kv->freelist = node->next;
+        node->hash = hash;
+        node->next = *qkv_bucket(kv, hash);
+        *qkv_bucket(kv, hash) = idx;
+        kv->keys++;
+    } else {
+        node = &kv->node[idx];
+        qkv_live_add(kv, node->off, -(int32_t)qkv_rec_size(qkv_rec(kv, node->off)));
+    }
+    node->off = off;
+    qkv_live_add(kv, off, qkv_rec_size(rec));
+    return 0;
+}
+
+static void
+qkv_index_del (qkv_t *kv, const char *key, uint32_t klen)
+{
+    uint32_t hash = qkv_hash(key, klen);
+    uint16_t idx = qkv_lookup(kv, key, klen, hash);
+    uint16_t *link = qkv_bucket(kv, hash);
+
+    if (idx == QKV_NIL) {
+        return;
+    }
+    while (*link != idx) {
+        link = &kv->node[*link].next;
+    }
+    *link = kv->node[idx].next;
+    qkv_live_add(kv, kv->node[idx].off, -(int32_t)qkv_rec_size(qkv_rec(kv, kv->node[idx].off)));
+    kv->node[idx].next = kv->freelist;
+    kv->freelist = idx;
+    kv->keys--;
+}
+
+/*Replays sector records into the index, finds the append offset*/
+static int
+qkv_scan (qkv_t *kv, uint16_t s)
+{
+    uint32_t base = s * QKV_SECTOR, off = sizeof(qkv_sect_hdr_t);
+    const qkv_rec_hdr_t *rec;
+    uint32_t size;
+
+    while (off + sizeof(*rec) <= QKV_SECTOR) {
+        rec = qkv_rec(kv, base + off);
+        if (qkv_rec_pad(rec)) {
+            off += sizeof(uint32_t);
+            continue;
+        }
+        if (rec->magic == 0xff) {
+            if (!qkv_blank((const uint8_t *)rec, QKV_SECTOR - off)) {
+                break;
+            }
+            kv->sect[s].end = off;
+            return 0;
+        }
+        size = qkv_rec_size(rec);
+        if (rec->magic != QKV_REC_MAGIC || !rec->klen || rec->klen > QKV_KEY_MAX ||
+            off + size > QKV_SECTOR ||
+            rec->crc != qkv_rec_crc(rec, qkv_rec_key(rec), qkv_rec_val(rec))) {
+            break;
+        }
+        if (rec->vlen == QKV_TOMB) {
+            qkv_index_del(kv, qkv_rec_key(rec), rec->klen);
+        } else if (qkv_index_put(kv, base + off) < 0) {
+            return -1;
+        }
+        off += size;
+    }
+    /*Torn write : keep what is valid, no appends until repaired*/
+    kv->sect[s].end = off;
+    kv->sect[s].state = QKV_CLOSED;
+    kv->stat.torn++;
+    return 0;
+}
+
+/*
+ * Zeroes the torn tail of the head, so the sector stays in use.
+ * Otherwise every power loss would waste the rest of a sector.
+ */
+static void
+qkv_repair (qkv_t *kv, uint16_t s)
+{
+    const uint8_t *p = kv->base + s * QKV_SECTOR;
+    uint32_t end = QKV_SECTOR;
+
+    while (end > kv->sect[s].end && p[end - 1] == 0xff) {
+        end--;
+    }
+    end = QKV_ALIGN4(end);
+    if (end == kv->sect[s].end) {
+        kv->sect[s].state = QKV_USED;
+        return;
+    }
+    d_memset(kv->stage, 0, end - kv->sect[s].end);
+    if (kv->ops->prog(kv->ops->hw, s * QKV_SECTOR + kv->sect[s].end, kv->stage,
+                      end - kv->sect[s].end) < 0) {
+        kv->stat.errors++;
+        return;
+    }
+    kv->sect[s].end = end;
+    kv->sect[s].state = QKV_USED;
+}
+
+int qkv_mount (qkv_t *kv, const qkv_ops_t *ops, const uint8_t *base, uint16_t nsect,
+                 void *mem, uint16_t maxkeys)
+{
+    const qkv_sect_hdr_t *hdr;
+    uint8_t *p = (uint8_t *)QKV_MEM_ALIGN((uintptr_t)mem);
+    uint16_t *ord;
+    uint32_t erases = 0;
+    uint16_t i, j, n = 0;
+
+    if (nsect < QKV_RESERVE + 2 || !maxkeys || maxkeys == QKV_NIL) {
+        return -1;
+    }
+    d_memset(kv, 0, sizeof(*kv));
+    kv->ops = ops;
+    kv->base = base;
+    kv->nsect = nsect;
+    kv->maxkeys = maxkeys;
+    kv->hmask = qkv_hsize(maxkeys) - 1;
+    kv->head = QKV_NIL;
+
+    kv->sect = (qkv_sect_t *)p;
+    p += QKV_MEM_ALIGN(nsect * sizeof(qkv_sect_t));
+    kv->node = (qkv_node_t *)p;
+    p += QKV_MEM_ALIGN(maxkeys * sizeof(qkv_node_t));
+    kv->hash = (uint16_t *)p;
+    p += QKV_MEM_ALIGN((kv->hmask + 1) * sizeof(uint16_t));
+    ord = (uint16_t *)p;
+    p += QKV_MEM_ALIGN(nsect * sizeof(uint16_t));
+    kv->stage = p;
+
+    for (i = 0; i <= kv->hmask; i++) {
+        kv->hash[i] = QKV_NIL;
+    }
+    for (i = 0; i < maxkeys; i++) {
+        kv->node[i].next = i + 1 < maxkeys ? i + 1 : QKV_NIL;
+    }
+    kv->freelist = 0;
+
+    /*Valid sectors, in sequence order*/
+    for (i = 0; i < nsect; i++) {
+        hdr = (const qkv_sect_hdr_t *)(base + i * QKV_SECTOR);
+        d_memset(&kv->sect[i], 0, sizeof(kv->sect[i]));
+        if (hdr->magic != QKV_SECT_MAGIC ||
+            hdr->crc != qpak_crc32(0, hdr, sizeof(*hdr) - sizeof(hdr->crc))) {
+            kv->sect[i].state = QKV_FREE;
+            kv->nfree++;
+            continue;
+        }
+        kv->sect[i].state = QKV_USED;
+        kv->sect[i].seq = hdr->seq;
+        kv->sect[i].erases = hdr->erases;
+        if (hdr->erases > erases) {
+            erases = hdr->erases;
+        }
+        for (j = n++; j && kv->sect[ord[j - 1]].seq > hdr->seq; j--) {
+            ord[j] = ord[j - 1];
+        }
+        ord[j] = i;
+    }
+    for (i = 0; i < n; i++) {
+        if (qkv_scan(kv, ord[i]) < 0) {
+            dprintf("qkv : too many keys\n");
+            return -1;
+        }
+    }
+    if (n) {
+        kv->head = ord[n - 1];
+        kv->seq = kv->sect[kv->head].seq;
+        /*busy flash : head stays closed, next append opens a new sector*/
+        if (kv->sect[kv->head].state == QKV_CLOSED && qkv_begin(kv) == 0) {
+            qkv_repair(kv, kv->head);
+            qkv_end(kv);
+        }
+    }
+    /*Count of an erased sector is lost with its header, round-robin keeps them close*/
+    for (i = 0; i < nsect; i++) {
+        if (kv->sect[i].state == QKV_FREE) {
+            kv->sect[i].erases = erases;
+        }
+    }
+    return 0;
+}
+
+static int qkv_compact (qkv_t *kv);
+static uint16_t qkv_reclaim (qkv_t *kv);
+
+/*
+ * Opens next free sector in ring order after the head.
+ * Plain writes leave QKV_RESERVE sectors for compaction.
+ */
+static int
+qkv_open (qkv_t *kv, d_bool compacting)
+{
+    qkv_sect_hdr_t hdr;
+    uint16_t i, s = QKV_NIL, start;
+
+    if (!compacting) {
+        for (i = 0; kv->nfree <= QKV_RESERVE; i++) {
+            if (i >= kv->nsect || qkv_compact(kv) <= 0) {
+                return -1;
+            }
+        }
+    }
+    start = kv->head == QKV_NIL ? kv->nsect - 1 : kv->head;
+    for (i = 1; i <= kv->nsect; i++) {
+        if (kv->sect[(start + i) % kv->nsect].state == QKV_FREE) {
+            s = (start + i) % kv->nsect;
+            break;
+        }
+    }
+    if (s == QKV_NIL && (!compacting || (s = qkv_reclaim(kv)) == QKV_NIL)) {
+        return -1;
+    }
+    if (!qkv_blank(kv->base + s * QKV_SECTOR, QKV_SECTOR)) {
+        kv->stat.erases++;
+        kv->sect[s].erases++;
+        if (kv->ops->erase(kv->ops->hw, s * QKV_SECTOR) < 0) {
+            kv->stat.errors++;
+            return -1;
+        }
+    }
+    hdr.magic = QKV_SECT_MAGIC;
+    hdr.seq = kv->seq + 1;
+    hdr.erases = kv->sect[s].erases;
+    hdr.crc = qpak_crc32(0, &hdr, sizeof(hdr) - sizeof(hdr.crc));
+    if (kv->ops->prog(kv->ops->hw, s * QKV_SECTOR, &hdr, sizeof(hdr)) < 0) {
+        kv->stat.errors++;
+        return -1;
+    }
+    kv->stat.progbytes += sizeof(hdr);
+    kv->seq = hdr.seq;
+    kv->sect[s].seq = hdr.seq;
+    kv->sect[s].end = sizeof(hdr);
+    kv->sect[s].live = 0;
+    kv->sect[s].state = QKV_USED;
+    kv->nfree--;
+    kv->head = s;
+    return 0;
+}
+
+/*
+ * Record is assembled in stage and programmed with one command.
+ * 'key', 'val' must not point into the region : it is unmapped while programmed.
+ */
+static int
+qkv_append (qkv_t *kv, const char *key, uint32_t klen, const void *val, uint32_t vlen,
+              d_bool compacting)
+{
+    qkv_rec_hdr_t *rec = (qkv_rec_hdr_t *)kv->stage;
+    uint8_t *body = kv->stage + sizeof(*rec);
+    uint32_t off, size, dlen = vlen == QKV_TOMB ? 0 : vlen;
+    qkv_sect_t *sect;
+
+    /*Before staging : opening may compact through the stage*/
+    size = QKV_ALIGN4(sizeof(*rec) + klen + dlen);
+    if (kv->head == QKV_NIL || kv->sect[kv->head].state != QKV_USED ||
+        kv->sect[kv->head].end + size > QKV_SECTOR) {
+        if (qkv_open(kv, compacting) < 0) {
+            return -1;
+        }
+    }
+    /*compaction passes key and value already in place*/
+    if ((const uint8_t *)key != body) {
+        d_memcpy(body, key, klen);
+    }
+    if (dlen && (const uint8_t *)val != body + klen) {
+        d_memcpy(body + klen, val, dlen);
+    }
+    rec->magic = QKV_REC_MAGIC;
+    rec->klen = klen;
+    rec->vlen = vlen;
+    rec->crc = qkv_rec_crc(rec, body, body + klen);
+
+    sect = &kv->sect[kv->head];
+    off = kv->head * QKV_SECTOR + sect->end;
+    if (kv->ops->prog(kv->ops->hw, off, rec, sizeof(*rec) + klen + dlen) < 0) {
+        /*Unknown state of the tail*/
+        sect->state = QKV_CLOSED;
+        sect->end = QKV_SECTOR;
+        kv->stat.errors++;
+        return -1;
+    }
+    sect->end += size;
+    kv->stat.progbytes += sizeof(*rec) + klen + dlen;
+    return off;
+}
+
+/*Next record of a sector within [*off, end), NULL - end of records*/
+static const qkv_rec_hdr_t *
+qkv_next (qkv_t *kv, uint32_t *off, uint32_t end)
+{
+    const qkv_rec_hdr_t *rec;
+
+    while (*off + sizeof(*rec) <= end) {
+        rec = qkv_rec(kv, *off);
+        if (qkv_rec_pad(rec)) {
+            *off += sizeof(uint32_t);
+            continue;
+        }
+        if (rec->magic != QKV_REC_MAGIC) {
+            break;
+        }
+        *off += qkv_rec_size(rec);
+        return rec;
+    }
+    return NULL;
+}
+
+/*Sector erased and back to the free pool*/
+static int
+qkv_erase (qkv_t *kv, uint16_t s)
+{
+    kv->stat.erases++;
+    kv->sect[s].erases++;
+    if (kv->ops->erase(kv->ops->hw, s * QKV_SECTOR) < 0) {
+        kv->stat.errors++;
+        return -1;
+    }
+    kv->sect[s].state = QKV_FREE;
+    kv->sect[s].end = 0;
+    kv->sect[s].live = 0;
+    kv->nfree++;
+    return 0;
+}
+
+/*Oldest sector other than the head*/
+static uint16_t
+qkv_tail (qkv_t *kv)
+{
+    uint16_t i, tail = QKV_NIL;
+
+    for (i = 0; i < kv->nsect; i++) {
+        if (i == kv->head || kv->sect[i].state == QKV_FREE) {
+            continue;
+        }
+        if (tail == QKV_NIL || kv->sect[i].seq < kv->sect[tail].seq) {
+            tail = i;
+        }
+    }
+    return tail;
+}
+
+/*
+ * Live records of the tail go to the head, then tail is erased.
+ * Tombstones are dropped : no older sector is left to hold the key.
+ * Power loss in between leaves both copies, replay picks the newer.
+ */
+static int
+qkv_compact (qkv_t *kv)
+{
+    uint16_t tail = qkv_tail(kv), idx;
+    const qkv_rec_hdr_t *rec;
+    uint32_t off, end, recoff, size, vlen;
+    uint8_t *body;
+    int newoff;
+
+    if (tail == QKV_NIL) {
+        return 0;
+    }
+    off = tail * QKV_SECTOR + sizeof(qkv_sect_hdr_t);
+    end = tail * QKV_SECTOR + kv->sect[tail].end;
+    while (kv->sect[tail].live && (rec = qkv_next(kv, &off, end))) {
+        if (rec->vlen == QKV_TOMB) {
+            continue;
+        }
+        recoff = off - qkv_rec_size(rec);
+        idx = qkv_lookup(kv, qkv_rec_key(rec), rec->klen,
+                         qkv_hash(qkv_rec_key(rec), rec->klen));
+        if (idx == QKV_NIL || kv->node[idx].off != recoff) {
+            continue;
+        }
+        size = qkv_rec_size(rec);
+        vlen = rec->vlen;
+        body = kv->stage + sizeof(*rec);
+        d_memcpy(body, qkv_rec_key(rec), rec->klen + vlen);
+        newoff = qkv_append(kv, (const char *)body, rec->klen,
+                            body + rec->klen, vlen, d_true);
+        if (newoff < 0) {
+            return -1;
+        }
+        qkv_live_add(kv, recoff, -(int32_t)size);
+        qkv_live_add(kv, newoff, size);
+        kv->node[idx].off = newoff;
+        kv->stat.moved++;
+    }
+    if (qkv_erase(kv, tail) < 0) {
+        return -1;
+    }
+    kv->stat.compactions++;
+    return 1;
+}
+
+/*
+ * Last resort when no sector is free : compaction of the tail keeps
+ * failing (power loss while copying a big record, over and over).
+ * A sector with nothing live is erased out of order, its tombstones
+ * of unknown keys are kept in the head, older sectors may hold them.
+ */
+static uint16_t
+qkv_reclaim (qkv_t *kv)
+{
+    const qkv_rec_hdr_t *rec;
+    uint32_t off, end, need;
+    uint8_t *body = kv->stage + sizeof(*rec);
+    uint16_t s;
+    int pass;
+
+    if (kv->head == QKV_NIL || kv->sect[kv->head].state != QKV_USED) {
+        return QKV_NIL;
+    }
+    for (s = 0; s < kv->nsect; s++) {
+        if (s == kv->head || kv->sect[s].state == QKV_FREE || kv->sect[s].live) {
+            continue;
+        }
+        /*Pass 0 sizes the tombstones, pass 1 moves them*/
+        for (pass = 0, need = 0; pass < 2; pass++) {
+            if (pass && kv->sect[kv->head].end + need > QKV_SECTOR) {
+                break;
+            }
+            off = s * QKV_SECTOR + sizeof(qkv_sect_hdr_t);
+            end = s * QKV_SECTOR + kv->sect[s].end;
+            while ((rec = qkv_next(kv, &off, end))) {
+                if (rec->vlen != QKV_TOMB ||
+                    qkv_lookup(kv, qkv_rec_key(rec), rec->klen,
+                               qkv_hash(qkv_rec_key(rec), rec->klen)) != QKV_NIL) {
+                    continue;
+                }
+                if (!pass) {
+                    need += qkv_rec_size(rec);
+                    continue;
+                }
+                d_memcpy(body, qkv_rec_key(rec), rec->klen);
+                if (qkv_append(kv, (const char *)body, rec->klen, NULL, QKV_TOMB, d_true) < 0) {
+                    return QKV_NIL;
+                }
+            }
+        }
+        if (pass == 2) {
+            kv->stat.reclaims++;
+            return qkv_erase(kv, s) < 0 ? QKV_NIL : s;
+        }
+    }
+    return QKV_NIL;
+}
+
+
+/*Only when free space runs low and the tail has something to drop*/
+int qkv_gc (qkv_t *kv)
+{
+    uint16_t tail;
+    int err;
+
+    if (kv->nfree >= QKV_GC_FREE) {
+        return 0;
+    }
+    tail = qkv_tail(kv);
+    if (tail == QKV_NIL ||
+        kv->sect[tail].live >= kv->sect[tail].end - sizeof(qkv_sect_hdr_t)) {
+        return 0;
+    }
+    if (qkv_begin(kv) < 0) {
+        return -1;
+    }
+    err = qkv_compact(kv);
+    qkv_end(kv);
+    return err;
+}
+
+static const qkv_rec_hdr_t *
+qkv_find (qkv_t *kv, const char *key)
+{
+    uint32_t klen = strlen(key);
+    uint16_t idx;
+
+    if (!klen || klen > QKV_KEY_MAX) {
+        return NULL;
+    }
+    idx = qkv_lookup(kv, key, klen, qkv_hash(key, klen));
+    return idx == QKV_NIL ? NULL : qkv_rec(kv, kv->node[idx].off);
+}
+
+int qkv_get (qkv_t *kv, const char *key, const void **val, uint32_t *len)
+{
+    const qkv_rec_hdr_t *rec;
+
+    if (qkv_pin(kv) < 0) {
+        return -1;
+    }
+    rec = qkv_find(kv, key);
+    if (!rec) {
+        qkv_unpin(kv);
+        return -1;
+    }
+    *val = qkv_rec_val(rec);
+    *len = rec->vlen;
+    return 0;
+}
+
+void qkv_put (qkv_t *kv, const void *val)
+{
+    if (val) {
+        qkv_unpin(kv);
+    }
+}
+
+int qkv_read (qkv_t *kv, const char *key, void *buf, uint32_t size)
+{
+    const qkv_rec_hdr_t *rec;
+    int len = -1;
+
+    if (qkv_pin(kv) < 0) {
+        return -1;
+    }
+    rec = qkv_find(kv, key);
+    if (rec) {
+        d_memcpy(buf, qkv_rec_val(rec), rec->vlen < size ? rec->vlen : size);
+        len = rec->vlen;
+    }
+    qkv_unpin(kv);
+    return len;
+}
+
+int qkv_set (qkv_t *kv, const char *key, const void *val, uint32_t len)
+{
+    const qkv_rec_hdr_t *rec;
+    uint32_t klen = strlen(key);
+    d_bool same;
+    int off;
+
+    if (!klen || klen > QKV_KEY_MAX || len > QKV_VAL_MAX) {
+        return -1;
+    }
+    if (qkv_pin(kv) < 0) {
+        return -1;
+    }
+    rec = qkv_find(kv, key);
+    same = rec && rec->vlen == len && !memcmp(qkv_rec_val(rec), val, len);
+    qkv_unpin(kv);
+    if (same) {
+        kv->stat.same++;
+        return 0;
+    }
+    if (!rec && kv->keys == kv->maxkeys) {
+        return -1;
+    }
+    if (qkv_begin(kv) < 0) {
+        return -1;
+    }
+    off = qkv_append(kv, key, klen, val, len, d_false);
+    qkv_end(kv);
+    if (off < 0) {
+        return -1;
+    }
+    kv->stat.sets++;
+    return qkv_index_put(kv, off);
+}
+
+int qkv_del (qkv_t *kv, const char *key)
+{
+    uint32_t klen = strlen(key);
+    d_bool found;
+    int off;
+
+    if (qkv_pin(kv) < 0) {
+        return -1;
+    }
+    found = qkv_find(kv, key) != NULL;
+    qkv_unpin(kv);
+    if (!found || qkv_begin(kv) < 0) {
+        return -1;
+    }
+    off = qkv_append(kv, key, klen, NULL, QKV_TOMB, d_false);
+    qkv_end(kv);
+    if (off < 0) {
+        return -1;
+    }
+    kv->stat.dels++;
+    qkv_index_del(kv, key, klen);
+    return 0;
+}
+
+int qkv_foreach (qkv_t *kv, int (*func) (void *arg, const char *key, const void *val,
+                                             uint32_t len), void *arg)
+{
+    const qkv_rec_hdr_t *rec;
+    char key[QKV_KEY_MAX + 1];
+    uint32_t i;
+    uint16_t idx;
+    int err = 0;
+
+    if (qkv_pin(kv) < 0) {
+        return -1;
+    }
+    for (i = 0; i <= kv->hmask && !err; i++) {
+        for (idx = kv->hash[i]; idx != QKV_NIL && !err; idx = kv->node[idx].next) {
+            rec = qkv_rec(kv, kv->node[idx].off);
+            d_memcpy(key, qkv_rec_key(rec), rec->klen);
+            key[rec->klen] = 0;
+            err = func(arg, key, qkv_rec_val(rec), rec->vlen);
+        }
+    }
+    qkv_unpin(kv);
+    return err;
+}
+
+void qkv_stat_dump (qkv_t *kv)
+{
+    qkv_stat_t *st = &kv->stat;
+    uint32_t live = 0, used = 0, emin = ~0U, emax = 0;
+    uint16_t i, closed = 0;
+
+    for (i = 0; i < kv->nsect; i++) {
+        if (kv->sect[i].state != QKV_FREE) {
+            live += kv->sect[i].live;
+            used += kv->sect[i].end;
+        }
+        if (kv->sect[i].state == QKV_CLOSED) {
+            closed++;
+        }
+        if (kv->sect[i].erases < emin) {
+            emin = kv->sect[i].erases;
+        }
+        if (kv->sect[i].erases > emax) {
+            emax = kv->sect[i].erases;
+        }
+    }
+    dprintf("qkv : %u/%u keys, %u sectors, %u free, %u closed, live %u / used %u bytes\n",
+            kv->keys, kv->maxkeys, kv->nsect, kv->nfree, closed, live, used);
+    dprintf("set= %u, del= %u, same= %u, compact= %u, moved= %u, erase= %u, prog= %u bytes\n",
+            st->sets, st->dels, st->same, st->compactions, st->moved, st->erases, st->progbytes);
+    dprintf("reclaim= %u, torn= %u, errors= %u, busy= %u, sector erases %u..%u\n",
+            st->reclaims, st->torn, st->errors, st->busy, emin, emax);
+}
+
+#if defined(BSP_DRIVER)
+
+#include "stm32f769i_discovery_qspi.h"
+#include <heap.h>
+#include <bsp_cmd.h>
+#include <qspi_dma.h>
+
+#if QKV_SECTOR != MX25L512_SUBSECTOR_SIZE
+#error "qkv sector must match flash erase unit"
+#endif
+#if (QKV_QSPI_OFFSET < QPAK_QSPI_OFFSET + QPAK_QSPI_SIZE) && \
+    (QPAK_QSPI_OFFSET < QKV_QSPI_OFFSET + QKV_QSPI_SECTORS * QKV_SECTOR)
+#error "qkv region overlaps asset archive"
+#endif
+
+#define QKV_MAP ((const uint8_t *)QSPI_BASE + QKV_QSPI_OFFSET)
+
+static qkv_t qkv_store;
+static qkv_t *qkv_mounted = NULL;
+
+static int qkv_cmd (int argc, const char **argv);
+
+/*Mapped lines of the changed range are stale*/
+static void qkv_qspi_inval (uint32_t off, uint32_t size)
+{
+    uint32_t addr = (uint32_t)QKV_MAP + off;
+
+    SCB_InvalidateDCache_by_Addr((uint32_t *)(addr & ~31U), ((addr & 31) + size + 31) & ~31U);
+}
+
+static int qkv_qspi_prog (void *hw, uint32_t off, const void *data, uint32_t size)
+{
+    int err = 0;
+
+    if (qspi_unmap() < 0) {
+        return -1;
+    }
+    if (BSP_QSPI_Write((uint8_t *)data, QKV_QSPI_OFFSET + off, size) != QSPI_OK) {
+        err = -1;
+    }
+    if (qspi_map() < 0) {
+        err = -1;
+    }
+    qkv_qspi_inval(off, size);
+    return err;
+}
+
+static int qkv_qspi_erase (void *hw, uint32_t off)
+{
+    int err = 0;
+
+    if (qspi_unmap() < 0) {
+        return -1;
+    }
+    if (BSP_QSPI_Erase_Block(QKV_QSPI_OFFSET + off) != QSPI_OK) {
+        err = -1;
+    }
+    if (qspi_map() < 0) {
+        err = -1;
+    }
+    qkv_qspi_inval(off, QKV_SECTOR);
+    return err;
+}
+
+/*Readers of the mapped flash (qpak_get) must not see it go away*/
+static int qkv_qspi_begin (void *hw)
+{
+    return qspi_map_lock();
+}
+
+static void qkv_qspi_end (void *hw)
+{
+    qspi_map_unlock();
+}
+
+/*Reads in place : the map must not go away under them, as qpak_get*/
+static int qkv_qspi_pin (void *hw)
+{
+    return qspi_map_pin();
+}
+
+static void qkv_qspi_unpin (void *hw)
+{
+    qspi_map_unpin();
+}
+
+static const qkv_ops_t qkv_qspi_ops = {
+    .prog = qkv_qspi_prog,
+    .erase = qkv_qspi_erase,
+    .begin = qkv_qspi_begin,
+    .end = qkv_qspi_end,
+    .pin = qkv_qspi_pin,
+    .unpin = qkv_qspi_unpin,
+    .hw = NULL,
+};
+
+qkv_t *qkv_qspi (void)
+{
+    return qkv_mounted;
+}
+
+int qkv_qspi_mount (void)
+{
+    static d_bool registered = d_false;
+    void *mem;
+
+    if (!registered) {
+        cmd_register_func(qkv_cmd, "qkv");
+        registered = d_true;
+    }
+    if (qkv_mounted) {
+        return 0;
+    }
+    if (qspi_map() < 0) {
+        dprintf("qkv : qspi init failed\n");
+        return -1;
+    }
+    mem = heap_alloc_shared(qkv_memsize(QKV_QSPI_SECTORS, QKV_QSPI_KEYS));
+    if (!mem) {
+        return -1;
+    }
+    if (qkv_mount(&qkv_store, &qkv_qspi_ops, QKV_MAP, QKV_QSPI_SECTORS,
+                  mem, QKV_QSPI_KEYS) < 0) {
+        heap_free(mem);
+        return -1;
+    }
+    qkv_mounted = &qkv_store;
+    return 0;
+}
+
+int qkv_qspi_tickle (void)
+{
+    if (!qkv_mounted) {
+        return 0;
+    }
+    return qkv_gc(qkv_mounted);
+}
+
+static int qkv_print (void *arg, const char *key, const void *val, uint32_t len)
+{
+    dprintf("%s = \'%.*s\' (%u)\n", key, (int)len, (const char *)val, len);
+    return 0;
+}
+
+static int qkv_cmd (int argc, const char **argv)
+{
+    qkv_t *kv = qkv_mounted;
+
+    if (!kv) {
+        dprintf("qkv : not mounted\n");
+        return -1;
+    }
+    if (argc > 2 && !strcmp(argv[0], "set")) {
+        return qkv_set(kv, argv[1], argv[2], strlen(argv[2]));
+    }
+    if (argc > 1 && !strcmp(argv[0], "del")) {
+        return qkv_del(kv, argv[1]);
+    }
+    if (argc > 0 && !strcmp(argv[0], "gc")) {
+        while (qkv_gc(kv) > 0) {}
+        return 0;
+    }
+    if (argc > 0 && !strcmp(argv[0], "ls")) {
+        return qkv_foreach(kv, qkv_print, NULL);
+    }
+    qkv_stat_dump(kv);
+    return 0;
+}
+
+#endif /*BSP_DRIVER*/
@@ -0,0 +1,362 @@
+#include <string.h>
+#include <qpak.h>
+
+static const uint32_t qpak_crc_tab[16] = {
+    0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac,
+    0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+    0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c,
+    0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c,
+};
+
+/*FNV-1a*/
+uint32_t qpak_hash (const char *path)
+{
+    uint32_t hash = 0x811c9dc5;
+
+    while (*path) {
+        hash ^= (uint8_t)*path++;
+        hash *= 0x01000193;
+    }
+    return hash;
+}
+
+/*zlib compatible, 'crc' - previous result or 0*/
+uint32_t qpak_crc32 (uint32_t crc, const void *data, uint32_t size)
+{
+    const uint8_t *p = (const uint8_t *)data;
+
+    crc = ~crc;
+    while (size--) {
+        crc ^= *p++;
+        crc = (crc >> 4) ^ qpak_crc_tab[crc & 0xf];
+        crc = (crc >> 4) ^ qpak_crc_tab[crc & 0xf];
+    }
+    return ~crc;
+}
+
+int qpak_check (const void *pak, uint32_t size)
+{
+    const qpak_hdr_t *hdr = (const qpak_hdr_t *)pak;
+    const qpak_ent_t *ent;
+    uint32_t i, prev = 0;
+
+    if (size < sizeof(*hdr) || hdr->magic != QPAK_MAGIC ||
+        hdr->version != QPAK_VERSION || hdr->align != QPAK_ALIGN) {
+        return -1;
+    }
+    if (hdr->size > size || hdr->size < sizeof(*hdr) ||
+        hdr->count > (hdr->size - sizeof(*hdr)) / sizeof(qpak_ent_t)) {
+        return -1;
+    }
+    ent = qpak_index(pak);
+    for (i = 0; i < hdr->count; i++, ent++) {
+        if (ent->hash < prev || ent->name >= hdr->size ||
+            !memchr(qpak_name(pak, ent), 0, hdr->size - ent->name)) {
+            return -1;
+        }
+        if ((ent->offset & (QPAK_ALIGN - 1)) || ent->offset > hdr->size ||
+            ent->size > hdr->size - ent->offset) {
+            return -1;
+        }
+        prev = ent->hash;
+    }
+    return 0;
+}
+
+const qpak_ent_t *qpak_find (const void *pak, const char *path)
+{
+    const qpak_hdr_t *hdr = (const qpak_hdr_t *)pak;
+    const qpak_ent_t *idx = qpak_index(pak);
+    uint32_t hash = qpak_hash(path);
+    uint32_t lo = 0, hi = hdr->count, mid;
+
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (idx[mid].hash < hash) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    for (; lo < hdr->count && idx[lo].hash == hash; lo++) {
+        if (!strcmp(qpak_name(pak, &idx[lo]), path)) {
+            return &idx[lo];
+        }
+    }
+    return NULL;
+}
+
+#if defined(BSP_DRIVER)
+
+#include "stm32f769i_discovery_qspi.h"
+#include "../../ulib/io/fs/FatFs/src/ff.h"
+#include <misc_utils.h>
+#include <debug.h>
+#include <heap.h>
+#include <bsp_cmd.h>
+#include <qspi_dma.h>
+
+#define QPAK_MAP ((const uint8_t *)QSPI_BASE + QPAK_QSPI_OFFSET)
+#define QPAK_ERASE_SIZE MX25L512_SUBSECTOR_SIZE
+#define QPAK_SECTOR_SIZE MX25L512_SECTOR_SIZE
+#define QPAK_FILE_CHUNK (1 << 12)
+
+typedef struct {
+    qpak_hdr_t hdr;
+    uint32_t size;
+    uint32_t pos;
+    /*flash below this offset is erased*/
+    uint32_t erased;
+    uint32_t crc;
+    d_bool active;
+} qpak_upd_t;
+
+/*NULL - not mounted*/
+static const void *qpak_pak = NULL;
+static qpak_upd_t qpak_upd;
+
+static int qpak_cmd (int argc, const char **argv);
+
+static int qpak_map (void)
+{
+    return qspi_map();
+}
+
+/*Memory-mapped mode must be left before any indirect command*/
+static int qpak_unmap (void)
+{
+    qpak_pak = NULL;
+    return qspi_unmap();
+}
+
+int qpak_mount (void)
+{
+    static d_bool registered = d_false;
+
+    if (!registered) {
+        cmd_register_func(qpak_cmd, "qpak");
+        registered = d_true;
+    }
+    qpak_pak = NULL;
+    if (qpak_map() < 0) {
+        dprintf("qpak : qspi init failed\n");
+        return -1;
+    }
+    if (qpak_check(QPAK_MAP, QPAK_QSPI_SIZE) < 0) {
+        dprintf("qpak : no archive\n");
+        return -1;
+    }
+    qpak_pak = QPAK_MAP;
+    return 0;
+}
+
+const void *qpak_get (const char *path, uint32_t *size)
+{
+    const qpak_ent_t *ent;
+
+    if (!qpak_pak || (ent = qpak_find(qpak_pak, path)) == NULL) {
+        return NULL;
+    }
+    if (qspi_map_pin() < 0) {
+        return NULL;
+    }
+    if (size) {
+        *size = ent->size;
+    }
+    return qpak_data(qpak_pak, ent);
+}
+
+void qpak_put (const void *data)
+{
+    if (data) {
+        qspi_map_unpin();
+    }
+}
+
+/*
+ * Erases next unit at 'erased' : whole 64K sector when aligned and covered
+ * by the new archive (one command instead of 16), 4K block for the rest
+ */
+static int qpak_erase_next (void)
+{
+    uint32_t addr = QPAK_QSPI_OFFSET + qpak_upd.erased;
+
+    if (!(addr & (QPAK_SECTOR_SIZE - 1)) &&
+        qpak_upd.size - qpak_upd.erased >= QPAK_SECTOR_SIZE) {
+        if (BSP_QSPI_Erase_Sector(addr) != QSPI_OK) {
+            return -1;
+        }
+        qpak_upd.erased += QPAK_SECTOR_SIZE;
+        return 0;
+    }
+    if (BSP_QSPI_Erase_Block(addr) != QSPI_OK) {
+        return -1;
+    }
+    qpak_upd.erased += QPAK_ERASE_SIZE;
+    return 0;
+}
+
+static int qpak_prog (uint32_t offset, const void *data, uint32_t size)
+{
+    while (qpak_upd.erased < offset + size) {
+        if (qpak_erase_next() < 0) {
+            return -1;
+        }
+    }
+    if (BSP_QSPI_Write((uint8_t *)data, QPAK_QSPI_OFFSET + offset, size) != QSPI_OK) {
+        return -1;
+    }
+    return 0;
+}
+
+static int qpak_update_fail (void)
+{
+    if (qpak_upd.active) {
+        qpak_upd.active = d_false;
+        qpak_map();
+        qspi_map_unlock();
+    }
+    return -1;
+}
+
+/*
+ * Header block (or sector) is erased first and header is programmed last,
+ * so power loss during update leaves no valid archive, not a broken one.
+ */
+int qpak_update_begin (uint32_t size)
+{
+    if (size < sizeof(qpak_hdr_t) || size > QPAK_QSPI_SIZE) {
+        return -1;
+    }
+    /*no reader may hold archive (or qkv) pointers through the rewrite*/
+    if (qspi_map_lock() < 0) {
+        dprintf("qpak : flash in use\n");
+        return -1;
+    }
+    if (qpak_unmap() < 0) {
+        qspi_map_unlock();
+        return -1;
+    }
+    d_memset(&qpak_upd, 0, sizeof(qpak_upd));
+    qpak_upd.size = size;
+    qpak_upd.active = d_true;
+    if (qpak_erase_next() < 0) {
+        return qpak_update_fail();
+    }
+    return 0;
+}
+
+int qpak_update_write (const void *data, uint32_t size)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    uint32_t part;
+
+    if (!qpak_upd.active) {
+        return -1;
+    }
+    if (size > qpak_upd.size - qpak_upd.pos) {
+        return qpak_update_fail();
+    }
+    if (qpak_upd.pos < sizeof(qpak_hdr_t)) {
+        part = sizeof(qpak_hdr_t) - qpak_upd.pos;
+        if (part > size) {
+            part = size;
+        }
+        d_memcpy((uint8_t *)&qpak_upd.hdr + qpak_upd.pos, p, part);
+        qpak_upd.pos += part;
+        p += part;
+        size -= part;
+    }
+    if (!size) {
+        return 0;
+    }
+    if (qpak_prog(qpak_upd.pos, p, size) < 0) {
+        return qpak_update_fail();
+    }
+    qpak_upd.crc = qpak_crc32(qpak_upd.crc, p, size);
+    qpak_upd.pos += size;
+    return 0;
+}
+
+int qpak_update_end (void)
+{
+    qpak_hdr_t *hdr = &qpak_upd.hdr;
+    int err;
+
+    if (!qpak_upd.active || qpak_upd.pos != qpak_upd.size) {
+        return qpak_update_fail();
+    }
+    if (hdr->magic != QPAK_MAGIC || hdr->size != qpak_upd.size ||
+        hdr->crc != qpak_upd.crc) {
+        dprintf("qpak : bad image\n");
+        return qpak_update_fail();
+    }
+    if (BSP_QSPI_Write((uint8_t *)hdr, QPAK_QSPI_OFFSET, sizeof(*hdr)) != QSPI_OK) {
+        return qpak_update_fail();
+    }
+    qpak_upd.active = d_false;
+    /*drop old archive lines*/
+    SCB_InvalidateDCache_by_Addr((uint32_t *)QPAK_MAP, QPAK_ALIGN_UP(qpak_upd.size));
+    err = qpak_mount();
+    qspi_map_unlock();
+    return err;
+}
+
+int qpak_update_file (const char *path)
+{
+    FIL file;
+    UINT btr;
+    uint8_t *buf;
+    int err = -1;
+
+    if (f_open(&file, path, FA_READ) != FR_OK) {
+        return -1;
+    }
+    buf = heap_alloc_shared(QPAK_FILE_CHUNK);
+    if (!buf) {
+        f_close(&file);
+        return -1;
+    }
+    if (qpak_update_begin(f_size(&file)) < 0) {
+        goto done;
+    }
+    while (qpak_upd.pos < qpak_upd.size) {
+        if (f_read(&file, buf, QPAK_FILE_CHUNK, &btr) != FR_OK || !btr) {
+            qpak_update_fail();
+            goto done;
+        }
+        if (qpak_update_write(buf, btr) < 0) {
+            goto done;
+        }
+    }
+    err = qpak_update_end();
+done:
+    heap_free(buf);
+    f_close(&file);
+    return err;
+}
+
+static int qpak_cmd (int argc, const char **argv)
+{
+    const qpak_ent_t *ent;
+    uint32_t i;
+
+    if (argc > 1 && !strcmp(argv[0], "update")) {
+        if (qpak_update_file(argv[1]) < 0) {
+            dprintf("qpak : update failed\n");
+            return -1;
+        }
+        return 0;
+    }
+    if (!qpak_pak) {
+        dprintf("qpak : not mounted\n");
+        return 0;
+    }
+    ent = qpak_index(qpak_pak);
+    for (i = 0; i < ((const qpak_hdr_t *)qpak_pak)->count; i++, ent++) {
+        dprintf("%08x %8u %s\n", ent->offset, ent->size, qpak_name(qpak_pak, ent));
+    }
+    return 0;
+}
+
+#endif /*BSP_DRIVER*/
@@ -0,0 +1,553 @@
+#include <string.h>
+#include <qspi_dma.h>
+#include <misc_utils.h>
+#include <debug.h>
+
+void qspi_q_init (qspi_q_t *q, const qspi_q_ops_t *ops, uint32_t chunk)
+{
+    d_memset(q, 0, sizeof(*q));
+    q->ops = ops;
+    q->chunk = chunk;
+    q->dirty = 1;
+}
+
+void qspi_q_dirty (qspi_q_t *q)
+{
+    q->dirty = 1;
+}
+
+static inline void
+qspi_q_lock (qspi_q_t *q)
+{
+    if (q->ops->lock) {
+        q->ops->lock(q->ops->hw);
+    }
+}
+
+static inline void
+qspi_q_unlock (qspi_q_t *q)
+{
+    if (q->ops->unlock) {
+        q->ops->unlock(q->ops->hw);
+    }
+}
+
+static void
+qspi_q_push (qspi_q_t *q, qspi_req_t *req)
+{
+    req->next = NULL;
+    if (q->tail) {
+        q->tail->next = req;
+    } else {
+        q->head = req;
+    }
+    q->tail = req;
+    q->depth++;
+    if (q->depth > q->stat.maxdepth) {
+        q->stat.maxdepth = q->depth;
+    }
+}
+
+static qspi_req_t *
+qspi_q_pop (qspi_q_t *q)
+{
+    qspi_req_t *req = q->head;
+
+    q->head = req->next;
+    if (!q->head) {
+        q->tail = NULL;
+    }
+    req->next = NULL;
+    q->depth--;
+    return req;
+}
+
+static void
+qspi_q_end (qspi_q_t *q, qspi_req_t *req, int status)
+{
+    if (status == QSPI_REQ_ERR) {
+        q->stat.errors++;
+    }
+    req->status = status;
+    if (req->done) {
+        req->done(req);
+    }
+}
+
+/*Starts next chunk of the head request, or releases the queue*/
+static void
+qspi_q_next (qspi_q_t *q)
+{
+    qspi_req_t *req;
+
+    while ((req = q->head) != NULL) {
+        q->cur = req->size - req->pos;
+        if (q->cur > q->chunk) {
+            q->cur = q->chunk;
+        }
+        q->stat.xfers++;
+        if (q->ops->start(q->ops->hw, req->buf + req->pos, req->addr + req->pos, q->cur) == 0) {
+            return;
+        }
+        q->dirty = 1;
+        qspi_q_end(q, qspi_q_pop(q), QSPI_REQ_ERR);
+    }
+    q->busy = 0;
+}
+
+/*Fails requests queued so far, later ones (from 'done') stay queued*/
+static void
+qspi_q_fail (qspi_q_t *q)
+{
+    qspi_req_t *req, *next;
+
+    qspi_q_lock(q);
+    req = q->head;
+    q->head = q->tail = NULL;
+    q->depth = 0;
+    qspi_q_unlock(q);
+    while (req) {
+        next = req->next;
+        req->next = NULL;
+        qspi_q_end(q, req, QSPI_REQ_ERR);
+        req = next;
+    }
+}
+
+/*
+ * From thread, or from 'done' callback.
+ * The queue is started here only when idle, further chunks and
+ * requests are chained from completion (isr).
+ */
+int qspi_q_submit (qspi_q_t *q, qspi_req_t *req)
+{
+    if (!req->buf || !req->size) {
+        return -1;
+    }
+    req->pos = 0;
+    req->status = QSPI_REQ_PENDING;
+
+    qspi_q_lock(q);
+    q->stat.reqs++;
+    qspi_q_push(q, req);
+    if (q->busy) {
+        qspi_q_unlock(q);
+        return 0;
+    }
+    q->busy = 1;
+    qspi_q_unlock(q);
+
+    if (q->dirty) {
+        q->stat.polls++;
+        if (q->ops->ready(q->ops->hw) < 0) {
+            qspi_q_fail(q);
+            qspi_q_lock(q);
+            if (!q->head) {
+                q->busy = 0;
+                qspi_q_unlock(q);
+                return 0;
+            }
+            qspi_q_unlock(q);
+        } else {
+            q->dirty = 0;
+        }
+    }
+    qspi_q_next(q);
+    return 0;
+}
+
+void qspi_q_xfer_done (qspi_q_t *q, int err)
+{
+    qspi_req_t *req = q->head;
+
+    if (!q->busy || !req) {
+        return;
+    }
+    if (err) {
+        q->dirty = 1;
+        qspi_q_end(q, qspi_q_pop(q), QSPI_REQ_ERR);
+    } else {
+        req->pos += q->cur;
+        q->stat.bytes += q->cur;
+        if (req->pos == req->size) {
+            qspi_q_end(q, qspi_q_pop(q), QSPI_REQ_DONE);
+        } else if (req->next) {
+            /*Let the others go between chunks*/
+            qspi_q_push(q, qspi_q_pop(q));
+        }
+    }
+    qspi_q_next(q);
+}
+
+#if defined(BSP_DRIVER)
+
+#include "stm32f769i_discovery_qspi.h"
+#include <nvic.h>
+#include <uart_int.h>
+#include <bsp_cmd.h>
+
+/*
+ * QUADSPI dma request : DMA2 stream 2 channel 11 or stream 7 channel 3.
+ * Stream 7 is taken by uart tx / mic, stream 2 - by uart rx when enabled,
+ * then reads fall back to fifo threshold irq.
+ */
+#ifndef QSPI_ASYNC_DMA
+#define QSPI_ASYNC_DMA (!DEBUG_SERIAL_USE_RX)
+#endif
+#if QSPI_ASYNC_DMA && DEBUG_SERIAL_USE_RX
+#error "QSPI dma stream is used by uart rx"
+#endif
+
+#define QSPI_DMA_STREAM DMA2_Stream2
+#define QSPI_DMA_CHANNEL DMA_CHANNEL_11
+#define QSPI_DMA_IRQ DMA2_Stream2_IRQn
+#define QSPI_DMA_IRQHandler DMA2_Stream2_IRQHandler
+
+#define QSPI_READY_TIMEOUT MX25L512_SECTOR_ERASE_MAX_TIME
+
+extern QSPI_HandleTypeDef QSPIHandle;
+
+static qspi_q_t qspi_q;
+static d_bool qspi_ready = d_false;
+/*QSPI + dma stream*/
+static irqmask_t qspi_irq;
+static irqmask_t qspi_irq_saved;
+static uint32_t qspi_mapped_reads;
+/*see qspi_map_pin; 'unmapping' - pins fail while the map is being left*/
+static volatile uint32_t qspi_map_pins;
+static volatile d_bool qspi_map_locked = d_false;
+static volatile d_bool qspi_unmapping = d_false;
+static void (*qspi_yield_hook) (void) = NULL;
+#if QSPI_ASYNC_DMA
+static DMA_HandleTypeDef qspi_hdma;
+#endif
+
+static int qspi_cmd (int argc, const char **argv);
+
+static void qspi_lock (void *hw)
+{
+    qspi_irq_saved = qspi_irq;
+    irq_save(&qspi_irq_saved);
+}
+
+static void qspi_unlock (void *hw)
+{
+    irq_restore(qspi_irq_saved);
+}
+
+/*Only place where status is polled for async reads*/
+static int qspi_wait_ready (void *hw)
+{
+    uint32_t tickstart = HAL_GetTick();
+    uint8_t status;
+
+    while ((status = BSP_QSPI_GetStatus()) == QSPI_BUSY) {
+        if (HAL_GetTick() - tickstart > QSPI_READY_TIMEOUT) {
+            return -1;
+        }
+    }
+    return status == QSPI_OK ? 0 : -1;
+}
+
+/*Same command as BSP_QSPI_Read, data phase is left to dma*/
+static int qspi_start (void *hw, uint8_t *buf, uint32_t addr, uint32_t size)
+{
+    QSPI_CommandTypeDef s_command;
+    HAL_StatusTypeDef status;
+
+    s_command.InstructionMode   = QSPI_INSTRUCTION_4_LINES;
+    s_command.Instruction       = QPI_READ_4_BYTE_ADDR_CMD;
+    s_command.AddressMode       = QSPI_ADDRESS_4_LINES;
+    s_command.AddressSize       = QSPI_ADDRESS_32_BITS;
+    s_command.Address           = addr;
+    s_command.AlternateByteMode = QSPI_ALTERNATE_BYTES_NONE;
+    s_command.DataMode          = QSPI_DATA_4_LINES;
+    s_command.DummyCycles       = MX25L512_DUMMY_CYCLES_READ_QUAD_IO;
+    s_command.NbData            = size;
+    s_command.DdrMode           = QSPI_DDR_MODE_DISABLE;
+    s_command.DdrHoldHalfCycle  = QSPI_DDR_HHC_ANALOG_DELAY;
+    s_command.SIOOMode          = QSPI_SIOO_INST_EVERY_CMD;
+
+    if (HAL_QSPI_Command(&QSPIHandle, &s_command, HAL_QPSI_TIMEOUT_DEFAULT_VALUE) != HAL_OK) {
+        return -1;
+    }
+    MODIFY_REG(QSPIHandle.Instance->DCR, QUADSPI_DCR_CSHT, QSPI_CS_HIGH_TIME_1_CYCLE);
+#if QSPI_ASYNC_DMA
+    /*No dirty line may be evicted over dma data*/
+    SCB_InvalidateDCache_by_Addr((uint32_t *)buf, size);
+    status = HAL_QSPI_Receive_DMA(&QSPIHandle, buf);
+#else
+    status = HAL_QSPI_Receive_IT(&QSPIHandle, buf);
+#endif
+    if (status != HAL_OK) {
+        MODIFY_REG(QSPIHandle.Instance->DCR, QUADSPI_DCR_CSHT, QSPI_CS_HIGH_TIME_4_CYCLE);
+        return -1;
+    }
+    return 0;
+}
+
+static const qspi_q_ops_t qspi_q_ops = {
+    .start = qspi_start,
+    .ready = qspi_wait_ready,
+    .lock = qspi_lock,
+    .unlock = qspi_unlock,
+    .hw = NULL,
+};
+
+#if QSPI_ASYNC_DMA
+static void qspi_dma_init (void)
+{
+    __HAL_RCC_DMA2_CLK_ENABLE();
+
+    qspi_hdma.Instance                 = QSPI_DMA_STREAM;
+    qspi_hdma.Init.Channel             = QSPI_DMA_CHANNEL;
+    qspi_hdma.Init.Direction           = DMA_PERIPH_TO_MEMORY;
+    qspi_hdma.Init.PeriphInc           = DMA_PINC_DISABLE;
+    qspi_hdma.Init.MemInc              = DMA_MINC_ENABLE;
+    qspi_hdma.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    qspi_hdma.Init.MemDataAlignment    = DMA_MDATAALIGN_WORD;
+    qspi_hdma.Init.Mode                = DMA_NORMAL;
+    qspi_hdma.Init.Priority            = DMA_PRIORITY_HIGH;
+    qspi_hdma.Init.FIFOMode            = DMA_FIFOMODE_ENABLE;
+    qspi_hdma.Init.FIFOThreshold       = DMA_FIFO_THRESHOLD_FULL;
+    qspi_hdma.Init.MemBurst            = DMA_MBURST_INC4;
+    qspi_hdma.Init.PeriphBurst         = DMA_PBURST_SINGLE;
+
+    HAL_DMA_DeInit(&qspi_hdma);
+    HAL_DMA_Init(&qspi_hdma);
+    __HAL_LINKDMA(&QSPIHandle, hdma, qspi_hdma);
+
+    HAL_NVIC_SetPriority(QSPI_DMA_IRQ, 0x0F, 0);
+    HAL_NVIC_EnableIRQ(QSPI_DMA_IRQ);
+}
+#endif
+
+int qspi_init (void)
+{
+    irqmask_t irq = 0;
+
+    if (qspi_ready) {
+        return 0;
+    }
+    irq_bmap(&irq);
+    if (BSP_QSPI_Init() != QSPI_OK) {
+        return -1;
+    }
+#if QSPI_ASYNC_DMA
+    qspi_dma_init();
+#endif
+    irq_bmap(&qspi_irq);
+    qspi_irq = qspi_irq & (~irq);
+
+    qspi_q_init(&qspi_q, &qspi_q_ops, QSPI_DMA_CHUNK);
+    cmd_register_func(qspi_cmd, "qspi");
+    qspi_ready = d_true;
+    return 0;
+}
+
+int qspi_read_async (qspi_req_t *req)
+{
+    if (!qspi_ready || (((uint32_t)req->buf | req->size) & (QSPI_DMA_ALIGN - 1)) ||
+        req->addr >= MX25L512_FLASH_SIZE || req->size > MX25L512_FLASH_SIZE - req->addr) {
+        return -1;
+    }
+    if (HAL_QSPI_GetState(&QSPIHandle) == HAL_QSPI_STATE_BUSY_MEM_MAPPED) {
+        d_memcpy(req->buf, (const uint8_t *)QSPI_BASE + req->addr, req->size);
+        req->pos = req->size;
+        req->status = QSPI_REQ_DONE;
+        qspi_mapped_reads++;
+        if (req->done) {
+            req->done(req);
+        }
+        return 0;
+    }
+    return qspi_q_submit(&qspi_q, req);
+}
+
+void qspi_set_yield_hook (void (*yield) (void))
+{
+    qspi_yield_hook = yield;
+}
+
+static inline void
+qspi_yield (void)
+{
+    if (qspi_yield_hook) {
+        qspi_yield_hook();
+    }
+}
+
+int qspi_read_wait (qspi_req_t *req)
+{
+    while (req->status == QSPI_REQ_PENDING) {
+        qspi_yield();
+    }
+    return req->status;
+}
+
+int qspi_read (void *buf, uint32_t addr, uint32_t size)
+{
+    qspi_req_t req;
+
+    qspi_req_init(&req, buf, addr, size, NULL, NULL);
+    if (qspi_read_async(&req) < 0) {
+        return -1;
+    }
+    return qspi_read_wait(&req) == QSPI_REQ_DONE ? 0 : -1;
+}
+
+void qspi_flush (void)
+{
+    while (!qspi_q_idle(&qspi_q)) {
+        qspi_yield();
+    }
+}
+
+int qspi_map (void)
+{
+    if (qspi_init() < 0) {
+        return -1;
+    }
+    if (HAL_QSPI_GetState(&QSPIHandle) == HAL_QSPI_STATE_BUSY_MEM_MAPPED) {
+        return 0;
+    }
+    qspi_flush();
+    return BSP_QSPI_EnableMemoryMappedMode() == QSPI_OK ? 0 : -1;
+}
+
+int qspi_unmap (void)
+{
+    irqmask_t irq_flags;
+    int err;
+
+    if (!qspi_ready) {
+        return -1;
+    }
+    irq_save(&irq_flags);
+    err = qspi_map_pins ? -1 : 0;
+    if (!err) {
+        qspi_unmapping = d_true;
+    }
+    irq_restore(irq_flags);
+    if (err) {
+        return -1;
+    }
+    qspi_flush();
+    if (HAL_QSPI_GetState(&QSPIHandle) == HAL_QSPI_STATE_BUSY_MEM_MAPPED &&
+        HAL_QSPI_Abort(&QSPIHandle) != HAL_OK) {
+        err = -1;
+    }
+    qspi_unmapping = d_false;
+    return err;
+}
+
+int qspi_map_pin (void)
+{
+    irqmask_t irq_flags;
+    int err = -1;
+
+    irq_save(&irq_flags);
+    if (qspi_ready && !qspi_map_locked && !qspi_unmapping &&
+        HAL_QSPI_GetState(&QSPIHandle) == HAL_QSPI_STATE_BUSY_MEM_MAPPED) {
+        qspi_map_pins++;
+        err = 0;
+    }
+    irq_restore(irq_flags);
+    return err;
+}
+
+void qspi_map_unpin (void)
+{
+    irqmask_t irq_flags;
+
+    irq_save(&irq_flags);
+    if (qspi_map_pins) {
+        qspi_map_pins--;
+    }
+    irq_restore(irq_flags);
+}
+
+int qspi_map_lock (void)
+{
+    irqmask_t irq_flags;
+    int err = -1;
+
+    irq_save(&irq_flags);
+    if (!qspi_map_pins && !qspi_map_locked) {
+        qspi_map_locked = d_true;
+        err = 0;
+    }
+    irq_restore(irq_flags);
+    return err;
+}
+
+void qspi_map_unlock (void)
+{
+    qspi_map_locked = d_false;
+}
+
+void HAL_QSPI_RxCpltCallback (QSPI_HandleTypeDef *hqspi)
+{
+#if QSPI_ASYNC_DMA
+    qspi_req_t *req = qspi_q.head;
+#endif
+
+    MODIFY_REG(hqspi->Instance->DCR, QUADSPI_DCR_CSHT, QSPI_CS_HIGH_TIME_4_CYCLE);
+#if QSPI_ASYNC_DMA
+    /*Lines speculatively fetched during transfer*/
+    if (req) {
+        SCB_InvalidateDCache_by_Addr((uint32_t *)(req->buf + req->pos), qspi_q.cur);
+    }
+#endif
+    qspi_q_xfer_done(&qspi_q, 0);
+}
+
+void HAL_QSPI_ErrorCallback (QSPI_HandleTypeDef *hqspi)
+{
+    MODIFY_REG(hqspi->Instance->DCR, QUADSPI_DCR_CSHT, QSPI_CS_HIGH_TIME_4_CYCLE);
+    qspi_q_xfer_done(&qspi_q, -1);
+}
+
+void QUADSPI_IRQHandler (void)
+{
+    HAL_QSPI_IRQHandler(&QSPIHandle);
+}
+
+int qspi_dma_irq (void *stream)
+{
+#if QSPI_ASYNC_DMA
+    if (qspi_hdma.Instance == stream) {
+        HAL_DMA_IRQHandler(&qspi_hdma);
+        return 1;
+    }
+#endif
+    return 0;
+}
+
+#if !SERIAL_TTY_HAS_DMA
+/*Otherwise shared with uart rx, see uart_hal.c*/
+void QSPI_DMA_IRQHandler (void)
+{
+    qspi_dma_irq(QSPI_DMA_STREAM);
+}
+#endif
+
+static int qspi_cmd (int argc, const char **argv)
+{
+    qspi_q_stat_t *st = &qspi_q.stat;
+
+    if (argc > 0 && !strcmp(argv[0], "reset")) {
+        d_memset(st, 0, sizeof(*st));
+        qspi_mapped_reads = 0;
+        return 0;
+    }
+    dprintf("qspi : %s, chunk %u, queue %u\n",
+            QSPI_ASYNC_DMA ? "dma" : "irq", qspi_q.chunk, qspi_q.depth);
+    dprintf("req= %u, xfer= %u, bytes= %u, polls= %u, errors= %u, maxdepth= %u, mapped= %u\n",
+            st->reqs, st->xfers, st->bytes, st->polls, st->errors, st->maxdepth,
+            qspi_mapped_reads);
+    dprintf("map pins= %u%s\n", qspi_map_pins, qspi_map_locked ? ", locked" : "");
+    return 0;
+}
+
+#endif /*BSP_DRIVER*/
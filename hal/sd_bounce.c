@@ -0,0 +1,42 @@
+#include <sd_bounce.h>
+#include <misc_utils.h>
+
+static uint32_t sd_bounce[SD_BOUNCE_SIZE / sizeof(uint32_t)] __attribute__((aligned(32)));
+
+DRESULT sd_bounce_read (sd_bounce_rd_t read, BYTE lun, BYTE *buff, DWORD sector, UINT count)
+{
+    DRESULT res = RES_OK;
+    UINT chunk;
+
+    while (count) {
+        chunk = count > SD_BOUNCE_SECTORS ? SD_BOUNCE_SECTORS : count;
+        res = read(lun, (BYTE *)sd_bounce, sector, chunk);
+        if (res != RES_OK) {
+            break;
+        }
+        d_memcpy(buff, sd_bounce, chunk * _MIN_SS);
+        sector += chunk;
+        buff += chunk * _MIN_SS;
+        count -= chunk;
+    }
+    return res;
+}
+
+DRESULT sd_bounce_write (sd_bounce_wr_t write, BYTE lun, const BYTE *buff, DWORD sector, UINT count)
+{
+    DRESULT res = RES_OK;
+    UINT chunk;
+
+    while (count) {
+        chunk = count > SD_BOUNCE_SECTORS ? SD_BOUNCE_SECTORS : count;
+        d_memcpy(sd_bounce, buff, chunk * _MIN_SS);
+        res = write(lun, (const BYTE *)sd_bounce, sector, chunk);
+        if (res != RES_OK) {
+            break;
+        }
+        sector += chunk;
+        buff += chunk * _MIN_SS;
+        count -= chunk;
+    }
+    return res;
+}
@@ -0,0 +1,618 @@
+#include <string.h>
+
+#include <sd_cache.h>
+#include <misc_utils.h>
+#include <debug.h>
+
+#define SD_CACHE_VALID (1 << 0)
+#define SD_CACHE_DIRTY (1 << 1)
+/*fetched by read-ahead, not yet requested*/
+#define SD_CACHE_RA (1 << 2)
+
+#define SD_CACHE_ALIGN_UP(x) (((x) + SD_CACHE_ALIGN - 1) & ~(SD_CACHE_ALIGN - 1))
+
+static uint32_t
+sd_cache_hsize (uint32_t blocks)
+{
+    uint32_t size = 1;
+
+    while (size < blocks) {
+        size <<= 1;
+    }
+    return size;
+}
+
+uint32_t sd_cache_memsize (uint16_t blocks, uint16_t ramax)
+{
+    return SD_CACHE_ALIGN +
+           SD_CACHE_ALIGN_UP(blocks * sizeof(sd_cache_blk_t)) +
+           SD_CACHE_ALIGN_UP(sd_cache_hsize(blocks) * sizeof(uint16_t)) +
+           (ramax + blocks) * _MIN_SS;
+}
+
+static inline uint8_t *
+sd_cache_data (sd_cache_t *cache, uint16_t idx)
+{
+    return cache->data + idx * _MIN_SS;
+}
+
+static inline uint16_t *
+sd_cache_bucket (sd_cache_t *cache, DWORD sector)
+{
+    return &cache->hash[((uint32_t)sector * 2654435761U >> 16) & cache->hmask];
+}
+
+static uint16_t
+sd_cache_lookup (sd_cache_t *cache, DWORD sector)
+{
+    uint16_t idx = *sd_cache_bucket(cache, sector);
+
+    while (idx != SD_CACHE_NIL && cache->blk[idx].sector != sector) {
+        idx = cache->blk[idx].hnext;
+    }
+    return idx;
+}
+
+static void
+sd_cache_hash_insert (sd_cache_t *cache, uint16_t idx)
+{
+    uint16_t *head = sd_cache_bucket(cache, cache->blk[idx].sector);
+
+    cache->blk[idx].hnext = *head;
+    *head = idx;
+}
+
+static void
+sd_cache_hash_remove (sd_cache_t *cache, uint16_t idx)
+{
+    uint16_t *link = sd_cache_bucket(cache, cache->blk[idx].sector);
+
+    while (*link != idx) {
+        link = &cache->blk[*link].hnext;
+    }
+    *link = cache->blk[idx].hnext;
+}
+
+static void
+sd_cache_unlink (sd_cache_t *cache, uint16_t idx)
+{
+    sd_cache_blk_t *blk = &cache->blk[idx];
+
+    if (blk->prev != SD_CACHE_NIL) {
+        cache->blk[blk->prev].next = blk->next;
+    } else {
+        cache->head = blk->next;
+    }
+    if (blk->next != SD_CACHE_NIL) {
+        cache->blk[blk->next].prev = blk->prev;
+    } else {
+        cache->tail = blk->prev;
+    }
+}
+
+static void
+sd_cache_push_head (sd_cache_t *cache, uint16_t idx)
+{
+    sd_cache_blk_t *blk = &cache->blk[idx];
+
+    blk->prev = SD_CACHE_NIL;
+    blk->next = cache->head;
+    if (cache->head != SD_CACHE_NIL) {
+        cache->blk[cache->head].prev = idx;
+    } else {
+        cache->tail = idx;
+    }
+    cache->head = idx;
+}
+
+static void
+sd_cache_push_tail (sd_cache_t *cache, uint16_t idx)
+{
+    sd_cache_blk_t *blk = &cache->blk[idx];
+
+    blk->next = SD_CACHE_NIL;
+    blk->prev = cache->tail;
+    if (cache->tail != SD_CACHE_NIL) {
+        cache->blk[cache->tail].next = idx;
+    } else {
+        cache->head = idx;
+    }
+    cache->tail = idx;
+}
+
+int sd_cache_init (sd_cache_t *cache, const Diskio_drvTypeDef *drv, BYTE lun,
+                      void *mem, uint32_t size, uint16_t ramax)
+{
+    uint32_t blocks, i;
+    uint8_t *p;
+
+    if (!ramax) {
+        ramax = SD_CACHE_RA_DEF;
+    }
+    blocks = size / (_MIN_SS + sizeof(sd_cache_blk_t) + 2 * sizeof(uint16_t));
+    if (blocks > SD_CACHE_NIL - 1) {
+        blocks = SD_CACHE_NIL - 1;
+    }
+    while (blocks && sd_cache_memsize(blocks, ramax) > size) {
+        blocks--;
+    }
+    /*read-ahead must not evict the sectors it has just fetched*/
+    if (blocks < 2 * ramax) {
+        return -1;
+    }
+    d_memset(cache, 0, sizeof(*cache));
+    cache->drv = drv;
+    cache->lun = lun;
+    cache->nblk = blocks;
+    cache->ramax = ramax;
+    cache->hmask = sd_cache_hsize(blocks) - 1;
+
+    p = (uint8_t *)SD_CACHE_ALIGN_UP((uintptr_t)mem);
+    cache->blk = (sd_cache_blk_t *)p;
+    p += SD_CACHE_ALIGN_UP(blocks * sizeof(sd_cache_blk_t));
+    cache->hash = (uint16_t *)p;
+    p += SD_CACHE_ALIGN_UP((cache->hmask + 1) * sizeof(uint16_t));
+    cache->stage = p;
+    p += ramax * _MIN_SS;
+    cache->data = p;
+
+    for (i = 0; i <= cache->hmask; i++) {
+        cache->hash[i] = SD_CACHE_NIL;
+    }
+    cache->head = SD_CACHE_NIL;
+    cache->tail = SD_CACHE_NIL;
+    for (i = 0; i < blocks; i++) {
+        cache->blk[i].flags = 0;
+        cache->blk[i].hnext = SD_CACHE_NIL;
+        sd_cache_push_tail(cache, i);
+    }
+    cache->seqnext = (DWORD)-1;
+    return 0;
+}
+
+static DRESULT
+sd_cache_writeback (sd_cache_t *cache, uint16_t idx)
+{
+    sd_cache_blk_t *blk = &cache->blk[idx];
+    DRESULT res;
+
+    res = cache->drv->disk_write(cache->lun, sd_cache_data(cache, idx), blk->sector, 1);
+    if (res != RES_OK) {
+        cache->stat.errors++;
+        return res;
+    }
+    blk->flags &= ~SD_CACHE_DIRTY;
+    cache->dirty--;
+    cache->stat.writebacks++;
+    return RES_OK;
+}
+
+/*Least recently used block, detached from lru and hash; NIL - writeback failed*/
+static uint16_t
+sd_cache_take (sd_cache_t *cache, DWORD sector, uint8_t flags)
+{
+    uint16_t idx = cache->tail;
+    sd_cache_blk_t *blk = &cache->blk[idx];
+
+    if (blk->flags & SD_CACHE_VALID) {
+        if ((blk->flags & SD_CACHE_DIRTY) &&
+            sd_cache_writeback(cache, idx) != RES_OK) {
+            return SD_CACHE_NIL;
+        }
+        sd_cache_hash_remove(cache, idx);
+        cache->stat.evictions++;
+    }
+    sd_cache_unlink(cache, idx);
+    blk->sector = sector;
+    blk->flags = flags | SD_CACHE_VALID;
+    sd_cache_hash_insert(cache, idx);
+    sd_cache_push_head(cache, idx);
+    return idx;
+}
+
+static inline void
+sd_cache_touch (sd_cache_t *cache, uint16_t idx)
+{
+    if (cache->head != idx) {
+        sd_cache_unlink(cache, idx);
+        sd_cache_push_head(cache, idx);
+    }
+}
+
+static DRESULT
+sd_cache_bypass_read (sd_cache_t *cache, BYTE *buff, DWORD sector, UINT count)
+{
+    DRESULT res;
+    uint16_t idx;
+    UINT i;
+
+    cache->stat.bypass += count;
+    res = cache->drv->disk_read(cache->lun, buff, sector, count);
+    if (res != RES_OK) {
+        cache->stat.errors++;
+        return res;
+    }
+    /*disk is older than dirty sectors*/
+    for (i = 0; cache->dirty && i < count; i++) {
+        idx = sd_cache_lookup(cache, sector + i);
+        if (idx != SD_CACHE_NIL && (cache->blk[idx].flags & SD_CACHE_DIRTY)) {
+            d_memcpy(buff + i * _MIN_SS, sd_cache_data(cache, idx), _MIN_SS);
+        }
+    }
+    return RES_OK;
+}
+
+DRESULT sd_cache_read (sd_cache_t *cache, BYTE *buff, DWORD sector, UINT count)
+{
+    sd_cache_blk_t *blk;
+    DRESULT res;
+    uint16_t idx;
+    UINT n, fetch, i;
+
+    /*
+     * Sequential if continues previous request, or previous sector
+     * is cached : FAT lookups interleave with file data reads.
+     * Read-ahead window doubles while the stream goes on.
+     */
+    if (sector == cache->seqnext ||
+        (sector && sd_cache_lookup(cache, sector - 1) != SD_CACHE_NIL)) {
+        if (cache->rawin < cache->ramax) {
+            cache->rawin = cache->rawin ? cache->rawin * 2 : SD_CACHE_RA_MIN;
+        }
+    } else {
+        cache->rawin = 0;
+    }
+    cache->seqnext = sector + count;
+    cache->stat.reads += count;
+    if (count >= cache->ramax) {
+        return sd_cache_bypass_read(cache, buff, sector, count);
+    }
+    while (count) {
+        idx = sd_cache_lookup(cache, sector);
+        if (idx != SD_CACHE_NIL) {
+            blk = &cache->blk[idx];
+            if (blk->flags & SD_CACHE_RA) {
+                blk->flags &= ~SD_CACHE_RA;
+                cache->stat.rahits++;
+            }
+            d_memcpy(buff, sd_cache_data(cache, idx), _MIN_SS);
+            sd_cache_touch(cache, idx);
+            cache->stat.hits++;
+            sector++;
+            buff += _MIN_SS;
+            count--;
+            continue;
+        }
+        n = 1;
+        while (n < count && sd_cache_lookup(cache, sector + n) == SD_CACHE_NIL) {
+            n++;
+        }
+        fetch = n;
+        if (cache->rawin) {
+            while (fetch < n + cache->rawin && fetch < cache->ramax &&
+                   sd_cache_lookup(cache, sector + fetch) == SD_CACHE_NIL) {
+                fetch++;
+            }
+        }
+        res = cache->drv->disk_read(cache->lun, cache->stage, sector, fetch);
+        if (res != RES_OK && fetch > n) {
+            /*read-ahead may run past the end of the disk*/
+            fetch = n;
+            res = cache->drv->disk_read(cache->lun, cache->stage, sector, fetch);
+        }
+        if (res != RES_OK) {
+            cache->stat.errors++;
+            return res;
+        }
+        for (i = 0; i < fetch; i++) {
+            idx = sd_cache_take(cache, sector + i, i < n ? 0 : SD_CACHE_RA);
+            if (idx == SD_CACHE_NIL) {
+                return RES_ERROR;
+            }
+            d_memcpy(sd_cache_data(cache, idx), cache->stage + i * _MIN_SS, _MIN_SS);
+        }
+        d_memcpy(buff, cache->stage, n * _MIN_SS);
+        cache->stat.misses += n;
+        cache->stat.readahead += fetch - n;
+        sector += n;
+        buff += n * _MIN_SS;
+        count -= n;
+    }
+    return RES_OK;
+}
+
+DRESULT sd_cache_write (sd_cache_t *cache, const BYTE *buff, DWORD sector, UINT count)
+{
+    sd_cache_blk_t *blk;
+    DRESULT res;
+    uint16_t idx;
+    UINT i;
+
+    cache->stat.writes += count;
+    if (count >= cache->ramax) {
+        cache->stat.bypass += count;
+        res = cache->drv->disk_write(cache->lun, buff, sector, count);
+        if (res != RES_OK) {
+            cache->stat.errors++;
+            return res;
+        }
+        for (i = 0; i < count; i++) {
+            idx = sd_cache_lookup(cache, sector + i);
+            if (idx == SD_CACHE_NIL) {
+                continue;
+            }
+            blk = &cache->blk[idx];
+            d_memcpy(sd_cache_data(cache, idx), buff + i * _MIN_SS, _MIN_SS);
+            if (blk->flags & SD_CACHE_DIRTY) {
+                blk->flags &= ~SD_CACHE_DIRTY;
+                cache->dirty--;
+            }
+        }
+        return RES_OK;
+    }
+    for (i = 0; i < count; i++) {
+        idx = sd_cache_lookup(cache, sector + i);
+        if (idx == SD_CACHE_NIL) {
+            idx = sd_cache_take(cache, sector + i, 0);
+            if (idx == SD_CACHE_NIL) {
+                return RES_ERROR;
+            }
+        } else {
+            sd_cache_touch(cache, idx);
+        }
+        blk = &cache->blk[idx];
+        d_memcpy(sd_cache_data(cache, idx), buff + i * _MIN_SS, _MIN_SS);
+        blk->flags &= ~SD_CACHE_RA;
+        if (!(blk->flags & SD_CACHE_DIRTY)) {
+            blk->flags |= SD_CACHE_DIRTY;
+            cache->dirty++;
+        }
+    }
+    return RES_OK;
+}
+
+static inline d_bool
+sd_cache_is_dirty (sd_cache_t *cache, uint16_t idx)
+{
+    return idx != SD_CACHE_NIL && (cache->blk[idx].flags & SD_CACHE_DIRTY);
+}
+
+/*Writes dirty run containing block 'idx', up to 'ramax' sectors per command*/
+static DRESULT
+sd_cache_flush_run (sd_cache_t *cache, uint16_t idx)
+{
+    DWORD start = cache->blk[idx].sector;
+    DRESULT res;
+    UINT n = 0, i;
+
+    while (start && sd_cache_is_dirty(cache, sd_cache_lookup(cache, start - 1))) {
+        start--;
+    }
+    while (n < cache->ramax) {
+        idx = sd_cache_lookup(cache, start + n);
+        if (!sd_cache_is_dirty(cache, idx)) {
+            break;
+        }
+        d_memcpy(cache->stage + n * _MIN_SS, sd_cache_data(cache, idx), _MIN_SS);
+        n++;
+    }
+    res = cache->drv->disk_write(cache->lun, cache->stage, start, n);
+    if (res != RES_OK) {
+        cache->stat.errors++;
+        return res;
+    }
+    for (i = 0; i < n; i++) {
+        idx = sd_cache_lookup(cache, start + i);
+        cache->blk[idx].flags &= ~SD_CACHE_DIRTY;
+    }
+    cache->dirty -= n;
+    cache->stat.writebacks += n;
+    return RES_OK;
+}
+
+DRESULT sd_cache_sync (sd_cache_t *cache)
+{
+    DRESULT res;
+    uint16_t i;
+
+    for (i = 0; i < cache->nblk && cache->dirty; i++) {
+        /*each pass cleans at least the first sector of the run*/
+        while (cache->blk[i].flags & SD_CACHE_DIRTY) {
+            res = sd_cache_flush_run(cache, i);
+            if (res != RES_OK) {
+                return res;
+            }
+        }
+    }
+    return RES_OK;
+}
+
+static void
+sd_cache_release (sd_cache_t *cache, uint16_t idx)
+{
+    sd_cache_blk_t *blk = &cache->blk[idx];
+
+    if (blk->flags & SD_CACHE_DIRTY) {
+        cache->dirty--;
+    }
+    sd_cache_hash_remove(cache, idx);
+    blk->flags = 0;
+    sd_cache_unlink(cache, idx);
+    sd_cache_push_tail(cache, idx);
+}
+
+/*Forgets sectors without writing them back : trimmed range, media change*/
+void sd_cache_drop (sd_cache_t *cache, DWORD sector, DWORD count)
+{
+    uint16_t idx;
+    DWORD i;
+
+    if (count > cache->nblk) {
+        for (idx = 0; idx < cache->nblk; idx++) {
+            if ((cache->blk[idx].flags & SD_CACHE_VALID) &&
+                cache->blk[idx].sector - sector < count) {
+                sd_cache_release(cache, idx);
+            }
+        }
+        return;
+    }
+    for (i = 0; i < count; i++) {
+        idx = sd_cache_lookup(cache, sector + i);
+        if (idx != SD_CACHE_NIL) {
+            sd_cache_release(cache, idx);
+        }
+    }
+}
+
+DRESULT sd_cache_trim (sd_cache_t *cache, DWORD start, DWORD end)
+{
+    if (end < start) {
+        return RES_PARERR;
+    }
+    /*end - start + 1 wraps for the whole card*/
+    sd_cache_drop(cache, start, end - start);
+    sd_cache_drop(cache, end, 1);
+    return RES_OK;
+}
+
+void sd_cache_stat_reset (sd_cache_t *cache)
+{
+    d_memset(&cache->stat, 0, sizeof(cache->stat));
+}
+
+void sd_cache_stat_dump (sd_cache_t *cache)
+{
+    sd_cache_stat_t *stat = &cache->stat;
+    uint32_t lookups = stat->hits + stat->misses;
+
+    dprintf("sd cache : %u sectors, read-ahead %u, dirty %u\n",
+            cache->nblk, cache->ramax, cache->dirty);
+    dprintf("read= %u, write= %u, bypass= %u, errors= %u\n",
+            stat->reads, stat->writes, stat->bypass, stat->errors);
+    dprintf("hit= %u, miss= %u, hit rate= %u%%\n",
+            stat->hits, stat->misses, lookups ? (stat->hits * 100) / lookups : 0);
+    dprintf("read-ahead= %u, used= %u, evict= %u, writeback= %u\n",
+            stat->readahead, stat->rahits, stat->evictions, stat->writebacks);
+}
+
+#if defined(BSP_DRIVER)
+
+#include <sd_diskio.h>
+#include <heap.h>
+#include <bsp_cmd.h>
+
+static sd_cache_t sd_cache;
+static void *sd_cache_mem;
+static d_bool sd_cache_on;
+
+static int sd_cache_cmd (int argc, const char **argv)
+{
+    if (!sd_cache_on) {
+        dprintf("sd cache : off\n");
+        return 0;
+    }
+    if (argc > 0 && !strcmp(argv[0], "reset")) {
+        sd_cache_stat_reset(&sd_cache);
+        return 0;
+    }
+    if (argc > 0 && !strcmp(argv[0], "sync")) {
+        return sd_cache_sync(&sd_cache) == RES_OK ? 0 : -1;
+    }
+    sd_cache_stat_dump(&sd_cache);
+    return 0;
+}
+
+static DSTATUS SDC_initialize (BYTE lun)
+{
+    DSTATUS stat;
+
+    /*dirty sectors go to the card they were written for, before it is reset*/
+    if (sd_cache_on && sd_cache_sync(&sd_cache) != RES_OK) {
+        dprintf("sd cache : write back failed, dirty sectors dropped\n");
+    }
+    stat = SD_Driver.disk_initialize(lun);
+    if (sd_cache_on) {
+        /*card may be replaced, cached sectors are stale*/
+        sd_cache_drop(&sd_cache, 0, (DWORD)-1);
+        return stat;
+    }
+    if (stat & STA_NOINIT) {
+        return stat;
+    }
+    sd_cache_mem = heap_alloc_shared(SD_CACHE_SIZE);
+    if (sd_cache_mem &&
+        sd_cache_init(&sd_cache, &SD_Driver, lun, sd_cache_mem,
+                      SD_CACHE_SIZE, SD_CACHE_RA_DEF) == 0) {
+        sd_cache_on = d_true;
+        cmd_register_func(sd_cache_cmd, "sdcache");
+    } else {
+        dprintf("sd cache : no memory, uncached\n");
+        if (sd_cache_mem) {
+            heap_free(sd_cache_mem);
+            sd_cache_mem = NULL;
+        }
+    }
+    return stat;
+}
+
+static DSTATUS SDC_status (BYTE lun)
+{
+    return SD_Driver.disk_status(lun);
+}
+
+static DRESULT SDC_read (BYTE lun, BYTE *buff, DWORD sector, UINT count)
+{
+    if (!sd_cache_on) {
+        return SD_Driver.disk_read(lun, buff, sector, count);
+    }
+    return sd_cache_read(&sd_cache, buff, sector, count);
+}
+
+#if _USE_WRITE == 1
+static DRESULT SDC_write (BYTE lun, const BYTE *buff, DWORD sector, UINT count)
+{
+    if (!sd_cache_on) {
+        return SD_Driver.disk_write(lun, buff, sector, count);
+    }
+    return sd_cache_write(&sd_cache, buff, sector, count);
+}
+#endif /* _USE_WRITE == 1 */
+
+#if _USE_IOCTL == 1
+static DRESULT SDC_ioctl (BYTE lun, BYTE cmd, void *buff)
+{
+    DRESULT res;
+
+    if (sd_cache_on && cmd == CTRL_SYNC) {
+        res = sd_cache_sync(&sd_cache);
+        if (res != RES_OK) {
+            return res;
+        }
+    }
+#if defined(CTRL_TRIM)
+    if (sd_cache_on && cmd == CTRL_TRIM) {
+        /*trimmed data is garbage, don't write it back*/
+        res = sd_cache_trim(&sd_cache, ((DWORD *)buff)[0], ((DWORD *)buff)[1]);
+        if (res != RES_OK) {
+            return res;
+        }
+    }
+#endif
+    return SD_Driver.disk_ioctl(lun, cmd, buff);
+}
+#endif /* _USE_IOCTL == 1 */
+
+const Diskio_drvTypeDef SD_CacheDriver =
+{
+    SDC_initialize,
+    SDC_status,
+    SDC_read,
+#if  _USE_WRITE == 1
+    SDC_write,
+#endif /* _USE_WRITE == 1 */
+#if  _USE_IOCTL == 1
+    SDC_ioctl,
+#endif /* _USE_IOCTL == 1 */
+};
+
+#endif /*BSP_DRIVER*/
@@ -59,16 +59,31 @@
 #include "debug.h"
 #include "heap.h"
 #include <misc_utils.h>
+#include <bsp_cmd.h>
+#include <sd_bounce.h>
+#include <sd_wq.h>
 
 //#ifndef SD_MODE_DMA_RO 
-#define SD_MODE_DMA_RO 0
+#define SD_MODE_DMA_RO 1
 //#endif
 
 //#ifndef SD_MODE_DMA_WO
 #define SD_MODE_DMA_WO 1
 //#endif
 
-#define SD_UNALIGNED_WA 1
+#ifndef ENABLE_SD_DMA_CACHE_MAINTENANCE
+#define ENABLE_SD_DMA_CACHE_MAINTENANCE 1
+#endif
+
+#define SD_CACHE_LINE_MASK (0x1f)
+
+/*Erase may take up to 250ms per allocation unit*/
+#define SD_ERASE_TIMEOUT (30 * 1000)
+
+/*I/O trace, 'sdtrace' console command; runtime off by default*/
+#ifndef SD_TRACE
+#define SD_TRACE 1
+#endif
 
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
@@ -92,11 +107,174 @@ static volatile DSTATUS Stat = STA_NOINIT;
 static irqmask_t dma_rxtx_irq;
 
 #if SD_MODE_DMA_RO || SD_MODE_DMA_WO
-static volatile  UINT  WriteStatus = 0, ReadStatus = 0;
+#define SD_XFER_BUSY (0)
+#define SD_XFER_DONE (1)
+#define SD_XFER_ERR (-1)
+static volatile int WriteStatus = SD_XFER_DONE, ReadStatus = SD_XFER_DONE;
 #endif /**/
 
+#if _USE_WRITE == 1
+static DRESULT _SD_write (BYTE lun, const BYTE *buff, DWORD sector, UINT count);
+/*Age checked on every driver call and by SD_Tickle()*/
+static sd_wq_t sd_wq = {.write = _SD_write, .ms = HAL_GetTick};
+#endif
+static void (*sd_yield_hook) (void) = NULL;
+/*
+ * Yield hook runs in the middle of a transfer, with sd_bounce or the write
+ * queue in use : the driver is not re-entered from it, disk calls made by
+ * the hook fail with RES_NOTRDY (STA_NOINIT for initialize/status).
+ */
+static volatile d_bool sd_yielding = d_false;
+
 extern void hdd_led_on (void);
 extern void hdd_led_off (void);
+extern SD_HandleTypeDef uSdHandle;
+
+#if SD_TRACE
+
+#include <sd_trace.h>
+
+static sd_trace_t sd_trace;
+
+static const char *sd_trace_op_name[SD_TRACE_OP_MAX] =
+{
+    [SD_TRACE_READ] = "read",
+    [SD_TRACE_WRITE] = "write",
+    [SD_TRACE_TRIM] = "trim",
+};
+
+static const char *sd_trace_path_name[SD_TRACE_PATH_MAX] =
+{
+    [SD_TRACE_DMA] = "dma",
+    [SD_TRACE_BOUNCE] = "bounce",
+    [SD_TRACE_POLL] = "poll",
+    [SD_TRACE_QUEUED] = "queued",
+    [SD_TRACE_FLUSH] = "flush",
+    [SD_TRACE_ERASE] = "erase",
+};
+
+#define SD_TRACE_BEGIN(stamp) \
+    uint32_t stamp = sd_trace.on ? DWT->CYCCNT : 0
+
+#define SD_TRACE_END(stamp, op, path, sector, count, res) \
+do { \
+    if (sd_trace.on) { \
+        SD_TraceEnd(stamp, op, path, sector, count, res); \
+    } \
+} while (0)
+
+#define SD_TRACE_STREAM() \
+do { \
+    if (sd_trace.stream) { \
+        SD_TraceStream(); \
+    } \
+} while (0)
+
+static void SD_TraceEnd (uint32_t stamp, sd_trace_op_e op, sd_trace_path_e path,
+                                DWORD sector, UINT count, DRESULT res)
+{
+    uint32_t cpu = SystemCoreClock / 1000000;
+
+    sd_trace_put(&sd_trace, HAL_GetTick(), (DWT->CYCCNT - stamp) / cpu,
+                 op, path, sector, count, res != RES_OK);
+}
+
+/*One line per request : sdt <ms> <op> <sector> <count> <path> <us> <err>*/
+static void SD_TracePrint (const sd_trace_rec_t *rec)
+{
+    dprintf("sdt %u %s %u %u %s %u %u\n",
+            rec->t, sd_trace_op_name[rec->op], rec->sector, rec->count,
+            sd_trace_path_name[rec->path], rec->dur, rec->err);
+}
+
+/*Called after request completes, so printing doesn't fall into the timing*/
+static void SD_TraceStream (void)
+{
+    sd_trace_rec_t *rec;
+
+    while ((rec = sd_trace_next(&sd_trace)) != NULL) {
+        SD_TracePrint(rec);
+    }
+}
+
+static void SD_TraceDump (void)
+{
+    uint32_t i = sd_trace.wr > SD_TRACE_DEPTH ? sd_trace.wr - SD_TRACE_DEPTH : 0;
+
+    for (; i != sd_trace.wr; i++) {
+        SD_TracePrint(&sd_trace.rec[i & (SD_TRACE_DEPTH - 1)]);
+    }
+}
+
+static void SD_TraceHist (void)
+{
+    int op, i;
+
+    for (op = 0; op < SD_TRACE_OP_MAX; op++) {
+        dprintf("%s : max= %u us\n", sd_trace_op_name[op], sd_trace.maxdur[op]);
+        for (i = 0; i < SD_TRACE_HIST; i++) {
+            if (sd_trace.hist[op][i]) {
+                dprintf("  < %u us : %u\n", 1U << i, sd_trace.hist[op][i]);
+            }
+        }
+    }
+    dprintf("records= %u, lost= %u\n", sd_trace.wr, sd_trace.lost);
+}
+
+static int SD_TraceCmd (int argc, const char **argv)
+{
+    if (argc < 1) {
+        dprintf("sdtrace [on|off|reset|dump|hist|stream <0|1>]\n");
+        return 0;
+    }
+    if (!strcmp(argv[0], "on")) {
+        CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+        DWT->LAR = 0xC5ACCE55;
+        DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+        sd_trace.on = 1;
+    } else if (!strcmp(argv[0], "off")) {
+        sd_trace.on = 0;
+    } else if (!strcmp(argv[0], "reset")) {
+        sd_trace_reset(&sd_trace);
+    } else if (!strcmp(argv[0], "dump")) {
+        SD_TraceDump();
+    } else if (!strcmp(argv[0], "hist")) {
+        SD_TraceHist();
+    } else if (!strcmp(argv[0], "stream")) {
+        sd_trace.stream = argc > 1 && argv[1][0] == '1';
+        /*stream from now on*/
+        sd_trace.rd = sd_trace.wr;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+#else /*SD_TRACE*/
+
+#define SD_TRACE_BEGIN(stamp)
+#define SD_TRACE_END(stamp, op, path, sector, count, res)
+#define SD_TRACE_STREAM()
+
+#endif /*SD_TRACE*/
+
+#if SD_MODE_DMA_RO
+#define SD_READ_PATH(buff) \
+    (((uint32_t)(buff) & SD_CACHE_LINE_MASK) ? SD_TRACE_BOUNCE : SD_TRACE_DMA)
+#else
+#define SD_READ_PATH(buff) \
+    (((uint32_t)(buff) & 0x3) ? SD_TRACE_BOUNCE : SD_TRACE_POLL)
+#endif
+
+#if SD_MODE_DMA_WO
+#define SD_WRITE_PATH(buff) \
+    ((buff) == (BYTE *)sd_wq.buf ? SD_TRACE_FLUSH : \
+     ((uint32_t)(buff) & 0x3) ? SD_TRACE_BOUNCE : SD_TRACE_DMA)
+#else
+#define SD_WRITE_PATH(buff) \
+    ((buff) == (BYTE *)sd_wq.buf ? SD_TRACE_FLUSH : \
+     ((uint32_t)(buff) & 0x3) ? SD_TRACE_BOUNCE : SD_TRACE_POLL)
+#endif
 
 /* Private function prototypes -----------------------------------------------*/
 static DSTATUS SD_CheckStatus(BYTE lun);
@@ -109,6 +287,10 @@ DRESULT SD_read (BYTE, BYTE*, DWORD, UINT);
 #if _USE_IOCTL == 1
   DRESULT SD_ioctl (BYTE, BYTE, void*);
 #endif  /* _USE_IOCTL == 1 */
+void SD_SetYieldHook (void (*yield) (void));
+#if _USE_WRITE == 1
+DRESULT SD_Tickle (void);
+#endif /* _USE_WRITE == 1 */
 
 const Diskio_drvTypeDef  SD_Driver =
 {
@@ -143,8 +325,20 @@ static DSTATUS SD_CheckStatus(BYTE lun)
   */
 DSTATUS SD_initialize(BYTE lun)
 {
-  Stat = STA_NOINIT;
   irqmask_t irq = 0, irqsave;
+
+  if (sd_yielding) {
+    return STA_NOINIT;
+  }
+#if _USE_WRITE == 1
+  /*queued run belongs to the card that was in use, card may be replaced*/
+  if (sd_wq.count && ((Stat & STA_NOINIT) || sd_wq_flush(&sd_wq) != RES_OK)) {
+    dprintf("%s() : queued write lost, sector= %u, count= %u\n",
+            __func__, (unsigned)sd_wq.sector, (unsigned)sd_wq.count);
+  }
+  sd_wq_drop(&sd_wq);
+#endif
+  Stat = STA_NOINIT;
 #if !defined(DISABLE_SD_INIT)
 
   irq_save(&irqsave);
@@ -158,6 +352,15 @@ DSTATUS SD_initialize(BYTE lun)
   irq_restore(irqsave);
 #else
   Stat = SD_CheckStatus(lun);
+#endif
+#if SD_TRACE
+  {
+    static d_bool registered = d_false;
+    if (!registered) {
+      cmd_register_func(SD_TraceCmd, "sdtrace");
+      registered = d_true;
+    }
+  }
 #endif
   return Stat;
 }
@@ -174,73 +377,128 @@ void SD_Deinitialize(void)
   */
 DSTATUS SD_status(BYTE lun)
 {
+    if (sd_yielding) {
+        return STA_NOINIT;
+    }
+#if _USE_WRITE == 1
+    /*failed write back - force remount, SD_initialize() retries it*/
+    if (!(Stat & STA_NOINIT) && sd_wq_poll(&sd_wq) != RES_OK) {
+        return STA_NOINIT;
+    }
+#endif
     return SD_CheckStatus(lun);
 }
 
-#if SD_UNALIGNED_WA
-
 #if (_MIN_SS != _MAX_SS)
 #error "Unsupported mode"
 #endif
 
-DRESULT SD_Uread(BYTE lun, BYTE *buff, DWORD sector, UINT count)
+void SD_SetYieldHook (void (*yield) (void))
 {
-    DRESULT result = RES_OK;
-    uint8_t ret = MSD_OK;
-    DWORD end = sector + count;
-    uint32_t *abuf = heap_malloc(_MIN_SS);
+    sd_yield_hook = yield;
+}
 
-    if (!abuf) {
-        return RES_NOTRDY;
+static inline void SD_Yield (void)
+{
+    if (sd_yield_hook) {
+        sd_yielding = d_true;
+        sd_yield_hook();
+        sd_yielding = d_false;
     }
-    assert(PTR_ALIGNED(abuf, sizeof(arch_word_t)));
-    for (; sector < end;) {
-        ret = BSP_SD_ReadBlocks(abuf, (uint32_t)sector,
-                                SD_BLOCK_SECTOR_CNT,
-                                SD_TIMEOUT);
-        if (ret == MSD_OK) {
-           while(BSP_SD_GetCardState()!= MSD_OK) {}
-        } else {
-           result = RES_ERROR;
-           break;
+}
+
+/*Waits for the card to leave programming/erase state*/
+static DRESULT SD_WaitReady (uint32_t timeout)
+{
+    uint32_t start = HAL_GetTick();
+
+    while (BSP_SD_GetCardState() != SD_TRANSFER_OK) {
+        if (HAL_GetTick() - start >= timeout) {
+            return RES_ERROR;
         }
-        d_memcpy(buff, abuf, _MIN_SS);
-        sector += 1;
-        buff += _MIN_SS;
+        SD_Yield();
     }
-    heap_free(abuf);
-    return result;
+    return RES_OK;
 }
 
-#endif /*SD_UNALIGNED_WA*/
+#if SD_MODE_DMA_RO || SD_MODE_DMA_WO
 
-#if SD_MODE_DMA_RO
+static inline d_bool SD_DmaActive (DMA_HandleTypeDef *hdma)
+{
+    return hdma && (hdma->Instance->CR & DMA_SxCR_EN);
+}
 
-DRESULT SD_UreadDma (BYTE lun, BYTE *buff, DWORD sector, UINT count)
+/*
+ * Stops a transfer which didn't complete in time and waits until both
+ * dma streams are off : caller reuses the buffer (sd_bounce, write queue)
+ * right after the error.
+ */
+static void SD_AbortXfer (volatile int *status)
 {
-    DRESULT result = RES_OK;
-    uint8_t ret = MSD_OK;
-    DWORD end = sector + count;
-    uint32_t *abuf = heap_malloc(_MIN_SS);
+    uint32_t start = HAL_GetTick();
 
-    if (!abuf) {
-        return RES_NOTRDY;
-    }
-    assert(PTR_ALIGNED(abuf, sizeof(arch_word_t)));
-    for (; sector < end;) {
-        ret = BSP_SD_ReadBlocks_DMA(abuf, (uint32_t)sector, 1);
-        if (ret == MSD_OK) {
-           while(BSP_SD_GetCardState()!= MSD_OK) {} 
-        } else {
-           result = RES_ERROR;
+    HAL_SD_Abort(&uSdHandle);
+    while (SD_DmaActive(uSdHandle.hdmarx) || SD_DmaActive(uSdHandle.hdmatx)) {
+        if (HAL_GetTick() - start >= SD_TIMEOUT) {
+            dprintf("%s() : dma stream still enabled\n", __func__);
             break;
         }
-        d_memcpy(buff, abuf, _MIN_SS);
-        sector += 1;
-        buff += _MIN_SS;
     }
-    heap_free(abuf);
-    return RES_OK;
+    *status = SD_XFER_ERR;
+}
+
+/*
+ * Waits for dma completion (HAL_SD_Rx/TxCpltCallback) and for the card
+ * to leave programming state, calling yield hook meanwhile.
+ * Interrupts stay enabled : SDMMC fifo is served by dma, not by the cpu,
+ * so irq latency can't cause fifo over/underrun.
+ */
+static DRESULT SD_WaitXfer (volatile int *status)
+{
+    uint32_t timeout = HAL_GetTick();
+
+    while (*status == SD_XFER_BUSY) {
+        if (HAL_GetTick() - timeout >= SD_TIMEOUT) {
+            SD_AbortXfer(status);
+            return RES_ERROR;
+        }
+        SD_Yield();
+    }
+    if (*status != SD_XFER_DONE) {
+        return RES_ERROR;
+    }
+    return SD_WaitReady(SD_TIMEOUT);
+}
+
+#endif /*SD_MODE_DMA_RO || SD_MODE_DMA_WO*/
+
+#if SD_MODE_DMA_RO
+
+/*'buff' must be cache line aligned : invalidate drops whole lines*/
+static DRESULT SD_ReadDma (BYTE lun, BYTE *buff, DWORD sector, UINT count)
+{
+    DRESULT res;
+
+#if (ENABLE_SD_DMA_CACHE_MAINTENANCE == 1)
+    /*no dirty line may be evicted over dma data*/
+    SCB_InvalidateDCache_by_Addr((uint32_t *)buff, count * _MIN_SS);
+#endif
+    ReadStatus = SD_XFER_BUSY;
+    if (BSP_SD_ReadBlocks_DMA((uint32_t *)buff, (uint32_t)sector,
+                              count * SD_BLOCK_SECTOR_CNT) != MSD_OK) {
+        return RES_ERROR;
+    }
+    res = SD_WaitXfer(&ReadStatus);
+#if (ENABLE_SD_DMA_CACHE_MAINTENANCE == 1)
+    /*drop lines speculatively fetched during transfer*/
+    SCB_InvalidateDCache_by_Addr((uint32_t *)buff, count * _MIN_SS);
+#endif
+    return res;
+}
+
+DRESULT SD_UreadDma (BYTE lun, BYTE *buff, DWORD sector, UINT count)
+{
+    return sd_bounce_read(SD_ReadDma, lun, buff, sector, count);
 }
 
 /**
@@ -253,59 +511,29 @@ DRESULT SD_UreadDma (BYTE lun, BYTE *buff, DWORD sector, UINT count)
   */
 DRESULT _SD_read(BYTE lun, BYTE *buff, DWORD sector, UINT count)
 {
-  DRESULT res = RES_ERROR;
-  ReadStatus = 0;
-  uint32_t timeout;
-#if (ENABLE_SD_DMA_CACHE_MAINTENANCE == 1)
-  uint32_t alignedAddr;
-#endif
+    if ((uint32_t)buff & SD_CACHE_LINE_MASK) {
+        return SD_UreadDma(lun, buff, sector, count);
+    }
+    return SD_ReadDma(lun, buff, sector, count);
+}
 
-  if (count > 1) {
-    return SD_UreadDma(lun, buff, sector, count);
-  }
+#else /*SD_MODE_DMA_RO*/
 
-  if(BSP_SD_ReadBlocks_DMA((uint32_t*)buff,
-                           (uint32_t) (sector),
-                           count) == MSD_OK)
-  {
-    /* Wait that the reading process is completed or a timeout occurs */
-    timeout = HAL_GetTick();
-    while((ReadStatus == 0) && ((HAL_GetTick() - timeout) < SD_TIMEOUT))
-    {
-    }
-    /* incase of a timeout return error */
-    if (ReadStatus == 0)
-    {
-      res = RES_ERROR;
-    }
-    else
-    {
-      ReadStatus = 0;
-      timeout = HAL_GetTick();
-
-      while((HAL_GetTick() - timeout) < SD_TIMEOUT)
-      {
-        if (BSP_SD_GetCardState() == SD_TRANSFER_OK)
-        {
-          res = RES_OK;
-#if (ENABLE_SD_DMA_CACHE_MAINTENANCE == 1)
-            /*
-               the SCB_InvalidateDCache_by_Addr() requires a 32-Byte aligned address,
-               adjust the address and the D-Cache size to invalidate accordingly.
-             */
-            alignedAddr = (uint32_t)buff & ~0x1F;
-            SCB_InvalidateDCache_by_Addr((uint32_t*)alignedAddr, count*BLOCKSIZE + ((uint32_t)buff - alignedAddr));
-#endif
-           break;
-        }
-      }
+/*'buff' must be word aligned*/
+static DRESULT SD_ReadPoll (BYTE lun, BYTE *buff, DWORD sector, UINT count)
+{
+    if (BSP_SD_ReadBlocks((uint32_t *)buff, (uint32_t)sector,
+                          count * SD_BLOCK_SECTOR_CNT, SD_TIMEOUT) != MSD_OK) {
+        return RES_ERROR;
     }
-  }
-  return res;
+    while (BSP_SD_GetCardState() != MSD_OK) {}
+    return RES_OK;
 }
 
-
-#else /*SD_MODE_DMA_RO*/
+DRESULT SD_Uread(BYTE lun, BYTE *buff, DWORD sector, UINT count)
+{
+    return sd_bounce_read(SD_ReadPoll, lun, buff, sector, count);
+}
 
 /**
   * @brief  Reads Sector(s)
@@ -320,16 +548,13 @@ DRESULT _SD_read(BYTE lun, BYTE *buff, DWORD sector, UINT count)
 {
   DRESULT res = RES_ERROR;
   uint8_t msd_res = MSD_ERROR;
-#if SD_UNALIGNED_WA
 
   if (((uint32_t)buff) & 0x3) {
      res = SD_Uread(lun, buff, sector, count);
-  } else
-#endif /*SD_UNALIGNED_WA*/
-  {
+  } else {
     msd_res = BSP_SD_ReadBlocks((uint32_t *)buff,
                           (uint32_t)sector,
-                          count,
+                          count * SD_BLOCK_SECTOR_CNT,
                           SD_TIMEOUT);
     if (msd_res == MSD_OK) {
         res = RES_OK;
@@ -345,14 +570,36 @@ DRESULT _SD_read(BYTE lun, BYTE *buff, DWORD sector, UINT count)
 DRESULT SD_read(BYTE lun, BYTE *buff, DWORD sector, UINT count)
 {
     DRESULT res;
+#if !SD_MODE_DMA_RO
+    /*polled fifo : any irq may cause rx overrun*/
     irqmask_t irq_flags = ~dma_rxtx_irq;
+#endif
+    if (sd_yielding) {
+        return RES_NOTRDY;
+    }
     hdd_led_on();
 
-    irq_save(&irq_flags);
-    res = _SD_read(lun, buff, sector, count * SD_BLOCK_SECTOR_CNT);
-    irq_restore(irq_flags);
+#if _USE_WRITE == 1
+    res = sd_wq_read_sync(&sd_wq, sector, count);
+    if (res != RES_OK) {
+        hdd_led_off();
+        return res;
+    }
+#endif
+    {
+        SD_TRACE_BEGIN(stamp);
+#if !SD_MODE_DMA_RO
+        irq_save(&irq_flags);
+#endif
+        res = _SD_read(lun, buff, sector, count);
+#if !SD_MODE_DMA_RO
+        irq_restore(irq_flags);
+#endif
+        SD_TRACE_END(stamp, SD_TRACE_READ, SD_READ_PATH(buff), sector, count, res);
+    }
 
     hdd_led_off();
+    SD_TRACE_STREAM();
     return res;
 }
 
@@ -370,58 +617,31 @@ DRESULT SD_read(BYTE lun, BYTE *buff, DWORD sector, UINT count)
 /**
   * @brief  Writes Sector(s)
   * @param  lun : not used
-  * @param  *buff: Data to be written
+  * @param  *buff: Data to be written, word aligned
   * @param  sector: Sector address (LBA)
   * @param  count: Number of sectors to write (1..128)
   * @retval DRESULT: Operation result
   */
 static DRESULT __SD_write (BYTE lun, const BYTE *buff, DWORD sector, UINT count)
 {
-  DRESULT res = RES_ERROR;
-  WriteStatus = 0;
-  uint32_t timeout;
-
 #if (ENABLE_SD_DMA_CACHE_MAINTENANCE == 1)
   uint32_t alignedAddr;
   /*
    the SCB_CleanDCache_by_Addr() requires a 32-Byte aligned address
    adjust the address and the D-Cache size to clean accordingly.
    */
-  alignedAddr = (uint32_t)buff &  ~0x1F;
-  SCB_CleanDCache_by_Addr((uint32_t*)alignedAddr, count*BLOCKSIZE + ((uint32_t)buff - alignedAddr));
+  alignedAddr = (uint32_t)buff &  ~SD_CACHE_LINE_MASK;
+  SCB_CleanDCache_by_Addr((uint32_t*)alignedAddr, count*_MIN_SS + ((uint32_t)buff - alignedAddr));
 #endif
 
+  WriteStatus = SD_XFER_BUSY;
   if(BSP_SD_WriteBlocks_DMA((uint32_t*)buff,
                             (uint32_t)(sector),
-                            count) == MSD_OK)
+                            count * SD_BLOCK_SECTOR_CNT) != MSD_OK)
   {
-    /* Wait that writing process is completed or a timeout occurs */
-
-    timeout = HAL_GetTick();
-    while((WriteStatus == 0) && ((HAL_GetTick() - timeout) < SD_TIMEOUT))
-    {
-    }
-    /* incase of a timeout return error */
-    if (WriteStatus == 0)
-    {
-      res = RES_ERROR;
-    }
-    else
-    {
-      WriteStatus = 0;
-      timeout = HAL_GetTick();
-
-      while((HAL_GetTick() - timeout) < SD_TIMEOUT)
-      {
-        if (BSP_SD_GetCardState() == SD_TRANSFER_OK)
-        {
-          res = RES_OK;
-          break;
-        }
-      }
-    }
+    return RES_ERROR;
   }
-  return res;
+  return SD_WaitXfer(&WriteStatus);
 }
 
 #else /*SD_MODE_DMA_WO*/
@@ -432,7 +652,7 @@ static DRESULT __SD_write(BYTE lun, const BYTE *buff, DWORD sector, UINT count)
   DRESULT res = RES_OK;
   ret = BSP_SD_WriteBlocks((uint32_t*)buff,
                            (uint32_t)sector,
-                           count,
+                           count * SD_BLOCK_SECTOR_CNT,
                            SD_TIMEOUT);
 
   if (ret == MSD_OK) {
@@ -445,65 +665,65 @@ static DRESULT __SD_write(BYTE lun, const BYTE *buff, DWORD sector, UINT count)
 
 #endif /*SD_MODE_DMA_WO*/
 
-#if SD_UNALIGNED_WA
-
 static DRESULT SD_UWrite (BYTE lun, const BYTE *buff, DWORD sector, UINT count)
 {
-    DRESULT res = RES_OK;
-    DWORD end = sector + count;
-    uint32_t *abuf = heap_malloc(_MIN_SS);
-
-    if (!abuf) {
-        return RES_NOTRDY;
-    }
-    assert(PTR_ALIGNED(abuf, sizeof(arch_word_t)));
-
-    for (; sector < end;) {
-        d_memcpy(abuf, buff, _MIN_SS);
-        res = __SD_write(lun, (BYTE *)abuf, sector, 1);
-        if (res == RES_OK) {
-           while(BSP_SD_GetCardState()!= MSD_OK) {}
-        } else {
-           res = RES_ERROR;
-           break;
-        }
-        sector += 1;
-        buff += _MIN_SS;
-    }
-    heap_free(abuf);
-    return res;
+    return sd_bounce_write(__SD_write, lun, buff, sector, count);
 }
 
-#endif /*SD_UNALIGNED_WA*/
-
 static DRESULT _SD_write (BYTE lun, const BYTE *buff, DWORD sector, UINT count)
 {
-    DRESULT res = RES_OK;
-#if SD_UNALIGNED_WA
+    DRESULT res;
+    SD_TRACE_BEGIN(stamp);
+#if !SD_MODE_DMA_WO
+    irqmask_t irq_flags = ~dma_rxtx_irq;
+
+    irq_save(&irq_flags);
+#endif
     if ((uint32_t)buff & 0x3) {
         res = SD_UWrite(lun, buff, sector, count);
-    } else
-#endif
-    {
+    } else {
         res = __SD_write(lun, buff, sector, count);
     }
-    if (res == RES_OK) {
-        while(BSP_SD_GetCardState()!= MSD_OK) {} 
-    }
+#if !SD_MODE_DMA_WO
+    irq_restore(irq_flags);
+#endif
+    SD_TRACE_END(stamp, SD_TRACE_WRITE, SD_WRITE_PATH(buff), sector, count, res);
     return res;
 }
 
-DRESULT SD_write (BYTE lun, const BYTE *buff, DWORD sector, UINT count)
+DRESULT SD_Tickle (void)
 {
     DRESULT res;
-    irqmask_t irq_flags = ~dma_rxtx_irq;
+
+    if (sd_yielding || (Stat & STA_NOINIT)) {
+        return RES_NOTRDY;
+    }
+    if (!sd_wq.count) {
+        return RES_OK;
+    }
     hdd_led_on();
-    irq_save(&irq_flags);
+    res = sd_wq_poll(&sd_wq);
+    hdd_led_off();
+    return res;
+}
 
-    res = _SD_write(lun, buff, sector, count);
+DRESULT SD_write (BYTE lun, const BYTE *buff, DWORD sector, UINT count)
+{
+    DRESULT res;
+    uint32_t queued = sd_wq.stat.queued;
+    SD_TRACE_BEGIN(stamp);
 
-    irq_restore(irq_flags);
+    if (sd_yielding) {
+        return RES_NOTRDY;
+    }
+    hdd_led_on();
+    res = sd_wq_write(&sd_wq, buff, sector, count);
+    if (sd_wq.stat.queued != queued) {
+        /*flush of a full run, if any, is traced before*/
+        SD_TRACE_END(stamp, SD_TRACE_WRITE, SD_TRACE_QUEUED, sector, count, RES_OK);
+    }
     hdd_led_off();
+    SD_TRACE_STREAM();
     return res;
 }
 
@@ -517,19 +737,89 @@ DRESULT SD_write (BYTE lun, const BYTE *buff, DWORD sector, UINT count)
   * @retval DRESULT: Operation result
   */
 #if _USE_IOCTL == 1
+#if defined(CTRL_TRIM)
+
+/*Erase unit in sectors, CSD SECTOR_SIZE*/
+static DWORD SD_EraseUnit (void)
+{
+    static DWORD unit = 0;
+    HAL_SD_CardCSDTypeDef csd;
+
+    if (!unit) {
+        if (HAL_SD_GetCardCSD(&uSdHandle, &csd) != HAL_OK) {
+            return 0;
+        }
+        unit = (csd.EraseGrMul + 1) / SD_BLOCK_SECTOR_CNT;
+        if (!unit) {
+            unit = 1;
+        }
+    }
+    return unit;
+}
+
+/*
+ * Only whole erase units are erased : partial unit erase makes
+ * the card copy the rest of the unit, that costs more than it saves.
+ */
+static DRESULT SD_Trim (BYTE lun, DWORD start, DWORD end)
+{
+    DWORD unit = SD_EraseUnit();
+    DRESULT res;
+
+    if (!unit || end < start) {
+        return RES_PARERR;
+    }
+    start = (start + unit - 1) / unit * unit;
+    end = (end + 1) / unit * unit;
+    if (end <= start) {
+        return RES_OK;
+    }
+#if _USE_WRITE == 1
+    res = sd_wq_flush(&sd_wq);
+    if (res != RES_OK) {
+        return res;
+    }
+#endif
+    hdd_led_on();
+    {
+        SD_TRACE_BEGIN(stamp);
+        if (BSP_SD_Erase(start * SD_BLOCK_SECTOR_CNT, end * SD_BLOCK_SECTOR_CNT - 1) != MSD_OK) {
+            res = RES_ERROR;
+        } else {
+            res = SD_WaitReady(SD_ERASE_TIMEOUT);
+        }
+        SD_TRACE_END(stamp, SD_TRACE_TRIM, SD_TRACE_ERASE, start, end - start, res);
+    }
+    hdd_led_off();
+    SD_TRACE_STREAM();
+    return res;
+}
+#endif /*CTRL_TRIM*/
+
 DRESULT SD_ioctl(BYTE lun, BYTE cmd, void *buff)
 {
   DRESULT res = RES_ERROR;
   BSP_SD_CardInfo CardInfo;
-  if (Stat & STA_NOINIT) return RES_NOTRDY;
+  if ((Stat & STA_NOINIT) || sd_yielding) return RES_NOTRDY;
 
   switch (cmd)
   {
   /* Make sure that no pending write process */
   case CTRL_SYNC :
+#if _USE_WRITE == 1
+    res = sd_wq_flush(&sd_wq);
+#else
     res = RES_OK;
+#endif
     break;
 
+#if defined(CTRL_TRIM)
+  /* Erase sectors, DWORD[2] : start, end (inclusive) */
+  case CTRL_TRIM :
+    res = SD_Trim(lun, ((DWORD *)buff)[0], ((DWORD *)buff)[1]);
+    break;
+#endif
+
   /* Get number of sectors on the disk (DWORD) */
   case GET_SECTOR_COUNT :
     BSP_SD_GetCardInfo(&CardInfo);
@@ -578,7 +868,7 @@ void BSP_SD_AbortCallback(void)
 void BSP_SD_WriteCpltCallback(void)
 {
 #if SD_MODE_DMA_WO
-  WriteStatus = 1;
+  WriteStatus = SD_XFER_DONE;
 #endif
 }
 
@@ -599,11 +889,24 @@ void BSP_SD_WriteCpltCallback(void)
 void BSP_SD_ReadCpltCallback(void)
 {
 #if SD_MODE_DMA_RO
-  ReadStatus = 1;
+  ReadStatus = SD_XFER_DONE;
 #endif
 }
 
-extern SD_HandleTypeDef uSdHandle;
+/*Transfer error, dma or data crc/timeout, completes the wait with error*/
+void HAL_SD_ErrorCallback(SD_HandleTypeDef *hsd)
+{
+#if SD_MODE_DMA_RO
+  if (ReadStatus == SD_XFER_BUSY) {
+    ReadStatus = SD_XFER_ERR;
+  }
+#endif
+#if SD_MODE_DMA_WO
+  if (WriteStatus == SD_XFER_BUSY) {
+    WriteStatus = SD_XFER_ERR;
+  }
+#endif
+}
 
 void BSP_SDMMC_DMA_Tx_IRQHandler (void)
 {
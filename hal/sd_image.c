@@ -0,0 +1,240 @@
+#if !defined(BSP_DRIVER)
+
+#define _GNU_SOURCE
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <sd_image.h>
+#include <misc_utils.h>
+#include <debug.h>
+
+static int sd_image_fd = -1;
+static DWORD sd_image_sectors;
+static sd_image_timing_t sd_image_tm;
+static sd_image_stat_t sd_image_st;
+/*monotonic us, when the card model completes last command*/
+static uint64_t sd_image_due;
+
+/*Card idle longer than this - don't pay back oversleep*/
+#define SD_IMAGE_IDLE_US (1000)
+
+int sd_image_open (const char *path, DWORD sectors, const sd_image_timing_t *timing)
+{
+    struct stat st;
+    int fd;
+
+    fd = open(path, sectors ? O_RDWR | O_CREAT : O_RDWR, 0644);
+    if (fd < 0) {
+        dprintf("sd image : can't open '%s' : %s\n", path, strerror(errno));
+        return -1;
+    }
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return -1;
+    }
+    if ((off_t)sectors * _MIN_SS > st.st_size) {
+        if (ftruncate(fd, (off_t)sectors * _MIN_SS) < 0) {
+            close(fd);
+            return -1;
+        }
+        st.st_size = (off_t)sectors * _MIN_SS;
+    }
+    sd_image_close();
+    sd_image_fd = fd;
+    sd_image_sectors = st.st_size / _MIN_SS;
+    sd_image_timing(timing);
+    sd_image_stat_reset();
+    return 0;
+}
+
+void sd_image_close (void)
+{
+    if (sd_image_fd >= 0) {
+        close(sd_image_fd);
+        sd_image_fd = -1;
+    }
+}
+
+void sd_image_timing (const sd_image_timing_t *timing)
+{
+    if (timing) {
+        sd_image_tm = *timing;
+    } else {
+        d_memset(&sd_image_tm, 0, sizeof(sd_image_tm));
+    }
+}
+
+void sd_image_stat (sd_image_stat_t *stat)
+{
+    *stat = sd_image_st;
+}
+
+void sd_image_stat_reset (void)
+{
+    d_memset(&sd_image_st, 0, sizeof(sd_image_st));
+}
+
+void sd_image_stat_dump (void)
+{
+    sd_image_stat_t *st = &sd_image_st;
+
+    dprintf("sd image : %lu sectors\n", (unsigned long)sd_image_sectors);
+    dprintf("read= %u cmd / %u sect, write= %u cmd / %u sect, sync= %u, errors= %u\n",
+            st->rdcmd, st->rdsect, st->wrcmd, st->wrsect, st->syncs, st->errors);
+    dprintf("busy= %llu us\n", (unsigned long long)st->busy);
+}
+
+static uint64_t
+sd_image_now (void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/*
+ * Sleeps until absolute deadline, so oversleep of one command
+ * is paid back by the next one and long runs keep model pace.
+ */
+static void
+sd_image_charge (uint32_t lat, uint32_t rate, UINT count)
+{
+    uint64_t us = lat, now;
+    struct timespec ts;
+
+    if (rate) {
+        us += ((uint64_t)count * _MIN_SS * 1000000) / ((uint64_t)rate * 1024);
+    }
+    sd_image_st.busy += us;
+    if (!sd_image_tm.realtime || !us) {
+        return;
+    }
+    now = sd_image_now();
+    if (now > sd_image_due + SD_IMAGE_IDLE_US) {
+        sd_image_due = now;
+    }
+    sd_image_due += us;
+    ts.tv_sec = sd_image_due / 1000000;
+    ts.tv_nsec = (sd_image_due % 1000000) * 1000;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {}
+}
+
+/*One image, drive 0*/
+static d_bool
+sd_image_ready (BYTE lun)
+{
+    return sd_image_fd >= 0 && lun == 0;
+}
+
+static d_bool
+sd_image_range_ok (DWORD sector, UINT count)
+{
+    return sd_image_fd >= 0 && sector < sd_image_sectors &&
+           count <= sd_image_sectors - sector;
+}
+
+static DSTATUS SDI_initialize (BYTE lun)
+{
+    return sd_image_ready(lun) ? 0 : STA_NOINIT;
+}
+
+static DSTATUS SDI_status (BYTE lun)
+{
+    return sd_image_ready(lun) ? 0 : STA_NOINIT;
+}
+
+static DRESULT SDI_read (BYTE lun, BYTE *buff, DWORD sector, UINT count)
+{
+    size_t size = (size_t)count * _MIN_SS;
+
+    if (!sd_image_ready(lun) || !sd_image_range_ok(sector, count) ||
+        pread(sd_image_fd, buff, size, (off_t)sector * _MIN_SS) != (ssize_t)size) {
+        sd_image_st.errors++;
+        return RES_ERROR;
+    }
+    sd_image_st.rdcmd++;
+    sd_image_st.rdsect += count;
+    sd_image_charge(sd_image_tm.rdlat, sd_image_tm.rdrate, count);
+    return RES_OK;
+}
+
+#if _USE_WRITE == 1
+static DRESULT SDI_write (BYTE lun, const BYTE *buff, DWORD sector, UINT count)
+{
+    size_t size = (size_t)count * _MIN_SS;
+
+    if (!sd_image_ready(lun) || !sd_image_range_ok(sector, count) ||
+        pwrite(sd_image_fd, buff, size, (off_t)sector * _MIN_SS) != (ssize_t)size) {
+        sd_image_st.errors++;
+        return RES_ERROR;
+    }
+    sd_image_st.wrcmd++;
+    sd_image_st.wrsect += count;
+    sd_image_charge(sd_image_tm.wrlat, sd_image_tm.wrrate, count);
+    return RES_OK;
+}
+#endif /* _USE_WRITE == 1 */
+
+#if _USE_IOCTL == 1
+#if defined(CTRL_TRIM)
+/*Erased sectors read back as zeros*/
+static DRESULT SDI_trim (DWORD start, DWORD end)
+{
+    if (end < start || !sd_image_range_ok(start, end - start + 1)) {
+        return RES_PARERR;
+    }
+    if (fallocate(sd_image_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                  (off_t)start * _MIN_SS, (off_t)(end - start + 1) * _MIN_SS) < 0) {
+        return RES_ERROR;
+    }
+    return RES_OK;
+}
+#endif /*CTRL_TRIM*/
+
+static DRESULT SDI_ioctl (BYTE lun, BYTE cmd, void *buff)
+{
+    if (!sd_image_ready(lun)) {
+        return RES_NOTRDY;
+    }
+    switch (cmd) {
+        case CTRL_SYNC:
+            sd_image_st.syncs++;
+            return fdatasync(sd_image_fd) < 0 ? RES_ERROR : RES_OK;
+        case GET_SECTOR_COUNT:
+            *(DWORD *)buff = sd_image_sectors;
+            return RES_OK;
+        case GET_SECTOR_SIZE:
+            *(WORD *)buff = _MIN_SS;
+            return RES_OK;
+        case GET_BLOCK_SIZE:
+            *(DWORD *)buff = 1;
+            return RES_OK;
+#if defined(CTRL_TRIM)
+        case CTRL_TRIM:
+            return SDI_trim(((DWORD *)buff)[0], ((DWORD *)buff)[1]);
+#endif
+    }
+    return RES_PARERR;
+}
+#endif /* _USE_IOCTL == 1 */
+
+const Diskio_drvTypeDef SD_ImageDriver =
+{
+    SDI_initialize,
+    SDI_status,
+    SDI_read,
+#if  _USE_WRITE == 1
+    SDI_write,
+#endif /* _USE_WRITE == 1 */
+#if  _USE_IOCTL == 1
+    SDI_ioctl,
+#endif /* _USE_IOCTL == 1 */
+};
+
+#endif /*!BSP_DRIVER*/
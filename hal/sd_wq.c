@@ -0,0 +1,89 @@
+#include <sd_wq.h>
+#include <misc_utils.h>
+
+void sd_wq_init (sd_wq_t *wq, sd_wq_wr_t write, BYTE lun, uint32_t (*ms) (void))
+{
+    wq->write = write;
+    wq->ms = ms;
+    wq->lun = lun;
+    wq->count = 0;
+    d_memset(&wq->stat, 0, sizeof(wq->stat));
+}
+
+DRESULT sd_wq_flush (sd_wq_t *wq)
+{
+    DRESULT res;
+
+    if (!wq->count) {
+        return RES_OK;
+    }
+    wq->stat.flushes++;
+    res = wq->write(wq->lun, (const BYTE *)wq->buf, wq->sector, wq->count);
+    if (res == RES_OK) {
+        wq->count = 0;
+    } else {
+        /*keep the run, next age check is a full period away*/
+        wq->stat.errors++;
+        wq->tick = wq->ms();
+    }
+    return res;
+}
+
+DRESULT sd_wq_poll (sd_wq_t *wq)
+{
+    if (wq->count && wq->ms() - wq->tick >= SD_WQ_AGE) {
+        return sd_wq_flush(wq);
+    }
+    return RES_OK;
+}
+
+DRESULT sd_wq_read_sync (sd_wq_t *wq, DWORD sector, UINT count)
+{
+    if (wq->count && sector < wq->sector + wq->count && sector + count > wq->sector) {
+        return sd_wq_flush(wq);
+    }
+    return sd_wq_poll(wq);
+}
+
+void sd_wq_drop (sd_wq_t *wq)
+{
+    wq->count = 0;
+}
+
+DRESULT sd_wq_write (sd_wq_t *wq, const BYTE *buff, DWORD sector, UINT count)
+{
+    DRESULT res;
+    UINT end;
+
+    wq->stat.writes++;
+    /*continues or overwrites queued run*/
+    if (wq->count && sector >= wq->sector &&
+        sector <= wq->sector + wq->count &&
+        sector + count - wq->sector <= SD_WQ_SECTORS) {
+
+        d_memcpy((BYTE *)wq->buf + (sector - wq->sector) * _MIN_SS,
+                 buff, count * _MIN_SS);
+        wq->stat.queued++;
+        end = sector + count - wq->sector;
+        if (end > wq->count) {
+            wq->count = end;
+        }
+        if (wq->count == SD_WQ_SECTORS) {
+            return sd_wq_flush(wq);
+        }
+        return sd_wq_poll(wq);
+    }
+    res = sd_wq_flush(wq);
+    if (res != RES_OK) {
+        return res;
+    }
+    if (count > SD_WQ_MERGE_MAX) {
+        return wq->write(wq->lun, buff, sector, count);
+    }
+    d_memcpy(wq->buf, buff, count * _MIN_SS);
+    wq->sector = sector;
+    wq->count = count;
+    wq->tick = wq->ms();
+    wq->stat.queued++;
+    return RES_OK;
+}
@@ -5,6 +5,8 @@
 #include <nvic.h>
 #include <tim.h>
 #include <uart_int.h>
+#include <audio_mic.h>
+#include <qspi_dma.h>
 
 #include <misc_utils.h>
 
@@ -563,11 +565,17 @@ void HAL_UART_TxCpltCallback(UART_HandleTypeDef *UartHandle)
 
 void DMA2_Stream7_IRQHandler (void)
 {
+    if (a_mic_dma_irq(DMA2_Stream7)) {
+        return;
+    }
     dma_tx_handle_irq(DMA2_Stream7);
 }
 
 void DMA2_Stream2_IRQHandler (void)
 {
+    if (qspi_dma_irq(DMA2_Stream2)) {
+        return;
+    }
     dma_rx_handle_irq(DMA2_Stream2);
 }
 
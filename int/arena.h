@@ -0,0 +1,138 @@
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <stdint.h>
+
+/*
+ * Region / arena allocator for long-lived buffers (framebuffers,
+ * audio periods, codec and DMA buffers) kept away from the general heap.
+ * Region is a fixed window split into banks, arenas are carved from it
+ * once, at init, each one inside a single bank. So a framebuffer and a
+ * render target placed in different SDRAM banks don't share row buffers.
+ * Arena itself is a bump allocator : O(1) alloc, no free, whole arena
+ * reset (or rewind to a mark). Everything is ARENA_ALIGN aligned, so
+ * buffers never share a cache line and cache maintenance for DMA is safe.
+ * Not isr safe. Core has no hw dependencies.
+ */
+
+/*Cache line*/
+#define ARENA_ALIGN (32)
+#define ARENA_ALIGN_UP(x) (((x) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+#define ARENA_BANK_MAX (4)
+/*Bank with the most room*/
+#define ARENA_BANK_ANY (0xff)
+
+typedef struct arena_s {
+    struct arena_s *next;
+    const char *name;
+    uint8_t *base;
+    uint32_t size;
+    /*bump offset*/
+    uint32_t used;
+    uint32_t peak;
+    uint32_t allocs;
+    uint32_t fails;
+    uint8_t bank;
+} arena_t;
+
+typedef struct {
+    uint8_t *base;
+    uint32_t size;
+    uint32_t bank_size;
+    /*per bank, offsets from 'base'; end == top - bank not in region*/
+    uint32_t top[ARENA_BANK_MAX];
+    uint32_t end[ARENA_BANK_MAX];
+    /*in creation order*/
+    arena_t *list;
+} arena_region_t;
+
+/*
+ * Window [base, base + size) of a device starting at 'org', with banks
+ * of 'bank_size' bytes (0 - one bank). Bank numbers are device banks.
+ */
+int arena_region_init (arena_region_t *reg, void *base, uint32_t size,
+                           void *org, uint32_t bank_size);
+/*'name' is not copied; -1 - no room in the bank*/
+int arena_create (arena_region_t *reg, arena_t *a, const char *name,
+                     uint32_t size, uint8_t bank);
+/*Only the last arena of a bank gives its room back, -1 otherwise*/
+int arena_release (arena_region_t *reg, arena_t *a);
+arena_t *arena_find (arena_region_t *reg, const char *name);
+/*Bytes left in the bank*/
+uint32_t arena_region_room (arena_region_t *reg, uint8_t bank);
+void arena_region_dump (arena_region_t *reg);
+
+static inline void *
+arena_alloc (arena_t *a, uint32_t size)
+{
+    uint32_t need = ARENA_ALIGN_UP(size);
+    void *p;
+
+    if (!size || need < size || need > a->size - a->used) {
+        a->fails++;
+        return NULL;
+    }
+    p = a->base + a->used;
+    a->used += need;
+    if (a->used > a->peak) {
+        a->peak = a->used;
+    }
+    a->allocs++;
+    return p;
+}
+
+static inline uint32_t
+arena_mark (arena_t *a)
+{
+    return a->used;
+}
+
+/*Drops everything allocated after 'mark'*/
+static inline void
+arena_rewind (arena_t *a, uint32_t mark)
+{
+    if (mark < a->used) {
+        a->used = mark;
+    }
+}
+
+static inline void
+arena_reset (arena_t *a)
+{
+    a->used = 0;
+}
+
+static inline uint32_t
+arena_room (arena_t *a)
+{
+    return a->size - a->used;
+}
+
+#if defined(BSP_DRIVER)
+
+/*
+ * Window of the board SDRAM for arenas, the general heap must stay below.
+ * FMC maps internal bank bits above row and column, so each of the 4 banks
+ * is a contiguous quarter of the device; default window is banks 2 and 3.
+ */
+#ifndef SDRAM_ARENA_OFFSET
+#define SDRAM_ARENA_OFFSET (8 * 1024 * 1024)
+#endif
+#ifndef SDRAM_ARENA_SIZE
+#define SDRAM_ARENA_SIZE (8 * 1024 * 1024)
+#endif
+/*SDRAM offset the general heap ends at, must match the board heap setup*/
+#ifndef SDRAM_HEAP_LIMIT
+#define SDRAM_HEAP_LIMIT SDRAM_ARENA_OFFSET
+#endif
+#if SDRAM_HEAP_LIMIT > SDRAM_ARENA_OFFSET
+#error "general heap overlaps the sdram arena window"
+#endif
+
+arena_region_t *sdram_region (void);
+/*Region is set up on first use*/
+int sdram_arena_create (arena_t *a, const char *name, uint32_t size, uint8_t bank);
+
+#endif /*BSP_DRIVER*/
+
+#endif /*__ARENA_H__*/
@@ -0,0 +1,56 @@
+#ifndef __AUDIO_ADPCM_H__
+#define __AUDIO_ADPCM_H__
+
+#include <stdint.h>
+
+/*
+ * IMA-ADPCM 4:1 sample storage.
+ * Data is split into fixed size blocks, each starts with a header per channel
+ * (first sample + step index), so any block decodes on its own : seek/loop
+ * cost is at most one block. Stereo : one byte per frame (L - low nibble),
+ * mono : two frames per byte (first - low nibble).
+ * a_adpcm_mix() decodes straight into the mixer int32 accumulator.
+ */
+
+#define A_ADPCM_MAGIC (0x34414d49) /*"IMA4"*/
+#define A_ADPCM_BLOCK (512)
+#define A_ADPCM_HDR_SIZE(chans) (4 * (chans))
+#define A_ADPCM_BLOCK_FRAMES(chans) \
+    (1 + (A_ADPCM_BLOCK - A_ADPCM_HDR_SIZE(chans)) * 2 / (chans))
+#define A_ADPCM_NOLOOP (0xffffffffU)
+
+/*File/asset header, little endian, blocks follow*/
+typedef struct {
+    uint32_t magic;
+    uint32_t samplerate;
+    uint32_t frames;
+    uint32_t loopstart;
+    uint16_t chans;
+    uint16_t blocksize;
+} a_adpcm_hdr_t;
+
+typedef struct {
+    const uint8_t *data;
+    uint32_t frames;
+    uint32_t loopstart;
+    uint32_t pos;
+    /*position inside current block, 0 - header frame*/
+    uint32_t bpos;
+    const uint8_t *p;
+    int32_t pred[2];
+    int8_t index[2];
+    uint8_t chans;
+} a_adpcm_t;
+
+int a_adpcm_init (a_adpcm_t *st, const void *asset);
+void a_adpcm_seek (a_adpcm_t *st, uint32_t frame);
+/*Adds up to 'frames' stereo frames into 'acc', returns frames mixed*/
+int a_adpcm_mix (a_adpcm_t *st, int32_t *acc, int16_t left, int16_t right, int frames);
+int a_adpcm_done (a_adpcm_t *st);
+
+/*Encoder, returns bytes written to 'out' (header included)*/
+uint32_t a_adpcm_encoded_size (uint32_t frames, int chans);
+uint32_t a_adpcm_encode (const int16_t *pcm, uint32_t frames, int chans,
+                            uint32_t samplerate, uint32_t loopstart, void *out);
+
+#endif /*__AUDIO_ADPCM_H__*/
@@ -0,0 +1,45 @@
+#ifndef __AUDIO_DSP_H__
+#define __AUDIO_DSP_H__
+
+#include <stdint.h>
+
+/*
+ * Q15/Q31 block primitives with CMSIS-DSP semantics.
+ * Target (ARM_MATH_CM7) - calls into CMSIS-DSP (libarm_cortexM7lfsp_math.a),
+ * otherwise portable C, bit exact with the CMSIS reference, for host tools.
+ * Biquad is Q31 direct form I (Q15 one is too coarse for low frequency
+ * poles at 48 kHz), coefficients per stage : {b0, b1, b2, a1, a2},
+ * feedback sign is CMSIS one : y = b0*x + b1*x1 + b2*x2 + a1*y1 + a2*y2.
+ * 64 bit accumulator wraps, input must leave headroom for the gain.
+ */
+
+#if defined(ARM_MATH_CM7)
+#include <arm_math.h>
+#define A_DSP_CMSIS 1
+#define A_DSP_ARCH "cmsis"
+typedef arm_biquad_casd_df1_inst_q31 a_dsp_biquad_t;
+#else
+#define A_DSP_ARCH "c"
+typedef struct {
+    uint32_t numStages;
+    int32_t *pState;
+    int32_t *pCoeffs;
+    uint8_t postShift;
+} a_dsp_biquad_t;
+#endif
+
+#define A_DSP_BQ_COEFS (5)
+#define A_DSP_BQ_STATE (4)
+
+void a_dsp_biquad_init (a_dsp_biquad_t *bq, int stages, int32_t *coefs,
+                            int32_t *state, int postshift);
+void a_dsp_biquad (const a_dsp_biquad_t *bq, int32_t *src, int32_t *dst, int samples);
+/*dst = sat((src * frac) >> (15 - shift))*/
+void a_dsp_scale (int16_t *src, int16_t frac, int shift, int16_t *dst, int samples);
+void a_dsp_add (int16_t *a, int16_t *b, int16_t *dst, int samples);
+void a_dsp_offset (int16_t *src, int16_t offset, int16_t *dst, int samples);
+int16_t a_dsp_mean (int16_t *src, int samples);
+/*Gain in dB -> Q15 fraction + left shift, for a_dsp_scale()*/
+void a_dsp_db2gain (float db, int16_t *frac, int8_t *shift);
+
+#endif /*__AUDIO_DSP_H__*/
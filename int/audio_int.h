@@ -4,6 +4,16 @@
 #include "config.h"
 #include "misc_utils.h"
 #include <audio_main.h>
+#include <audio_ring.h>
+#include <audio_mix.h>
+#include <audio_rev.h>
+#include <audio_stream.h>
+#include <audio_adpcm.h>
+#include <audio_voice.h>
+#include <audio_sink.h>
+#include <audio_period.h>
+#include <audio_tel.h>
+#include <audio_post.h>
 
 #ifndef AUDIO_RATE_DEFAULT
 #define AUDIO_RATE_DEFAULT 22050U
@@ -23,8 +33,13 @@
 #define REVERB_DECAY 128
 #define REVERB_LIFE_TIME 1000
 
+#ifndef USE_STEREO
 #define USE_STEREO 0
+#endif
+/*Send bus of audio_rev.h, set up on a_hal_configure*/
+#ifndef USE_REVERB
 #define USE_REVERB 0
+#endif
 #define COMPRESSION 1
 #define USE_FLOAT 1
 
@@ -63,9 +78,15 @@ struct a_channel_s {
     uint8_t volume;
 #if USE_STEREO
     uint8_t left, right;
+    /*gains from volume and pan, see a_mix_pan_gains*/
+    a_mix_ramp_t ramp;
 #endif
     uint8_t effect;
     uint8_t priority;
+    /*!= NULL - data is streamed, not precached*/
+    a_stream_t *stream;
+    /*!= NULL - chunk data is IMA-ADPCM, decoded while mixing*/
+    a_adpcm_t *adpcm;
 };
 
 struct a_channel_head_s {
@@ -90,6 +111,12 @@ typedef struct {
     uint32_t channels;
     uint32_t samplebits;
     irqmask_t irq;
+    /*A_SINK_SAI - codec, others - offline render, see a_sink_render*/
+    a_sink_e sink;
+    const char *path;
+    /*frames per period, 0 - fixed AUDIO_OUT_BUFFER_SIZE master, see a_period_preset*/
+    uint32_t periodsize;
+    uint32_t periods;
 } a_intcfg_t;
 
 #define a_chunk_len(chan) \
@@ -113,6 +140,14 @@ typedef struct {
 #define a_chn_loopstart(chan) \
     (chan)->inst.chunk.loopstart
 
+/*Effects send of a channel, per voice and period, before a_mix_voices()*/
+#if USE_REVERB
+#define a_chn_send(chan, src, chans, frames) \
+    a_rev_voice(src, chans, (chan)->effect, frames)
+#else
+#define a_chn_send(chan, src, chans, frames)
+#endif
+
 #define a_chan_foreach_safe(head, channel, next) \
 for (channel = (head)->first,\
      next = channel->next;   \
@@ -120,7 +155,35 @@ for (channel = (head)->first,\
      channel = next,         \
      next = next->next)
 
+/*Voices of the mixer : channels are allocated and stolen here*/
+extern a_voice_pool_t g_audio_voices;
+
 void a_hal_configure (a_intcfg_t *cfg);
+void a_hal_check_cfg (a_intcfg_t *cfg);
+void a_hal_shutdown (void);
+void a_hal_deinit (void);
+int a_sink_configure (const a_intcfg_t *cfg);
+
+/*Deferred mixing : depth - periods mixed ahead, power of 2*/
+int a_hal_ring_init (int depth);
+void a_hal_ring_deinit (void);
+int a_hal_ring_mix (void);
+void a_hal_ring_stat (a_ring_stat_t *stat);
+void a_hal_ring_stat_reset (void);
+
+/*
+ * Runtime period change, audio keeps running on the new buffer.
+ * Ring mode (a_hal_ring_init) is kept with the depth from 'periods',
+ * otherwise the isr keeps painting and no ring is allocated.
+ */
+int a_hal_set_period (a_intcfg_t *cfg, uint32_t frames, uint32_t periods);
+int a_hal_set_latency (a_intcfg_t *cfg, a_latency_e preset);
+void a_hal_period_info (a_period_t *period);
+
+/*Telemetry pull api, see audio_tel.h*/
+void a_hal_tel (a_tel_t *tel);
+void a_hal_tel_reset (void);
+void a_hal_tel_dump (void);
 
 void a_dsr_hung_fuse (isr_status_e status);
 void a_paint_buff_helper (a_buf_t *abuf);
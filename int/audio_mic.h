@@ -0,0 +1,102 @@
+#ifndef __AUDIO_MIC_H__
+#define __AUDIO_MIC_H__
+
+#include <stdint.h>
+#include <audio_ring.h>
+#include <audio_dsp.h>
+
+/*
+ * Digital microphone capture : DFSDM (BSP_AUDIO_IN_Record) -> per channel
+ * DC removal and gain -> delay-and-sum beam -> ring of mono PCM periods.
+ * Producer - BSP record half/complete callback (isr), consumer - any thread.
+ * Processing core (a_mic_process) has no hw dependencies.
+ */
+
+/*Interleave order of BSP record buffer*/
+typedef enum {
+    A_MIC_TOP_LEFT,
+    A_MIC_TOP_RIGHT,
+    A_MIC_BOTTOM_LEFT,
+    A_MIC_BOTTOM_RIGHT,
+    A_MIC_MAX,
+} a_mic_pos_e;
+
+/*Mic pitch on the board, um*/
+#ifndef A_MIC_PITCH_X_UM
+#define A_MIC_PITCH_X_UM (21000)
+#endif
+#ifndef A_MIC_PITCH_Y_UM
+#define A_MIC_PITCH_Y_UM (21000)
+#endif
+
+/*Steering delay is Q8 samples, history must cover the diagonal*/
+#define A_MIC_DELAY_FRAC (8)
+#define A_MIC_HIST (8)
+#define A_MIC_PERIOD_MAX (1024)
+/*DC estimate time constant, 2^n periods*/
+#define A_MIC_DC_SHIFT (4)
+/*Beam direction : azimuth in degrees, 0 - right, 90 - top of the board*/
+#define A_MIC_STEER_BROADSIDE (-1)
+
+typedef struct {
+    uint32_t periods;
+    uint32_t overruns;
+    uint32_t errors;
+    int16_t peak;
+    int16_t dc[A_MIC_MAX];
+} a_mic_stat_t;
+
+typedef struct {
+    uint32_t samplerate;
+    uint16_t chans;
+    uint16_t period;
+    int16_t gainfrac;
+    int8_t gainshift;
+    int steer;
+    /*Q8 samples*/
+    uint16_t delay[A_MIC_MAX];
+    /*Q16*/
+    int32_t dc[A_MIC_MAX];
+    int16_t line[A_MIC_MAX][A_MIC_HIST + A_MIC_PERIOD_MAX];
+    int16_t tmp[A_MIC_PERIOD_MAX];
+    a_ring_t ring;
+    a_mic_stat_t stat;
+} a_mic_t;
+
+/*chans : 2 (top pair) or 4, period in frames*/
+int a_mic_init (a_mic_t *mic, uint32_t samplerate, int chans, int period,
+                  void *ringmem, int depth);
+void a_mic_gain (a_mic_t *mic, float db);
+void a_mic_steer (a_mic_t *mic, int azimuth);
+/*in : 'period' interleaved frames, 'chans' samples each*/
+int a_mic_process (a_mic_t *mic, const int16_t *in);
+
+/*Consumer : oldest period (mono, 'period' samples) or NULL*/
+static inline int16_t *
+a_mic_rd_block (a_mic_t *mic)
+{
+    return (int16_t *)a_ring_rd_block(&mic->ring);
+}
+
+static inline void
+a_mic_rd_commit (a_mic_t *mic)
+{
+    a_ring_rd_commit(&mic->ring);
+}
+
+#if defined(BSP_DRIVER)
+/*
+ * < 0 - also when a dma stream of the mics is set up by another driver.
+ * The bottom pair needs DMA2 stream 6 (and 7) : stream 6 is SAI playback,
+ * so 4 mic capture can't start while audio out is running, and stream 7
+ * is uart tx with SERIAL_TTY_HAS_DMA. With playback use 2 mics, the top
+ * pair (streams 4 and 1).
+ */
+int a_mic_start (uint32_t samplerate, int chans, int period, int depth);
+void a_mic_stop (void);
+a_mic_t *a_mic_get (void);
+/*Shared DMA2 stream isr hook, !0 - stream belongs to capture*/
+int a_mic_dma_irq (void *stream);
+#endif
+
+#endif /*__AUDIO_MIC_H__*/
@@ -0,0 +1,87 @@
+#ifndef __AUDIO_MIX_H__
+#define __AUDIO_MIX_H__
+
+#include <stdint.h>
+
+/*
+ * Voice mixing kernels, 16 bit interleaved stereo in, int32 accumulator.
+ * Voices are mixed in pairs : acc += (s0 * g0 + s1 * g1) >> 15,
+ * an odd voice is mixed alone : acc += (s * g) >> 15.
+ * Cortex-M7 (SMLAD/QADD16/SSAT), SSE2 and scalar paths give identical result,
+ * a_mix_voices_ref() is the scalar reference.
+ * 'samples' - number of int16 values (2 per stereo frame), must be even.
+ */
+
+/*Q15 gain, non negative*/
+#define A_MIX_GAIN_ONE (0x7fff)
+#define A_MIX_VOL2GAIN(vol) ((int16_t)(((uint32_t)(vol) * A_MIX_GAIN_ONE) / MAX_VOL))
+
+#if (defined(__ARM_FEATURE_DSP) && __ARM_FEATURE_DSP) || defined(__TARGET_FEATURE_DSPMUL)
+#define A_MIX_ARCH "dsp"
+#elif defined(__SSE2__)
+#define A_MIX_ARCH "sse2"
+#else
+#define A_MIX_ARCH "c"
+#endif
+
+void a_mix_clear (int32_t *acc, int samples);
+void a_mix_voice (int32_t *acc, const int16_t *src, int16_t gain, int samples);
+void a_mix_voice_lr (int32_t *acc, const int16_t *src, int16_t left, int16_t right, int samples);
+void a_mix_voice2 (int32_t *acc, const int16_t *src0, int16_t gain0,
+                    const int16_t *src1, int16_t gain1, int samples);
+/*Saturate accumulator into output*/
+void a_mix_resolve (int16_t *dst, const int32_t *acc, int samples);
+/*Accumulator -> output step of a_mix_voices(), NULL - a_mix_resolve()*/
+typedef void (*a_mix_resolve_t) (int16_t *dst, const int32_t *acc, int samples);
+void a_mix_set_resolve (a_mix_resolve_t resolve);
+/*Effects return, added to the accumulator before resolve, NULL - none*/
+typedef void (*a_mix_bus_t) (int32_t *acc, int samples);
+void a_mix_set_bus (a_mix_bus_t bus);
+/*
+ * Voice count for telemetry : every kernel adds the voice samples it mixed,
+ * a_mix_voices_taken() returns them in voices of 'samples' (one period,
+ * a voice cut short counts as one) and restarts the count.
+ * Decoders mixing on their own (a_adpcm_mix) add with a_mix_count().
+ */
+void a_mix_count (int samples);
+uint32_t a_mix_voices_taken (int samples);
+/*Unity gain : dst = sat(dst + src)*/
+void a_mix_add_sat (int16_t *dst, const int16_t *src, int samples);
+
+/*
+ * Pan and volume with per frame linear ramp, gains are Q15.
+ * Current gain is kept in Q31 so ramp step keeps sub-lsb precision.
+ * After 'len' frames the target is reached exactly, no clicks on change.
+ */
+typedef enum {
+    A_PAN_LINEAR,
+    /*-3 dB at center, sin/cos*/
+    A_PAN_CONST_POWER,
+} a_pan_law_e;
+
+#define A_PAN_CENTER (128)
+#define A_MIX_RAMP_DEFAULT (64)
+
+typedef struct {
+    int32_t cur[2];
+    int32_t step[2];
+    int16_t target[2];
+    uint16_t left;
+} a_mix_ramp_t;
+
+void a_mix_pan_law (a_pan_law_e law);
+void a_mix_ramp_len (int frames);
+/*pan : 0 - left, A_PAN_CENTER, 255 - right*/
+void a_mix_pan_gains (uint8_t pan, int16_t gain, int16_t *left, int16_t *right);
+void a_mix_ramp_init (a_mix_ramp_t *ramp, int16_t left, int16_t right);
+void a_mix_ramp_set (a_mix_ramp_t *ramp, int16_t left, int16_t right);
+/*chans : 1 - mono source spread to both sides, 2 - interleaved stereo*/
+void a_mix_voice_ramp (int32_t *acc, const int16_t *src, int chans,
+                    a_mix_ramp_t *ramp, int frames);
+
+void a_mix_voices (int16_t *dst, int32_t *acc, const int16_t **src,
+                    const int16_t *gain, int cnt, int samples);
+void a_mix_voices_ref (int16_t *dst, int32_t *acc, const int16_t **src,
+                    const int16_t *gain, int cnt, int samples);
+
+#endif /*__AUDIO_MIX_H__*/
@@ -0,0 +1,91 @@
+#ifndef __AUDIO_PERIOD_H__
+#define __AUDIO_PERIOD_H__
+
+#include <stdint.h>
+
+/*
+ * Output period arithmetic. DMA buffer holds 2 periods (half/complete),
+ * periods above 2 are mixed ahead into the period ring (power of 2 depth),
+ * so worst case latency is (ring depth + 1) periods.
+ */
+
+typedef enum {
+    A_LATENCY_DEFAULT,
+    A_LATENCY_LOW,
+    A_LATENCY_BALANCED,
+    A_LATENCY_POWERSAVE,
+    A_LATENCY_MAX,
+} a_latency_e;
+
+/*frames : multiple of cache line (8 stereo 16 bit frames)*/
+#define A_PERIOD_ALIGN (8)
+#define A_PERIOD_MIN (64)
+/*2 periods of 16 bit samples must fit into one DMA transfer*/
+#define A_PERIOD_DMA_MAX (0xffff)
+#define A_PERIODS_MIN (3)
+#define A_PERIODS_MAX (2 + 8)
+
+typedef struct {
+    uint32_t frames;
+    uint32_t samples;
+    uint32_t bytes;
+    /*whole DMA buffer, bytes*/
+    uint32_t dmasize;
+    int ringdepth;
+    /*one period of audio = mixing budget*/
+    uint32_t period_us;
+    uint32_t latency_us;
+} a_period_t;
+
+static inline void
+a_period_preset (a_latency_e preset, uint32_t *frames, uint32_t *periods)
+{
+    switch (preset) {
+        case A_LATENCY_LOW:
+            *frames = 128;
+            *periods = 3;
+        break;
+        case A_LATENCY_BALANCED:
+            *frames = 512;
+            *periods = 4;
+        break;
+        case A_LATENCY_POWERSAVE:
+            *frames = 2048;
+            *periods = 4;
+        break;
+        default:
+            *frames = 0;
+            *periods = 0;
+        break;
+    }
+}
+
+static inline int
+a_period_calc (uint32_t rate, uint32_t chans, uint32_t samplebits,
+                uint32_t frames, uint32_t periods, a_period_t *p)
+{
+    int depth = 1;
+
+    if (!rate || !chans || chans > 2 || samplebits != 16 ||
+        frames < A_PERIOD_MIN || (frames % A_PERIOD_ALIGN) ||
+        periods < A_PERIODS_MIN || periods > A_PERIODS_MAX) {
+        return -1;
+    }
+    if (frames > A_PERIOD_DMA_MAX / (chans * 2)) {
+        return -1;
+    }
+    /*Round ring up to power of 2*/
+    while (depth < (int)(periods - 2)) {
+        depth <<= 1;
+    }
+    p->frames = frames;
+    p->samples = frames * chans;
+    p->bytes = p->samples * (samplebits / 8);
+    p->dmasize = p->bytes * 2;
+    p->ringdepth = depth;
+    p->period_us = (uint32_t)(((uint64_t)frames * 1000000U) / rate);
+    p->latency_us = p->period_us * (depth + 1);
+    return 0;
+}
+
+#endif /*__AUDIO_PERIOD_H__*/
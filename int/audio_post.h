@@ -0,0 +1,113 @@
+#ifndef __AUDIO_POST_H__
+#define __AUDIO_POST_H__
+
+#include <stdint.h>
+#include <audio_dsp.h>
+
+/*
+ * Post mix stage for 16 bit interleaved stereo : parametric EQ
+ * (Q31 biquad cascade) followed by a look-ahead peak limiter.
+ * One profile per output device, coefficients are computed in thread
+ * context and handed to the audio side through an atomic triple buffer,
+ * so the chain may run in the isr or in thread context (period ring).
+ * One publishing thread.
+ * Samples enter the cascade A_POST_HEADROOM bits below Q31 full scale,
+ * so EQ boost and mixer overs pass it unclipped, and the limiter
+ * brings the (wide) result back under the threshold.
+ * a_post_init() hooks a_post_resolve() into a_mix_voices(), so the chain
+ * takes the mixer accumulator before anything is clipped, in whichever
+ * context (isr, ring, dsr) the mixer runs.
+ */
+
+typedef enum {
+    A_POST_SPEAKER,
+    A_POST_HEADPHONE,
+    A_POST_DEV_MAX,
+} a_post_dev_e;
+
+typedef enum {
+    A_EQ_PEAK,
+    A_EQ_LOWSHELF,
+    A_EQ_HIGHSHELF,
+    A_EQ_LOWPASS,
+    A_EQ_HIGHPASS,
+} a_eq_type_e;
+
+#define A_POST_BANDS_MAX (5)
+/*Look-ahead, frames*/
+#define A_POST_LOOK_MAX (64)
+/*Frames per processing chunk*/
+#define A_POST_BLOCK (128)
+/*int16 full scale in Q31 chain, bits below*/
+#define A_POST_HEADROOM (4)
+/*Sum of band boosts, dB*/
+#define A_POST_BOOST_MAX (18.0f)
+
+typedef struct {
+    a_eq_type_e type;
+    /*Hz*/
+    float freq;
+    /*dB, shelf/peak only*/
+    float gain;
+    float q;
+} a_eq_band_t;
+
+typedef struct {
+    uint8_t enable;
+    /*dBFS, <= 0*/
+    float threshold;
+    /*ms*/
+    float lookahead;
+    float release;
+} a_lim_param_t;
+
+typedef struct {
+    a_eq_band_t band[A_POST_BANDS_MAX];
+    int bands;
+    a_lim_param_t lim;
+} a_post_profile_t;
+
+/*Computed chain, read only for audio side*/
+typedef struct {
+    int32_t coefs[A_POST_BANDS_MAX * A_DSP_BQ_COEFS];
+    uint8_t stages;
+    uint8_t postshift;
+    uint8_t look;
+    /*mixer accumulator clamp, keeps boosted cascade in Q31 range*/
+    int32_t accmax;
+    int32_t threshold;
+    /*Q15 per frame*/
+    int32_t release;
+    /*Q16, floor (1 / look)*/
+    uint32_t lookinv;
+    uint8_t limit;
+} a_post_cfg_t;
+
+typedef struct {
+    uint32_t frames;
+    /*frames with gain reduction*/
+    uint32_t limited;
+    /*Q15*/
+    int32_t mingain;
+} a_post_stat_t;
+
+/*Recomputes active profile for new rate*/
+void a_post_init (uint32_t samplerate);
+/*Thread context, < 0 - invalid parameters*/
+int a_post_profile (a_post_dev_e dev, const a_post_profile_t *profile);
+void a_post_profile_get (a_post_dev_e dev, a_post_profile_t *profile);
+int a_post_device (a_post_dev_e dev);
+void a_post_bypass (int bypass);
+/*
+ * Audio side : in place on resolved samples, for output painted without
+ * a_mix_voices(); no-op when the period already went through a_post_resolve()
+ */
+void a_post_process (int16_t *buf, int samples);
+/*Audio side : mixer accumulator -> output, replaces a_mix_resolve()*/
+void a_post_resolve (int16_t *dst, const int32_t *acc, int samples);
+void a_post_stat (a_post_stat_t *stat);
+void a_post_stat_reset (void);
+/*Computed magnitude of active EQ at 'freq', dB*/
+float a_post_response (float freq);
+
+#endif /*__AUDIO_POST_H__*/
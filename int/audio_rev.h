@@ -0,0 +1,62 @@
+#ifndef __AUDIO_REV_H__
+#define __AUDIO_REV_H__
+
+#include <stdint.h>
+
+/*
+ * Effects send bus : Freeverb style network in Q15,
+ * 4 parallel damped combs + 2 serial all-pass per side.
+ * Voices with non zero 'effect' are summed (mono) into the send buffer,
+ * a_rev_process() adds the wet stereo result to the mix accumulator.
+ * Delay lines are power of 2 rings, placed into DTCM on target.
+ *
+ * Mixer wiring : the paint loop sends each voice of the period with
+ * a_rev_voice() (a_chn_send() of audio_int.h, by a_channel_t.effect),
+ * a_rev_init() hooks a_rev_return() into a_mix_voices(), which runs the
+ * network over the bus before the accumulator is resolved. With nothing
+ * sent the network runs until its tail is down to zero, then stops.
+ */
+
+#ifndef A_DTCM
+#if defined(BSP_DRIVER) && defined(__GNUC__)
+#define A_DTCM __attribute__((section(".dtcm")))
+#else
+#define A_DTCM
+#endif
+#endif
+
+#define A_REV_COMBS (4)
+#define A_REV_ALLPASS (2)
+/*Ring sizes for rates up to 48 kHz*/
+#define A_REV_COMB_LOG2 (11)
+#define A_REV_ALLPASS_LOG2 (10)
+
+/*'effect' of a_channel_t -> Q15 send gain*/
+#define A_REV_SEND_GAIN(effect) ((int16_t)((effect) * 0x7fff / 255))
+/*Send bus, frames : longest period (A_LATENCY_POWERSAVE)*/
+#define A_REV_BUS_FRAMES (2048)
+
+typedef struct {
+    /*Q15*/
+    int16_t feedback;
+    int16_t damp;
+    int16_t wet;
+    int16_t width;
+} a_rev_param_t;
+
+int a_rev_setup (uint32_t rate, const a_rev_param_t *param);
+void a_rev_param (const a_rev_param_t *param);
+void a_rev_param_default (a_rev_param_t *param, uint8_t decay);
+void a_rev_clear (void);
+/*Adds voice into mono send bus, 'send' holds 'frames' values*/
+void a_rev_send (int32_t *send, const int16_t *src, int16_t gain, int frames);
+/*Runs network over 'send', adds stereo result into 'acc'*/
+void a_rev_process (const int32_t *send, int32_t *acc, int frames);
+/*Mixer bus : voice of 'chans' (1, 2) into the period send bus, by 'effect' 0..255*/
+void a_rev_voice (const int16_t *src, int chans, uint8_t effect, int frames);
+/*Mixer bus : runs the network over the bus into 'acc', see a_mix_set_bus()*/
+void a_rev_return (int32_t *acc, int samples);
+/*Frames of silence until the tail is gone, 0 - network idle*/
+uint32_t a_rev_tail (void);
+
+#endif /*__AUDIO_REV_H__*/
@@ -0,0 +1,133 @@
+#ifndef __AUDIO_RING_H__
+#define __AUDIO_RING_H__
+
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Single producer/single consumer ring of fixed size blocks.
+ * Producer - mixer (thread context), consumer - audio DMA isr.
+ * Lock free : 'wr' is written only by producer, 'rd' only by consumer.
+ */
+
+#if defined(__CORTEX_M)
+#define A_RING_BARRIER() __DMB()
+#else
+#define A_RING_BARRIER() __sync_synchronize()
+#endif
+
+#define A_RING_DEPTH_MAX (1 << 3)
+
+typedef struct {
+    uint32_t produced;
+    uint32_t consumed;
+    uint32_t underruns;
+    /*ready periods at the moment of dma request*/
+    int lead;
+    int minlead;
+    int depth;
+} a_ring_stat_t;
+
+typedef struct {
+    uint8_t *mem;
+    uint32_t blksize;
+    uint16_t depth; /*power of 2*/
+    volatile uint16_t wr;
+    volatile uint16_t rd;
+} a_ring_t;
+
+static inline void
+a_ring_init (a_ring_t *ring, void *mem, uint32_t blksize, uint16_t depth)
+{
+    ring->mem = (uint8_t *)mem;
+    ring->blksize = blksize;
+    ring->depth = depth;
+    ring->wr = 0;
+    ring->rd = 0;
+}
+
+static inline int
+a_ring_fill (const a_ring_t *ring)
+{
+    return (uint16_t)(ring->wr - ring->rd);
+}
+
+static inline int
+a_ring_space (const a_ring_t *ring)
+{
+    return ring->depth - a_ring_fill(ring);
+}
+
+/*Producer : get block to write, NULL if full*/
+static inline void *
+a_ring_wr_block (a_ring_t *ring)
+{
+    if (!a_ring_space(ring)) {
+        return NULL;
+    }
+    return ring->mem + (ring->wr & (ring->depth - 1)) * ring->blksize;
+}
+
+/*Producer : publish block, obtained with a_ring_wr_block*/
+static inline void
+a_ring_wr_commit (a_ring_t *ring)
+{
+    /*block data must be visible before the index*/
+    A_RING_BARRIER();
+    ring->wr = ring->wr + 1;
+}
+
+/*Consumer : get oldest block, NULL if empty*/
+static inline void *
+a_ring_rd_block (a_ring_t *ring)
+{
+    if (!a_ring_fill(ring)) {
+        return NULL;
+    }
+    A_RING_BARRIER();
+    return ring->mem + (ring->rd & (ring->depth - 1)) * ring->blksize;
+}
+
+/*Consumer : release block, obtained with a_ring_rd_block*/
+static inline void
+a_ring_rd_commit (a_ring_t *ring)
+{
+    A_RING_BARRIER();
+    ring->rd = ring->rd + 1;
+}
+
+static inline void
+a_ring_stat_reset (const a_ring_t *ring, a_ring_stat_t *stat)
+{
+    memset(stat, 0, sizeof(*stat));
+    stat->minlead = ring->depth;
+    stat->depth = ring->depth;
+}
+
+/*
+ * Consumer, once per dma period : moves the oldest block to 'dst',
+ * or silence if the producer is late (underrun).
+ * Returns 0 if a block was taken, -1 on underrun.
+ */
+static inline int
+a_ring_play (a_ring_t *ring, a_ring_stat_t *stat, void *dst)
+{
+    int lead = a_ring_fill(ring);
+    void *block = a_ring_rd_block(ring);
+
+    stat->lead = lead;
+    if (lead < stat->minlead) {
+        stat->minlead = lead;
+    }
+    if (!block) {
+        memset(dst, 0, ring->blksize);
+        stat->underruns++;
+        return -1;
+    }
+    memcpy(dst, block, ring->blksize);
+    a_ring_rd_commit(ring);
+    stat->consumed++;
+    return 0;
+}
+
+#endif /*__AUDIO_RING_H__*/
@@ -0,0 +1,47 @@
+#ifndef __AUDIO_SINK_H__
+#define __AUDIO_SINK_H__
+
+#include <stdint.h>
+
+/*
+ * Offline audio sinks : master buffer periods are painted in a loop
+ * (no SAI/DMA) and optionally written into a wav file.
+ * Used for golden file tests and reproducible mixer benchmarks.
+ */
+
+typedef enum {
+    A_SINK_SAI,
+    A_SINK_NULL,
+    A_SINK_FILE,
+} a_sink_e;
+
+typedef struct {
+    /*>= 0 - bytes written*/
+    int (*write) (void *ctx, const void *buf, uint32_t size);
+    int (*seek) (void *ctx, uint32_t offset);
+    void (*close) (void *ctx);
+    void *ctx;
+} a_sink_ops_t;
+
+typedef struct {
+    uint32_t periods;
+    uint32_t samples;
+    uint32_t bytes;
+    /*mixing time, us*/
+    uint32_t total;
+    uint32_t max;
+    uint32_t min;
+    uint32_t errors;
+    /*one period of audio, us*/
+    uint32_t budget;
+} a_sink_stat_t;
+
+/*a_sink_configure() - see audio_int.h*/
+/*Paints 'periods' half buffers as fast as possible*/
+int a_sink_render (int periods);
+void a_sink_close (void);
+void a_sink_clock (uint32_t (*us) (void));
+void a_sink_stat (a_sink_stat_t *stat);
+void a_sink_stat_dump (void);
+
+#endif /*__AUDIO_SINK_H__*/
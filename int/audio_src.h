@@ -0,0 +1,62 @@
+#ifndef __AUDIO_SRC_H__
+#define __AUDIO_SRC_H__
+
+#include <stdint.h>
+
+/*
+ * Per voice sample rate conversion, fused into mixing :
+ * output frames are accumulated into the mixer int32 buffer (see audio_mix.h).
+ * Position is kept in frames + Q16 fraction, pitch scales the step and,
+ * when pitching up, lowers the filter cutoff along with it.
+ * A_SRC_POLY - 8 tap, 64 phase windowed sinc, A_SRC_LINEAR - cheap mode.
+ * Input may come in blocks : last frames of a block are kept as filter
+ * history, so block edges are not zero padded.
+ */
+
+#define A_SRC_TAPS (8)
+#define A_SRC_PHASES_LOG2 (6)
+#define A_SRC_PHASES (1 << A_SRC_PHASES_LOG2)
+#define A_SRC_FRAC_BITS (16)
+#define A_SRC_ONE (1 << A_SRC_FRAC_BITS)
+/*Max step incl. pitch, 8.0*/
+#define A_SRC_STEP_MAX (A_SRC_ONE * 8)
+/*Shared coefficient tables, one per cutoff, see a_src_pitch*/
+#define A_SRC_TBL_MAX (8)
+
+typedef enum {
+    A_SRC_LINEAR,
+    A_SRC_POLY,
+} a_src_mode_e;
+
+typedef struct {
+    const int16_t *coef;
+    uint32_t step;
+    uint32_t basestep;
+    /*frame of the current block, < 0 - in history*/
+    int32_t pos;
+    uint32_t frac;
+    /*last frames of the previous block, L/R*/
+    int16_t hist[A_SRC_TAPS][2];
+    uint8_t chans;
+    uint8_t mode;
+} a_src_t;
+
+int a_src_init (a_src_t *src, uint32_t inrate, uint32_t outrate,
+                    int chans, a_src_mode_e mode);
+/*Q16 : A_SRC_ONE - no pitch shift*/
+void a_src_pitch (a_src_t *src, uint32_t pitch);
+/*History is kept : seek to the loop start stays continuous*/
+void a_src_seek (a_src_t *src, uint32_t frame);
+int a_src_rate_supported (uint32_t inrate, uint32_t outrate);
+/*
+ * Mix up to 'outframes' stereo frames into 'acc', reading 'in' of 'inframes'.
+ * Returns frames produced. Less than 'outframes' - block is over : its tail
+ * is taken into history, position is moved to the next block, which
+ * is expected in the next call. Frames whose filter taps reach past
+ * the block end are left for the next block; in == NULL - end of input,
+ * mixes these frames out with zeros past the end.
+ */
+int a_src_mix (a_src_t *src, int32_t *acc, int16_t gain,
+                    const int16_t *in, int inframes, int outframes);
+
+#endif /*__AUDIO_SRC_H__*/
@@ -0,0 +1,89 @@
+#ifndef __AUDIO_STREAM_H__
+#define __AUDIO_STREAM_H__
+
+#include <stdint.h>
+
+/*
+ * Streamed voice : 16 bit stereo wav is read into a byte ring ahead of
+ * the mixer read pointer. a_stream_fill() runs from background context
+ * (single producer), the mixer consumes with a_stream_mix() (single consumer).
+ * File reads are chunk sized and end on a chunk boundary of the file, so
+ * past the first read they start sector aligned (chunk a multiple of the
+ * sector) whatever the wav header size : no partial sector copies in FatFs.
+ * A read never wraps the ring. From open the ring offset follows the file
+ * offset, the ring end falls on a chunk boundary; after a loop it may not,
+ * and the read cut by the ring end is followed by one short read to realign.
+ */
+
+#define A_STREAM_NOLOOP (0xffffffffU)
+#define A_STREAM_FRAME (4)
+
+typedef struct {
+    /*>= 0 - bytes read, < 0 - error*/
+    int (*read) (void *ctx, void *buf, uint32_t size);
+    /*absolute offset, < 0 - error*/
+    int (*seek) (void *ctx, uint32_t offset);
+    void (*close) (void *ctx);
+    void *ctx;
+} a_stream_src_t;
+
+typedef struct {
+    uint32_t reads;
+    uint32_t bytes;
+    uint32_t loops;
+    uint32_t errors;
+    /*mixer wanted more frames than ready*/
+    uint32_t underruns;
+    uint32_t starved;
+    /*ring fill in bytes : now and lowest seen while playing*/
+    uint32_t fill;
+    uint32_t lowwater;
+    uint32_t size;
+} a_stream_stat_t;
+
+typedef struct {
+    const a_stream_src_t *src;
+    uint8_t *ring;
+    /*power of 2, multiple of chunk*/
+    uint32_t size;
+    uint32_t chunk;
+    volatile uint32_t wr;
+    volatile uint32_t rd;
+    /*pcm data region in the file*/
+    uint32_t dataoff;
+    uint32_t datalen;
+    /*bytes from data start*/
+    uint32_t loopstart;
+    uint32_t filepos;
+    uint32_t samplerate;
+    uint8_t eof;
+    a_stream_stat_t stat;
+} a_stream_t;
+
+/*
+ * Parses wav header from 'src', 'loopstart' in frames (a_chn_loopstart) or
+ * A_STREAM_NOLOOP. Ring is pre-filled before return.
+ * -1 if the file rate is not 'outrate', the mixer rate : no conversion.
+ */
+int a_stream_open (a_stream_t *st, const a_stream_src_t *src, void *ring,
+                        uint32_t size, uint32_t chunk, uint32_t loopstart,
+                        uint32_t outrate);
+void a_stream_close (a_stream_t *st);
+/*
+ * Background : reads while ring has space, returns bytes read.
+ * A read returning 0 before the end of data ends the stream, as an error.
+ */
+int a_stream_fill (a_stream_t *st);
+/*Mixer : adds up to 'frames' into 'acc', returns frames mixed*/
+int a_stream_mix (a_stream_t *st, int32_t *acc, int16_t gain, int frames);
+/*1 - all data played and not looped*/
+int a_stream_done (a_stream_t *st);
+void a_stream_stat (a_stream_t *st, a_stream_stat_t *stat);
+
+#if defined(BSP_DRIVER)
+int a_stream_open_file (a_stream_t *st, const char *path, void *ring,
+                        uint32_t size, uint32_t chunk, uint32_t loopstart,
+                        uint32_t outrate);
+#endif
+
+#endif /*__AUDIO_STREAM_H__*/
@@ -0,0 +1,99 @@
+#ifndef __AUDIO_TEL_H__
+#define __AUDIO_TEL_H__
+
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Audio path telemetry, cycle counter based. Updates are a few adds
+ * and compares, cheap enough to be always on.
+ * Worst case values hold since last reset.
+ */
+
+typedef struct {
+    uint32_t last;
+    uint32_t min;
+    uint32_t max;
+    uint32_t cnt;
+    uint64_t total;
+} a_tel_val_t;
+
+typedef struct {
+    /*dma half/complete callback interval, cycles*/
+    a_tel_val_t interval;
+    /*period mixing time, cycles*/
+    a_tel_val_t mix;
+    uint32_t cbstamp;
+    /*expected interval, cycles*/
+    uint32_t period;
+    /*interval above period by 1/4*/
+    uint32_t late;
+    /*callback found previous period still pending (dsr mode)*/
+    uint32_t missed;
+    /*voices mixed in the last period, see a_mix_voices_taken*/
+    uint32_t voices;
+    uint32_t voicesmax;
+    uint32_t clock;
+} a_tel_t;
+
+static inline void
+a_tel_val (a_tel_val_t *v, uint32_t x)
+{
+    v->last = x;
+    if (x > v->max) {
+        v->max = x;
+    }
+    if (x < v->min || !v->cnt) {
+        v->min = x;
+    }
+    v->cnt++;
+    v->total += x;
+}
+
+static inline void
+a_tel_reset (a_tel_t *tel, uint32_t period, uint32_t clock)
+{
+    memset(tel, 0, sizeof(*tel));
+    tel->period = period;
+    tel->clock = clock;
+}
+
+/*Dma callback entry*/
+static inline void
+a_tel_callback (a_tel_t *tel, uint32_t now)
+{
+    uint32_t d;
+
+    if (tel->cbstamp) {
+        d = now - tel->cbstamp;
+        a_tel_val(&tel->interval, d);
+        if (tel->period && d > tel->period + (tel->period >> 2)) {
+            tel->late++;
+        }
+    }
+    tel->cbstamp = now ? now : 1;
+}
+
+static inline void
+a_tel_mix (a_tel_t *tel, uint32_t start, uint32_t end)
+{
+    a_tel_val(&tel->mix, end - start);
+}
+
+static inline void
+a_tel_voices (a_tel_t *tel, uint32_t voices)
+{
+    tel->voices = voices;
+    if (voices > tel->voicesmax) {
+        tel->voicesmax = voices;
+    }
+}
+
+/*cycles -> us*/
+static inline uint32_t
+a_tel_us (const a_tel_t *tel, uint64_t cycles)
+{
+    return tel->clock ? (uint32_t)((cycles * 1000000U) / tel->clock) : 0;
+}
+
+#endif /*__AUDIO_TEL_H__*/
@@ -0,0 +1,73 @@
+#ifndef __AUDIO_VOICE_H__
+#define __AUDIO_VOICE_H__
+
+#include <stdint.h>
+
+/*
+ * Fixed voice pool, constant time allocate/free, steal bounded by 32 voices.
+ * Voices are indices into the caller channel array (up to 32).
+ * Priority (0 - lowest) is bucketed into 32 levels, each level has a bitmap
+ * of its voices and 'levels' has a bit per non-empty level, so both the
+ * free voice and the lowest level are found with one CLZ. Inside that level
+ * the victim is the voice of the lowest exact priority : the scan is bounded
+ * by the voices of one level, never by the pool size alone.
+ */
+
+#define A_VOICE_MAX (32)
+#define A_VOICE_LEVELS (32)
+#define A_VOICE_LEVEL(prio) ((prio) >> 3)
+#define A_VOICE_NONE (-1)
+#define A_VOICE_MASK(size) ((size) >= A_VOICE_MAX ? 0xffffffffU : ((1U << (size)) - 1))
+/*Static pool of 'n' free voices*/
+#define A_VOICE_POOL_INIT(n) {.free = A_VOICE_MASK(n), .size = (n)}
+
+#if defined(__CC_ARM)
+#define A_VOICE_CLZ(x) __clz(x)
+#else
+#define A_VOICE_CLZ(x) __builtin_clz(x)
+#endif
+/*Index of lowest set bit, x != 0*/
+#define A_VOICE_CTZ(x) (31 - A_VOICE_CLZ((x) & (0U - (x))))
+
+typedef struct a_voice_pool_s a_voice_pool_t;
+
+struct a_voice_pool_s {
+    uint32_t free;
+    uint32_t levels;
+    uint32_t level[A_VOICE_LEVELS];
+    uint8_t prio[A_VOICE_MAX];
+    uint8_t size;
+    uint8_t used;
+    uint32_t steals;
+    uint32_t refused;
+    /*Same meaning as for a_channel_head_t*/
+    void (*empty_handle) (a_voice_pool_t *pool);
+    void (*first_link_handle) (a_voice_pool_t *pool);
+    void (*remove_handle) (a_voice_pool_t *pool, int voice);
+    void *user;
+};
+
+void a_voice_pool_init (a_voice_pool_t *pool, int size);
+/*
+ * Free voice, or steals the lowest priority one not above 'prio'
+ * (the lowest index among equals), A_VOICE_NONE if none
+ */
+int a_voice_alloc (a_voice_pool_t *pool, uint8_t prio);
+void a_voice_free (a_voice_pool_t *pool, int voice);
+void a_voice_set_prio (a_voice_pool_t *pool, int voice, uint8_t prio);
+/*Removes all voices with priority below 'prio', returns count*/
+int a_voice_reject_below (a_voice_pool_t *pool, uint8_t prio);
+
+static inline uint32_t
+a_voice_busy (const a_voice_pool_t *pool)
+{
+    return ~pool->free & A_VOICE_MASK(pool->size);
+}
+
+/*Iterates busy voices : 'bits' is scratch, safe to free 'voice' inside*/
+#define a_voice_foreach(pool, voice, bits) \
+    for (bits = a_voice_busy(pool); \
+         bits && ((voice = A_VOICE_CTZ(bits)), 1); \
+         bits &= bits - 1)
+
+#endif /*__AUDIO_VOICE_H__*/
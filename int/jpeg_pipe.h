@@ -0,0 +1,104 @@
+#ifndef __JPEG_PIPE_H__
+#define __JPEG_PIPE_H__
+
+#include <stdint.h>
+#include <jpeg.h>
+
+/*
+ * Three stage image loader : file read -> jpeg codec -> convert/blit.
+ * Each stage runs one job at a time and is driven by start/poll callbacks,
+ * so SD reads of image N+1, codec work on image N and DMA2D/CPU conversion
+ * of image N-1 overlap. Stages are joined with bounded queues.
+ * Scheduler itself has no hw dependencies; stage ops may be mocked.
+ */
+
+typedef enum {
+    JPEG_PIPE_READ,
+    JPEG_PIPE_DECODE,
+    JPEG_PIPE_CONVERT,
+    JPEG_PIPE_STAGE_MAX,
+} jpeg_pipe_stage_e;
+
+/*Must be power of 2*/
+#define JPEG_PIPE_QUEUE_MAX (1 << 2)
+
+typedef struct jpeg_pipe_job_s {
+    const char *path;
+    void *data;
+    uint32_t size;
+    void *tempbuf;
+    uint32_t outformat;
+    const uint32_t *clut;
+    uint32_t clutsize;
+    /*'data' is heap memory owned by the pipe, released after decode*/
+    uint8_t owndata;
+    jpeg_info_t info;
+    void *user;
+    int err;
+    uint32_t tstart[JPEG_PIPE_STAGE_MAX];
+    uint32_t tend[JPEG_PIPE_STAGE_MAX];
+} jpeg_pipe_job_t;
+
+typedef struct {
+    /*0 - started, < 0 - error*/
+    int (*start) (void *ctx, jpeg_pipe_job_t *job);
+    /*0 - in progress, 1 - done, < 0 - error*/
+    int (*poll) (void *ctx, jpeg_pipe_job_t *job);
+    void *ctx;
+    /*
+     * Polled again after each poll of a non-urgent stage, so blocking
+     * work of other stages (file reads) can't starve a hw stage.
+     */
+    uint8_t urgent;
+} jpeg_pipe_stage_ops_t;
+
+typedef struct {
+    jpeg_pipe_job_t *buf[JPEG_PIPE_QUEUE_MAX];
+    uint16_t rd, wr;
+    uint16_t depth;
+    uint16_t maxfill;
+} jpeg_pipe_queue_t;
+
+typedef struct {
+    /*time units from the 'time' callback*/
+    uint32_t busy;
+    uint32_t starved;
+    uint32_t blocked;
+    uint32_t jobs;
+    uint32_t errors;
+    uint32_t maxlatency;
+} jpeg_pipe_stat_t;
+
+typedef struct {
+    const jpeg_pipe_stage_ops_t *ops;
+    jpeg_pipe_job_t *job;
+    uint8_t done;
+} jpeg_pipe_stage_t;
+
+typedef struct {
+    jpeg_pipe_stage_t stage[JPEG_PIPE_STAGE_MAX];
+    /*queue[i] feeds stage[i], queue[JPEG_PIPE_STAGE_MAX] - finished jobs*/
+    jpeg_pipe_queue_t queue[JPEG_PIPE_STAGE_MAX + 1];
+    jpeg_pipe_stat_t stat[JPEG_PIPE_STAGE_MAX];
+    uint32_t (*time) (void);
+    void (*complete) (jpeg_pipe_job_t *job);
+    uint32_t tlast;
+    uint32_t tbegin;
+    uint32_t inflight;
+} jpeg_pipe_t;
+
+void jpeg_pipe_init (jpeg_pipe_t *pipe, const jpeg_pipe_stage_ops_t **ops,
+                          int depth, uint32_t (*time) (void));
+int jpeg_pipe_submit (jpeg_pipe_t *pipe, jpeg_pipe_job_t *job);
+jpeg_pipe_job_t *jpeg_pipe_collect (jpeg_pipe_t *pipe);
+int jpeg_pipe_tick (jpeg_pipe_t *pipe);
+int jpeg_pipe_run (jpeg_pipe_t *pipe, jpeg_pipe_job_t *jobs, int cnt);
+void jpeg_pipe_stat_reset (jpeg_pipe_t *pipe);
+void jpeg_pipe_stat_dump (jpeg_pipe_t *pipe);
+
+extern const jpeg_pipe_stage_ops_t jpeg_pipe_decode_ops;
+#if defined(BSP_DRIVER)
+extern const jpeg_pipe_stage_ops_t jpeg_pipe_read_ops;
+#endif
+
+#endif /*__JPEG_PIPE_H__*/
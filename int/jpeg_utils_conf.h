@@ -42,6 +42,7 @@
 #define JPEG_ARGB8888            0  /* ARGB8888 Color Format */
 #define JPEG_RGB888              1  /* RGB888 Color Format   */
 #define JPEG_RGB565              2  /* RGB565 Color Format   */
+#define JPEG_L8                  3  /* 8 bit CLUT index, runtime only : see JPEG_SetDecodeOutputFormat */
     
 /**
 * @}
@@ -52,11 +53,19 @@
 /** @addtogroup JPEG_Exported_Defines
   * @{
   */    
+#ifndef USE_JPEG_DECODER
 #define USE_JPEG_DECODER     1  /* Enable Decoding Post-Processing functions (YCbCr to RGB conversion) */
+#endif
+#ifndef USE_JPEG_ENCODER
 #define USE_JPEG_ENCODER     0  /* Enable Encoding Pre-Processing functions (RGB to YCbCr conversion)*/
+#endif
 
-#define JPEG_RGB_FORMAT      JPEG_ARGB8888  /* Select RGB format: ARGB8888, RGB888, RBG565 */
+#ifndef JPEG_RGB_FORMAT
+#define JPEG_RGB_FORMAT      JPEG_ARGB8888  /* Select default RGB format: ARGB8888, RGB888, RBG565 */
+#endif
+#ifndef JPEG_SWAP_RB
 #define JPEG_SWAP_RB         0  /* Change color order to BGR */
+#endif
 
 /**
 * @}
@@ -0,0 +1,195 @@
+#ifndef __QKV_H__
+#define __QKV_H__
+
+#include <stdint.h>
+
+/*
+ * Log-structured key-value store on NOR flash (QSPI).
+ * Region is a ring of erase sectors, each opened with a header
+ * carrying a sequence number. Records (key, value, crc) are appended
+ * to the newest sector, a newer record of the same key supersedes
+ * the older one, zero-length tombstone deletes it.
+ * Index (key hash -> record) lives in RAM and is rebuilt at mount
+ * by replaying sectors in sequence order; torn records fail crc.
+ * Torn tail of the head sector is zeroed at mount (NOR may always
+ * clear bits), zero words are skipped, so appends go on after it.
+ * Compaction always takes the oldest sector : live records are
+ * copied to the head, then the sector is erased. So sectors are
+ * reused strictly round-robin, which levels wear.
+ * qkv_gc() compacts ahead in the background (idle loop), qkv_set()
+ * compacts by itself only when it would eat into the reserve.
+ * Values are read in place, through the 'base' mapping.
+ * Core has no hw dependencies, flash program/erase go through ops.
+ */
+
+#define QKV_SECTOR (4096)
+#define QKV_KEY_MAX (63)
+#define QKV_NIL (0xffff)
+/*
+ * Sectors kept erased for compaction : power loss while compacting
+ * may take one of them, the other lets compaction resume after mount.
+ */
+#define QKV_RESERVE (2)
+/*qkv_gc compacts while fewer sectors are free*/
+#ifndef QKV_GC_FREE
+#define QKV_GC_FREE (4)
+#endif
+
+#define QKV_SECT_MAGIC (0x5356514b) /*"KQVS"*/
+#define QKV_REC_MAGIC (0xa5)
+#define QKV_TOMB (0xffff)
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t erases;
+    /*crc32 of the fields above*/
+    uint32_t crc;
+} qkv_sect_hdr_t;
+
+/*Followed by key (no '\0') and value, padded to 4*/
+typedef struct {
+    uint8_t magic;
+    uint8_t klen;
+    /*QKV_TOMB - deleted*/
+    uint16_t vlen;
+    /*crc32 of klen, vlen, key, value*/
+    uint32_t crc;
+} qkv_rec_hdr_t;
+
+#define QKV_VAL_MAX (QKV_SECTOR - sizeof(qkv_sect_hdr_t) - sizeof(qkv_rec_hdr_t) - QKV_KEY_MAX - 4)
+
+typedef struct {
+    /*0 - ok; ranges never cross a sector, programmed bits only go 1 -> 0*/
+    int (*prog) (void *hw, uint32_t off, const void *data, uint32_t size);
+    int (*erase) (void *hw, uint32_t off);
+    /*
+     * Optional, around every update (set, del, gc, mount repair) :
+     * -1 - flash can't be written now, the update fails with nothing written
+     */
+    int (*begin) (void *hw);
+    void (*end) (void *hw);
+    /*
+     * Optional, around every read through 'base' outside an update :
+     * -1 - region not readable now (flash unmapped), the call fails
+     */
+    int (*pin) (void *hw);
+    void (*unpin) (void *hw);
+    void *hw;
+} qkv_ops_t;
+
+typedef enum {
+    QKV_FREE,
+    QKV_USED,
+    /*torn tail or program error, no more appends*/
+    QKV_CLOSED,
+} qkv_state_e;
+
+typedef struct {
+    uint32_t seq;
+    uint32_t erases;
+    /*append offset within sector*/
+    uint16_t end;
+    /*bytes of records still in the index*/
+    uint16_t live;
+    uint8_t state;
+} qkv_sect_t;
+
+typedef struct {
+    uint32_t hash;
+    uint32_t off;
+    uint16_t next;
+} qkv_node_t;
+
+typedef struct {
+    uint32_t sets;
+    uint32_t dels;
+    /*set with unchanged value, no flash write*/
+    uint32_t same;
+    uint32_t compactions;
+    /*records moved by compaction*/
+    uint32_t moved;
+    /*dead sectors erased out of order, see qkv_reclaim*/
+    uint32_t reclaims;
+    uint32_t erases;
+    uint32_t progbytes;
+    uint32_t torn;
+    uint32_t errors;
+    /*updates refused by ops->begin*/
+    uint32_t busy;
+} qkv_stat_t;
+
+typedef struct {
+    const qkv_ops_t *ops;
+    const uint8_t *base;
+    qkv_sect_t *sect;
+    qkv_node_t *node;
+    uint16_t *hash;
+    /*one record, compaction copies through RAM*/
+    uint8_t *stage;
+    uint16_t nsect;
+    uint16_t maxkeys;
+    uint16_t hmask;
+    uint16_t freelist;
+    uint16_t keys;
+    uint16_t nfree;
+    /*QKV_NIL - no sector open for append*/
+    uint16_t head;
+    uint32_t seq;
+    qkv_stat_t stat;
+} qkv_t;
+
+uint32_t qkv_memsize (uint16_t nsect, uint16_t maxkeys);
+/*
+ * 'base' - region start, readable (mapped), 'nsect' sectors of QKV_SECTOR.
+ * Blank or foreign region mounts empty, sectors are erased on demand.
+ */
+int qkv_mount (qkv_t *kv, const qkv_ops_t *ops, const uint8_t *base, uint16_t nsect,
+                 void *mem, uint16_t maxkeys);
+/*
+ * Pointer into the region, -1 - no key or not readable.
+ * Region stays pinned (no set/del/gc gets through) until qkv_put()
+ */
+int qkv_get (qkv_t *kv, const char *key, const void **val, uint32_t *len);
+void qkv_put (qkv_t *kv, const void *val);
+/*Copy of the value, returns length or -1*/
+int qkv_read (qkv_t *kv, const char *key, void *buf, uint32_t size);
+/*'val' must not point into the region (see qkv_get)*/
+int qkv_set (qkv_t *kv, const char *key, const void *val, uint32_t len);
+int qkv_del (qkv_t *kv, const char *key);
+/*
+ * Incremental compaction step, 1 - sector reclaimed, 0 - nothing to do.
+ * Background work : keeps QKV_GC_FREE sectors free, so qkv_set() doesn't erase.
+ */
+int qkv_gc (qkv_t *kv);
+/*Calls 'func' for every live key, stops on non-zero return; 'func' must not update*/
+int qkv_foreach (qkv_t *kv, int (*func) (void *arg, const char *key, const void *val,
+                                             uint32_t len), void *arg);
+void qkv_stat_dump (qkv_t *kv);
+
+#if defined(BSP_DRIVER)
+
+/*Region in QSPI flash, after the asset archive (see qpak.h)*/
+#ifndef QKV_QSPI_OFFSET
+#define QKV_QSPI_OFFSET (32 * 1024 * 1024)
+#endif
+#ifndef QKV_QSPI_SECTORS
+#define QKV_QSPI_SECTORS (64)
+#endif
+#ifndef QKV_QSPI_KEYS
+#define QKV_QSPI_KEYS (256)
+#endif
+
+/*
+ * Store on the board QSPI flash, NULL until mounted.
+ * Updates take qspi_map_lock() : they fail (-1) while a reader
+ * pins the mapping (see qpak_get) or the archive is updated.
+ */
+qkv_t *qkv_qspi (void);
+int qkv_qspi_mount (void);
+/*Background compaction step, from the idle loop; see qkv_gc()*/
+int qkv_qspi_tickle (void);
+
+#endif /*BSP_DRIVER*/
+
+#endif /*__QKV_H__*/
@@ -0,0 +1,94 @@
+#ifndef __QPAK_H__
+#define __QPAK_H__
+
+#include <stdint.h>
+
+/*
+ * Read-only packed asset archive, built on host (tools/qpak.c),
+ * used in place from memory-mapped QSPI flash : lookup returns
+ * a pointer into the archive, no copy to RAM.
+ *
+ * Layout : header | index, sorted by (hash, name) | names | data.
+ * Each data entry starts on QPAK_ALIGN boundary, so it may feed
+ * DMA2D/JPEG/audio directly and never shares a cache line.
+ * All fields are little endian.
+ */
+
+#define QPAK_MAGIC (0x4b415051) /*"QPAK"*/
+#define QPAK_VERSION (1)
+#define QPAK_ALIGN (32)
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t align;
+    uint32_t count;
+    /*whole archive, bytes*/
+    uint32_t size;
+    /*crc32 of bytes [sizeof(qpak_hdr_t), size)*/
+    uint32_t crc;
+    uint32_t rsvd[3];
+} qpak_hdr_t;
+
+typedef struct {
+    uint32_t hash;
+    /*offsets from archive start*/
+    uint32_t name;
+    uint32_t offset;
+    uint32_t size;
+} qpak_ent_t;
+
+#define QPAK_ALIGN_UP(x) (((x) + QPAK_ALIGN - 1) & ~(QPAK_ALIGN - 1))
+
+static inline const qpak_ent_t *
+qpak_index (const void *pak)
+{
+    return (const qpak_ent_t *)((const uint8_t *)pak + sizeof(qpak_hdr_t));
+}
+
+static inline const char *
+qpak_name (const void *pak, const qpak_ent_t *ent)
+{
+    return (const char *)pak + ent->name;
+}
+
+static inline const void *
+qpak_data (const void *pak, const qpak_ent_t *ent)
+{
+    return (const uint8_t *)pak + ent->offset;
+}
+
+uint32_t qpak_hash (const char *path);
+uint32_t qpak_crc32 (uint32_t crc, const void *data, uint32_t size);
+/*0 - header and index are sane, no crc check*/
+int qpak_check (const void *pak, uint32_t size);
+const qpak_ent_t *qpak_find (const void *pak, const char *path);
+
+#if defined(BSP_DRIVER)
+
+/*Archive place in QSPI flash*/
+#ifndef QPAK_QSPI_OFFSET
+#define QPAK_QSPI_OFFSET (0)
+#endif
+#ifndef QPAK_QSPI_SIZE
+#define QPAK_QSPI_SIZE (32 * 1024 * 1024)
+#endif
+
+int qpak_mount (void);
+/*
+ * Pointer into mapped flash, the mapping is pinned until qpak_put()
+ * (see qspi_map_pin) : flash writers - qkv updates, archive update -
+ * fail meanwhile. NULL - no such file, or flash is being written.
+ */
+const void *qpak_get (const char *path, uint32_t *size);
+void qpak_put (const void *data);
+
+/*Streamed rewrite of the archive, header is written last; holds qspi_map_lock()*/
+int qpak_update_begin (uint32_t size);
+int qpak_update_write (const void *data, uint32_t size);
+int qpak_update_end (void);
+int qpak_update_file (const char *path);
+
+#endif /*BSP_DRIVER*/
+
+#endif /*__QPAK_H__*/
@@ -0,0 +1,151 @@
+#ifndef __QSPI_DMA_H__
+#define __QSPI_DMA_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Asynchronous QSPI flash reads for the periods when memory-mapped
+ * mode is off (program/erase, archive update).
+ * Requests are queued, each one is moved in chunks of 'chunk' bytes,
+ * an unfinished request goes to the queue tail after every chunk,
+ * so a short read never waits for a long one to complete.
+ * Flash status is polled once, when the queue starts after init or error,
+ * not per request : BSP program/erase return with the flash ready.
+ * Queue core (qspi_q_*) has no hw dependencies, transfers go through ops.
+ */
+
+typedef enum {
+    QSPI_REQ_IDLE,
+    QSPI_REQ_PENDING,
+    QSPI_REQ_DONE,
+    QSPI_REQ_ERR,
+} qspi_req_status_e;
+
+typedef struct qspi_req_s qspi_req_t;
+
+/*Called from isr (or from submit, on immediate failure)*/
+typedef void (*qspi_done_t) (qspi_req_t *req);
+
+struct qspi_req_s {
+    qspi_req_t *next;
+    uint8_t *buf;
+    uint32_t addr;
+    uint32_t size;
+    /*bytes transferred*/
+    uint32_t pos;
+    qspi_done_t done;
+    void *user;
+    volatile int status;
+};
+
+typedef struct {
+    /*0 - chunk started, end is reported with qspi_q_xfer_done*/
+    int (*start) (void *hw, uint8_t *buf, uint32_t addr, uint32_t size);
+    /*0 - flash ready for read commands; blocking, not called from isr*/
+    int (*ready) (void *hw);
+    /*Mask completion irq*/
+    void (*lock) (void *hw);
+    void (*unlock) (void *hw);
+    void *hw;
+} qspi_q_ops_t;
+
+typedef struct {
+    uint32_t reqs;
+    uint32_t xfers;
+    uint32_t bytes;
+    uint32_t polls;
+    uint32_t errors;
+    uint32_t maxdepth;
+} qspi_q_stat_t;
+
+typedef struct {
+    const qspi_q_ops_t *ops;
+    /*head - request in flight*/
+    qspi_req_t *head, *tail;
+    uint32_t chunk;
+    /*size of chunk in flight*/
+    uint32_t cur;
+    uint32_t depth;
+    volatile uint8_t busy;
+    /*flash state unknown, poll before next transfer*/
+    uint8_t dirty;
+    qspi_q_stat_t stat;
+} qspi_q_t;
+
+void qspi_q_init (qspi_q_t *q, const qspi_q_ops_t *ops, uint32_t chunk);
+/*-1 - bad request, 'done' is not called*/
+int qspi_q_submit (qspi_q_t *q, qspi_req_t *req);
+/*Isr : chunk in flight completed, err != 0 - failed*/
+void qspi_q_xfer_done (qspi_q_t *q, int err);
+void qspi_q_dirty (qspi_q_t *q);
+
+static inline int
+qspi_q_idle (qspi_q_t *q)
+{
+    return !q->busy;
+}
+
+static inline void
+qspi_req_init (qspi_req_t *req, void *buf, uint32_t addr, uint32_t size,
+                  qspi_done_t done, void *user)
+{
+    req->next = NULL;
+    req->buf = (uint8_t *)buf;
+    req->addr = addr;
+    req->size = size;
+    req->pos = 0;
+    req->done = done;
+    req->user = user;
+    req->status = QSPI_REQ_IDLE;
+}
+
+#if defined(BSP_DRIVER)
+
+/*DMA needs cache line aligned buffers, QSPI_DMA_ALIGN for buf and size*/
+#define QSPI_DMA_ALIGN (32)
+/*Below 64K - DMA item counter limit*/
+#ifndef QSPI_DMA_CHUNK
+#define QSPI_DMA_CHUNK (32 * 1024)
+#endif
+
+/*Shared by all QSPI users, BSP_QSPI_Init done once*/
+int qspi_init (void);
+/*Isr of the QSPI dma stream when it is shared; 1 - handled*/
+int qspi_dma_irq (void *stream);
+
+/*
+ * 0 - queued, -1 - bad request or no flash.
+ * 'buf' and 'size' must be QSPI_DMA_ALIGN (cache line) aligned, else -1 :
+ * the destination lines are invalidated around the dma, a shared line
+ * would lose the neighbour data.
+ * In memory-mapped mode the read is done by copy before return.
+ */
+int qspi_read_async (qspi_req_t *req);
+/*Request result, QSPI_REQ_DONE or QSPI_REQ_ERR*/
+int qspi_read_wait (qspi_req_t *req);
+/*Blocking, alignment as for qspi_read_async()*/
+int qspi_read (void *buf, uint32_t addr, uint32_t size);
+/*Wait for the queue to drain, before leaving indirect mode*/
+void qspi_flush (void);
+/*Memory-mapped mode on/off, queue is drained first; no-op if already there*/
+int qspi_map (void);
+/*-1 while the mapping is pinned*/
+int qspi_unmap (void);
+/*
+ * Holders of pointers into the mapped flash pin it, so it can't be
+ * unmapped under them; -1 - not mapped, or locked for writing.
+ * Flash writers (program/erase) take the lock for the whole update :
+ * -1 while pinned or already locked, pins fail until qspi_map_unlock().
+ * Both are irq safe.
+ */
+int qspi_map_pin (void);
+void qspi_map_unpin (void);
+int qspi_map_lock (void);
+void qspi_map_unlock (void);
+/*Called while waiting; NULL - busy wait*/
+void qspi_set_yield_hook (void (*yield) (void));
+
+#endif /*BSP_DRIVER*/
+
+#endif /*__QSPI_DMA_H__*/
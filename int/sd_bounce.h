@@ -0,0 +1,27 @@
+#ifndef __SD_BOUNCE_H__
+#define __SD_BOUNCE_H__
+
+#include <stdint.h>
+#include "../../ulib/io/fs/FatFs/src/ff_gen_drv.h"
+
+/*
+ * Buffers not suitable for the block transfer (unaligned, or not cache
+ * line aligned for dma reads) go through a static bounce chunk :
+ * one multi block command per chunk + memcpy, no heap on the io path.
+ * Chunk is cache line aligned, so dma cache maintenance never touches
+ * neighbour data. Core has no hw dependencies : SD_Driver runs it over
+ * its block transfers, host benches over SD_ImageDriver.
+ * Not reentrant, callers are serialized by the disk layer.
+ */
+
+#define SD_BOUNCE_SIZE (16 * 1024)
+#define SD_BOUNCE_SECTORS (SD_BOUNCE_SIZE / _MIN_SS)
+
+typedef DRESULT (*sd_bounce_rd_t) (BYTE lun, BYTE *buff, DWORD sector, UINT count);
+typedef DRESULT (*sd_bounce_wr_t) (BYTE lun, const BYTE *buff, DWORD sector, UINT count);
+
+/*'read'/'write' get the bounce chunk, at most SD_BOUNCE_SECTORS per call*/
+DRESULT sd_bounce_read (sd_bounce_rd_t read, BYTE lun, BYTE *buff, DWORD sector, UINT count);
+DRESULT sd_bounce_write (sd_bounce_wr_t write, BYTE lun, const BYTE *buff, DWORD sector, UINT count);
+
+#endif /*__SD_BOUNCE_H__*/
@@ -0,0 +1,84 @@
+#ifndef __SD_CACHE_H__
+#define __SD_CACHE_H__
+
+#include <stdint.h>
+#include "../../ulib/io/fs/FatFs/src/ff_gen_drv.h"
+
+/*
+ * Write-back sector cache between FatFs and a block driver.
+ * Wraps any Diskio_drvTypeDef : hashed lookup, LRU eviction,
+ * dirty sectors are written back on eviction or CTRL_SYNC.
+ * Sequential reads trigger multi-block read-ahead.
+ * Requests of 'ramax' sectors or more bypass the cache.
+ * Core has no hw dependencies, so it runs against any host driver.
+ */
+
+#define SD_CACHE_NIL (0xffff)
+#define SD_CACHE_ALIGN (32)
+/*Default read-ahead, sectors*/
+#define SD_CACHE_RA_DEF (16)
+#define SD_CACHE_RA_MIN (2)
+
+typedef struct {
+    uint32_t reads;
+    uint32_t writes;
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t readahead;
+    /*read-ahead sectors used before eviction*/
+    uint32_t rahits;
+    uint32_t evictions;
+    uint32_t writebacks;
+    uint32_t bypass;
+    uint32_t errors;
+} sd_cache_stat_t;
+
+typedef struct {
+    DWORD sector;
+    uint16_t prev, next;
+    uint16_t hnext;
+    uint8_t flags;
+} sd_cache_blk_t;
+
+typedef struct {
+    const Diskio_drvTypeDef *drv;
+    BYTE lun;
+    sd_cache_blk_t *blk;
+    uint16_t *hash;
+    uint8_t *data;
+    /*ramax sectors, contiguous multi-block transfers*/
+    uint8_t *stage;
+    uint16_t nblk;
+    uint16_t hmask;
+    /*head - most recently used*/
+    uint16_t head, tail;
+    uint16_t ramax;
+    uint16_t rawin;
+    uint16_t dirty;
+    DWORD seqnext;
+    sd_cache_stat_t stat;
+} sd_cache_t;
+
+uint32_t sd_cache_memsize (uint16_t blocks, uint16_t ramax);
+int sd_cache_init (sd_cache_t *cache, const Diskio_drvTypeDef *drv, BYTE lun,
+                      void *mem, uint32_t size, uint16_t ramax);
+DRESULT sd_cache_read (sd_cache_t *cache, BYTE *buff, DWORD sector, UINT count);
+DRESULT sd_cache_write (sd_cache_t *cache, const BYTE *buff, DWORD sector, UINT count);
+DRESULT sd_cache_sync (sd_cache_t *cache);
+void sd_cache_drop (sd_cache_t *cache, DWORD sector, DWORD count);
+/*CTRL_TRIM range, 'end' inclusive : dropped unwritten; end < start - RES_PARERR, nothing dropped*/
+DRESULT sd_cache_trim (sd_cache_t *cache, DWORD start, DWORD end);
+void sd_cache_stat_reset (sd_cache_t *cache);
+void sd_cache_stat_dump (sd_cache_t *cache);
+
+#if defined(BSP_DRIVER)
+/*SDRAM budget for SD_CacheDriver*/
+#ifndef SD_CACHE_SIZE
+#define SD_CACHE_SIZE (256 * 1024)
+#endif
+
+/*SD_Driver behind the cache; uncached if budget can't be allocated*/
+extern const Diskio_drvTypeDef SD_CacheDriver;
+#endif
+
+#endif /*__SD_CACHE_H__*/
@@ -53,6 +53,17 @@
 /* Exported constants --------------------------------------------------------*/
 /* Exported functions ------------------------------------------------------- */
 extern const Diskio_drvTypeDef  SD_Driver;
+/*
+ * Called while waiting for dma transfer; NULL - busy wait.
+ * Must not use the card : disk calls from the hook fail with RES_NOTRDY.
+ */
+void SD_SetYieldHook (void (*yield) (void));
+/*
+ * Periodic write back of the write queue (ticker/idle loop), flushes the
+ * queued run once it is older than the age limit. Same context as the disk
+ * calls, not from irq; RES_NOTRDY from the yield hook or before init.
+ */
+DRESULT SD_Tickle (void);
 
 #endif /* __SD_DISKIO_H */
 
@@ -0,0 +1,53 @@
+#ifndef __SD_IMAGE_H__
+#define __SD_IMAGE_H__
+
+#include <stdint.h>
+#include "../../ulib/io/fs/FatFs/src/ff_gen_drv.h"
+
+/*
+ * Host only : Diskio_drvTypeDef over a disk image file,
+ * so FatFs, sd_cache and the loaders run and can be profiled on Linux.
+ * Every command is charged a card model time : fixed latency + size / throughput.
+ * Model time is accumulated, and optionally slept, to mimic a real card.
+ */
+
+#if !defined(BSP_DRIVER)
+
+typedef struct {
+    /*per command, us*/
+    uint32_t rdlat;
+    uint32_t wrlat;
+    /*KB/s, 0 - unlimited*/
+    uint32_t rdrate;
+    uint32_t wrrate;
+    /*sleep for model time, otherwise only account it*/
+    uint8_t realtime;
+} sd_image_timing_t;
+
+typedef struct {
+    uint32_t rdcmd;
+    uint32_t wrcmd;
+    uint32_t rdsect;
+    uint32_t wrsect;
+    uint32_t syncs;
+    uint32_t errors;
+    /*model time, us*/
+    uint64_t busy;
+} sd_image_stat_t;
+
+/*Typical class 10 card on 4-bit bus*/
+#define SD_IMAGE_TIMING_CLASS10 {300, 1200, 20 * 1024, 10 * 1024, 0}
+
+/*'sectors' != 0 - create or grow the image*/
+int sd_image_open (const char *path, DWORD sectors, const sd_image_timing_t *timing);
+void sd_image_close (void);
+void sd_image_timing (const sd_image_timing_t *timing);
+void sd_image_stat (sd_image_stat_t *stat);
+void sd_image_stat_reset (void);
+void sd_image_stat_dump (void);
+
+extern const Diskio_drvTypeDef SD_ImageDriver;
+
+#endif /*!BSP_DRIVER*/
+
+#endif /*__SD_IMAGE_H__*/
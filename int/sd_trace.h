@@ -0,0 +1,119 @@
+#ifndef __SD_TRACE_H__
+#define __SD_TRACE_H__
+
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * SD i/o trace : ring of last requests and log2 latency histograms
+ * per operation. Record is a few stores; off by default, when off
+ * driver pays one flag test per request.
+ */
+
+#define SD_TRACE_DEPTH (1 << 8)
+#define SD_TRACE_HIST (24)
+
+typedef enum {
+    SD_TRACE_READ,
+    SD_TRACE_WRITE,
+    SD_TRACE_TRIM,
+    SD_TRACE_OP_MAX,
+} sd_trace_op_e;
+
+typedef enum {
+    /*dma straight from/to caller buffer*/
+    SD_TRACE_DMA,
+    /*unaligned buffer, through bounce chunk*/
+    SD_TRACE_BOUNCE,
+    SD_TRACE_POLL,
+    /*absorbed by write queue, no card access*/
+    SD_TRACE_QUEUED,
+    /*write queue sent to card*/
+    SD_TRACE_FLUSH,
+    SD_TRACE_ERASE,
+    SD_TRACE_PATH_MAX,
+} sd_trace_path_e;
+
+typedef struct {
+    /*ms*/
+    uint32_t t;
+    uint32_t sector;
+    /*us*/
+    uint32_t dur;
+    uint32_t count;
+    uint8_t op;
+    uint8_t path;
+    uint8_t err;
+} sd_trace_rec_t;
+
+typedef struct {
+    sd_trace_rec_t rec[SD_TRACE_DEPTH];
+    uint32_t wr;
+    /*next record to stream out*/
+    uint32_t rd;
+    /*overwritten before streamed out*/
+    uint32_t lost;
+    /*[i] - requests of [2^(i-1), 2^i) us, card commands only*/
+    uint32_t hist[SD_TRACE_OP_MAX][SD_TRACE_HIST];
+    uint32_t maxdur[SD_TRACE_OP_MAX];
+    uint8_t on;
+    uint8_t stream;
+} sd_trace_t;
+
+static inline int
+sd_trace_bucket (uint32_t us)
+{
+    int i = us ? 32 - __builtin_clz(us) : 0;
+
+    return i < SD_TRACE_HIST ? i : SD_TRACE_HIST - 1;
+}
+
+static inline void
+sd_trace_put (sd_trace_t *trace, uint32_t t, uint32_t dur, sd_trace_op_e op,
+                  sd_trace_path_e path, uint32_t sector, uint32_t count, int err)
+{
+    sd_trace_rec_t *rec = &trace->rec[trace->wr & (SD_TRACE_DEPTH - 1)];
+
+    rec->t = t;
+    rec->sector = sector;
+    rec->dur = dur;
+    rec->count = count;
+    rec->op = op;
+    rec->path = path;
+    rec->err = err;
+    trace->wr++;
+    if (trace->wr - trace->rd > SD_TRACE_DEPTH) {
+        trace->rd = trace->wr - SD_TRACE_DEPTH;
+        if (trace->stream) {
+            trace->lost++;
+        }
+    }
+    if (path != SD_TRACE_QUEUED) {
+        trace->hist[op][sd_trace_bucket(dur)]++;
+        if (dur > trace->maxdur[op]) {
+            trace->maxdur[op] = dur;
+        }
+    }
+}
+
+/*Oldest record not streamed yet, NULL if none*/
+static inline sd_trace_rec_t *
+sd_trace_next (sd_trace_t *trace)
+{
+    if (trace->rd == trace->wr) {
+        return NULL;
+    }
+    return &trace->rec[trace->rd++ & (SD_TRACE_DEPTH - 1)];
+}
+
+static inline void
+sd_trace_reset (sd_trace_t *trace)
+{
+    uint8_t on = trace->on, stream = trace->stream;
+
+    memset(trace, 0, sizeof(*trace));
+    trace->on = on;
+    trace->stream = stream;
+}
+
+#endif /*__SD_TRACE_H__*/
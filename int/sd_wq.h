@@ -0,0 +1,58 @@
+#ifndef __SD_WQ_H__
+#define __SD_WQ_H__
+
+#include <stdint.h>
+#include "../../ulib/io/fs/FatFs/src/ff_gen_drv.h"
+
+/*
+ * Write queue : small writes of adjacent (or already queued) sectors are
+ * gathered into one multi block command - FAT, directory and log updates
+ * come sector by sector. Queue is flushed when a write doesn't fit the run,
+ * when it gets full, on read of a queued sector (sd_wq_read_sync), on sync
+ * and when older than SD_WQ_AGE ms (sd_wq_poll). A failed flush keeps the
+ * run queued for the next attempt.
+ * Core has no hw dependencies : SD_Driver runs it over its block write,
+ * host tests and benches over any driver.
+ */
+
+#define SD_WQ_SECTORS (32)
+/*Larger writes go straight to the card*/
+#define SD_WQ_MERGE_MAX (8)
+#define SD_WQ_AGE (100)
+
+typedef DRESULT (*sd_wq_wr_t) (BYTE lun, const BYTE *buff, DWORD sector, UINT count);
+
+typedef struct {
+    uint32_t writes;
+    /*writes taken by the queue*/
+    uint32_t queued;
+    /*commands issued for queued runs*/
+    uint32_t flushes;
+    uint32_t errors;
+} sd_wq_stat_t;
+
+typedef struct {
+    /*cache line aligned, flushed by dma*/
+    uint32_t buf[SD_WQ_SECTORS * _MIN_SS / sizeof(uint32_t)] __attribute__((aligned(32)));
+    sd_wq_wr_t write;
+    uint32_t (*ms) (void);
+    BYTE lun;
+    DWORD sector;
+    /*queued run, 0 - empty*/
+    UINT count;
+    uint32_t tick;
+    sd_wq_stat_t stat;
+} sd_wq_t;
+
+/*'write' - block write below the queue, 'ms' - millisecond clock for the age*/
+void sd_wq_init (sd_wq_t *wq, sd_wq_wr_t write, BYTE lun, uint32_t (*ms) (void));
+DRESULT sd_wq_write (sd_wq_t *wq, const BYTE *buff, DWORD sector, UINT count);
+DRESULT sd_wq_flush (sd_wq_t *wq);
+/*Flushes the run once it is older than SD_WQ_AGE*/
+DRESULT sd_wq_poll (sd_wq_t *wq);
+/*Before a read : flushes if the run overlaps it, else polls*/
+DRESULT sd_wq_read_sync (sd_wq_t *wq, DWORD sector, UINT count);
+/*Forgets the run, media change*/
+void sd_wq_drop (sd_wq_t *wq);
+
+#endif /*__SD_WQ_H__*/
@@ -0,0 +1,47 @@
+/*Minimal host bench helpers, see Makefile*/
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static inline double b_sec (clock_t t0)
+{
+    return (double)(clock() - t0) / CLOCKS_PER_SEC;
+}
+
+/*
+ * Host core clock, to turn cpu time into cycles : BENCH_MHZ from the
+ * environment, else the first "cpu MHz" of /proc/cpuinfo, 0 - unknown.
+ * Frequency scaling makes the cpuinfo value a guess, pin it with BENCH_MHZ.
+ */
+static inline double b_host_mhz (void)
+{
+    static double mhz = -1;
+    const char *env = getenv("BENCH_MHZ");
+    char line[256];
+    FILE *fp;
+
+    if (mhz >= 0) {
+        return mhz;
+    }
+    mhz = 0;
+    if (env) {
+        mhz = atof(env);
+        return mhz;
+    }
+    fp = fopen("/proc/cpuinfo", "r");
+    if (!fp) {
+        return mhz;
+    }
+    while (fgets(line, sizeof(line), fp)) {
+        if (sscanf(line, "cpu MHz : %lf", &mhz) == 1) {
+            break;
+        }
+    }
+    fclose(fp);
+    return mhz;
+}
+
+#endif /*__BENCH_H__*/
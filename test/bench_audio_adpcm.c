@@ -0,0 +1,91 @@
+/*
+ * IMA-ADPCM decode-and-mix throughput, 44.1 kHz, 512 frame periods :
+ * a_adpcm_mix with 16 looped voices, mono and stereo assets, against
+ * a_mix_voice on the same voices kept as 16 bit pcm.
+ * Reported as realtime voices per MHz of host clock (see bench.h) and
+ * cycles per voice frame, as bench_audio_mix.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+#include <audio_adpcm.h>
+#include <audio_mix.h>
+#include "bench.h"
+
+#define F 512
+#define V 16
+#define FRAMES (44100)
+#define ITER 5000
+
+static int16_t pcm[FRAMES * 2];
+static uint8_t asset[V][sizeof(a_adpcm_hdr_t) + (FRAMES / 200 + 1) * A_ADPCM_BLOCK];
+static int32_t acc[F * 2];
+static int16_t out[F * 2];
+
+static void report (const char *name, clock_t t0, double vframes)
+{
+    double mhz = b_host_mhz(), voices = vframes / 44100.0 / b_sec(t0);
+
+    if (!mhz) {
+        printf("%s : %-14s host clock unknown, set BENCH_MHZ\n", __FILE__, name);
+        return;
+    }
+    printf("%s : %-14s %7.2f voices/MHz, %.2f cycles per voice frame (host %.0f MHz)\n",
+           __FILE__, name, voices / mhz, mhz * 1e6 / (voices * 44100.0), mhz);
+}
+
+static void run_adpcm (const char *name, int chans)
+{
+    a_adpcm_t st[V];
+    clock_t t0;
+    int i, v;
+
+    for (v = 0; v < V; v++) {
+        a_adpcm_encode(pcm, FRAMES, chans, 44100, v * 100, asset[v]);
+        a_adpcm_init(&st[v], asset[v]);
+    }
+    t0 = clock();
+    for (i = 0; i < ITER; i++) {
+        a_mix_clear(acc, F * 2);
+        for (v = 0; v < V; v++) {
+            a_adpcm_mix(&st[v], acc, A_MIX_GAIN_ONE / 2, A_MIX_GAIN_ONE / 3, F);
+        }
+        a_mix_resolve(out, acc, F * 2);
+    }
+    report(name, t0, (double)ITER * F * V);
+}
+
+static void run_pcm (void)
+{
+    uint32_t pos[V];
+    clock_t t0;
+    int i, v;
+
+    for (v = 0; v < V; v++) {
+        pos[v] = v * 1000;
+    }
+    t0 = clock();
+    for (i = 0; i < ITER; i++) {
+        a_mix_clear(acc, F * 2);
+        for (v = 0; v < V; v++) {
+            a_mix_voice(acc, pcm + pos[v] * 2, A_MIX_GAIN_ONE / 2, F * 2);
+            pos[v] = (pos[v] + F) % (FRAMES - F);
+        }
+        a_mix_resolve(out, acc, F * 2);
+    }
+    report("pcm stereo", t0, (double)ITER * F * V);
+}
+
+int main (void)
+{
+    int i;
+
+    for (i = 0; i < FRAMES * 2; i++) {
+        pcm[i] = (int16_t)(12000 * sin(i * 0.01) + rand() % 2001 - 1000);
+    }
+    run_pcm();
+    run_adpcm("adpcm mono", 1);
+    run_adpcm("adpcm stereo", 2);
+    return 0;
+}
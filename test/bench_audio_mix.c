@@ -0,0 +1,84 @@
+/*
+ * Mixer throughput, 44.1 kHz stereo periods : a_mix_voices with 16 voices,
+ * and a_mix_voice_ramp per voice for mono against stereo sources, with
+ * gains steady and ramping every period.
+ * Reported as realtime voices per MHz of host clock (see bench.h) and
+ * cycles per voice frame, comparable across hosts of the same class.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <audio_mix.h>
+#include "bench.h"
+
+#define N 1024
+#define V 16
+#define ITER 20000
+
+static int16_t s[V][N], d[N];
+static int32_t acc[N];
+
+static void report (const char *name, clock_t t0, double vframes)
+{
+    double mhz = b_host_mhz(), voices = vframes / 44100.0 / b_sec(t0);
+
+    if (!mhz) {
+        printf("%s : %s path, %-16s host clock unknown, set BENCH_MHZ\n",
+               __FILE__, A_MIX_ARCH, name);
+        return;
+    }
+    printf("%s : %s path, %-16s %7.2f voices/MHz, %.2f cycles per voice frame (host %.0f MHz)\n",
+           __FILE__, A_MIX_ARCH, name, voices / mhz, mhz * 1e6 / (voices * 44100.0), mhz);
+}
+
+/*chans : 1 - mono voices, 2 - stereo; ramp - new gains every period*/
+static void run_ramp (const char *name, int chans, int ramp)
+{
+    a_mix_ramp_t r[V];
+    clock_t t0;
+    int i, v;
+
+    for (v = 0; v < V; v++) {
+        a_mix_ramp_init(&r[v], A_MIX_GAIN_ONE / 2, A_MIX_GAIN_ONE / 3);
+    }
+    a_mix_ramp_len(N / 2);
+    t0 = clock();
+    for (i = 0; i < ITER; i++) {
+        a_mix_clear(acc, N);
+        for (v = 0; v < V; v++) {
+            if (ramp) {
+                a_mix_ramp_set(&r[v], (i & 1) ? A_MIX_GAIN_ONE : 0x1000, (i & 1) ? 0x1000 : A_MIX_GAIN_ONE);
+            }
+            a_mix_voice_ramp(acc, s[v], chans, &r[v], N / 2);
+        }
+        a_mix_resolve(d, acc, N);
+    }
+    report(name, t0, (double)ITER * (N / 2) * V);
+}
+
+int main (void)
+{
+    const int16_t *src[V];
+    int16_t g[V];
+    clock_t t0;
+    int i, j;
+
+    for (i = 0; i < V; i++) {
+        src[i] = s[i];
+        g[i] = rand() & A_MIX_GAIN_ONE;
+        for (j = 0; j < N; j++) {
+            s[i][j] = (int16_t)rand();
+        }
+    }
+    t0 = clock();
+    for (i = 0; i < ITER; i++) {
+        a_mix_voices(d, acc, src, g, V, N);
+    }
+    report("voices", t0, (double)ITER * (N / 2) * V);
+
+    run_ramp("mono steady", 1, 0);
+    run_ramp("stereo steady", 2, 0);
+    run_ramp("mono ramping", 1, 1);
+    run_ramp("stereo ramping", 2, 1);
+    return 0;
+}
@@ -0,0 +1,98 @@
+/*
+ * Reverb send bus cost at 44.1 kHz, 512 frame periods : the network
+ * (a_rev_process), the per voice send (a_rev_voice, mono and stereo),
+ * and the mixer period with the bus hooked, while sending and once
+ * the tail has died out. Cycles per frame from the host clock (bench.h).
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <audio_rev.h>
+#include <audio_mix.h>
+#include "bench.h"
+
+#define RATE 44100
+#define F 512
+#define ITER 20000
+
+static int16_t st[F * 2], mono[F], out[F * 2];
+static int32_t send[F], acc[F * 2];
+
+static void report (const char *name, clock_t t0, double frames)
+{
+    double sec = b_sec(t0), mhz = b_host_mhz();
+
+    printf("%s : %-20s %6.3f%% of realtime", __FILE__, name, 100 * sec * RATE / frames);
+    if (mhz) {
+        printf(", %6.1f cycles per frame (host %.0f MHz)", sec * mhz * 1e6 / frames, mhz);
+    }
+    printf("\n");
+}
+
+static void mix_period (void)
+{
+    const int16_t *src[1] = {st};
+    int16_t g[1] = {A_MIX_GAIN_ONE / 2};
+
+    a_mix_voices(out, acc, src, g, 1, F * 2);
+}
+
+int main (void)
+{
+    a_rev_param_t p;
+    clock_t t0;
+    int i;
+
+    for (i = 0; i < F; i++) {
+        st[i * 2] = rand();
+        st[i * 2 + 1] = rand();
+        mono[i] = rand();
+        send[i] = rand() % 20000;
+    }
+    a_rev_param_default(&p, 128);
+    if (a_rev_setup(RATE, &p) < 0) {
+        return 1;
+    }
+
+    t0 = clock();
+    for (i = 0; i < ITER; i++) {
+        a_rev_process(send, acc, F);
+    }
+    report("network", t0, (double)ITER * F);
+
+    t0 = clock();
+    for (i = 0; i < ITER; i++) {
+        a_rev_voice(mono, 1, 100, F);
+    }
+    report("send, mono voice", t0, (double)ITER * F);
+    t0 = clock();
+    for (i = 0; i < ITER; i++) {
+        a_rev_voice(st, 2, 100, F);
+    }
+    report("send, stereo voice", t0, (double)ITER * F);
+
+    a_rev_clear();
+    a_mix_set_bus(NULL);
+    t0 = clock();
+    for (i = 0; i < ITER; i++) {
+        mix_period();
+    }
+    report("voice, no bus", t0, (double)ITER * F);
+    a_mix_set_bus(a_rev_return);
+    t0 = clock();
+    for (i = 0; i < ITER; i++) {
+        a_rev_voice(st, 2, 100, F);
+        mix_period();
+    }
+    report("voice, sending", t0, (double)ITER * F);
+    while (a_rev_tail()) {
+        mix_period();
+    }
+    t0 = clock();
+    for (i = 0; i < ITER; i++) {
+        mix_period();
+    }
+    report("voice, tail over", t0, (double)ITER * F);
+    return 0;
+}
@@ -0,0 +1,50 @@
+/*
+ * a_voice_alloc cost : random alloc/steal/free mix, and the worst case -
+ * full 32 voice pool in one priority level, each steal scans all of it.
+ */
+#include <stdio.h>
+#include <time.h>
+#include <audio_voice.h>
+
+#define ITER 10000000
+
+static double ns_per_op (clock_t t0)
+{
+    return 1e9 * (double)(clock() - t0) / CLOCKS_PER_SEC / ITER;
+}
+
+int main (void)
+{
+    a_voice_pool_t pool;
+    volatile int sink = 0;
+    uint32_t s = 1;
+    clock_t t0;
+    int i, voice;
+
+    a_voice_pool_init(&pool, A_VOICE_MAX);
+    t0 = clock();
+    for (i = 0; i < ITER; i++) {
+        s = s * 1103515245 + 12345;
+        voice = a_voice_alloc(&pool, s >> 24);
+        sink += voice;
+        if (((s >> 8) & 1) && voice >= 0) {
+            a_voice_free(&pool, (s >> 10) % A_VOICE_MAX);
+        }
+    }
+    printf("%s : mixed alloc/steal/free %.1f ns per op\n", __FILE__, ns_per_op(t0));
+
+    /*all voices of level 2, lowest priority ends up at the highest index*/
+    a_voice_pool_init(&pool, A_VOICE_MAX);
+    for (i = 0; i < A_VOICE_MAX; i++) {
+        a_voice_alloc(&pool, 23 - (i & 7));
+    }
+    t0 = clock();
+    for (i = 0; i < ITER; i++) {
+        voice = a_voice_alloc(&pool, 23);
+        a_voice_set_prio(&pool, voice, 16 + (i & 7));
+        sink += voice;
+    }
+    printf("%s : worst case steal (%d voices, one level) %.1f ns per op\n",
+           __FILE__, A_VOICE_MAX, ns_per_op(t0));
+    return 0;
+}
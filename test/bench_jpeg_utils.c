@@ -0,0 +1,68 @@
+/*
+ * JPEG decode color conversion cost per output format : one 800x480 4:2:0
+ * frame of random MCUs, compiled-in ARGB8888 converter against the generic
+ * converter with RGB888, dithered RGB565 and dithered L8 (16 and 256 color
+ * CLUT) line stores.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <jpeg_utils.h>
+
+#define W 800
+#define H 480
+#define ITER 50
+
+static uint8_t mcu[W * H * 3 / 2];
+static uint8_t out[W * H * 4];
+static uint32_t clut16[16], clut256[256];
+
+static void run (const char *name, uint32_t format, const uint32_t *clut, uint32_t size)
+{
+    JPEG_ConfTypeDef info = {0};
+    JPEG_YCbCrToRGB_Convert_Function func;
+    uint32_t nmcu, done;
+    clock_t t0;
+    double sec;
+    int i;
+
+    if (JPEG_SetDecodeOutputFormat(format, clut, size) != HAL_OK) {
+        printf("%s : format refused\n", name);
+        exit(1);
+    }
+    info.ColorSpace = JPEG_YCBCR_COLORSPACE;
+    info.ChromaSubsampling = JPEG_420_SUBSAMPLING;
+    info.ImageWidth = W;
+    info.ImageHeight = H;
+    JPEG_GetDecodeColorConvertFunc(&info, &func, &nmcu);
+    t0 = clock();
+    for (i = 0; i < ITER; i++) {
+        func(mcu, out, 0, sizeof(mcu), &done);
+    }
+    sec = (double)(clock() - t0) / CLOCKS_PER_SEC;
+    printf("%s : %-12s %6.2f ms per frame, %6.1f Mpixel/s\n",
+           __FILE__, name, 1e3 * sec / ITER, (double)W * H * ITER / sec / 1e6);
+}
+
+int main (void)
+{
+    uint32_t i;
+
+    for (i = 0; i < sizeof(mcu); i++) {
+        mcu[i] = rand();
+    }
+    for (i = 0; i < 16; i++) {
+        clut16[i] = (i & 1 ? 0xff0000 : 0) | (i & 2 ? 0xff00 : 0) | (i & 4 ? 0xff : 0) |
+                    (i & 8 ? 0x404040 : 0);
+    }
+    for (i = 0; i < 256; i++) {
+        clut256[i] = ((i >> 5) * 255 / 7) << 16 | (((i >> 2) & 7) * 255 / 7) << 8 | (i & 3) * 85;
+    }
+    JPEG_InitColorTables();
+    run("ARGB8888", JPEG_ARGB8888, NULL, 0);
+    run("RGB888", JPEG_RGB888, NULL, 0);
+    run("RGB565", JPEG_RGB565, NULL, 0);
+    run("L8 16", JPEG_L8, clut16, 16);
+    run("L8 256", JPEG_L8, clut256, 256);
+    return 0;
+}
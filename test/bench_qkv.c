@@ -0,0 +1,107 @@
+/*
+ * qkv settings workload against a NOR model (MX25L512 typical : 0.25 ms
+ * per 256 byte page programmed, 30 ms per 4K erase) : 100000 sets of
+ * 32 byte values, 90% to 10 hot keys, with compaction inline (in qkv_set)
+ * and in the background (qkv_gc between sets). Modelled time spent in
+ * qkv_set, worst single set, write amplification and wear spread.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <qkv.h>
+
+#define NSECT (16)
+#define KEYS (100)
+#define SETS (100000)
+#define PAGE_US (250)
+#define ERASE_US (30000)
+
+static uint8_t flash[NSECT * QKV_SECTOR];
+static uint8_t mem[1 << 16];
+static uint32_t erasecnt[NSECT];
+static double flash_us;
+
+static int flash_prog (void *hw, uint32_t off, const void *data, uint32_t size)
+{
+    const uint8_t *d = data;
+    uint32_t i;
+
+    for (i = 0; i < size; i++) {
+        flash[off + i] &= d[i];
+    }
+    flash_us += ((off + size - 1) / 256 - off / 256 + 1) * PAGE_US;
+    return 0;
+}
+
+static int flash_erase (void *hw, uint32_t off)
+{
+    memset(flash + off, 0xff, QKV_SECTOR);
+    erasecnt[off / QKV_SECTOR]++;
+    flash_us += ERASE_US;
+    return 0;
+}
+
+static const qkv_ops_t flash_ops = {flash_prog, flash_erase, NULL, NULL, NULL, NULL, NULL};
+
+static void run (int background)
+{
+    qkv_t kv;
+    char key[32];
+    uint8_t v[32];
+    double set_us = 0, worst = 0, t;
+    uint32_t i, user = 0, emin = ~0U, emax = 0;
+    int k;
+
+    memset(flash, 0xff, sizeof(flash));
+    memset(erasecnt, 0, sizeof(erasecnt));
+    srand(1);
+    if (qkv_mount(&kv, &flash_ops, flash, NSECT, mem, 256) < 0) {
+        printf("mount failed\n");
+        exit(1);
+    }
+    for (k = 0; k < KEYS; k++) {
+        sprintf(key, "cfg/key%02d", k);
+        memset(v, k, sizeof(v));
+        qkv_set(&kv, key, v, sizeof(v));
+    }
+    flash_us = 0;
+    for (i = 0; i < SETS; i++) {
+        k = rand() % 100 < 90 ? rand() % 10 : rand() % KEYS;
+        sprintf(key, "cfg/key%02d", k);
+        *(uint32_t *)v = i;
+        t = flash_us;
+        if (qkv_set(&kv, key, v, sizeof(v)) < 0) {
+            printf("set failed\n");
+            exit(1);
+        }
+        t = flash_us - t;
+        set_us += t;
+        if (t > worst) {
+            worst = t;
+        }
+        user += sizeof(v) + strlen(key);
+        if (background && i % 16 == 0) {
+            qkv_gc(&kv);
+        }
+    }
+    for (k = 0; k < NSECT; k++) {
+        if (erasecnt[k] < emin) {
+            emin = erasecnt[k];
+        }
+        if (erasecnt[k] > emax) {
+            emax = erasecnt[k];
+        }
+    }
+    printf("%s : in set %.1f s (%.0f sets/s), worst set %.1f ms, total flash %.1f s\n",
+           background ? "background gc" : "inline gc    ",
+           set_us / 1e6, SETS / (set_us / 1e6), worst / 1000, flash_us / 1e6);
+    printf("  write amp %.2f, compactions %u, erases/sector %u..%u\n",
+           (double)kv.stat.progbytes / user, kv.stat.compactions, emin, emax);
+}
+
+int main (void)
+{
+    run(0);
+    run(1);
+    return 0;
+}
@@ -0,0 +1,93 @@
+/*
+ * Unaligned SD path, hal/sd_bounce.c as SD_Driver runs it (SD_UreadDma,
+ * SD_UWrite), over the sd image driver (class 10 card model) : one command
+ * per sector through the bounce (the old path), SD_BOUNCE_SIZE chunks, and
+ * an aligned buffer straight to the driver. MB/s is what the card model
+ * sees, host time is the copy cost.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sd_image.h>
+#include <sd_bounce.h>
+#include "bench.h"
+
+#define SECTORS (16 * 1024 * 1024 / _MIN_SS)
+
+static uint8_t dst[128 * _MIN_SS + 1] __attribute__((aligned(32)));
+
+static DRESULT per_sector (int wr, BYTE *buf, DWORD sector, UINT count)
+{
+    DRESULT res = RES_OK;
+
+    while (count-- && res == RES_OK) {
+        res = wr ? sd_bounce_write(SD_ImageDriver.disk_write, 0, buf, sector, 1) :
+                   sd_bounce_read(SD_ImageDriver.disk_read, 0, buf, sector, 1);
+        sector++;
+        buf += _MIN_SS;
+    }
+    return res;
+}
+
+static DRESULT chunk (int wr, BYTE *buf, DWORD sector, UINT count)
+{
+    return wr ? sd_bounce_write(SD_ImageDriver.disk_write, 0, buf, sector, count) :
+                sd_bounce_read(SD_ImageDriver.disk_read, 0, buf, sector, count);
+}
+
+static DRESULT aligned (int wr, BYTE *buf, DWORD sector, UINT count)
+{
+    return wr ? SD_ImageDriver.disk_write(0, buf, sector, count) :
+                SD_ImageDriver.disk_read(0, buf, sector, count);
+}
+
+static int run (const char *name, DRESULT (*fn) (int, BYTE *, DWORD, UINT),
+                BYTE *buf, int wr, UINT count)
+{
+    sd_image_stat_t st;
+    clock_t t0;
+    DWORD s;
+
+    sd_image_stat_reset();
+    t0 = clock();
+    for (s = 0; s + count <= SECTORS; s += count) {
+        if (fn(wr, buf, s, count) != RES_OK) {
+            return -1;
+        }
+    }
+    sd_image_stat(&st);
+    printf("%s : %-5s %3u sectors, %-12s %6u cmds %6.2f MB/s, host %.1f ms\n",
+           __FILE__, wr ? "write" : "read", count, name, wr ? st.wrcmd : st.rdcmd,
+           SECTORS * (double)_MIN_SS / st.busy, 1e3 * b_sec(t0));
+    return 0;
+}
+
+int main (void)
+{
+    static const UINT reqs[] = {1, 8, 128};
+    const sd_image_timing_t timing = SD_IMAGE_TIMING_CLASS10;
+    char path[] = "/tmp/bench_sd_bounceXXXXXX";
+    int fd = mkstemp(path), r, wr, failed = 0;
+
+    if (fd < 0) {
+        return 1;
+    }
+    close(fd);
+    if (sd_image_open(path, SECTORS, &timing) < 0 ||
+        SD_ImageDriver.disk_initialize(0) != 0) {
+        unlink(path);
+        return 1;
+    }
+    for (wr = 0; wr < 2; wr++) {
+        for (r = 0; r < (int)(sizeof(reqs) / sizeof(reqs[0])); r++) {
+            failed |= run("per sector", per_sector, dst + 1, wr, reqs[r]);
+            failed |= run("bounce chunk", chunk, dst + 1, wr, reqs[r]);
+            failed |= run("aligned", aligned, dst, wr, reqs[r]);
+        }
+    }
+    sd_image_close();
+    unlink(path);
+    return !!failed;
+}
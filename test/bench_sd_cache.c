@@ -0,0 +1,125 @@
+/*
+ * sd_cache replay : launcher scan, asset loads, big file read and saves
+ * against a card model (0.5 ms per read command + 15 MB/s, 0.8 ms per
+ * write command + 10 MB/s), uncached and through the cache.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sd_cache.h>
+
+#define NSEC 200000
+#define SS 512
+
+typedef struct {
+    char op;
+    DWORD sector;
+    UINT count;
+} trace_op_t;
+
+static uint8_t *disk;
+static double card_us;
+static uint8_t mem[256 * 1024];
+static uint8_t buf[128 * SS];
+static trace_op_t trace[40000];
+static int tracelen;
+
+static DRESULT card_read (BYTE lun, BYTE *buff, DWORD sector, UINT count)
+{
+    card_us += 500 + count * SS / 15.0;
+    memcpy(buff, disk + sector * SS, count * SS);
+    return RES_OK;
+}
+
+static DRESULT card_write (BYTE lun, const BYTE *buff, DWORD sector, UINT count)
+{
+    card_us += 800 + count * SS / 10.0;
+    memcpy(disk + sector * SS, buff, count * SS);
+    return RES_OK;
+}
+
+static const Diskio_drvTypeDef card_drv = {NULL, NULL, card_read, card_write, NULL};
+
+static void add (char op, DWORD sector, UINT count)
+{
+    trace[tracelen].op = op;
+    trace[tracelen].sector = sector;
+    trace[tracelen].count = count;
+    tracelen++;
+}
+
+static void trace_build (void)
+{
+    DWORD base;
+    int f, i;
+
+    /*launcher scan : dir sector, FAT lookup, 2 header sectors per entry*/
+    for (f = 0; f < 300; f++) {
+        add('r', 2000 + f / 16, 1);
+        add('r', 100 + (f * 7) % 64, 1);
+        add('r', 10000 + f * 64, 1);
+        add('r', 10000 + f * 64 + 1, 1);
+    }
+    /*asset loads : small f_read chunks with FAT walks*/
+    for (f = 0; f < 40; f++) {
+        base = 50000 + f * 400;
+        add('r', 2000 + f % 20, 1);
+        for (i = 0; i < 200; i++) {
+            if (i % 8 == 0) {
+                add('r', 100 + (base / 1000) % 64, 1);
+            }
+            add('r', base + i, 1);
+        }
+    }
+    /*big file : 64 sector chunks, bypass the cache*/
+    for (i = 0; i < 200; i++) {
+        add('r', 120000 + i * 64, 64);
+    }
+    /*saves : FAT, dir entry and data rewritten*/
+    for (f = 0; f < 50; f++) {
+        add('w', 100 + f % 3, 1);
+        add('w', 2003, 1);
+        add('w', 150000 + f * 2, 2);
+    }
+    add('s', 0, 0);
+}
+
+static double replay (sd_cache_t *cache)
+{
+    const trace_op_t *t;
+    int i;
+
+    card_us = 0;
+    for (i = 0; i < tracelen; i++) {
+        t = &trace[i];
+        if (t->op == 'r') {
+            cache ? sd_cache_read(cache, buf, t->sector, t->count) :
+                    card_read(0, buf, t->sector, t->count);
+        } else if (t->op == 'w') {
+            cache ? sd_cache_write(cache, buf, t->sector, t->count) :
+                    card_write(0, buf, t->sector, t->count);
+        } else if (cache) {
+            sd_cache_sync(cache);
+        }
+    }
+    return card_us / 1000;
+}
+
+int main (void)
+{
+    sd_cache_t cache;
+    double direct, cached;
+
+    disk = calloc(NSEC, SS);
+    if (!disk || sd_cache_init(&cache, &card_drv, 0, mem, sizeof(mem), SD_CACHE_RA_DEF)) {
+        return 1;
+    }
+    trace_build();
+    direct = replay(NULL);
+    cached = replay(&cache);
+    sd_cache_stat_dump(&cache);
+    printf("%s : %d ops, uncached %.1f ms, cached %.1f ms (%.2fx)\n",
+           __FILE__, tracelen, direct, cached, direct / cached);
+    free(disk);
+    return 0;
+}
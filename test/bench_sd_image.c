@@ -0,0 +1,109 @@
+/*
+ * FAT-like access patterns on the sd image driver (class 10 card model),
+ * direct and through sd_cache : directory scan, sequential read with
+ * FAT walk, many small files opened. Model time is what the card sees.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sd_image.h>
+#include <sd_cache.h>
+
+#define SECTORS 400000
+/*layout : FAT at 32, data at 8192, 8 sector clusters, 128 entries per FAT sector*/
+#define FAT 32
+#define DATA 8192
+
+static uint8_t mem[256 * 1024], buf[64 * 512];
+static sd_cache_t cache;
+static int cached;
+static int failed;
+
+static void rd (DWORD sector, UINT count)
+{
+    DRESULT res = cached ? sd_cache_read(&cache, buf, sector, count) :
+                           SD_ImageDriver.disk_read(0, buf, sector, count);
+
+    failed |= res != RES_OK;
+}
+
+static void dirscan (void)
+{
+    DWORD dir;
+    int d, e;
+
+    for (d = 0; d < 20; d++) {
+        dir = DATA + d * 8;
+        for (e = 0; e < 100; e++) {
+            rd(dir + (e * 32 / 512) % 8, 1);
+            if (e % 16 == 15) {
+                rd(FAT + dir / 128, 1);
+            }
+            rd(FAT + (100000 + d * 1000 + e) / 128 % 2000, 1);
+        }
+    }
+}
+
+static void seqread (void)
+{
+    int i;
+
+    for (i = 0; i < 2048; i++) {
+        if (i % 2 == 0) {
+            rd(FAT + (200000 + i) / 128, 1);
+        }
+        rd(200000 + i * 8, 8);
+    }
+}
+
+static void smallopen (void)
+{
+    int f;
+
+    for (f = 0; f < 500; f++) {
+        rd(DATA + (f / 16) % 8, 1);
+        rd(DATA + (f / 16) % 8 + 1, 1);
+        rd(FAT + (300000 + f * 8) / 128, 1);
+        rd(300000 + f * 8, 1);
+    }
+}
+
+static void run (const char *name, void (*fn) (void))
+{
+    sd_image_stat_t st;
+
+    for (cached = 0; cached < 2; cached++) {
+        if (cached) {
+            sd_cache_init(&cache, &SD_ImageDriver, 0, mem, sizeof(mem), SD_CACHE_RA_DEF);
+        }
+        sd_image_stat_reset();
+        fn();
+        sd_image_stat(&st);
+        printf("%s : %-10s %-6s %5u cmds %6u sectors, %7.1f ms\n", __FILE__, name,
+               cached ? "cached" : "direct", st.rdcmd, st.rdsect, st.busy / 1000.0);
+    }
+}
+
+int main (void)
+{
+    const sd_image_timing_t timing = SD_IMAGE_TIMING_CLASS10;
+    char path[] = "/tmp/bench_sd_imageXXXXXX";
+    int fd = mkstemp(path);
+
+    if (fd < 0) {
+        return 1;
+    }
+    close(fd);
+    if (sd_image_open(path, SECTORS, &timing) < 0 ||
+        SD_ImageDriver.disk_initialize(0) != 0) {
+        unlink(path);
+        return 1;
+    }
+    run("dirscan", dirscan);
+    run("seqread", seqread);
+    run("smallopen", smallopen);
+    sd_image_close();
+    unlink(path);
+    return failed;
+}
@@ -0,0 +1,110 @@
+/*
+ * hal/sd_wq.c over the sd image driver (class 10 card model), FAT-like
+ * write patterns : log append sector by sector with FAT and directory
+ * updates, many small files created, and 64 KB streaming writes.
+ * Direct to the driver against through the write queue; model time is
+ * what the card sees, the clock advances 1 ms per request.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sd_image.h>
+#include <sd_wq.h>
+
+#define SECTORS 400000
+#define FAT 32
+#define DIR 8192
+#define DATA 16384
+
+static uint8_t buf[128 * 512] __attribute__((aligned(32)));
+static sd_wq_t wq;
+static uint32_t now;
+static int queued;
+static int failed;
+
+static uint32_t bench_ms (void)
+{
+    return now;
+}
+
+static void wr (DWORD sector, UINT count)
+{
+    DRESULT res = queued ? sd_wq_write(&wq, buf, sector, count) :
+                           SD_ImageDriver.disk_write(0, buf, sector, count);
+
+    now++;
+    failed |= res != RES_OK;
+}
+
+static void logappend (void)
+{
+    int i;
+
+    for (i = 0; i < 4000; i++) {
+        wr(DATA + i, 1);
+        if (i % 8 == 7) {
+            wr(FAT + (DATA + i) / 128, 1);
+            wr(DIR, 1);
+        }
+    }
+}
+
+static void smallfiles (void)
+{
+    int f;
+
+    for (f = 0; f < 500; f++) {
+        wr(DATA + 100000 + f * 8, 2);
+        wr(FAT + (100000 + f * 8) / 128, 1);
+        wr(DIR + 1 + f / 16, 1);
+    }
+}
+
+static void stream (void)
+{
+    int i;
+
+    for (i = 0; i < 200; i++) {
+        wr(DATA + 200000 + i * 128, 128);
+        wr(FAT + (200000 + i * 128) / 128, 1);
+    }
+}
+
+static void run (const char *name, void (*fn) (void))
+{
+    sd_image_stat_t st;
+
+    for (queued = 0; queued < 2; queued++) {
+        sd_wq_init(&wq, SD_ImageDriver.disk_write, 0, bench_ms);
+        sd_image_stat_reset();
+        fn();
+        failed |= sd_wq_flush(&wq) != RES_OK;
+        sd_image_stat(&st);
+        printf("%s : %-10s %-6s %5u cmds %6u sectors, %7.1f ms\n", __FILE__, name,
+               queued ? "queued" : "direct", st.wrcmd, st.wrsect, st.busy / 1000.0);
+    }
+}
+
+int main (void)
+{
+    const sd_image_timing_t timing = SD_IMAGE_TIMING_CLASS10;
+    char path[] = "/tmp/bench_sd_wqXXXXXX";
+    int fd = mkstemp(path);
+
+    if (fd < 0) {
+        return 1;
+    }
+    close(fd);
+    if (sd_image_open(path, SECTORS, &timing) < 0 ||
+        SD_ImageDriver.disk_initialize(0) != 0) {
+        unlink(path);
+        return 1;
+    }
+    run("logappend", logappend);
+    run("smallfiles", smallfiles);
+    run("stream", stream);
+    sd_image_close();
+    unlink(path);
+    return failed;
+}
@@ -0,0 +1,36 @@
+/*Host stand-in for the boot32 audio_main.h, what audio_int.h needs*/
+#ifndef __AUDIO_MAIN_H__
+#define __AUDIO_MAIN_H__
+
+#include <stdint.h>
+#include <misc_utils.h>
+
+#define MAX_VOL (127)
+
+typedef int16_t snd_sample_t;
+
+#define AUDIO_SAMPLES_2_BYTES(samples) ((samples) * sizeof(snd_sample_t))
+#define AUDIO_SIZE_TO_MS(rate, size) (((size) * 1000) / (rate))
+#define AUDIO_MS_TO_SIZE(rate, ms) (((rate) * (ms)) / 1000)
+
+typedef struct {
+    snd_sample_t *abuf;
+    uint32_t alen;
+    uint8_t volume;
+    uint8_t cache;
+    uint32_t loopstart;
+} Mix_Chunk;
+
+typedef struct {
+    Mix_Chunk chunk;
+    d_bool is_playing;
+    void (*complete) (int channel);
+} audio_channel_t;
+
+typedef struct {
+    uint32_t samplerate;
+    uint16_t channels;
+    uint16_t bits;
+} wave_t;
+
+#endif /*__AUDIO_MAIN_H__*/
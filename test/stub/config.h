@@ -0,0 +1,7 @@
+/*Host stand-in for the board config.h*/
+#ifndef __CONFIG_H__
+#define __CONFIG_H__
+
+#define AUDIO_MODULE_PRESENT 1
+
+#endif /*__CONFIG_H__*/
@@ -0,0 +1,10 @@
+/*Host stand-in for the boot32 debug.h*/
+#ifndef __DEBUG_H__
+#define __DEBUG_H__
+
+#include <stdio.h>
+#include <assert.h>
+
+#define dprintf printf
+
+#endif /*__DEBUG_H__*/
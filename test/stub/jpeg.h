@@ -0,0 +1,13 @@
+/*Host stand-in for the boot32 jpeg.h*/
+#ifndef __JPEG_H__
+#define __JPEG_H__
+
+#include <stdint.h>
+
+typedef struct jpeg_info_s {
+    uint32_t w, h;
+    uint32_t colormode;
+    uint32_t flags;
+} jpeg_info_t;
+
+#endif /*__JPEG_H__*/
@@ -0,0 +1,21 @@
+/*Host stand-in for the boot32 misc_utils.h*/
+#ifndef __MISC_UTILS_H__
+#define __MISC_UTILS_H__
+
+#include <string.h>
+#include <stdint.h>
+
+typedef uint32_t arch_word_t;
+typedef uint32_t irqmask_t;
+typedef int d_bool;
+#define d_true 1
+#define d_false 0
+
+#define d_memset memset
+#define d_memcpy memcpy
+#define d_memzero(p, n) memset(p, 0, n)
+#define arrlen(a) ((int)(sizeof(a) / sizeof((a)[0])))
+
+uint32_t d_time (void);
+
+#endif /*__MISC_UTILS_H__*/
@@ -0,0 +1,54 @@
+/*
+ * Host stand-in for the CMSIS device header : Cortex-M7 DSP (SIMD)
+ * intrinsics in plain C, after the ARMv7-M ARM pseudocode, so
+ * the DSP paths can be run against the scalar references.
+ */
+#ifndef __STM32F7XX_H
+#define __STM32F7XX_H
+
+#include <stdint.h>
+
+#define __HI16(x) ((int32_t)(int16_t)((x) >> 16))
+#define __LO16(x) ((int32_t)(int16_t)(x))
+
+static inline int32_t
+__SSAT (int32_t v, uint32_t bits)
+{
+    int32_t max = (1 << (bits - 1)) - 1, min = -max - 1;
+
+    return v > max ? max : v < min ? min : v;
+}
+
+static inline uint32_t
+__SMLAD (uint32_t x, uint32_t y, uint32_t acc)
+{
+    int64_t v = (int64_t)__LO16(x) * __LO16(y) + (int64_t)__HI16(x) * __HI16(y) + (int32_t)acc;
+
+    return (uint32_t)v;
+}
+
+static inline uint32_t
+__SMUAD (uint32_t x, uint32_t y)
+{
+    return __SMLAD(x, y, 0);
+}
+
+static inline uint32_t
+__SMUADX (uint32_t x, uint32_t y)
+{
+    return __SMLAD(x, (y << 16) | (y >> 16), 0);
+}
+
+static inline uint32_t
+__QADD16 (uint32_t x, uint32_t y)
+{
+    uint32_t lo = (uint16_t)__SSAT(__LO16(x) + __LO16(y), 16);
+    uint32_t hi = (uint16_t)__SSAT(__HI16(x) + __HI16(y), 16);
+
+    return lo | (hi << 16);
+}
+
+#define __PKHBT(a, b, sh) (((uint32_t)(a) & 0xffff) | (((uint32_t)(b) << (sh)) & 0xffff0000))
+#define __PKHTB(a, b, sh) (((uint32_t)(a) & 0xffff0000) | ((uint32_t)((int32_t)(b) >> (sh)) & 0xffff))
+
+#endif /*__STM32F7XX_H*/
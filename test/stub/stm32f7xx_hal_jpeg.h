@@ -0,0 +1,23 @@
+/*Host stand-in, values as in STM32F7xx_Driver/Inc/stm32f7xx_hal_jpeg.h*/
+#ifndef __STM32F7xx_HAL_JPEG_H
+#define __STM32F7xx_HAL_JPEG_H
+
+#include "stm32f7xx_hal.h"
+
+#define JPEG_GRAYSCALE_COLORSPACE ((uint32_t)0x00000000U)
+#define JPEG_YCBCR_COLORSPACE ((uint32_t)0x00000010U)
+#define JPEG_CMYK_COLORSPACE ((uint32_t)0x00000030U)
+
+#define JPEG_444_SUBSAMPLING ((uint32_t)0x00000000U)
+#define JPEG_420_SUBSAMPLING ((uint32_t)0x00000001U)
+#define JPEG_422_SUBSAMPLING ((uint32_t)0x00000002U)
+
+typedef struct {
+    uint8_t ColorSpace;
+    uint8_t ChromaSubsampling;
+    uint32_t ImageHeight;
+    uint32_t ImageWidth;
+    uint8_t ImageQuality;
+} JPEG_ConfTypeDef;
+
+#endif /*__STM32F7xx_HAL_JPEG_H*/
@@ -0,0 +1,52 @@
+/*
+ * Host stand-in for the FatFs ff_gen_drv.h (ulib, out of tree) :
+ * disk types and the driver table. Found through -Istub/ulib/io,
+ * the headers include it as "../../ulib/io/fs/FatFs/src/ff_gen_drv.h".
+ */
+#ifndef __FF_GEN_DRV_H__
+#define __FF_GEN_DRV_H__
+
+#include <stdint.h>
+
+typedef unsigned char BYTE;
+typedef uint16_t WORD;
+typedef uint32_t DWORD;
+typedef unsigned int UINT;
+typedef BYTE DSTATUS;
+
+typedef enum {
+    RES_OK = 0,
+    RES_ERROR,
+    RES_WRPRT,
+    RES_NOTRDY,
+    RES_PARERR,
+} DRESULT;
+
+#define STA_NOINIT 0x01
+#define STA_NODISK 0x02
+#define STA_PROTECT 0x04
+
+#define _MIN_SS 512
+#define _MAX_SS 512
+#define _USE_WRITE 1
+#define _USE_IOCTL 1
+
+#define CTRL_SYNC 0
+#define GET_SECTOR_COUNT 1
+#define GET_SECTOR_SIZE 2
+#define GET_BLOCK_SIZE 3
+#define CTRL_TRIM 4
+
+typedef struct {
+    DSTATUS (*disk_initialize) (BYTE);
+    DSTATUS (*disk_status) (BYTE);
+    DRESULT (*disk_read) (BYTE, BYTE *, DWORD, UINT);
+#if _USE_WRITE == 1
+    DRESULT (*disk_write) (BYTE, const BYTE *, DWORD, UINT);
+#endif
+#if _USE_IOCTL == 1
+    DRESULT (*disk_ioctl) (BYTE, BYTE, void *);
+#endif
+} Diskio_drvTypeDef;
+
+#endif /*__FF_GEN_DRV_H__*/
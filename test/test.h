@@ -0,0 +1,20 @@
+/*Minimal host test helpers, see Makefile*/
+#ifndef __TEST_H__
+#define __TEST_H__
+
+#include <stdio.h>
+
+static int t_fails;
+
+#define T_CHECK(c)                                                        \
+    do {                                                                  \
+        if (!(c)) {                                                       \
+            printf("%s:%d : check failed : %s\n", __FILE__, __LINE__, #c); \
+            t_fails++;                                                    \
+        }                                                                 \
+    } while (0)
+
+#define T_DONE()                                                          \
+    (printf("%s : %s\n", __FILE__, t_fails ? "FAIL" : "ok"), t_fails ? 1 : 0)
+
+#endif /*__TEST_H__*/
@@ -0,0 +1,121 @@
+/*
+ * hal/arena.c : bank placement in a window over a 16M device with 4M banks
+ * (unaligned window start, explicit and ANY bank, arenas never cross a
+ * bank), ARENA_ALIGN alignment and bounds of bump allocations, mark/rewind,
+ * reset, LIFO release per bank, single bank region.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <arena.h>
+#include "test.h"
+
+#define MB (1024 * 1024)
+#define BANK (4 * MB)
+
+static int bank_of (const uint8_t *org, const uint8_t *p)
+{
+    return (int)((p - org) / BANK);
+}
+
+static int in_one_bank (const uint8_t *org, const arena_t *a)
+{
+    return bank_of(org, a->base) == a->bank &&
+           bank_of(org, a->base + a->size - 1) == a->bank;
+}
+
+int main (void)
+{
+    arena_region_t reg, flat;
+    arena_t fb, rt, audio, jpeg, tmp, big, one;
+    uint8_t *org, *p, *prev = NULL, *first;
+    uint32_t mark, room2, room3, size;
+    int i;
+
+    org = aligned_alloc(4096, 16 * MB);
+    if (!org) {
+        return 1;
+    }
+
+    /*window = banks 2 and 3, start not aligned*/
+    T_CHECK(arena_region_init(&reg, org + 8 * MB + 5, 8 * MB - 5, org, BANK) == 0);
+    T_CHECK(((uintptr_t)reg.base & (ARENA_ALIGN - 1)) == 0);
+    T_CHECK(arena_region_room(&reg, 0) == 0 && arena_region_room(&reg, 1) == 0);
+    T_CHECK(arena_region_room(&reg, 2) == BANK - ARENA_ALIGN);
+    T_CHECK(arena_region_room(&reg, 3) == BANK);
+    T_CHECK(arena_region_room(&reg, ARENA_BANK_MAX) == 0);
+    T_CHECK(arena_region_init(&flat, org, 16 * MB, org, BANK + 1) < 0);
+    T_CHECK(arena_region_init(&flat, org, 16 * MB, org + 1, BANK) < 0);
+    T_CHECK(arena_region_init(&flat, org, 20 * MB, org, BANK) < 0);
+
+    /*placement : requested bank, ANY - most room*/
+    T_CHECK(arena_create(&reg, &fb, "fb", 800 * 480 * 4 * 2, 2) == 0);
+    T_CHECK(arena_create(&reg, &rt, "render", 800 * 480 * 4, 3) == 0);
+    T_CHECK(fb.bank == 2 && in_one_bank(org, &fb));
+    T_CHECK(rt.bank == 3 && in_one_bank(org, &rt));
+    T_CHECK(arena_create(&reg, &audio, "audio", 100000, ARENA_BANK_ANY) == 0);
+    T_CHECK(audio.bank == 3 && in_one_bank(org, &audio));
+    T_CHECK(audio.base == rt.base + rt.size);
+    /*bank 3 still has more room than bank 2*/
+    T_CHECK(arena_create(&reg, &jpeg, "jpeg", 1000, ARENA_BANK_ANY) == 0);
+    T_CHECK(jpeg.bank == 3 && in_one_bank(org, &jpeg) && jpeg.size == ARENA_ALIGN_UP(1000));
+    /*fits the window, not a bank*/
+    T_CHECK(arena_create(&reg, &big, "big", 5 * MB, ARENA_BANK_ANY) < 0);
+    T_CHECK(arena_create(&reg, &big, "big", 100, 1) < 0);
+    T_CHECK(arena_create(&reg, &big, "big", 100, 7) < 0);
+    T_CHECK(arena_create(&reg, &big, "big", 0, 2) < 0);
+    T_CHECK(arena_find(&reg, "audio") == &audio && !arena_find(&reg, "nope"));
+    T_CHECK(reg.list == &fb && fb.next == &rt && rt.next == &audio && audio.next == &jpeg);
+
+    /*bump allocations : aligned, ascending, in bounds*/
+    for (i = 1; (p = arena_alloc(&audio, i % 97 + 1)) != NULL; i++) {
+        T_CHECK(((uintptr_t)p & (ARENA_ALIGN - 1)) == 0);
+        T_CHECK(p >= audio.base && p + i % 97 + 1 <= audio.base + audio.size);
+        T_CHECK(!prev || p >= prev + ARENA_ALIGN);
+        prev = p;
+    }
+    T_CHECK(audio.fails == 1 && arena_room(&audio) < (uint32_t)ARENA_ALIGN_UP(i % 97 + 1));
+    T_CHECK(!arena_alloc(&audio, 0));
+    arena_reset(&audio);
+    /*size overflow on align up*/
+    T_CHECK(!arena_alloc(&audio, 0xffffffffu) && !arena_alloc(&audio, 0xffffffe1u));
+    T_CHECK(audio.used == 0 && audio.peak > audio.size - ARENA_ALIGN * 4);
+
+    /*mark / rewind*/
+    first = arena_alloc(&audio, 64);
+    mark = arena_mark(&audio);
+    T_CHECK(arena_alloc(&audio, 1000) == first + 64);
+    arena_rewind(&audio, mark);
+    T_CHECK(arena_alloc(&audio, 8) == first + 64);
+    arena_rewind(&audio, audio.size);
+    T_CHECK(audio.used == 64 + ARENA_ALIGN);
+    T_CHECK(arena_alloc(&jpeg, jpeg.size) == jpeg.base && !arena_alloc(&jpeg, 1));
+
+    /*LIFO release per bank : bank 3 holds render, audio, jpeg*/
+    room2 = arena_region_room(&reg, 2);
+    room3 = arena_region_room(&reg, 3);
+    T_CHECK(arena_release(&reg, &rt) < 0 && arena_release(&reg, &audio) < 0);
+    T_CHECK(arena_release(&reg, &jpeg) == 0);
+    T_CHECK(arena_region_room(&reg, 3) == room3 + ARENA_ALIGN_UP(1000));
+    T_CHECK(arena_region_room(&reg, 2) == room2);
+    T_CHECK(!arena_find(&reg, "jpeg") && arena_release(&reg, &jpeg) < 0);
+    T_CHECK(arena_create(&reg, &tmp, "tmp", 1000, 3) == 0 && tmp.base == jpeg.base);
+    T_CHECK(arena_release(&reg, &tmp) == 0);
+    T_CHECK(arena_release(&reg, &rt) < 0);
+    T_CHECK(arena_release(&reg, &audio) == 0 && arena_release(&reg, &rt) == 0);
+    T_CHECK(arena_release(&reg, &fb) == 0);
+    T_CHECK(arena_region_room(&reg, 2) == BANK - ARENA_ALIGN);
+    T_CHECK(arena_region_room(&reg, 3) == BANK && !reg.list);
+
+    /*no banks : whole window in bank 0*/
+    T_CHECK(arena_region_init(&flat, org, 16 * MB, org, 0) == 0);
+    T_CHECK(arena_region_room(&flat, 0) == 16 * MB && arena_region_room(&flat, 1) == 0);
+    size = 16 * MB - ARENA_ALIGN;
+    T_CHECK(arena_create(&flat, &one, "one", size, ARENA_BANK_ANY) == 0 && one.bank == 0);
+    T_CHECK(arena_create(&flat, &tmp, "tmp", ARENA_ALIGN + 1, 0) < 0);
+    T_CHECK(arena_create(&flat, &tmp, "tmp", ARENA_ALIGN, 0) == 0);
+    T_CHECK(arena_region_room(&flat, 0) == 0);
+    arena_region_dump(&flat);
+
+    free(org);
+    return T_DONE();
+}
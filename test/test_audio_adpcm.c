@@ -0,0 +1,154 @@
+/*
+ * hal/audio_adpcm.c encoder against decoder, mono and stereo : block header
+ * frames are exact, decoded signal tracks the source (snr), decode is the
+ * same in one call and in random pieces, a seek to any frame gives the same
+ * frames as the straight decode, a looped asset wraps sample exact and the
+ * decoder is counted as a mixed voice (a_mix_voices_taken).
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <audio_adpcm.h>
+#include <audio_mix.h>
+#include "test.h"
+
+#define FRAMES (5000)
+#define LOOP (1234)
+#define GAIN (0x7fff)
+
+static int16_t pcm[FRAMES * 2];
+static uint8_t asset[sizeof(a_adpcm_hdr_t) + (FRAMES / 100 + 1) * A_ADPCM_BLOCK];
+/*straight decode, stereo frames*/
+static int32_t ref[FRAMES * 2];
+static int32_t acc[FRAMES * 4];
+
+static void make_pcm (int chans)
+{
+    int i, c;
+
+    for (i = 0; i < FRAMES; i++) {
+        for (c = 0; c < chans; c++) {
+            pcm[i * chans + c] = (int16_t)(12000 * sin(i * (0.01 + c * 0.013)) +
+                                           (rand() % 2001 - 1000));
+        }
+    }
+}
+
+/*Decodes the whole asset in pieces of at most 'piece' frames*/
+static int decode (a_adpcm_t *st, int32_t *out, int frames, int piece)
+{
+    int n, done = 0;
+
+    memset(out, 0, frames * 2 * sizeof(*out));
+    while (done < frames) {
+        n = piece > 0 ? piece : 1 + rand() % 700;
+        if (n > frames - done) {
+            n = frames - done;
+        }
+        n = a_adpcm_mix(st, out + done * 2, GAIN, GAIN, n);
+        if (!n) {
+            break;
+        }
+        done += n;
+    }
+    return done;
+}
+
+static void check_chans (int chans)
+{
+    const uint32_t bf = A_ADPCM_BLOCK_FRAMES(chans);
+    a_adpcm_t st;
+    double sig = 0, err = 0, e;
+    uint32_t size;
+    int i, c, f, bad;
+
+    make_pcm(chans);
+    size = a_adpcm_encode(pcm, FRAMES, chans, 44100, A_ADPCM_NOLOOP, asset);
+    T_CHECK(size == a_adpcm_encoded_size(FRAMES, chans) && size <= sizeof(asset));
+    T_CHECK(a_adpcm_init(&st, asset) == 0);
+    T_CHECK(decode(&st, ref, FRAMES, FRAMES) == FRAMES);
+    T_CHECK(a_adpcm_done(&st));
+    T_CHECK(a_adpcm_mix(&st, acc, GAIN, GAIN, 16) == 0);
+
+    /*header frames carry the source, the rest is close to it*/
+    for (bad = 0, i = 0; i < FRAMES; i++) {
+        for (c = 0; c < 2; c++) {
+            int32_t s = pcm[i * chans + (chans == 2 ? c : 0)];
+
+            if (i % bf == 0) {
+                bad += ref[i * 2 + c] != (s * GAIN) >> 15;
+            }
+            e = ref[i * 2 + c] - (double)s;
+            sig += (double)s * s;
+            err += e * e;
+        }
+    }
+    T_CHECK(bad == 0);
+    printf("%s : %d chans, snr %.1f dB\n", __FILE__, chans, 10 * log10(sig / err));
+    T_CHECK(10 * log10(sig / err) > 25);
+
+    /*random pieces*/
+    T_CHECK(a_adpcm_init(&st, asset) == 0);
+    T_CHECK(decode(&st, acc, FRAMES, 0) == FRAMES);
+    T_CHECK(!memcmp(acc, ref, sizeof(ref)));
+
+    /*counts as one voice of the period for telemetry*/
+    a_mix_voices_taken(1);
+    a_adpcm_seek(&st, 0);
+    T_CHECK(a_adpcm_mix(&st, acc, GAIN, GAIN, 512) == 512);
+    T_CHECK(a_mix_voices_taken(512 * 2) == 1);
+
+    /*seek : block starts, around them, odd and even mono nibbles*/
+    for (bad = 0, i = 0; i < 300; i++) {
+        f = i < 8 ? (int)(bf * (i / 2) + (i & 1)) : rand() % FRAMES;
+        if (i >= 8 && i < 16) {
+            f = (bf * (i - 7) - 1) % FRAMES;
+        }
+        a_adpcm_seek(&st, f);
+        T_CHECK(decode(&st, acc, FRAMES - f, 0) == FRAMES - f);
+        bad += !!memcmp(acc, ref + f * 2, (FRAMES - f) * 2 * sizeof(*acc));
+    }
+    T_CHECK(bad == 0);
+    a_adpcm_seek(&st, FRAMES);
+    T_CHECK(a_adpcm_done(&st));
+
+    /*loop : end of data wraps to the loop frame inside one mix call*/
+    T_CHECK(a_adpcm_encode(pcm, FRAMES, chans, 44100, LOOP, asset) == size);
+    T_CHECK(a_adpcm_init(&st, asset) == 0);
+    T_CHECK(decode(&st, acc, FRAMES * 2, 0) == FRAMES * 2);
+    T_CHECK(!memcmp(acc, ref, sizeof(ref)));
+    f = FRAMES - LOOP;
+    T_CHECK(!memcmp(acc + FRAMES * 2, ref + LOOP * 2, f * 2 * sizeof(*acc)));
+    T_CHECK(!memcmp(acc + (FRAMES + f) * 2, ref + LOOP * 2, (FRAMES - f) * 2 * sizeof(*acc)));
+    T_CHECK(!a_adpcm_done(&st));
+}
+
+int main (void)
+{
+    a_adpcm_hdr_t hdr;
+    a_adpcm_t st;
+
+    check_chans(1);
+    check_chans(2);
+
+    /*header checks*/
+    a_adpcm_encode(pcm, FRAMES, 2, 44100, A_ADPCM_NOLOOP, asset);
+    memcpy(&hdr, asset, sizeof(hdr));
+    hdr.magic++;
+    memcpy(asset, &hdr, sizeof(hdr));
+    T_CHECK(a_adpcm_init(&st, asset) < 0);
+    hdr.magic--;
+    hdr.chans = 3;
+    memcpy(asset, &hdr, sizeof(hdr));
+    T_CHECK(a_adpcm_init(&st, asset) < 0);
+    hdr.chans = 2;
+    hdr.blocksize = 256;
+    memcpy(asset, &hdr, sizeof(hdr));
+    T_CHECK(a_adpcm_init(&st, asset) < 0);
+    /*loop past the end plays once*/
+    hdr.blocksize = A_ADPCM_BLOCK;
+    hdr.loopstart = FRAMES;
+    memcpy(asset, &hdr, sizeof(hdr));
+    T_CHECK(a_adpcm_init(&st, asset) == 0 && st.loopstart == A_ADPCM_NOLOOP);
+    return T_DONE();
+}
@@ -0,0 +1,151 @@
+/*
+ * hal/audio_mic.c on PDM derived input : each mic is a second order
+ * sigma-delta bitstream (64x, DC offset of either sign) decimated by
+ * a sinc3 filter, as DFSDM does. Checks steering gain, off-axis rejection,
+ * DC removal, and the peak of a period clipped at INT16_MIN.
+ */
+#include <string.h>
+#include <math.h>
+#include <audio_mic.h>
+#include "test.h"
+
+#define FS 48000
+#define OSR 64
+#define N 256
+#define PERIODS 120
+#define AMP 0.25
+#define TONE 6000.0
+
+typedef struct {
+    double i1, i2;
+    /*sinc3 integrators and combs*/
+    int64_t s1, s2, s3;
+    int64_t c1, c2, c3;
+} pdm_t;
+
+static int16_t in[N * A_MIC_MAX];
+static int16_t ringmem[N * 4];
+static a_mic_t mic;
+
+/*Mic positions, m, same layout as a_mic_xy*/
+static const double xy[A_MIC_MAX][2] = {
+    {-A_MIC_PITCH_X_UM / 2e6,  A_MIC_PITCH_Y_UM / 2e6},
+    { A_MIC_PITCH_X_UM / 2e6,  A_MIC_PITCH_Y_UM / 2e6},
+    {-A_MIC_PITCH_X_UM / 2e6, -A_MIC_PITCH_Y_UM / 2e6},
+    { A_MIC_PITCH_X_UM / 2e6, -A_MIC_PITCH_Y_UM / 2e6},
+};
+
+static int pdm_bit (pdm_t *m, double x)
+{
+    int y = m->i2 >= 0 ? 1 : -1;
+
+    m->i1 += x - y;
+    m->i2 += m->i1 - y;
+    return y;
+}
+
+/*One output sample : OSR bits through the integrators, then the combs*/
+static int16_t pdm_sample (pdm_t *m, double t0, double lead, double dc)
+{
+    int64_t v, d1, d2;
+    int k;
+
+    for (k = 0; k < OSR; k++) {
+        double t = t0 + (double)k / (FS * OSR) + lead;
+
+        m->s1 += pdm_bit(m, AMP * sin(2 * M_PI * TONE * t) + dc);
+        m->s2 += m->s1;
+        m->s3 += m->s2;
+    }
+    d1 = m->s3 - m->c1;
+    m->c1 = m->s3;
+    d2 = d1 - m->c2;
+    m->c2 = d1;
+    v = d2 - m->c3;
+    m->c3 = d2;
+    /*sinc3 gain is OSR^3*/
+    return (int16_t)((v * 32767) / ((int64_t)OSR * OSR * OSR));
+}
+
+/*Beam power against a single mic tone, dB; 'dcres' - mean of the output*/
+static double run (int chans, int steer, int srcdeg, double *dcres)
+{
+    static pdm_t pdm[A_MIC_MAX];
+    double a = srcdeg * M_PI / 180, e = 0, dc = 0;
+    int16_t *out;
+    long cnt = 0;
+    int p, i, c;
+
+    memset(pdm, 0, sizeof(pdm));
+    T_CHECK(a_mic_init(&mic, FS, chans, N, ringmem, 4) == 0);
+    a_mic_steer(&mic, steer);
+    for (p = 0; p < PERIODS; p++) {
+        for (i = 0; i < N; i++) {
+            for (c = 0; c < chans; c++) {
+                double lead = (xy[c][0] * cos(a) + xy[c][1] * sin(a)) / 343.0;
+                in[i * chans + c] = pdm_sample(&pdm[c], (double)(p * N + i) / FS,
+                                               lead, (c & 1 ? -0.02 : 0.02) * (c + 1));
+            }
+        }
+        T_CHECK(a_mic_process(&mic, in) == 0);
+        out = a_mic_rd_block(&mic);
+        T_CHECK(out != NULL);
+        if (p >= PERIODS / 2) {
+            for (i = 0; i < N; i++) {
+                e += (double)out[i] * out[i];
+                dc += out[i];
+                cnt++;
+            }
+        }
+        a_mic_rd_commit(&mic);
+    }
+    *dcres = dc / cnt;
+    return 10 * log10(e / cnt / (AMP * 32767 * AMP * 32767 / 2));
+}
+
+/*Positive half first, then a full scale negative one : peak must saturate*/
+static void check_peak (void)
+{
+    int i, c;
+
+    T_CHECK(a_mic_init(&mic, FS, 2, N, ringmem, 4) == 0);
+    a_mic_gain(&mic, 12.0f);
+    for (i = 0; i < N; i++) {
+        for (c = 0; c < 2; c++) {
+            in[i * 2 + c] = i < N / 2 ? INT16_MAX : INT16_MIN;
+        }
+    }
+    T_CHECK(a_mic_process(&mic, in) == 0);
+    T_CHECK(a_mic_rd_block(&mic)[N - 1] == INT16_MIN);
+    T_CHECK(mic.stat.peak == INT16_MAX);
+    a_mic_rd_commit(&mic);
+}
+
+int main (void)
+{
+    double on, off, dc, worstdc = 0;
+    int steer, chans;
+
+    /*sinc3 droop at 6 kHz is 0.68 dB*/
+    for (chans = 2; chans <= A_MIC_MAX; chans += 2) {
+        for (steer = 0; steer < 360; steer += 90) {
+            on = run(chans, steer, steer, &dc);
+            worstdc = fabs(dc) > worstdc ? fabs(dc) : worstdc;
+            off = run(chans, steer, steer + 180, &dc);
+            worstdc = fabs(dc) > worstdc ? fabs(dc) : worstdc;
+            printf("%d mics, steer %3d : on axis %6.2f dB, opposite %6.2f dB\n",
+                   chans, steer, on, off);
+            T_CHECK(on > -1.5 && on < 0.5);
+            /*top pair has no aperture along y*/
+            if (chans == A_MIC_MAX || steer % 180 == 0) {
+                T_CHECK(off < on - 3.0);
+            }
+        }
+    }
+    printf("dc residual %.2f lsb, %d periods\n", worstdc, mic.stat.periods);
+    T_CHECK(worstdc < 4.0);
+    /*offsets of 0.06 and -0.08 full scale were seen and removed*/
+    T_CHECK(mic.stat.dc[2] > 1500 && mic.stat.dc[3] < -2000);
+    check_peak();
+    return T_DONE();
+}
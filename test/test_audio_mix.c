@@ -0,0 +1,234 @@
+/*
+ * hal/audio_mix.c kernels against the scalar reference a_mix_voices_ref :
+ * built once per path (native SSE2, plain C, emulated Cortex-M7 DSP),
+ * full scale and clipping inputs, odd voice counts, short blocks.
+ * Pan laws : end points, -3 dB / -6 dB center, power or sum kept, mirror
+ * symmetry. Ramps : a ramp split over periods of any size joins up with
+ * the single call result, steps evenly, lands on the target exactly, and
+ * a retarget mid ramp continues from where the gain is.
+ */
+#include <stdlib.h>
+#include <math.h>
+#include <audio_mix.h>
+#include "test.h"
+
+#define N 1024
+#define V 17
+#define RAMP 100
+#define RAMP_N 300
+
+static int16_t s[V][N];
+static int16_t d0[N], d1[N];
+static int32_t acc0[N], acc1[N];
+
+static void check_pan (void)
+{
+    int16_t l, r, l2, r2, pl = A_MIX_GAIN_ONE, pr = 0;
+    double p, pmin = 2, pmax = 0;
+    int pan, bad = 0;
+
+    a_mix_pan_law(A_PAN_LINEAR);
+    a_mix_pan_gains(0, A_MIX_GAIN_ONE, &l, &r);
+    T_CHECK(l == A_MIX_GAIN_ONE && r == 0);
+    a_mix_pan_gains(255, A_MIX_GAIN_ONE, &l, &r);
+    T_CHECK(l == 0 && r == A_MIX_GAIN_ONE);
+    a_mix_pan_gains(A_PAN_CENTER, A_MIX_GAIN_ONE, &l, &r);
+    T_CHECK(abs(l - A_MIX_GAIN_ONE / 2) <= 64 && abs(r - A_MIX_GAIN_ONE / 2) <= 64);
+    for (pan = 0; pan < 256; pan++) {
+        a_mix_pan_gains(pan, A_MIX_GAIN_ONE, &l, &r);
+        a_mix_pan_gains(255 - pan, A_MIX_GAIN_ONE, &l2, &r2);
+        bad += l + r != A_MIX_GAIN_ONE;
+        bad += abs(l - r2) > 1 || l > pl || r < pr;
+        pl = l;
+        pr = r;
+    }
+    T_CHECK(bad == 0);
+
+    a_mix_pan_law(A_PAN_CONST_POWER);
+    a_mix_pan_gains(0, A_MIX_GAIN_ONE, &l, &r);
+    T_CHECK(l == A_MIX_GAIN_ONE && r == 0);
+    a_mix_pan_gains(255, A_MIX_GAIN_ONE, &l, &r);
+    T_CHECK(l == 0 && r == A_MIX_GAIN_ONE);
+    a_mix_pan_gains(A_PAN_CENTER, A_MIX_GAIN_ONE, &l, &r);
+    T_CHECK(l == r && fabs(20 * log10((double)l / A_MIX_GAIN_ONE) + 3.01) < 0.01);
+    pl = A_MIX_GAIN_ONE;
+    pr = 0;
+    for (pan = 0; pan < 256; pan++) {
+        a_mix_pan_gains(pan, A_MIX_GAIN_ONE, &l, &r);
+        a_mix_pan_gains(255 - pan, A_MIX_GAIN_ONE, &l2, &r2);
+        p = ((double)l * l + (double)r * r) / ((double)A_MIX_GAIN_ONE * A_MIX_GAIN_ONE);
+        pmin = p < pmin ? p : pmin;
+        pmax = p > pmax ? p : pmax;
+        bad += l != r2 || l > pl || r < pr;
+        pl = l;
+        pr = r;
+    }
+    T_CHECK(bad == 0);
+    /*power within 0.01 dB across the field*/
+    T_CHECK(10 * log10(pmax / pmin) < 0.01);
+    /*gain scales both sides*/
+    a_mix_pan_gains(64, A_MIX_GAIN_ONE / 4, &l2, &r2);
+    a_mix_pan_gains(64, A_MIX_GAIN_ONE, &l, &r);
+    T_CHECK(abs(l2 - l / 4) <= 1 && abs(r2 - r / 4) <= 1);
+}
+
+/*Mixes RAMP_N frames of a dc source through 'ramp', periods from 'chunks'*/
+static void ramp_render (int32_t *acc, int chans, const int *chunks, int16_t l, int16_t r)
+{
+    static int16_t dc[RAMP_N * 2];
+    a_mix_ramp_t ramp;
+    int i, done = 0, n;
+
+    for (i = 0; i < RAMP_N * 2; i++) {
+        dc[i] = INT16_MAX;
+    }
+    a_mix_clear(acc, RAMP_N * 2);
+    a_mix_ramp_init(&ramp, l, r);
+    a_mix_ramp_set(&ramp, r, l);
+    for (i = 0; done < RAMP_N; i++) {
+        n = chunks[i % 8] < RAMP_N - done ? chunks[i % 8] : RAMP_N - done;
+        a_mix_voice_ramp(acc + done * 2, dc + done * chans, chans, &ramp, n);
+        done += n;
+    }
+}
+
+static void check_ramp (int chans)
+{
+    static const int one[8] = {RAMP_N};
+    static const int odd[8] = {1, 7, 64, 13, 2, 37, 5, 100};
+    static const int tiny[8] = {1, 1, 1, 1, 1, 1, 1, 1};
+    static int32_t ref[RAMP_N * 2], out[RAMP_N * 2];
+    const int16_t lo = 0x1234, hi = A_MIX_GAIN_ONE;
+    int i, c, d, bad = 0, maxd = (hi - lo) / RAMP + 2;
+    a_mix_ramp_t ramp;
+
+    a_mix_ramp_len(RAMP);
+    ramp_render(ref, chans, one, lo, hi);
+    ramp_render(out, chans, odd, lo, hi);
+    for (i = 0; i < RAMP_N * 2; i++) {
+        bad += out[i] != ref[i];
+    }
+    ramp_render(out, chans, tiny, lo, hi);
+    for (i = 0; i < RAMP_N * 2; i++) {
+        bad += out[i] != ref[i];
+    }
+    T_CHECK(bad == 0);
+    /*left goes up, right goes down, no step bigger than the ramp step*/
+    for (c = 0; c < 2; c++) {
+        d = (((int32_t)INT16_MAX * (c ? hi : lo)) >> 15);
+        T_CHECK(abs(ref[c] - d) <= maxd);
+        for (i = 1; i < RAMP_N; i++) {
+            d = ref[i * 2 + c] - ref[(i - 1) * 2 + c];
+            bad += c ? d > 0 : d < 0;
+            bad += abs(d) > maxd;
+        }
+        /*target is exact from the last ramp frame on*/
+        for (i = RAMP - 1; i < RAMP_N; i++) {
+            bad += ref[i * 2 + c] != (((int32_t)INT16_MAX * (c ? lo : hi)) >> 15);
+        }
+    }
+    T_CHECK(bad == 0);
+
+    /*retarget halfway : no jump, back to the start value in RAMP frames*/
+    for (i = 0; i < RAMP_N * 2; i++) {
+        s[0][i % N] = INT16_MAX;
+    }
+    a_mix_clear(out, RAMP_N * 2);
+    a_mix_ramp_init(&ramp, lo, lo);
+    a_mix_ramp_set(&ramp, hi, hi);
+    a_mix_voice_ramp(out, s[0], chans, &ramp, RAMP / 2);
+    a_mix_ramp_set(&ramp, lo, lo);
+    a_mix_voice_ramp(out + RAMP, s[0], chans, &ramp, RAMP + 10);
+    T_CHECK(abs(out[RAMP] - out[RAMP - 2]) <= maxd);
+    T_CHECK(out[RAMP + 2 * (RAMP - 1)] == (((int32_t)INT16_MAX * lo) >> 15));
+    T_CHECK(out[RAMP + 2 * (RAMP + 9) + 1] == (((int32_t)INT16_MAX * lo) >> 15));
+    a_mix_ramp_len(A_MIX_RAMP_DEFAULT);
+}
+
+/*Voice count : every kernel counts once, ramp and steady parts included*/
+static void check_count (void)
+{
+    const int16_t *src[5] = {s[0], s[1], s[2], s[3], s[4]};
+    int16_t g[5] = {0x1000, 0x2000, 0x3000, 0x4000, 0x5000};
+    a_mix_ramp_t r;
+    int chans;
+
+    a_mix_voices_taken(N);
+    a_mix_voices(d0, acc0, src, g, 5, N);
+    T_CHECK(a_mix_voices_taken(N) == 5);
+    T_CHECK(a_mix_voices_taken(N) == 0);
+    for (chans = 1; chans <= 2; chans++) {
+        a_mix_clear(acc0, N);
+        a_mix_ramp_len(N / 8);
+        a_mix_ramp_init(&r, 0x1000, 0x1000);
+        a_mix_ramp_set(&r, 0x7000, 0x2000);
+        a_mix_voice_ramp(acc0, s[0], chans, &r, N / 4);
+        a_mix_voice_ramp(acc0, s[0], chans, &r, N / 4);
+        T_CHECK(a_mix_voices_taken(1) == N);
+    }
+    /*a voice cut at half period still counts*/
+    a_mix_voice(acc0, s[0], 0x1000, N);
+    a_mix_voice_lr(acc0, s[1], 0x1000, 0x2000, N);
+    a_mix_voice(acc0, s[2], 0x1000, N / 2);
+    T_CHECK(a_mix_voices_taken(N) == 3);
+    a_mix_ramp_len(A_MIX_RAMP_DEFAULT);
+}
+
+int main (void)
+{
+    const int16_t *src[V];
+    int16_t g[V], a0[N];
+    int i, j, c, n, v, bad = 0, badacc = 0;
+
+    srand(1);
+    for (i = 0; i < V; i++) {
+        src[i] = s[i];
+        for (j = 0; j < N; j++) {
+            /*mostly random, plenty of both full scale ends*/
+            s[i][j] = (rand() & 1) ? (rand() % 3 ? (int16_t)rand() : INT16_MIN) : INT16_MAX;
+        }
+    }
+    for (c = 0; c <= V; c++) {
+        for (i = 0; i < V; i++) {
+            g[i] = (i & 3) == 0 ? A_MIX_GAIN_ONE : rand() & A_MIX_GAIN_ONE;
+        }
+        for (n = 0; n <= N; n += (n < 16 ? 2 : 254)) {
+            a_mix_voices(d0, acc0, src, g, c, n);
+            a_mix_voices_ref(d1, acc1, src, g, c, n);
+            for (j = 0; j < n; j++) {
+                bad += d0[j] != d1[j];
+                badacc += acc0[j] != acc1[j];
+            }
+        }
+    }
+    T_CHECK(bad == 0);
+    T_CHECK(badacc == 0);
+
+    /*left/right gains land on their own channel*/
+    a_mix_clear(acc0, N);
+    a_mix_voice_lr(acc0, s[0], A_MIX_GAIN_ONE, 0x4000, N);
+    for (bad = 0, j = 0; j < N; j += 2) {
+        bad += acc0[j] != (s[0][j] * A_MIX_GAIN_ONE) >> 15;
+        bad += acc0[j + 1] != (s[0][j + 1] * 0x4000) >> 15;
+    }
+    T_CHECK(bad == 0);
+
+    for (j = 0; j < N; j++) {
+        a0[j] = s[0][j];
+    }
+    a_mix_add_sat(a0, s[1], N);
+    for (bad = 0, j = 0; j < N; j++) {
+        v = s[0][j] + s[1][j];
+        v = v > INT16_MAX ? INT16_MAX : v < INT16_MIN ? INT16_MIN : v;
+        bad += a0[j] != v;
+    }
+    T_CHECK(bad == 0);
+
+    check_pan();
+    check_ramp(1);
+    check_ramp(2);
+    check_count();
+
+    printf("%s : %s path\n", __FILE__, A_MIX_ARCH);
+    return T_DONE();
+}
@@ -0,0 +1,71 @@
+/*
+ * int/audio_period.h : latency presets are valid periods, the budget
+ * (period_us), dma size and ring depth/latency math, and rejection of
+ * bad sizes, including frame counts that would overflow the dma check.
+ */
+#include <audio_period.h>
+#include "test.h"
+
+static int calc (uint32_t rate, uint32_t chans, uint32_t bits, uint32_t frames,
+                 uint32_t periods, a_period_t *p)
+{
+    return a_period_calc(rate, chans, bits, frames, periods, p);
+}
+
+int main (void)
+{
+    static const uint32_t rates[] = {8000, 22050, 44100, 48000};
+    static const int depth[] = {0, 0, 0, 1, 2, 4, 4, 8, 8, 8, 8};
+    uint32_t frames, periods, r;
+    a_period_t p;
+    int e;
+
+    /*presets*/
+    for (e = A_LATENCY_LOW; e < A_LATENCY_MAX; e++) {
+        a_period_preset(e, &frames, &periods);
+        T_CHECK(frames && calc(44100, 2, 16, frames, periods, &p) == 0);
+    }
+    a_period_preset(A_LATENCY_DEFAULT, &frames, &periods);
+    T_CHECK(frames == 0 && periods == 0);
+    a_period_preset(A_LATENCY_LOW, &frames, &periods);
+    T_CHECK(calc(44100, 2, 16, frames, periods, &p) == 0);
+    T_CHECK(p.frames == 128 && p.ringdepth == 1);
+    T_CHECK(p.period_us == 2902 && p.latency_us == 2 * 2902);
+    a_period_preset(A_LATENCY_POWERSAVE, &frames, &periods);
+    T_CHECK(calc(48000, 2, 16, frames, periods, &p) == 0);
+    T_CHECK(p.ringdepth == 2 && p.period_us == 42666 && p.latency_us == 3 * 42666);
+
+    /*sizes and latency*/
+    for (r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+        for (periods = A_PERIODS_MIN; periods <= A_PERIODS_MAX; periods++) {
+            T_CHECK(calc(rates[r], 2, 16, 256, periods, &p) == 0);
+            T_CHECK(p.samples == 512 && p.bytes == 1024 && p.dmasize == 2048);
+            T_CHECK(p.ringdepth == depth[periods]);
+            T_CHECK(p.period_us == (uint32_t)(256ULL * 1000000 / rates[r]));
+            T_CHECK(p.latency_us == p.period_us * (p.ringdepth + 1));
+        }
+    }
+    T_CHECK(calc(22050, 1, 16, 512, 3, &p) == 0 && p.samples == 512 && p.dmasize == 2048);
+
+    /*bad sizes*/
+    T_CHECK(calc(0, 2, 16, 256, 4, &p) < 0);
+    T_CHECK(calc(44100, 0, 16, 256, 4, &p) < 0);
+    T_CHECK(calc(44100, 3, 16, 256, 4, &p) < 0);
+    T_CHECK(calc(44100, 2, 24, 256, 4, &p) < 0);
+    T_CHECK(calc(44100, 2, 16, A_PERIOD_MIN - A_PERIOD_ALIGN, 4, &p) < 0);
+    T_CHECK(calc(44100, 2, 16, A_PERIOD_MIN, 4, &p) == 0);
+    T_CHECK(calc(44100, 2, 16, 260, 4, &p) < 0);
+    T_CHECK(calc(44100, 2, 16, 256, A_PERIODS_MIN - 1, &p) < 0);
+    T_CHECK(calc(44100, 2, 16, 256, A_PERIODS_MAX + 1, &p) < 0);
+    /*2 periods in one dma transfer*/
+    frames = (A_PERIOD_DMA_MAX / 4) & ~(A_PERIOD_ALIGN - 1);
+    T_CHECK(calc(44100, 2, 16, frames, 4, &p) == 0 && p.dmasize / 2 <= A_PERIOD_DMA_MAX);
+    T_CHECK(calc(44100, 2, 16, frames + A_PERIOD_ALIGN, 4, &p) < 0);
+    frames = (A_PERIOD_DMA_MAX / 2) & ~(A_PERIOD_ALIGN - 1);
+    T_CHECK(calc(44100, 1, 16, frames, 4, &p) == 0);
+    T_CHECK(calc(44100, 1, 16, frames + A_PERIOD_ALIGN, 4, &p) < 0);
+    /*frames * 4 wraps to 0*/
+    T_CHECK(calc(44100, 2, 16, 0x40000000, 4, &p) < 0);
+    T_CHECK(calc(44100, 0x80000000U, 16, 256, 4, &p) < 0);
+    return T_DONE();
+}
@@ -0,0 +1,158 @@
+/*
+ * hal/audio_post.c : measured EQ response against a_post_response(),
+ * limiter ceiling on a 16 voice accumulator, mixer resolve through the chain,
+ * triple buffer handoff : the audio side always takes the latest profile,
+ * however publishes and periods interleave.
+ */
+#include <stdlib.h>
+#include <math.h>
+#include <audio_mix.h>
+#include <audio_post.h>
+#include "test.h"
+
+#define FS 48000
+#define VOICES 16
+
+static int16_t buf[FS * 2];
+static int32_t acc[FS * 4];
+static int16_t out[FS * 4];
+
+/*Gain of the chain at 'freq', dB, second half of a quarter second tone*/
+static double measure (float freq, int amp)
+{
+    int n = FS / 4, i, len;
+    double e = 0;
+
+    for (i = 0; i < n; i++) {
+        buf[2 * i] = buf[2 * i + 1] = (int16_t)(amp * sin(2 * M_PI * freq * i / FS));
+    }
+    for (i = 0; i < n * 2; i += 512) {
+        len = n * 2 - i < 512 ? n * 2 - i : 512;
+        a_post_process(buf + i, len);
+    }
+    for (i = n / 2; i < n; i++) {
+        e += (double)buf[2 * i] * buf[2 * i];
+    }
+    return 10 * log10(e / (n / 2) / (amp * (double)amp / 2));
+}
+
+static double response_error (const a_post_profile_t *prof)
+{
+    static const float freq[] = {60, 100, 150, 300, 1000, 3000, 6000, 10000, 16000};
+    double err, worst = 0;
+    int i;
+
+    T_CHECK(a_post_profile(A_POST_SPEAKER, prof) == 0);
+    T_CHECK(a_post_device(A_POST_SPEAKER) == 0);
+    for (i = 0; i < (int)(sizeof(freq) / sizeof(freq[0])); i++) {
+        err = fabs(measure(freq[i], 8000) - a_post_response(freq[i]));
+        if (err > worst) {
+            worst = err;
+        }
+    }
+    return worst;
+}
+
+int main (void)
+{
+    static const a_eq_band_t bands[] = {
+        {A_EQ_LOWSHELF, 100, 6, 0.707f},
+        {A_EQ_PEAK, 1000, -6, 1.0f},
+        {A_EQ_PEAK, 3000, 4, 2.0f},
+        {A_EQ_HIGHSHELF, 8000, -3, 0.707f},
+        {A_EQ_HIGHPASS, 150, 0, 0.707f},
+    };
+    a_post_profile_t prof = {.bands = 0, .lim = {0, 0, 1, 80}};
+    a_post_stat_t stat;
+    int16_t vbuf[VOICES][512];
+    const int16_t *src[VOICES];
+    int16_t gain[VOICES];
+    int32_t thr;
+    double err, worst = 0;
+    int i, j, peak;
+
+    a_post_init(FS);
+
+    /*each band alone, then the whole cascade*/
+    for (i = 0; i < (int)(sizeof(bands) / sizeof(bands[0])); i++) {
+        prof.band[0] = bands[i];
+        prof.bands = 1;
+        err = response_error(&prof);
+        worst = err > worst ? err : worst;
+    }
+    for (i = 0; i < (int)(sizeof(bands) / sizeof(bands[0])); i++) {
+        prof.band[i] = bands[i];
+    }
+    prof.bands = i;
+    err = response_error(&prof);
+    worst = err > worst ? err : worst;
+    printf("eq : max |measured - computed| %.3f dB\n", worst);
+    T_CHECK(worst < 0.1);
+
+    /*handoff : 1..4 publishes between periods, the last one is measured*/
+    prof.bands = 1;
+    for (i = 0, worst = 0; i < 12; i++) {
+        for (j = 0; j <= i % 4; j++) {
+            prof.band[0] = (a_eq_band_t){A_EQ_PEAK, 1000, (float)(j * 3 - i % 5), 1.0f};
+            T_CHECK(a_post_profile(A_POST_SPEAKER, &prof) == 0);
+        }
+        err = fabs(measure(1000, 8000) - prof.band[0].gain);
+        worst = err > worst ? err : worst;
+    }
+    printf("handoff : max |measured - last published| %.3f dB\n", worst);
+    T_CHECK(worst < 0.1);
+
+    /*limiter : 16 voice sum far above int16, quiet tail passes untouched*/
+    a_post_profile_get(A_POST_HEADPHONE, &prof);
+    T_CHECK(prof.lim.enable);
+    T_CHECK(a_post_device(A_POST_HEADPHONE) == 0);
+    a_post_stat_reset();
+    for (i = 0; i < 2 * FS; i++) {
+        double s = 0;
+        for (j = 0; j < VOICES; j++) {
+            s += 6000 * sin(2 * M_PI * (110 + j * 37) * i / FS + j);
+        }
+        if (i > FS / 2) {
+            s *= 0.1;
+        }
+        acc[2 * i] = (int32_t)s;
+        acc[2 * i + 1] = (int32_t)-s;
+    }
+    for (i = 0; i < FS * 4; i += 256) {
+        a_post_resolve(out + i, acc + i, 256);
+    }
+    thr = (int32_t)(32767 * pow(10, prof.lim.threshold / 20));
+    peak = 0;
+    for (i = 0; i < FS * 4; i++) {
+        peak = abs(out[i]) > peak ? abs(out[i]) : peak;
+    }
+    a_post_stat(&stat);
+    printf("limiter : in %d, out %d, threshold %d, limited %u / %u frames\n",
+           VOICES * 6000, peak, thr, stat.limited, stat.frames);
+    T_CHECK(peak <= thr + 1 && peak > thr * 9 / 10);
+    T_CHECK(stat.limited > 0 && stat.limited < stat.frames);
+
+    /*a_mix_voices resolves through the chain, a_post_process is skipped after*/
+    for (j = 0; j < VOICES; j++) {
+        src[j] = vbuf[j];
+        gain[j] = A_MIX_GAIN_ONE;
+        for (i = 0; i < 512; i++) {
+            /*1.5 kHz, 32 samples per period*/
+            vbuf[j][i] = (int16_t)(12000 * sin(2 * M_PI * (i / 2) / 32));
+        }
+    }
+    a_post_stat_reset();
+    for (i = 0; i < 64; i++) {
+        a_mix_voices(out, acc, src, gain, VOICES, 512);
+        a_post_process(out, 512);
+    }
+    a_post_stat(&stat);
+    peak = 0;
+    for (i = 0; i < 512; i++) {
+        peak = abs(out[i]) > peak ? abs(out[i]) : peak;
+    }
+    printf("mixer : %u frames resolved, limited %u, out %d\n", stat.frames, stat.limited, peak);
+    T_CHECK(stat.frames == 64 * 256 && stat.limited > 0);
+    T_CHECK(peak <= thr + 1 && peak > thr * 9 / 10);
+    return T_DONE();
+}
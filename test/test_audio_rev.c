@@ -0,0 +1,154 @@
+/*
+ * hal/audio_rev.c impulse response : the tail decays per second
+ * and dies out to exact zero, no limit cycle left in the loops.
+ * Mixer bus : voices sent by effect level through a_mix_voices() give
+ * the same wet signal as a_rev_send/a_rev_process, effect 0 sends
+ * nothing, and the network stops once its tail is really zero.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <audio_rev.h>
+#include <audio_mix.h>
+#include "test.h"
+
+#define F 441
+#define RATE 44100
+
+static int32_t send[F], acc[F * 2];
+static int16_t st[F * 2], mono[F], dup[F * 2], out[F * 2];
+
+/*Period of one voice at zero dry gain, wet only*/
+static void mix_period (void)
+{
+    const int16_t *src[1] = {st};
+    int16_t g[1] = {0};
+
+    a_mix_voices(out, acc, src, g, 1, F * 2);
+}
+
+static int silent (const int32_t *a, int n)
+{
+    while (n--) {
+        if (*a++) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * One period sent with 'chans' source, then silence : wet output through
+ * the mixer against a_rev_send/a_rev_process with 'ref' source.
+ * Returns periods which differ, < 0 - all silent.
+ */
+static int against_direct (const a_rev_param_t *p, const int16_t *src, int chans,
+                           const int16_t *ref_src, uint8_t effect)
+{
+    static int32_t wet[10][F * 2];
+    int b, bad = 0, loud = 0;
+
+    T_CHECK(a_rev_setup(RATE, p) == 0);
+    memset(send, 0, sizeof(send));
+    a_rev_send(send, ref_src, A_REV_SEND_GAIN(effect), F);
+    for (b = 0; b < 10; b++) {
+        memset(wet[b], 0, sizeof(wet[b]));
+        a_rev_process(send, wet[b], F);
+        memset(send, 0, sizeof(send));
+    }
+    T_CHECK(a_rev_setup(RATE, p) == 0);
+    for (b = 0; b < 10; b++) {
+        if (!b) {
+            a_rev_voice(src, chans, effect, F);
+        }
+        mix_period();
+        bad += memcmp(acc, wet[b], sizeof(acc)) != 0;
+        loud += !silent(acc, F * 2);
+    }
+    return loud ? bad : -1;
+}
+
+static void check_bus (uint8_t decay)
+{
+    a_rev_param_t p;
+    int i, periods;
+    uint32_t tail;
+
+    for (i = 0; i < F; i++) {
+        st[i * 2] = rand();
+        st[i * 2 + 1] = rand();
+        mono[i] = rand();
+        dup[i * 2] = dup[i * 2 + 1] = mono[i];
+    }
+    a_rev_param_default(&p, decay);
+    a_mix_set_bus(a_rev_return);
+
+    /*stereo voice through the mixer against the direct calls*/
+    T_CHECK(against_direct(&p, st, 2, st, 200) == 0);
+    /*mono voice is sent as is*/
+    T_CHECK(against_direct(&p, mono, 1, dup, 255) == 0);
+
+    /*effect 0 : dry only, network idle*/
+    T_CHECK(a_rev_setup(RATE, &p) == 0);
+    a_rev_voice(st, 2, 0, F);
+    mix_period();
+    T_CHECK(silent(acc, F * 2) && a_rev_tail() == 0);
+
+    /*tail runs out, then the network is stopped with all state at zero*/
+    a_rev_voice(st, 2, 255, F);
+    mix_period();
+    tail = a_rev_tail();
+    T_CHECK(tail > RATE / 10);
+    for (periods = 0; a_rev_tail(); periods++) {
+        mix_period();
+    }
+    T_CHECK(periods == (int)((tail + F - 1) / F));
+    for (i = 0; i < 2 * RATE / F; i++) {
+        memset(send, 0, sizeof(send));
+        memset(acc, 0, sizeof(acc));
+        a_rev_process(send, acc, F);
+        T_CHECK(silent(acc, F * 2));
+    }
+    a_mix_set_bus(NULL);
+    printf("decay %u : tail %.1f s\n", decay, (double)tail / RATE);
+}
+
+int main (void)
+{
+    a_rev_param_t p;
+    double e[10] = {0};
+    int b, i, tail;
+
+    a_rev_param_default(&p, 255);
+    T_CHECK(a_rev_setup(RATE, &p) == 0);
+    /*Impulse, then silence*/
+    memset(send, 0, sizeof(send));
+    send[0] = 20000 << 3;
+    for (b = 0; b < 10 * RATE / F; b++) {
+        memset(acc, 0, sizeof(acc));
+        a_rev_process(send, acc, F);
+        memset(send, 0, sizeof(send));
+        for (i = 0; i < F * 2; i++) {
+            e[b / (RATE / F)] += (double)acc[i] * acc[i];
+        }
+    }
+    for (i = 1; i < 10 && e[i - 1] > 0; i++) {
+        T_CHECK(e[i] < e[i - 1]);
+    }
+    /*Max decay : 60 s of silence, every output and line back to zero*/
+    for (b = 0; b < 60 * RATE / F; b++) {
+        memset(acc, 0, sizeof(acc));
+        a_rev_process(send, acc, F);
+    }
+    for (tail = 0, i = 0; i < F * 2; i++) {
+        tail += acc[i] != 0;
+    }
+    printf("energy 0 s %.3g, 1 s %.3g, 2 s %.3g, nonzero after 70 s %d\n",
+           e[0], e[1], e[2], tail);
+    T_CHECK(e[0] > 0);
+    T_CHECK(tail == 0);
+
+    check_bus(0);
+    check_bus(128);
+    check_bus(255);
+    return T_DONE();
+}
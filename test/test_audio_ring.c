@@ -0,0 +1,162 @@
+/*
+ * int/audio_ring.h on a simulated dma clock : the consumer (a_ring_play)
+ * runs once per period, the producer wakes between the periods and mixes
+ * until the ring is full, as a_hal_ring_mix does. A producer missing m
+ * wakes must give exactly max(0, m + 1 - depth) underruns and the matching
+ * lead/minlead, blocks come out in order with silence in the gaps, and
+ * the counters stay consistent over a random run past the index wrap.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <audio_ring.h>
+#include "test.h"
+
+#define BLK (8)
+
+typedef struct {
+    a_ring_t ring;
+    a_ring_stat_t stat;
+    uint32_t mem[A_RING_DEPTH_MAX][BLK];
+    uint32_t seq;       /*last block produced, 0 - none*/
+    uint32_t played;    /*last block played*/
+    int gaps;
+    int disorder;
+} sim_t;
+
+static void sim_init (sim_t *s, int depth)
+{
+    memset(s, 0, sizeof(*s));
+    a_ring_init(&s->ring, s->mem, sizeof(s->mem[0]), depth);
+    a_ring_stat_reset(&s->ring, &s->stat);
+}
+
+/*Producer wake : every block carries its sequence number*/
+static int sim_mix (sim_t *s)
+{
+    uint32_t *blk;
+    int i, cnt = 0;
+
+    while ((blk = a_ring_wr_block(&s->ring)) != NULL) {
+        s->seq++;
+        for (i = 0; i < BLK; i++) {
+            blk[i] = s->seq;
+        }
+        a_ring_wr_commit(&s->ring);
+        s->stat.produced++;
+        cnt++;
+    }
+    return cnt;
+}
+
+/*Dma period : takes one block, checks what came out*/
+static void sim_play (sim_t *s)
+{
+    uint32_t out[BLK];
+    int i, err;
+
+    memset(out, 0xaa, sizeof(out));
+    err = a_ring_play(&s->ring, &s->stat, out);
+    for (i = 1; i < BLK; i++) {
+        if (out[i] != out[0]) {
+            s->disorder++;
+        }
+    }
+    if (err) {
+        if (out[0]) {
+            s->disorder++;
+        }
+        s->gaps++;
+        return;
+    }
+    if (out[0] != s->played + 1) {
+        s->disorder++;
+    }
+    s->played = out[0];
+}
+
+/*
+ * Producer wakes halfway between the dma periods, except for 'm' periods
+ * from 'stall_at'. Returns underruns of the run.
+ */
+static uint32_t sim_stall (int depth, int m, int *minlead)
+{
+    sim_t s;
+    int k, stall_at = 20;
+
+    sim_init(&s, depth);
+    /*pre-roll*/
+    T_CHECK(sim_mix(&s) == depth);
+    a_ring_stat_reset(&s.ring, &s.stat);
+    for (k = 0; k < 100; k++) {
+        sim_play(&s);
+        if (k < stall_at || k >= stall_at + m) {
+            sim_mix(&s);
+        }
+        /*lead is taken before the block is removed*/
+        if (k <= stall_at) {
+            T_CHECK(s.stat.lead == depth);
+        } else if (k <= stall_at + m) {
+            T_CHECK(s.stat.lead == (depth - (k - stall_at) > 0 ? depth - (k - stall_at) : 0));
+        } else {
+            T_CHECK(s.stat.lead == depth);
+        }
+    }
+    T_CHECK(!s.disorder && s.gaps == (int)s.stat.underruns);
+    T_CHECK(s.stat.consumed + s.stat.underruns == 100);
+    /*pre-roll is not counted*/
+    T_CHECK(depth + s.stat.produced - s.stat.consumed == (uint32_t)a_ring_fill(&s.ring));
+    T_CHECK(s.stat.depth == depth);
+    *minlead = s.stat.minlead;
+    return s.stat.underruns;
+}
+
+/*Producer wakes at random times, sometimes late by several periods*/
+static void random_run (int depth)
+{
+    static sim_t s;
+    uint32_t t, next_dma, next_wake, period = 1000, late = 0, plays = 0;
+
+    sim_init(&s, depth);
+    sim_mix(&s);
+    next_dma = period;
+    next_wake = period / 2;
+    for (t = 0; plays < 200000; t++) {
+        if (t == next_dma) {
+            if (!a_ring_fill(&s.ring)) {
+                late++;
+            }
+            sim_play(&s);
+            plays++;
+            next_dma += period;
+        }
+        if (t == next_wake) {
+            sim_mix(&s);
+            next_wake += rand() % 50 ? 1 + rand() % period : period * (1 + rand() % (depth + 2));
+        }
+    }
+    T_CHECK(!s.disorder);
+    T_CHECK(s.stat.underruns == late && s.gaps == (int)late);
+    T_CHECK(s.stat.consumed + s.stat.underruns == plays);
+    T_CHECK(s.stat.produced - s.stat.consumed == (uint32_t)a_ring_fill(&s.ring));
+    T_CHECK(s.played == s.stat.consumed);
+    /*indices wrapped*/
+    T_CHECK(s.stat.produced > 0x10000);
+    T_CHECK(late > 0 && late < plays / 20);
+    T_CHECK(s.stat.minlead == 0 && s.stat.lead <= depth);
+    printf("depth %d : %u periods, %u underruns\n", depth, plays, late);
+}
+
+int main (void)
+{
+    int depth, m, minlead;
+
+    for (depth = 1; depth <= A_RING_DEPTH_MAX; depth <<= 1) {
+        for (m = 0; m <= A_RING_DEPTH_MAX + 3; m++) {
+            T_CHECK(sim_stall(depth, m, &minlead) == (uint32_t)(m + 1 > depth ? m + 1 - depth : 0));
+            T_CHECK(minlead == (m >= depth ? 0 : depth - m));
+        }
+    }
+    random_run(2);
+    random_run(A_RING_DEPTH_MAX);
+    return T_DONE();
+}
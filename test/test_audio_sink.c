@@ -0,0 +1,181 @@
+/*
+ * hal/audio_sink.c host build, golden file : a fixed scene (triangle pad
+ * sent to the reverb, a noise burst, a clipping square for the limiter) is
+ * rendered through the file sink and the wav must match data/audio_sink.wav
+ * byte for byte. Stat accounting is checked on a fake clock, per period
+ * cost on the host clock is reported.
+ * After an intended change of the output : .output/test_audio_sink -u
+ * rewrites the reference, check it by ear before committing.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <audio_int.h>
+#include "test.h"
+
+#define REF "data/audio_sink.wav"
+#define OUTFILE ".output/audio_sink.wav"
+#define RATE 22050
+/*master half buffer : one period*/
+#define SAMPLES 1024
+#define FRAMES (SAMPLES / 2)
+#define PERIODS 24
+
+static snd_sample_t master[SAMPLES * 2];
+static a_intcfg_t conf;
+static int16_t pad[SAMPLES], noise[SAMPLES], square[SAMPLES];
+static int32_t acc[SAMPLES];
+static uint32_t t_now, t_step;
+static int period;
+
+void
+a_get_master4idx (a_buf_t *m, int idx)
+{
+    m->buf = master + idx * SAMPLES;
+    m->samples = SAMPLES;
+    m->dirty = NULL;
+}
+
+void
+a_get_master_base (a_buf_t *m)
+{
+    m->buf = master;
+    m->samples = SAMPLES * 2;
+    m->dirty = NULL;
+}
+
+a_intcfg_t *
+a_get_conf (void)
+{
+    return &conf;
+}
+
+void
+error_handle (void)
+{
+    printf("%s : error_handle()\n", __FILE__);
+    exit(1);
+}
+
+/*Integer only sources, the reference does not depend on libm*/
+static void scene_voices (int p)
+{
+    static uint32_t seed = 1;
+    int i, t, tri;
+
+    for (i = 0; i < FRAMES; i++) {
+        t = (p * FRAMES + i) % 100;
+        tri = t < 50 ? t * 400 - 10000 : 30000 - t * 400;
+        pad[2 * i] = tri;
+        pad[2 * i + 1] = -tri / 2;
+        seed = seed * 1103515245U + 12345U;
+        noise[2 * i] = noise[2 * i + 1] = (p >= 4 && p < 8) ? (int16_t)(seed >> 16) / 4 : 0;
+        square[2 * i] = square[2 * i + 1] = ((p * FRAMES + i) / 37) & 1 ? 30000 : -30000;
+    }
+}
+
+/*The paint loop is out of tree : mixes the scene the way a_paint_buffer does*/
+void
+a_paint_buff_helper (a_buf_t *abuf)
+{
+    const int16_t *src[3] = {pad, noise, square};
+    int16_t gain[3] = {A_MIX_GAIN_ONE / 2, A_MIX_GAIN_ONE / 3, 0};
+
+    scene_voices(period);
+    if (period >= 12 && period < 18) {
+        gain[2] = A_MIX_GAIN_ONE;
+    }
+    if (period < 10) {
+        a_rev_voice(pad, 2, 100, FRAMES);
+    }
+    a_mix_voices(abuf->buf, acc, src, gain, 3, abuf->samples);
+    period++;
+}
+
+static uint32_t fake_us (void)
+{
+    t_now += t_step;
+    return t_now;
+}
+
+static long load (const char *path, uint8_t **data)
+{
+    FILE *fp = fopen(path, "rb");
+    long size;
+
+    *data = NULL;
+    if (!fp) {
+        return -1;
+    }
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    *data = malloc(size);
+    if (fread(*data, 1, size, fp) != (size_t)size) {
+        size = -1;
+    }
+    fclose(fp);
+    return size;
+}
+
+static void render (const char *path, uint32_t (*us) (void))
+{
+    memset(&conf, 0, sizeof(conf));
+    conf.samplerate = RATE;
+    conf.channels = 2;
+    conf.samplebits = 16;
+    conf.sink = A_SINK_FILE;
+    conf.path = path;
+    period = 0;
+    a_post_stat_reset();
+    a_hal_check_cfg(&conf);
+    a_hal_configure(&conf);
+    a_sink_clock(us);
+    T_CHECK(a_sink_render(PERIODS) == PERIODS);
+}
+
+int main (int argc, char **argv)
+{
+    int update = argc > 1 && !strcmp(argv[1], "-u");
+    a_sink_stat_t stat;
+    a_post_stat_t post;
+    uint8_t *ref, *out;
+    long refsize, outsize;
+    int i;
+
+    /*stat accounting : every period takes 2 clock reads*/
+    t_step = 7;
+    render(OUTFILE, fake_us);
+    a_sink_stat(&stat);
+    T_CHECK(stat.periods == PERIODS && stat.samples == PERIODS * SAMPLES);
+    T_CHECK(stat.bytes == PERIODS * SAMPLES * sizeof(snd_sample_t));
+    T_CHECK(stat.total == PERIODS * 7 && stat.min == 7 && stat.max == 7);
+    T_CHECK(stat.errors == 0);
+    T_CHECK(stat.budget == (uint64_t)SAMPLES * 1000000 / (RATE * 2));
+    a_hal_shutdown();
+
+    /*per period cost on the host clock, same scene*/
+    render(update ? REF : OUTFILE, NULL);
+    a_sink_stat_dump();
+    a_hal_shutdown();
+    /*the scene goes through the limiter*/
+    a_post_stat(&post);
+    T_CHECK(post.frames == PERIODS * FRAMES && post.limited > 0);
+
+    outsize = load(update ? REF : OUTFILE, &out);
+    T_CHECK(outsize == 44 + PERIODS * SAMPLES * (long)sizeof(snd_sample_t));
+    refsize = load(REF, &ref);
+    if (refsize < 0) {
+        printf("%s : no %s, run with -u to create it\n", __FILE__, REF);
+    }
+    T_CHECK(refsize == outsize && ref && out && !memcmp(ref, out, outsize));
+    if (refsize == outsize && ref && out) {
+        for (i = 0; i < outsize && ref[i] == out[i]; i++) {}
+        if (i < outsize) {
+            printf("%s : first difference at byte %d\n", __FILE__, i);
+        }
+    }
+    T_CHECK(out && !memcmp(out, "RIFF", 4) && !memcmp(out + 36, "data", 4));
+    free(ref);
+    free(out);
+    return T_DONE();
+}
@@ -0,0 +1,149 @@
+/*
+ * hal/audio_src.c : sine SNR against the ideal resampled signal,
+ * block split input gives the same output as one block (filter history
+ * carried over block edges), pitching up lowers the cutoff.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <audio_src.h>
+#include "test.h"
+
+#define IN 20000
+#define OUT (IN * 4)
+
+static int16_t in[IN * 2];
+static int32_t acc[OUT * 2], acc2[OUT * 2];
+
+static void
+tone (int chans, uint32_t rate, double f, double amp)
+{
+    int i;
+
+    for (i = 0; i < IN; i++) {
+        in[i * chans] = (int16_t)lrint(amp * sin(2 * M_PI * f * i / rate));
+        if (chans > 1) {
+            in[i * chans + 1] = in[i * chans];
+        }
+    }
+}
+
+/*Whole input in one block, then drained*/
+static int
+run (a_src_t *s, int32_t *out, int chans)
+{
+    int n;
+
+    memset(out, 0, sizeof(acc));
+    n = a_src_mix(s, out, 0x7fff, in, IN, OUT);
+    n += a_src_mix(s, out + n * 2, 0x7fff, NULL, 0, OUT - n);
+    return n;
+}
+
+static double
+snr (a_src_mode_e mode, int chans, uint32_t inrate, uint32_t outrate, double f)
+{
+    double sig = 0, err = 0, t, ref, d;
+    a_src_t s;
+    int i, n;
+
+    tone(chans, inrate, f, 16000);
+    a_src_init(&s, inrate, outrate, chans, mode);
+    n = run(&s, acc, chans);
+    for (i = 100; i < n - 100; i++) {
+        t = (double)i * s.step / A_SRC_ONE;
+        ref = 16000 * sin(2 * M_PI * f * t / inrate) * 32767 / 32768.0;
+        d = acc[i * 2] - ref;
+        sig += ref * ref;
+        err += d * d;
+        if (acc[i * 2] != acc[i * 2 + 1]) {
+            return -1;
+        }
+    }
+    return 10 * log10(sig / err);
+}
+
+/*Same input fed in random sized blocks, output taken in random pieces*/
+static int
+blocks_match (a_src_mode_e mode, int chans, uint32_t inrate, uint32_t outrate, uint32_t pitch)
+{
+    a_src_t s;
+    int i, n, m, pos, len, want, got;
+
+    srand(7);
+    for (i = 0; i < IN * chans; i++) {
+        in[i] = (int16_t)(rand() - RAND_MAX / 2);
+    }
+    a_src_init(&s, inrate, outrate, chans, mode);
+    a_src_pitch(&s, pitch);
+    n = run(&s, acc, chans);
+
+    a_src_init(&s, inrate, outrate, chans, mode);
+    a_src_pitch(&s, pitch);
+    memset(acc2, 0, sizeof(acc2));
+    m = 0;
+    for (pos = 0; pos < IN; pos += len) {
+        len = 1 + rand() % 300;
+        if (len > IN - pos) {
+            len = IN - pos;
+        }
+        do {
+            want = 1 + rand() % 100;
+            got = a_src_mix(&s, acc2 + m * 2, 0x7fff, in + pos * chans, len, want);
+            m += got;
+        } while (got == want);
+    }
+    m += a_src_mix(&s, acc2 + m * 2, 0x7fff, NULL, 0, OUT - m);
+    return n == m && !memcmp(acc, acc2, n * 2 * sizeof(*acc));
+}
+
+/*Output level of a tone, dB, same in and out rate*/
+static double
+level (uint32_t pitch, double f)
+{
+    double sum = 0;
+    a_src_t s;
+    int i, n;
+
+    tone(2, 44100, f, 16000);
+    a_src_init(&s, 44100, 44100, 2, A_SRC_POLY);
+    a_src_pitch(&s, pitch);
+    n = run(&s, acc, 2);
+    for (i = 100; i < n - 100; i++) {
+        sum += (double)acc[i * 2] * acc[i * 2];
+    }
+    return 10 * log10(sum / (n - 200) / (16000.0 * 16000.0 / 2));
+}
+
+int main (void)
+{
+    double lin, poly, flat, alias;
+    uint32_t p;
+
+    lin = snr(A_SRC_LINEAR, 2, 22050, 44100, 1000);
+    poly = snr(A_SRC_POLY, 2, 22050, 44100, 1000);
+    printf("22050 -> 44100, 1 kHz : linear %.1f dB, poly %.1f dB\n", lin, poly);
+    T_CHECK(lin > 40 && poly > 60);
+    poly = snr(A_SRC_POLY, 1, 48000, 44100, 1000);
+    printf("48000 -> 44100, 1 kHz mono : poly %.1f dB\n", poly);
+    T_CHECK(poly > 60);
+
+    T_CHECK(blocks_match(A_SRC_POLY, 2, 22050, 44100, A_SRC_ONE));
+    T_CHECK(blocks_match(A_SRC_POLY, 1, 11025, 44100, A_SRC_ONE * 3 / 2));
+    T_CHECK(blocks_match(A_SRC_POLY, 2, 44100, 44100, A_SRC_ONE * 5 / 2));
+    T_CHECK(blocks_match(A_SRC_LINEAR, 2, 22050, 44100, A_SRC_ONE));
+    T_CHECK(blocks_match(A_SRC_LINEAR, 1, 48000, 44100, A_SRC_ONE * 3 / 4));
+
+    /*0.7 of nyquist, over output nyquist once pitched an octave up*/
+    flat = level(A_SRC_ONE, 44100 * 0.35);
+    alias = level(A_SRC_ONE * 2, 44100 * 0.35);
+    printf("0.7 nyquist tone : %.1f dB, pitch x2 %.1f dB\n", flat, alias);
+    T_CHECK(flat > -3);
+    T_CHECK(alias < flat - 12);
+
+    /*pitch sweep runs out of tables, shares the closest lower one*/
+    for (p = A_SRC_ONE; p < A_SRC_ONE * 8; p += A_SRC_ONE / 7) {
+        T_CHECK(blocks_match(A_SRC_POLY, 2, 44100, 44100, p));
+    }
+    return T_DONE();
+}
@@ -0,0 +1,148 @@
+/*
+ * hal/audio_stream.c over an in-memory wav : looped playback is sample
+ * exact with a throttled source, reads never wrap the ring and end on
+ * file chunk boundaries (or the ring end), so a straight run behind the
+ * 44 byte header reads chunk aligned file offsets after the first read.
+ * Truncated file ends the stream, rate mismatch is refused.
+ */
+#include <string.h>
+#include <audio_stream.h>
+#include "test.h"
+
+#define FRAMES 10000
+#define RING 8192
+#define CHUNK 2048
+#define LOOP 5000
+
+static uint8_t file[44 + FRAMES * A_STREAM_FRAME];
+static uint32_t fsize, fpos;
+/*> 0 - max bytes per read*/
+static int throttle;
+static uint8_t ring[RING];
+static int badread;
+/*ring reads starting off a chunk boundary of the file*/
+static int unaligned;
+
+static int
+mem_read (void *ctx, void *buf, uint32_t n)
+{
+    uint32_t off = (uint8_t *)buf - ring;
+
+    /*header reads go elsewhere*/
+    if ((uint8_t *)buf >= ring && (uint8_t *)buf < ring + RING &&
+        (off + n > RING || ((fpos + n) % CHUNK && off + n != RING && fpos + n != fsize))) {
+        badread++;
+    }
+    if ((uint8_t *)buf >= ring && (uint8_t *)buf < ring + RING && fpos % CHUNK) {
+        unaligned++;
+    }
+    if (throttle > 0 && n > (uint32_t)throttle) {
+        n = throttle;
+    }
+    if (fpos + n > fsize) {
+        n = fpos < fsize ? fsize - fpos : 0;
+    }
+    memcpy(buf, file + fpos, n);
+    fpos += n;
+    return n;
+}
+
+static int
+mem_seek (void *ctx, uint32_t off)
+{
+    fpos = off;
+    return 0;
+}
+
+static const a_stream_src_t mem_src = {mem_read, mem_seek, NULL, NULL};
+
+static void
+le32 (uint8_t *p, uint32_t v)
+{
+    memcpy(p, &v, 4);
+}
+
+static void
+make_wav (uint32_t rate, uint32_t datalen)
+{
+    int16_t v;
+    int i;
+
+    memcpy(file, "RIFF\0\0\0\0WAVEfmt \x10\0\0\0\x01\0\x02\0\0\0\0\0\0\0\0\0\x04\0\x10\0data", 40);
+    le32(file + 24, rate);
+    le32(file + 28, rate * A_STREAM_FRAME);
+    le32(file + 40, datalen);
+    for (i = 0; i < FRAMES * 2; i++) {
+        v = i % 10000;
+        memcpy(file + 44 + i * 2, &v, 2);
+    }
+    fsize = sizeof(file);
+}
+
+int main (void)
+{
+    static int32_t acc[2 * 256];
+    a_stream_stat_t stat;
+    a_stream_t st;
+    int t, i, n, expect = 0, bad = 0, total = 0;
+
+    make_wav(44100, FRAMES * A_STREAM_FRAME);
+    T_CHECK(a_stream_open(&st, &mem_src, ring, RING, CHUNK, LOOP, 22050) < 0);
+    throttle = 0;
+    T_CHECK(a_stream_open(&st, &mem_src, ring, RING, CHUNK, LOOP, 44100) == 0);
+    for (t = 0; t < 400; t++) {
+        /*throttled half of the time*/
+        throttle = (t % 50 < 25) ? 0 : 300;
+        a_stream_fill(&st);
+        memset(acc, 0, sizeof(acc));
+        n = a_stream_mix(&st, acc, 0x7fff, 256);
+        for (i = 0; i < n; i++) {
+            bad += acc[2 * i] != (((expect * 2) % 10000) * 0x7fff) >> 15;
+            if (++expect == FRAMES) {
+                expect = LOOP;
+            }
+        }
+        total += n;
+    }
+    a_stream_stat(&st, &stat);
+    printf("frames %d, reads %u, loops %u, underruns %u, errors %u\n",
+           total, stat.reads, stat.loops, stat.underruns, stat.errors);
+    T_CHECK(bad == 0);
+    T_CHECK(badread == 0);
+    T_CHECK(stat.loops > 0 && stat.errors == 0);
+    T_CHECK(total > FRAMES * 2);
+
+    /*straight run : only the first read is off the file chunk grid*/
+    make_wav(44100, FRAMES * A_STREAM_FRAME);
+    throttle = 0;
+    badread = unaligned = 0;
+    T_CHECK(a_stream_open(&st, &mem_src, ring, RING, CHUNK, A_STREAM_NOLOOP, 44100) == 0);
+    for (expect = 0, bad = 0, t = 0; t < 100 && !a_stream_done(&st); t++) {
+        a_stream_fill(&st);
+        memset(acc, 0, sizeof(acc));
+        n = a_stream_mix(&st, acc, 0x7fff, 256);
+        for (i = 0; i < n; i++, expect++) {
+            bad += acc[2 * i] != (((expect * 2) % 10000) * 0x7fff) >> 15;
+        }
+    }
+    a_stream_stat(&st, &stat);
+    T_CHECK(a_stream_done(&st) && expect == FRAMES && bad == 0);
+    T_CHECK(badread == 0 && unaligned == 1);
+    T_CHECK(stat.reads > FRAMES * A_STREAM_FRAME / CHUNK);
+
+    /*header claims more data than the file has*/
+    make_wav(44100, FRAMES * A_STREAM_FRAME);
+    fsize = 44 + 3000 * A_STREAM_FRAME;
+    throttle = 0;
+    T_CHECK(a_stream_open(&st, &mem_src, ring, RING, CHUNK, A_STREAM_NOLOOP, 44100) == 0);
+    for (total = 0, t = 0; t < 100 && !a_stream_done(&st); t++) {
+        a_stream_fill(&st);
+        memset(acc, 0, sizeof(acc));
+        total += a_stream_mix(&st, acc, 0x7fff, 256);
+    }
+    a_stream_stat(&st, &stat);
+    T_CHECK(a_stream_done(&st));
+    T_CHECK(stat.errors == 1);
+    T_CHECK(total == 3000);
+    return T_DONE();
+}
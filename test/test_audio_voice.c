@@ -0,0 +1,108 @@
+/*
+ * hal/audio_voice.c pool : stealing policy by exact priority, handles,
+ * rejection of lower priorities.
+ */
+#include <string.h>
+#include <audio_voice.h>
+#include "test.h"
+
+static int removed = A_VOICE_NONE;
+static int empties, firsts;
+
+static void on_remove (a_voice_pool_t *pool, int voice)
+{
+    removed = voice;
+}
+
+static void on_empty (a_voice_pool_t *pool)
+{
+    empties++;
+}
+
+static void on_first (a_voice_pool_t *pool)
+{
+    firsts++;
+}
+
+static void pool_setup (a_voice_pool_t *pool, int size)
+{
+    a_voice_pool_init(pool, size);
+    pool->remove_handle = on_remove;
+    pool->empty_handle = on_empty;
+    pool->first_link_handle = on_first;
+    removed = A_VOICE_NONE;
+    empties = 0;
+    firsts = 0;
+}
+
+int main (void)
+{
+    a_voice_pool_t pool;
+    a_voice_pool_t spool = A_VOICE_POOL_INIT(16);
+    uint32_t bits;
+    int i, voice, cnt;
+
+    /*static pool matches the runtime init*/
+    a_voice_pool_init(&pool, 16);
+    T_CHECK(!memcmp(&pool, &spool, sizeof(pool)));
+
+    /*free voices first, lowest index*/
+    pool_setup(&pool, 16);
+    for (i = 0; i < 16; i++) {
+        T_CHECK(a_voice_alloc(&pool, i * 16) == i);
+    }
+    T_CHECK(firsts == 1 && pool.used == 16 && pool.steals == 0);
+
+    /*full : lowest priority (voice 0, prio 0) is the victim*/
+    T_CHECK(a_voice_alloc(&pool, 100) == 0);
+    T_CHECK(removed == 0 && pool.prio[0] == 100 && pool.steals == 1);
+    /*next lowest is voice 1, prio 16*/
+    T_CHECK(a_voice_alloc(&pool, 100) == 1);
+    /*nothing below 32 left*/
+    T_CHECK(a_voice_alloc(&pool, 31) == A_VOICE_NONE && pool.refused == 1);
+
+    /*same level, exact priority decides : prio 0 can't steal prio 7*/
+    pool_setup(&pool, 4);
+    for (i = 0; i < 4; i++) {
+        T_CHECK(a_voice_alloc(&pool, 7 - i) == i);
+    }
+    T_CHECK(A_VOICE_LEVEL(0) == A_VOICE_LEVEL(7));
+    T_CHECK(a_voice_alloc(&pool, 0) == A_VOICE_NONE);
+    T_CHECK(a_voice_alloc(&pool, 3) == A_VOICE_NONE);
+    T_CHECK(removed == A_VOICE_NONE && pool.refused == 2);
+    /*victim is prio 4 (voice 3) though it has the highest index*/
+    T_CHECK(a_voice_alloc(&pool, 4) == 3 && removed == 3);
+    /*equal priorities : lowest index*/
+    a_voice_set_prio(&pool, 1, 5);
+    a_voice_set_prio(&pool, 2, 5);
+    T_CHECK(a_voice_alloc(&pool, 6) == 3 && removed == 3);
+    T_CHECK(a_voice_alloc(&pool, 6) == 1 && removed == 1);
+
+    /*rejection is exact too : prio 5 and 6 go, 7 and 8 stay*/
+    pool_setup(&pool, 4);
+    a_voice_alloc(&pool, 5);
+    a_voice_alloc(&pool, 8);
+    a_voice_alloc(&pool, 7);
+    a_voice_alloc(&pool, 6);
+    T_CHECK(a_voice_reject_below(&pool, 7) == 2);
+    T_CHECK(a_voice_busy(&pool) == ((1U << 1) | (1U << 2)));
+    T_CHECK(a_voice_reject_below(&pool, 7) == 0);
+
+    /*iteration may free, the last free reports empty*/
+    cnt = 0;
+    a_voice_foreach(&pool, voice, bits) {
+        a_voice_free(&pool, voice);
+        cnt++;
+    }
+    T_CHECK(cnt == 2 && empties == 1 && pool.used == 0);
+
+    /*32 voices, all in one level : every steal scans the whole level*/
+    pool_setup(&pool, A_VOICE_MAX);
+    for (i = 0; i < A_VOICE_MAX; i++) {
+        T_CHECK(a_voice_alloc(&pool, 16 + (i & 7)) == i);
+    }
+    T_CHECK(pool.levels == (1U << A_VOICE_LEVEL(16)));
+    T_CHECK(a_voice_alloc(&pool, 23) == 0 && pool.prio[0] == 23);
+    T_CHECK(a_voice_alloc(&pool, 23) == 8);
+    return T_DONE();
+}
@@ -0,0 +1,135 @@
+/*
+ * hal/jpeg_pipe.c scheduler with mocked stages : stage overlap,
+ * urgent (codec) stage served between the polls of the read stage,
+ * failed jobs carried to the end.
+ */
+#include <string.h>
+#include <jpeg_pipe.h>
+#include "test.h"
+
+#define JOBS 6
+
+typedef struct {
+    int polls;      /*polls per job*/
+    int left;
+    int fail_job;   /*start of this job fails, -1 - none*/
+    int started;
+    int polled;
+} mock_t;
+
+static uint32_t now;
+static char trace[4096];
+static int tracelen;
+
+static uint32_t mock_time (void)
+{
+    return now++;
+}
+
+static int mock_start (void *ctx, jpeg_pipe_job_t *job)
+{
+    mock_t *m = ctx;
+
+    m->started++;
+    if ((int)(job - (jpeg_pipe_job_t *)job->user) == m->fail_job) {
+        return -1;
+    }
+    m->left = m->polls;
+    return 0;
+}
+
+static int mock_poll (void *ctx, jpeg_pipe_job_t *job, char tag)
+{
+    mock_t *m = ctx;
+
+    m->polled++;
+    if (tracelen < (int)sizeof(trace) - 1) {
+        trace[tracelen++] = tag;
+    }
+    return --m->left > 0 ? 0 : 1;
+}
+
+static int read_poll (void *ctx, jpeg_pipe_job_t *job)
+{
+    return mock_poll(ctx, job, 'r');
+}
+
+static int decode_poll (void *ctx, jpeg_pipe_job_t *job)
+{
+    return mock_poll(ctx, job, 'd');
+}
+
+static int convert_poll (void *ctx, jpeg_pipe_job_t *job)
+{
+    return mock_poll(ctx, job, 'c');
+}
+
+static mock_t rd, dec, cvt;
+static const jpeg_pipe_stage_ops_t read_ops = {mock_start, read_poll, &rd, 0};
+static const jpeg_pipe_stage_ops_t decode_ops = {mock_start, decode_poll, &dec, 1};
+static const jpeg_pipe_stage_ops_t decode_lazy_ops = {mock_start, decode_poll, &dec, 0};
+static const jpeg_pipe_stage_ops_t convert_ops = {mock_start, convert_poll, &cvt, 0};
+
+static uint32_t elapsed;
+
+static int run (const jpeg_pipe_stage_ops_t *decode, int fail_read, int fail_decode,
+                 jpeg_pipe_job_t *jobs)
+{
+    const jpeg_pipe_stage_ops_t *ops[JPEG_PIPE_STAGE_MAX] = {&read_ops, decode, &convert_ops};
+    jpeg_pipe_t pipe;
+    int i, err;
+
+    memset(&rd, 0, sizeof(rd));
+    memset(&dec, 0, sizeof(dec));
+    memset(&cvt, 0, sizeof(cvt));
+    rd.polls = 8;
+    dec.polls = 12;
+    cvt.polls = 2;
+    rd.fail_job = fail_read;
+    dec.fail_job = fail_decode;
+    cvt.fail_job = -1;
+    tracelen = 0;
+    memset(trace, 0, sizeof(trace));
+    memset(jobs, 0, sizeof(*jobs) * JOBS);
+    for (i = 0; i < JOBS; i++) {
+        jobs[i].user = jobs;
+    }
+    now = 0;
+    jpeg_pipe_init(&pipe, ops, 2, mock_time);
+    err = jpeg_pipe_run(&pipe, jobs, JOBS);
+    elapsed = now;
+    return err;
+}
+
+int main (void)
+{
+    jpeg_pipe_job_t jobs[JOBS];
+    uint32_t lazy;
+    int i, overlap;
+
+    T_CHECK(run(&decode_lazy_ops, -1, -1, jobs) == 0);
+    lazy = elapsed;
+
+    T_CHECK(run(&decode_ops, -1, -1, jobs) == 0);
+    T_CHECK(rd.started == JOBS && dec.started == JOBS && cvt.started == JOBS);
+    T_CHECK(rd.polled == JOBS * rd.polls);
+    T_CHECK(dec.polled == JOBS * dec.polls);
+    /*codec is polled on both sides of a read poll*/
+    overlap = 0;
+    for (i = 1; i < tracelen; i++) {
+        if (trace[i] == 'r' && trace[i - 1] == 'd') {
+            overlap++;
+        }
+    }
+    T_CHECK(overlap > 0);
+    T_CHECK(strstr(trace, "drd") != NULL);
+    /*slower codec is polled twice a tick while the read is busy*/
+    T_CHECK(elapsed < lazy);
+
+    /*failed read and failed decode start : both reported, others done*/
+    T_CHECK(run(&decode_ops, 1, 3, jobs) == 2);
+    T_CHECK(jobs[1].err < 0 && jobs[3].err < 0);
+    T_CHECK(jobs[0].err == 0 && jobs[2].err == 0 && jobs[5].err == 0);
+    T_CHECK(cvt.started == JOBS - 2);
+    return T_DONE();
+}
@@ -0,0 +1,214 @@
+/*
+ * Color conversion of Utilities/JPEG/jpeg_utils.c : runtime output formats
+ * against the compiled-in ARGB8888 converters, with and without JPEG_SWAP_RB,
+ * and ARGB8888 through the generic converter (JPEG_RGB_FORMAT = RGB888).
+ * ARGB8888 pixels are opaque either way.
+ * Encoder-only build (TEST_JPEG_ENCODER) checks the encoder input stride.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <jpeg_utils.h>
+#include "test.h"
+
+#define W 32
+#define H 16
+
+#if (USE_JPEG_DECODER == 1)
+
+static uint8_t mcu[W * H * 3];
+static uint32_t ref[W * H];
+static uint8_t out[W * H * 4];
+
+/*One image of random samples, in the MCU order of 'sub'*/
+static uint32_t
+make_mcus (uint32_t sub, uint8_t y, uint8_t cb, uint8_t cr, int random)
+{
+    uint32_t block = sub == JPEG_420_SUBSAMPLING ? 384 : 192;
+    uint32_t n = sub == JPEG_420_SUBSAMPLING ? ((W + 15) / 16) * (H / 16) : (W / 8) * (H / 8);
+    uint32_t i;
+
+    for (i = 0; i < n * block; i++) {
+        if (random) {
+            mcu[i] = rand();
+        } else {
+            uint32_t pos = i % block, luma = sub == JPEG_420_SUBSAMPLING ? 256 : 64;
+
+            mcu[i] = pos < luma ? y : pos < luma + 64 ? cb : cr;
+        }
+    }
+    return n * block;
+}
+
+static void
+decode (uint32_t sub, uint32_t size, uint8_t *dst)
+{
+    JPEG_ConfTypeDef info = {0};
+    JPEG_YCbCrToRGB_Convert_Function func;
+    uint32_t nmcu, done;
+
+    info.ColorSpace = JPEG_YCBCR_COLORSPACE;
+    info.ChromaSubsampling = sub;
+    info.ImageWidth = W;
+    info.ImageHeight = H;
+    T_CHECK(JPEG_GetDecodeColorConvertFunc(&info, &func, &nmcu) == HAL_OK);
+    memset(dst, 0xaa, sizeof(out));
+    func(mcu, dst, 0, size, &done);
+}
+
+static void
+true_rgb (uint32_t px, int *r, int *g, int *b)
+{
+#if (JPEG_SWAP_RB == 1)
+    *r = px & 0xff;
+    *b = (px >> 16) & 0xff;
+#else
+    *r = (px >> 16) & 0xff;
+    *b = px & 0xff;
+#endif
+    *g = (px >> 8) & 0xff;
+}
+
+static void
+check_formats (uint32_t sub)
+{
+    uint32_t size = make_mcus(sub, 0, 0, 0, 1), i;
+    int r, g, b, r5, g6, b5, err = 0;
+    uint16_t px;
+
+    JPEG_SetDecodeOutputFormat(JPEG_ARGB8888, NULL, 0);
+    decode(sub, size, (uint8_t *)ref);
+    for (i = 0; i < W * H; i++) {
+        T_CHECK(ref[i] >> 24 == 0xff);
+    }
+
+    JPEG_SetDecodeOutputFormat(JPEG_RGB888, NULL, 0);
+    T_CHECK(JPEG_GetDecodeBytesPerPixel() == 3);
+    decode(sub, size, out);
+    for (i = 0; i < W * H; i++) {
+        true_rgb(ref[i], &r, &g, &b);
+#if (JPEG_SWAP_RB == 1)
+        T_CHECK(out[i * 3] == r && out[i * 3 + 1] == g && out[i * 3 + 2] == b);
+#else
+        T_CHECK(out[i * 3] == b && out[i * 3 + 1] == g && out[i * 3 + 2] == r);
+#endif
+    }
+
+    JPEG_SetDecodeOutputFormat(JPEG_RGB565, NULL, 0);
+    T_CHECK(JPEG_GetDecodeBytesPerPixel() == 2);
+    decode(sub, size, out);
+    T_CHECK(out[W * H * 2] == 0xaa);
+    for (i = 0; i < W * H; i++) {
+        true_rgb(ref[i], &r, &g, &b);
+        px = ((uint16_t *)out)[i];
+#if (JPEG_SWAP_RB == 1)
+        r5 = (px & 0x1f) << 3;
+        b5 = (px >> 11) << 3;
+#else
+        r5 = (px >> 11) << 3;
+        b5 = (px & 0x1f) << 3;
+#endif
+        g6 = ((px >> 5) & 0x3f) << 2;
+        T_CHECK(abs(r5 - r) < 8 && abs(g6 - g) < 4 && abs(b5 - b) < 8);
+        err += (r5 - r) + (b5 - b);
+    }
+    /*Ordered dither : no drift to one side*/
+    T_CHECK(abs(err) / (W * H * 2) <= 2);
+}
+
+static void
+check_l8 (void)
+{
+    static const uint32_t prim[] = {0x000000, 0xff0000, 0x00ff00, 0x0000ff, 0xffffff};
+    static uint32_t grey[256];
+    uint32_t size, i;
+
+    JPEG_SetDecodeOutputFormat(JPEG_ARGB8888, NULL, 0);
+    T_CHECK(JPEG_SetDecodeOutputFormat(JPEG_L8, NULL, 0) == HAL_ERROR);
+    T_CHECK(JPEG_SetDecodeOutputFormat(JPEG_L8, prim, 5) == HAL_OK);
+    T_CHECK(JPEG_GetDecodeBytesPerPixel() == 1);
+
+    /*Pure red and pure blue : CLUT holds true colors, regardless of JPEG_SWAP_RB*/
+    size = make_mcus(JPEG_444_SUBSAMPLING, 76, 85, 255, 0);
+    decode(JPEG_444_SUBSAMPLING, size, out);
+    for (i = 0; i < W * H; i++) {
+        T_CHECK(out[i] == 1);
+    }
+    T_CHECK(out[W * H] == 0xaa);
+    size = make_mcus(JPEG_444_SUBSAMPLING, 29, 255, 107, 0);
+    decode(JPEG_444_SUBSAMPLING, size, out);
+    for (i = 0; i < W * H; i++) {
+        T_CHECK(out[i] == 3);
+    }
+
+    /*Grey levels follow luma*/
+    for (i = 0; i < 256; i++) {
+        grey[i] = i * 0x010101;
+    }
+    T_CHECK(JPEG_SetDecodeOutputFormat(JPEG_L8, grey, 256) == HAL_OK);
+    for (i = 0; i < 256; i += 15) {
+        uint32_t j;
+
+        size = make_mcus(JPEG_444_SUBSAMPLING, i, 128, 128, 0);
+        decode(JPEG_444_SUBSAMPLING, size, out);
+        for (j = 0; j < W * H; j++) {
+            T_CHECK(abs((int)out[j] - (int)i) <= 24);
+        }
+    }
+}
+
+int main (void)
+{
+    JPEG_InitColorTables();
+    check_formats(JPEG_444_SUBSAMPLING);
+    check_formats(JPEG_420_SUBSAMPLING);
+    check_l8();
+    return T_DONE();
+}
+
+#else /*USE_JPEG_DECODER*/
+
+static uint32_t img[16 * 16];
+static uint8_t mcu[4 * 192];
+
+static void
+check_ycc (const uint8_t *blk, uint32_t rgb)
+{
+    double r = (rgb >> 16) & 0xff, g = (rgb >> 8) & 0xff, b = rgb & 0xff;
+    int y = 0.299 * r + 0.587 * g + 0.114 * b + 0.5;
+    int cb = 128 - 0.1687 * r - 0.3313 * g + 0.5 * b + 0.5;
+    int cr = 128 + 0.5 * r - 0.4187 * g - 0.0813 * b + 0.5;
+    uint32_t i;
+
+    for (i = 0; i < 64; i++) {
+        T_CHECK(abs(blk[i] - y) <= 2);
+        T_CHECK(abs(blk[64 + i] - cb) <= 2);
+        T_CHECK(abs(blk[128 + i] - cr) <= 2);
+    }
+}
+
+int main (void)
+{
+    static const uint32_t left = 0xc86432, right = 0x3264c8;
+    JPEG_ConfTypeDef info = {0};
+    JPEG_RGBToYCbCr_Convert_Function func;
+    uint32_t nmcu, done, i;
+
+    JPEG_InitColorTables();
+    /*Two colors side by side : every 8x8 MCU must come out uniform*/
+    for (i = 0; i < 16 * 16; i++) {
+        img[i] = (i % 16) < 8 ? left : right;
+    }
+    info.ColorSpace = JPEG_YCBCR_COLORSPACE;
+    info.ChromaSubsampling = JPEG_444_SUBSAMPLING;
+    info.ImageWidth = 16;
+    info.ImageHeight = 16;
+    T_CHECK(JPEG_GetEncodeColorConvertFunc(&info, &func, &nmcu) == HAL_OK);
+    T_CHECK(nmcu == 4);
+    T_CHECK(func((uint8_t *)img, mcu, 0, sizeof(img), &done) == 4);
+    for (i = 0; i < 4; i++) {
+        check_ycc(mcu + i * 192, (i & 1) ? right : left);
+    }
+    return T_DONE();
+}
+
+#endif /*USE_JPEG_DECODER*/
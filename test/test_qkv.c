@@ -0,0 +1,324 @@
+/*
+ * hal/qkv.c on a simulated NOR flash (bits only go 1 -> 0, sector erase) :
+ * power is cut at random points of program/erase, leaving partly written
+ * bytes or a half erased sector. After every cut the store must mount and
+ * hold the model values, except the one key being updated, which may hold
+ * either its old or its new value. Then : updates refused by ops->begin
+ * write nothing, reads are pinned and fail when ops->pin refuses, an
+ * update is refused while a qkv_get value is held, background qkv_gc
+ * keeps qkv_set away from erases.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <qkv.h>
+#include "test.h"
+
+#define NSECT (16)
+#define NKEYS (48)
+#define MAXKEYS (64)
+#define ROUNDS (1000)
+#define VAL_MAX (4096)
+
+static uint8_t flash[NSECT * QKV_SECTOR];
+/*bytes (erase counts 64) until power cut, -1 - never*/
+static long budget = -1;
+static jmp_buf cut;
+static int bad_prog, erases, busy, unmapped, pins;
+
+static void power_cut (void)
+{
+    budget = -1;
+    longjmp(cut, 1);
+}
+
+static int flash_prog (void *hw, uint32_t off, const void *data, uint32_t size)
+{
+    const uint8_t *d = data;
+    uint32_t i;
+
+    if (off / QKV_SECTOR != (off + size - 1) / QKV_SECTOR) {
+        bad_prog++;
+    }
+    for (i = 0; i < size; i++) {
+        if (budget == 0) {
+            /*some bits made it*/
+            flash[off + i] &= d[i] | (uint8_t)rand();
+            power_cut();
+        }
+        if (budget > 0) {
+            budget--;
+        }
+        flash[off + i] &= d[i];
+    }
+    return 0;
+}
+
+static int flash_erase (void *hw, uint32_t off)
+{
+    uint32_t i;
+
+    if (off % QKV_SECTOR) {
+        bad_prog++;
+    }
+    if (budget == 0) {
+        for (i = 0; i < QKV_SECTOR; i++) {
+            if (rand() % 3 == 0) {
+                flash[off + i] = 0xff;
+            } else if (rand() % 5 == 0) {
+                flash[off + i] = rand();
+            }
+        }
+        power_cut();
+    }
+    if (budget > 0) {
+        budget = budget > 64 ? budget - 64 : 0;
+    }
+    memset(flash + off, 0xff, QKV_SECTOR);
+    erases++;
+    return 0;
+}
+
+/*As qspi_map_lock : no update under a pinned read*/
+static int flash_begin (void *hw)
+{
+    return busy || pins ? -1 : 0;
+}
+
+static int flash_pin (void *hw)
+{
+    if (unmapped) {
+        return -1;
+    }
+    pins++;
+    return 0;
+}
+
+static void flash_unpin (void *hw)
+{
+    pins--;
+}
+
+static const qkv_ops_t flash_ops = {flash_prog, flash_erase, flash_begin, NULL,
+                                    flash_pin, flash_unpin, NULL};
+
+static qkv_t kv;
+static uint8_t mem[1 << 16];
+
+/*Model, len -1 - absent*/
+static uint8_t mval[NKEYS][VAL_MAX];
+static int mlen[NKEYS];
+/*update in progress when power is cut*/
+static int inkey = -1, inlen;
+static uint8_t inval[VAL_MAX];
+static int mismatch, refused, sets;
+
+static void key_name (int k, char *s)
+{
+    sprintf(s, "cfg/key%02d%s", k, k % 7 ? "" : "/with/a/longer/name");
+}
+
+static int rand_len (void)
+{
+    int r = rand() % 100;
+
+    return r < 70 ? rand() % 40 : r < 95 ? rand() % 400 : rand() % VAL_MAX;
+}
+
+static void verify (int after_cut)
+{
+    static uint8_t buf[VAL_MAX];
+    char s[80];
+    int k, n;
+
+    for (k = 0; k < NKEYS; k++) {
+        key_name(k, s);
+        n = qkv_read(&kv, s, buf, sizeof(buf));
+        if (n == mlen[k] && (n < 0 || !memcmp(buf, mval[k], n))) {
+            continue;
+        }
+        if (!after_cut || k != inkey || n != inlen || (n > 0 && memcmp(buf, inval, n))) {
+            mismatch++;
+            continue;
+        }
+        /*the interrupted update made it*/
+        mlen[k] = n;
+        if (n > 0) {
+            memcpy(mval[k], inval, n);
+        }
+    }
+}
+
+static void ops_loop (int nops)
+{
+    static uint8_t v[VAL_MAX];
+    char s[80];
+    int i, j, k, r, len, err;
+
+    for (i = 0; i < nops; i++) {
+        r = rand() % 100;
+        k = rand() % NKEYS;
+        key_name(k, s);
+        if (r < 75) {
+            len = rand_len();
+            for (j = 0; j < len; j++) {
+                v[j] = rand();
+            }
+            if (rand() % 4 == 0 && mlen[k] > 0) {
+                len = mlen[k];
+                memcpy(v, mval[k], len);
+            }
+            inkey = k;
+            inlen = len;
+            memcpy(inval, v, len);
+            err = qkv_set(&kv, s, v, len);
+            inkey = -1;
+            if (err) {
+                /*too long, or store full of live data; never a flash error*/
+                if (kv.stat.errors) {
+                    mismatch++;
+                }
+                if (len <= (int)QKV_VAL_MAX) {
+                    refused++;
+                }
+                continue;
+            }
+            sets++;
+            mlen[k] = len;
+            memcpy(mval[k], v, len);
+        } else if (r < 90) {
+            inkey = k;
+            inlen = -1;
+            err = qkv_del(&kv, s);
+            inkey = -1;
+            if (err != (mlen[k] < 0 ? -1 : 0)) {
+                mismatch++;
+            }
+            mlen[k] = -1;
+        } else {
+            qkv_gc(&kv);
+        }
+        if (rand() % 50 == 0) {
+            verify(0);
+        }
+    }
+}
+
+static void power_cut_rounds (void)
+{
+    volatile int round, cuts = 0;
+    int k;
+
+    memset(flash, 0xff, sizeof(flash));
+    for (k = 0; k < NKEYS; k++) {
+        mlen[k] = -1;
+    }
+    for (round = 0; round < ROUNDS; round++) {
+        budget = -1;
+        if (setjmp(cut)) {
+            cuts++;
+            T_CHECK(qkv_mount(&kv, &flash_ops, flash, NSECT, mem, MAXKEYS) == 0);
+            verify(1);
+            inkey = -1;
+            continue;
+        }
+        T_CHECK(qkv_mount(&kv, &flash_ops, flash, NSECT, mem, MAXKEYS) == 0);
+        verify(0);
+        budget = rand() % 3 ? rand() % 3000 : rand() % 60000;
+        ops_loop(200);
+        budget = -1;
+    }
+    T_CHECK(!mismatch && !bad_prog);
+    T_CHECK(cuts > ROUNDS / 2 && sets > ROUNDS * 10);
+    printf("%d rounds, %d cuts, %d sets, %d refused (full)\n", round, cuts, sets, refused);
+}
+
+static int count_key (void *arg, const char *key, const void *val, uint32_t len)
+{
+    (*(int *)arg)++;
+    return pins == 1 ? 0 : -1;
+}
+
+/*ops->begin refuses : nothing is written, store unchanged; ops->pin refuses : no read*/
+static void busy_updates (void)
+{
+    static uint8_t copy[sizeof(flash)];
+    const void *val;
+    uint32_t len;
+    int i;
+
+    memset(flash, 0xff, sizeof(flash));
+    T_CHECK(qkv_mount(&kv, &flash_ops, flash, NSECT, mem, MAXKEYS) == 0);
+    T_CHECK(qkv_set(&kv, "a", "1", 1) == 0);
+    T_CHECK(qkv_set(&kv, "b", "2", 1) == 0);
+    memcpy(copy, flash, sizeof(flash));
+    busy = 1;
+    T_CHECK(qkv_set(&kv, "a", "3", 1) < 0);
+    T_CHECK(qkv_set(&kv, "c", "4", 1) < 0);
+    T_CHECK(qkv_del(&kv, "b") < 0);
+    T_CHECK(kv.stat.busy == 3);
+    /*unchanged value needs no write*/
+    T_CHECK(qkv_set(&kv, "a", "1", 1) == 0);
+    T_CHECK(!memcmp(copy, flash, sizeof(flash)));
+    busy = 0;
+    T_CHECK(qkv_get(&kv, "a", &val, &len) == 0 && len == 1 && !memcmp(val, "1", 1));
+    /*held value : the update is refused*/
+    T_CHECK(pins == 1 && qkv_set(&kv, "a", "5", 1) < 0);
+    qkv_put(&kv, val);
+    T_CHECK(qkv_get(&kv, "c", &val, &len) < 0 && pins == 0);
+    /*flash unmapped : reads fail, nothing is pinned*/
+    unmapped = 1;
+    T_CHECK(qkv_get(&kv, "a", &val, &len) < 0);
+    T_CHECK(qkv_read(&kv, "a", copy, 1) < 0);
+    T_CHECK(qkv_set(&kv, "a", "1", 1) < 0 && qkv_del(&kv, "a") < 0);
+    i = 0;
+    T_CHECK(qkv_foreach(&kv, count_key, &i) < 0 && i == 0);
+    unmapped = 0;
+    T_CHECK(pins == 0 && qkv_read(&kv, "a", copy, 1) == 1 && copy[0] == '1');
+    T_CHECK(qkv_foreach(&kv, count_key, &i) == 0 && i == 2 && pins == 0);
+    /*head stays open for appends*/
+    T_CHECK(qkv_set(&kv, "c", "4", 1) == 0);
+    T_CHECK(kv.sect[kv.head].seq == 1);
+
+    /*gc is refused too*/
+    for (i = 0; kv.nfree >= QKV_GC_FREE; i++) {
+        T_CHECK(qkv_set(&kv, "fill", &i, sizeof(i)) == 0);
+    }
+    busy = 1;
+    T_CHECK(qkv_gc(&kv) < 0);
+    busy = 0;
+    T_CHECK(qkv_gc(&kv) == 1);
+}
+
+/*Background gc between sets : sets never wait for an erase*/
+static void background_gc (void)
+{
+    char s[80];
+    uint8_t v[32];
+    int i, k, e, inline_erases = 0;
+
+    memset(flash, 0xff, sizeof(flash));
+    T_CHECK(qkv_mount(&kv, &flash_ops, flash, NSECT, mem, MAXKEYS) == 0);
+    for (i = 0; i < 20000; i++) {
+        k = rand() % 100 < 90 ? rand() % 8 : rand() % 40;
+        sprintf(s, "hot/%d", k);
+        memset(v, i, sizeof(v));
+        e = erases;
+        T_CHECK(qkv_set(&kv, s, v, sizeof(v)) == 0);
+        inline_erases += erases - e;
+        if (i % 8 == 0) {
+            qkv_gc(&kv);
+        }
+    }
+    T_CHECK(kv.stat.compactions > 100);
+    T_CHECK(inline_erases == 0);
+}
+
+int main (void)
+{
+    T_CHECK(qkv_memsize(NSECT, MAXKEYS) <= sizeof(mem));
+    power_cut_rounds();
+    busy_updates();
+    background_gc();
+    return T_DONE();
+}
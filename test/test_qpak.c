@@ -0,0 +1,188 @@
+/*
+ * hal/qpak.c lookup and tools/qpak.c packer : a directory tree with
+ * nested names, an empty file and an FNV-1a collision pair is packed,
+ * then every file is found by name with its own bytes on QPAK_ALIGN,
+ * missing names are not found and damaged headers/indexes are refused.
+ * The packer main is linked in as qpak_tool_main, see Makefile.
+ */
+#define _XOPEN_SOURCE 700
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <qpak.h>
+#include "test.h"
+
+int qpak_tool_main (int argc, char **argv);
+
+typedef struct {
+    const char *name;
+    uint32_t size;
+} file_t;
+
+/*"costarring" and "liquid" share the FNV-1a hash*/
+static const file_t files[] = {
+    {"costarring", 100},
+    {"liquid", 33},
+    {"a.bin", 1},
+    {"empty", 0},
+    {"img/logo.jpg", 5000},
+    {"img/icons/ok.bmp", 64},
+    {"snd/click.adp", 4097},
+};
+
+static char root[64];
+
+static uint8_t fill (const char *name, uint32_t i)
+{
+    return (uint8_t)(qpak_hash(name) + i * 7);
+}
+
+static int mkfile (const file_t *f)
+{
+    char path[256], *p;
+    FILE *fp;
+    uint32_t i;
+
+    snprintf(path, sizeof(path), "%s/%s", root, f->name);
+    for (p = strchr(path + strlen(root) + 1, '/'); p; p = strchr(p + 1, '/')) {
+        *p = 0;
+        mkdir(path, 0700);
+        *p = '/';
+    }
+    fp = fopen(path, "wb");
+    if (!fp) {
+        return -1;
+    }
+    for (i = 0; i < f->size; i++) {
+        fputc(fill(f->name, i), fp);
+    }
+    fclose(fp);
+    return 0;
+}
+
+static uint8_t *load (const char *path, long *size)
+{
+    FILE *fp = fopen(path, "rb");
+    uint8_t *buf;
+
+    if (!fp) {
+        return NULL;
+    }
+    fseek(fp, 0, SEEK_END);
+    *size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    buf = malloc(*size);
+    if (buf && fread(buf, 1, *size, fp) != (size_t)*size) {
+        free(buf);
+        buf = NULL;
+    }
+    fclose(fp);
+    return buf;
+}
+
+static int same (const uint8_t *data, const file_t *f)
+{
+    uint32_t i;
+
+    for (i = 0; i < f->size; i++) {
+        if (data[i] != fill(f->name, i)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int main (void)
+{
+    char out[96], cmd[sizeof(root) + sizeof(out) + 16];
+    char *pack_argv[] = {"qpak", out, root, NULL};
+    char *list_argv[] = {"qpak", "-l", out, NULL};
+    const qpak_hdr_t *hdr;
+    const qpak_ent_t *ent;
+    uint8_t *pak, *bad;
+    long size;
+    uint32_t i;
+
+    T_CHECK(qpak_hash("costarring") == qpak_hash("liquid"));
+
+    strcpy(root, "/tmp/test_qpak_XXXXXX");
+    if (!mkdtemp(root)) {
+        printf("mkdtemp failed\n");
+        return 1;
+    }
+    for (i = 0; i < sizeof(files) / sizeof(files[0]); i++) {
+        T_CHECK(mkfile(&files[i]) == 0);
+    }
+    snprintf(out, sizeof(out), "%s.pak", root);
+    T_CHECK(qpak_tool_main(3, pack_argv) == 0);
+    T_CHECK(qpak_tool_main(3, list_argv) == 0);
+
+    pak = load(out, &size);
+    T_CHECK(pak != NULL);
+    if (!pak) {
+        return T_DONE();
+    }
+    hdr = (const qpak_hdr_t *)pak;
+    T_CHECK(qpak_check(pak, size) == 0);
+    T_CHECK(hdr->count == sizeof(files) / sizeof(files[0]));
+    T_CHECK(hdr->size == (uint32_t)size && !(size & (QPAK_ALIGN - 1)));
+    T_CHECK(hdr->crc == qpak_crc32(0, pak + sizeof(*hdr), hdr->size - sizeof(*hdr)));
+
+    for (i = 0; i < sizeof(files) / sizeof(files[0]); i++) {
+        ent = qpak_find(pak, files[i].name);
+        T_CHECK(ent != NULL);
+        if (!ent) {
+            continue;
+        }
+        T_CHECK(!strcmp(qpak_name(pak, ent), files[i].name));
+        T_CHECK(ent->size == files[i].size);
+        T_CHECK(!(ent->offset & (QPAK_ALIGN - 1)));
+        T_CHECK(same(qpak_data(pak, ent), &files[i]));
+    }
+    /*index is sorted, both halves of the collision are kept apart*/
+    ent = qpak_index(pak);
+    for (i = 1; i < hdr->count; i++) {
+        T_CHECK(ent[i - 1].hash <= ent[i].hash);
+    }
+    T_CHECK(qpak_find(pak, "costarring") != qpak_find(pak, "liquid"));
+
+    T_CHECK(qpak_find(pak, "missing") == NULL);
+    T_CHECK(qpak_find(pak, "img") == NULL);
+    T_CHECK(qpak_find(pak, "img/logo.jp") == NULL);
+    T_CHECK(qpak_find(pak, "") == NULL);
+
+    /*damaged archives*/
+    bad = malloc(size);
+    T_CHECK(qpak_check(pak, sizeof(*hdr) - 1) < 0);
+    T_CHECK(qpak_check(pak, size - 1) < 0);
+    memcpy(bad, pak, size);
+    ((qpak_hdr_t *)bad)->magic ^= 1;
+    T_CHECK(qpak_check(bad, size) < 0);
+    memcpy(bad, pak, size);
+    ((qpak_hdr_t *)bad)->count = size;
+    T_CHECK(qpak_check(bad, size) < 0);
+    memcpy(bad, pak, size);
+    ((qpak_hdr_t *)bad)->size = sizeof(*hdr) - 1;
+    T_CHECK(qpak_check(bad, size) < 0);
+    memcpy(bad, pak, size);
+    ((qpak_ent_t *)(bad + sizeof(*hdr)))[1].offset += 1;
+    T_CHECK(qpak_check(bad, size) < 0);
+    memcpy(bad, pak, size);
+    ((qpak_ent_t *)(bad + sizeof(*hdr)))[2].size = size;
+    T_CHECK(qpak_check(bad, size) < 0);
+    memcpy(bad, pak, size);
+    ((qpak_ent_t *)(bad + sizeof(*hdr)))[0].hash = 0xffffffff;
+    T_CHECK(qpak_check(bad, size) < 0);
+    /*crc catches what the structure check doesn't*/
+    memcpy(bad, pak, size);
+    bad[size - 1] ^= 0x80;
+    T_CHECK(qpak_check(bad, size) == 0);
+    T_CHECK(qpak_crc32(0, bad + sizeof(*hdr), size - sizeof(*hdr)) != hdr->crc);
+    free(bad);
+    free(pak);
+
+    snprintf(cmd, sizeof(cmd), "rm -rf %s %s", root, out);
+    T_CHECK(system(cmd) == 0);
+    return T_DONE();
+}
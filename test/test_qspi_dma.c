@@ -0,0 +1,194 @@
+/*
+ * hal/qspi_dma.c request queue with a mocked transfer engine : chunking,
+ * submits from completion callbacks, random start/transfer failures,
+ * a short read is not stuck behind a long one, flash status is polled
+ * once per start after init or error, not per request.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <qspi_dma.h>
+#include "test.h"
+
+#define FLASH (1 << 20)
+#define CHUNK (4096)
+#define JOBS (64)
+#define JOB_MAX (20000)
+
+typedef struct {
+    int on;
+    uint8_t *buf;
+    uint32_t addr;
+    uint32_t size;
+} xfer_t;
+
+typedef struct {
+    qspi_req_t req;
+    uint8_t *mem;
+    int resubmit;
+} job_t;
+
+static uint8_t flash[FLASH];
+static xfer_t xf;
+static int start_fail, ready_fail, readys, overlap, bad_data;
+static uint32_t max_chunk;
+static qspi_q_t q;
+
+static int mock_start (void *hw, uint8_t *buf, uint32_t addr, uint32_t size)
+{
+    if (xf.on) {
+        overlap++;
+    }
+    if (size > max_chunk) {
+        max_chunk = size;
+    }
+    if (start_fail && rand() % start_fail == 0) {
+        return -1;
+    }
+    xf.on = 1;
+    xf.buf = buf;
+    xf.addr = addr;
+    xf.size = size;
+    return 0;
+}
+
+static int mock_ready (void *hw)
+{
+    readys++;
+    return ready_fail ? -1 : 0;
+}
+
+static const qspi_q_ops_t mock_ops = {mock_start, mock_ready, NULL, NULL, NULL};
+
+/*Completes chunk in flight, as the dma isr would*/
+static void complete (int err)
+{
+    xf.on = 0;
+    if (!err) {
+        memcpy(xf.buf, flash + xf.addr, xf.size);
+    }
+    qspi_q_xfer_done(&q, err);
+}
+
+static void drain (int errmod)
+{
+    while (xf.on) {
+        complete(errmod && rand() % errmod == 0);
+    }
+}
+
+static void job_done (qspi_req_t *req)
+{
+    job_t *job = req->user;
+    uint32_t size;
+
+    if (req->status == QSPI_REQ_DONE && memcmp(job->mem, flash + req->addr, req->size)) {
+        bad_data++;
+    }
+    if (job->resubmit) {
+        job->resubmit = 0;
+        size = 1 + rand() % 5000;
+        qspi_req_init(req, job->mem, rand() % (FLASH - size), size, job_done, job);
+        T_CHECK(qspi_q_submit(&q, req) == 0);
+    }
+}
+
+static void random_passes (void)
+{
+    static job_t jobs[JOBS];
+    uint32_t size;
+    int pass, i, k, n, errmod;
+
+    qspi_q_init(&q, &mock_ops, CHUNK);
+    for (i = 0; i < JOBS; i++) {
+        jobs[i].mem = malloc(JOB_MAX);
+    }
+    for (pass = 0; pass < 200; pass++) {
+        n = 1 + rand() % JOBS;
+        errmod = pass % 3 ? 0 : 7;
+        start_fail = pass % 5 ? 0 : 9;
+        for (i = 0; i < n; i++) {
+            size = 1 + rand() % JOB_MAX;
+            jobs[i].resubmit = rand() % 8 == 0;
+            qspi_req_init(&jobs[i].req, jobs[i].mem, rand() % (FLASH - size),
+                          size, job_done, &jobs[i]);
+            T_CHECK(qspi_q_submit(&q, &jobs[i].req) == 0);
+            /*completions interleave with submits*/
+            for (k = rand() % 3; k && xf.on; k--) {
+                complete(0);
+            }
+        }
+        drain(errmod);
+        T_CHECK(qspi_q_idle(&q) && !q.head && !q.depth);
+        for (i = 0; i < n; i++) {
+            T_CHECK(jobs[i].req.status == QSPI_REQ_DONE ||
+                    (jobs[i].req.status == QSPI_REQ_ERR && (errmod || start_fail)));
+        }
+    }
+    start_fail = 0;
+    T_CHECK(!overlap && !bad_data);
+    T_CHECK(max_chunk == CHUNK);
+    T_CHECK(q.stat.errors > 0);
+    /*status polls follow errors only*/
+    T_CHECK(q.stat.polls < q.stat.reqs / 10);
+    printf("reqs= %u, xfers= %u, polls= %u, errors= %u, maxdepth= %u\n",
+           q.stat.reqs, q.stat.xfers, q.stat.polls, q.stat.errors, q.stat.maxdepth);
+    for (i = 0; i < JOBS; i++) {
+        free(jobs[i].mem);
+    }
+}
+
+int main (void)
+{
+    static uint8_t big[FLASH];
+    uint8_t small[64];
+    qspi_req_t rb, rs;
+    int i, chunks;
+
+    for (i = 0; i < FLASH; i++) {
+        flash[i] = rand();
+    }
+    random_passes();
+
+    /*short read behind a 1M one is done after the next chunk*/
+    qspi_q_init(&q, &mock_ops, CHUNK);
+    qspi_req_init(&rb, big, 0, FLASH, NULL, NULL);
+    qspi_req_init(&rs, small, 100, sizeof(small), NULL, NULL);
+    T_CHECK(qspi_q_submit(&q, &rb) == 0 && qspi_q_submit(&q, &rs) == 0);
+    for (chunks = 0; rs.status == QSPI_REQ_PENDING && xf.on; chunks++) {
+        complete(0);
+    }
+    T_CHECK(chunks == 2);
+    T_CHECK(rs.status == QSPI_REQ_DONE && !memcmp(small, flash + 100, sizeof(small)));
+    drain(0);
+    T_CHECK(rb.status == QSPI_REQ_DONE && !memcmp(big, flash, FLASH));
+    T_CHECK(q.stat.polls == 1);
+
+    /*flash not ready : queued request fails, next submit polls again*/
+    qspi_q_init(&q, &mock_ops, CHUNK);
+    ready_fail = 1;
+    readys = 0;
+    qspi_req_init(&rs, small, 0, sizeof(small), NULL, NULL);
+    T_CHECK(qspi_q_submit(&q, &rs) == 0);
+    T_CHECK(rs.status == QSPI_REQ_ERR && qspi_q_idle(&q));
+    ready_fail = 0;
+    T_CHECK(qspi_q_submit(&q, &rs) == 0);
+    drain(0);
+    T_CHECK(rs.status == QSPI_REQ_DONE && readys == 2);
+    T_CHECK(qspi_q_submit(&q, &rs) == 0);
+    drain(0);
+    T_CHECK(readys == 2);
+
+    /*transfer error : poll before the next start*/
+    T_CHECK(qspi_q_submit(&q, &rs) == 0);
+    complete(1);
+    T_CHECK(rs.status == QSPI_REQ_ERR);
+    T_CHECK(qspi_q_submit(&q, &rs) == 0);
+    drain(0);
+    T_CHECK(readys == 3 && rs.status == QSPI_REQ_DONE);
+
+    qspi_req_init(&rs, small, 0, 0, NULL, NULL);
+    T_CHECK(qspi_q_submit(&q, &rs) < 0);
+    qspi_req_init(&rs, NULL, 0, sizeof(small), NULL, NULL);
+    T_CHECK(qspi_q_submit(&q, &rs) < 0);
+    return T_DONE();
+}
@@ -0,0 +1,120 @@
+/*
+ * hal/sd_cache.c against a ram disk : random reads/writes checked against
+ * a reference image, sync and drop (the media change sequence of
+ * SDC_initialize), trim ranges, read-ahead on a sequential scan, end of disk.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <sd_cache.h>
+#include "test.h"
+
+#define NSEC 20000
+#define SS 512
+
+static uint8_t disk[NSEC * SS], ref[NSEC * SS];
+static uint32_t rdcmd;
+static uint8_t mem[80 * 1024];
+
+static DRESULT ram_read (BYTE lun, BYTE *buff, DWORD sector, UINT count)
+{
+    if (sector + count > NSEC) {
+        return RES_ERROR;
+    }
+    rdcmd++;
+    memcpy(buff, disk + sector * SS, count * SS);
+    return RES_OK;
+}
+
+static DRESULT ram_write (BYTE lun, const BYTE *buff, DWORD sector, UINT count)
+{
+    if (sector + count > NSEC) {
+        return RES_ERROR;
+    }
+    memcpy(disk + sector * SS, buff, count * SS);
+    return RES_OK;
+}
+
+static const Diskio_drvTypeDef ram_drv = {NULL, NULL, ram_read, ram_write, NULL};
+
+int main (void)
+{
+    static uint8_t buf[64 * SS];
+    sd_cache_t cache;
+    DWORD sector;
+    UINT n, k;
+    int i, op, bad = 0;
+
+    srand(1);
+    for (i = 0; i < NSEC * SS; i++) {
+        disk[i] = ref[i] = (uint8_t)rand();
+    }
+    T_CHECK(sd_cache_init(&cache, &ram_drv, 0, mem, 64 * 1024, 16) == 0);
+
+    for (i = 0; i < 200000 && !bad; i++) {
+        op = rand() % 10;
+        /*two thirds of the requests hit a hot region, as FAT and dirs do*/
+        sector = rand() % 3 ? (DWORD)(rand() % 400) : (DWORD)(rand() % NSEC);
+        n = rand() % 8 ? 1 + rand() % 4 : 1 + rand() % 40;
+        if (sector + n > NSEC) {
+            n = NSEC - sector;
+        }
+        if (op < 6) {
+            bad |= sd_cache_read(&cache, buf, sector, n) != RES_OK;
+            bad |= memcmp(buf, ref + sector * SS, n * SS) != 0;
+        } else if (op < 9) {
+            for (k = 0; k < n * SS; k++) {
+                buf[k] = (uint8_t)rand();
+            }
+            memcpy(ref + sector * SS, buf, n * SS);
+            bad |= sd_cache_write(&cache, buf, sector, n) != RES_OK;
+        } else if (rand() % 50 == 0) {
+            bad |= sd_cache_sync(&cache) != RES_OK || cache.dirty;
+            bad |= memcmp(disk, ref, sizeof(disk)) != 0;
+        } else if (rand() % 200 == 0) {
+            /*media change : sync first, then nothing cached is trusted*/
+            bad |= sd_cache_sync(&cache) != RES_OK;
+            sd_cache_drop(&cache, 0, (DWORD)-1);
+        }
+    }
+    T_CHECK(!bad);
+    if (bad) {
+        printf("mismatch at op %d\n", i);
+    }
+    T_CHECK(sd_cache_sync(&cache) == RES_OK);
+    T_CHECK(!memcmp(disk, ref, sizeof(disk)));
+
+    /*dropping without sync loses writes, drop after sync loses nothing*/
+    memset(buf, 0x5a, SS);
+    memcpy(ref + 7 * SS, buf, SS);
+    T_CHECK(sd_cache_write(&cache, buf, 7, 1) == RES_OK);
+    T_CHECK(sd_cache_sync(&cache) == RES_OK);
+    sd_cache_drop(&cache, 0, (DWORD)-1);
+    T_CHECK(sd_cache_read(&cache, buf, 7, 1) == RES_OK && !memcmp(buf, ref + 7 * SS, SS));
+
+    /*trim : reversed range is rejected and keeps dirty data, inclusive end*/
+    memset(buf, 0xa5, 3 * SS);
+    T_CHECK(sd_cache_write(&cache, buf, 20, 3) == RES_OK && cache.dirty == 3);
+    T_CHECK(sd_cache_trim(&cache, 22, 20) == RES_PARERR && cache.dirty == 3);
+    T_CHECK(sd_cache_trim(&cache, 21, 21) == RES_OK && cache.dirty == 2);
+    T_CHECK(sd_cache_trim(&cache, 23, 100) == RES_OK && cache.dirty == 2);
+    T_CHECK(sd_cache_trim(&cache, 0, (DWORD)-1) == RES_OK && cache.dirty == 0);
+    T_CHECK(sd_cache_sync(&cache) == RES_OK && !memcmp(disk, ref, sizeof(disk)));
+
+    /*single sector sequential scan : read-ahead folds it into few commands*/
+    sd_cache_drop(&cache, 0, (DWORD)-1);
+    sd_cache_stat_reset(&cache);
+    rdcmd = 0;
+    for (i = 5000; i < 9000; i++) {
+        T_CHECK(sd_cache_read(&cache, buf, i, 1) == RES_OK);
+        bad |= memcmp(buf, ref + i * SS, SS) != 0;
+    }
+    T_CHECK(!bad);
+    printf("sequential 4000 x 1 sector : %u commands\n", rdcmd);
+    T_CHECK(rdcmd < 4000 / 8);
+
+    /*read-ahead is clipped at the end of the disk*/
+    T_CHECK(sd_cache_read(&cache, buf, NSEC - 3, 1) == RES_OK);
+    T_CHECK(sd_cache_read(&cache, buf, NSEC - 2, 2) == RES_OK);
+    T_CHECK(!memcmp(buf, ref + (NSEC - 2) * SS, 2 * SS));
+    return T_DONE();
+}
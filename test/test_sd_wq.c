@@ -0,0 +1,151 @@
+/*
+ * hal/sd_wq.c against a ram disk with a command log : random writes and
+ * reads (flushed first when they overlap the run) checked against a
+ * reference image, overlapping writes folded into one command with the
+ * last data, write order kept around large direct writes, flush on full
+ * run and on age, a failed flush keeps the run.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <sd_wq.h>
+#include "test.h"
+
+#define NSEC 4096
+#define SS 512
+
+static uint8_t disk[NSEC * SS], ref[NSEC * SS];
+static uint32_t now, wrcmd, fails;
+static DWORD last_sector;
+static UINT last_count;
+
+static uint32_t fake_ms (void)
+{
+    return now;
+}
+
+static DRESULT ram_write (BYTE lun, const BYTE *buff, DWORD sector, UINT count)
+{
+    if (fails) {
+        fails--;
+        return RES_ERROR;
+    }
+    if (sector + count > NSEC) {
+        return RES_ERROR;
+    }
+    wrcmd++;
+    last_sector = sector;
+    last_count = count;
+    memcpy(disk + sector * SS, buff, count * SS);
+    return RES_OK;
+}
+
+static DRESULT rd (sd_wq_t *wq, BYTE *buff, DWORD sector, UINT count)
+{
+    DRESULT res = sd_wq_read_sync(wq, sector, count);
+
+    if (res == RES_OK) {
+        memcpy(buff, disk + sector * SS, count * SS);
+    }
+    return res;
+}
+
+static DRESULT wr (sd_wq_t *wq, BYTE *buff, DWORD sector, UINT count, int fill)
+{
+    memset(buff, fill, count * SS);
+    memcpy(ref + sector * SS, buff, count * SS);
+    return sd_wq_write(wq, buff, sector, count);
+}
+
+int main (void)
+{
+    static uint8_t buf[64 * SS];
+    static sd_wq_t wq;
+    DWORD sector;
+    UINT n;
+    int i, op, bad = 0;
+
+    srand(1);
+    sd_wq_init(&wq, ram_write, 0, fake_ms);
+
+    /*random : writes cluster as FAT and dir updates do, clock runs*/
+    for (i = 0; i < 100000 && !bad; i++) {
+        op = rand() % 10;
+        sector = rand() % 3 ? (DWORD)(rand() % 64) : (DWORD)(rand() % NSEC);
+        n = rand() % 8 ? 1 + rand() % 3 : 1 + rand() % 40;
+        if (sector + n > NSEC) {
+            n = NSEC - sector;
+        }
+        now += rand() % 8;
+        if (op < 4) {
+            bad |= rd(&wq, buf, sector, n) != RES_OK;
+            bad |= memcmp(buf, ref + sector * SS, n * SS) != 0;
+        } else if (op < 9) {
+            bad |= wr(&wq, buf, sector, n, rand()) != RES_OK;
+        } else {
+            bad |= sd_wq_poll(&wq) != RES_OK;
+            bad |= wq.count && now - wq.tick >= SD_WQ_AGE;
+        }
+    }
+    T_CHECK(!bad);
+    if (bad) {
+        printf("mismatch at op %d\n", i);
+    }
+    T_CHECK(sd_wq_flush(&wq) == RES_OK && wq.count == 0);
+    T_CHECK(!memcmp(disk, ref, sizeof(disk)));
+    printf("random : %u writes, %u queued, %u flushes\n",
+           wq.stat.writes, wq.stat.queued, wq.stat.flushes);
+    T_CHECK(wq.stat.flushes < wq.stat.queued);
+
+    /*overlapping and adjacent writes : one command, last data wins*/
+    wrcmd = 0;
+    T_CHECK(wr(&wq, buf, 100, 4, 1) == RES_OK);
+    T_CHECK(wr(&wq, buf, 101, 2, 2) == RES_OK);
+    T_CHECK(wr(&wq, buf, 104, 1, 3) == RES_OK);
+    T_CHECK(wr(&wq, buf, 100, 1, 4) == RES_OK);
+    T_CHECK(wrcmd == 0 && wq.count == 5);
+    T_CHECK(sd_wq_flush(&wq) == RES_OK && wrcmd == 1);
+    T_CHECK(last_sector == 100 && last_count == 5);
+    T_CHECK(!memcmp(disk + 100 * SS, ref + 100 * SS, 5 * SS));
+    T_CHECK(disk[100 * SS] == 4 && disk[101 * SS] == 2 && disk[103 * SS] == 1);
+
+    /*read : flushed only when it overlaps the run*/
+    wrcmd = 0;
+    T_CHECK(wr(&wq, buf, 200, 2, 5) == RES_OK);
+    T_CHECK(rd(&wq, buf, 198, 2) == RES_OK && wrcmd == 0 && wq.count == 2);
+    T_CHECK(rd(&wq, buf, 201, 4) == RES_OK && wrcmd == 1 && wq.count == 0);
+    T_CHECK(!memcmp(buf, ref + 201 * SS, 4 * SS));
+
+    /*order : run goes before a large write over it*/
+    wrcmd = 0;
+    T_CHECK(wr(&wq, buf, 300, 1, 6) == RES_OK);
+    T_CHECK(wr(&wq, buf, 295, SD_WQ_MERGE_MAX + 1, 7) == RES_OK);
+    T_CHECK(wrcmd == 2 && wq.count == 0 && last_sector == 295);
+    T_CHECK(!memcmp(disk + 290 * SS, ref + 290 * SS, 20 * SS) && disk[300 * SS] == 7);
+
+    /*full run is flushed at once*/
+    wrcmd = 0;
+    for (i = 0; i < SD_WQ_SECTORS; i++) {
+        T_CHECK(wr(&wq, buf, 400 + i, 1, i) == RES_OK);
+    }
+    T_CHECK(wrcmd == 1 && wq.count == 0 && last_count == SD_WQ_SECTORS);
+
+    /*age*/
+    wrcmd = 0;
+    T_CHECK(wr(&wq, buf, 500, 1, 8) == RES_OK);
+    now += SD_WQ_AGE - 1;
+    T_CHECK(sd_wq_poll(&wq) == RES_OK && wrcmd == 0);
+    now++;
+    T_CHECK(sd_wq_poll(&wq) == RES_OK && wrcmd == 1 && wq.count == 0);
+
+    /*failed flush keeps the run and restarts its age, a later write is not lost*/
+    T_CHECK(wr(&wq, buf, 600, 2, 9) == RES_OK);
+    fails = 1;
+    now += 10;
+    T_CHECK(sd_wq_flush(&wq) == RES_ERROR && wq.count == 2 && wq.tick == now);
+    fails = 1;
+    memset(buf, 10, SS);
+    T_CHECK(sd_wq_write(&wq, buf, 700, SD_WQ_MERGE_MAX + 1) == RES_ERROR && wq.count == 2);
+    T_CHECK(sd_wq_flush(&wq) == RES_OK && wq.stat.errors == 2);
+    T_CHECK(!memcmp(disk, ref, sizeof(disk)));
+    return T_DONE();
+}
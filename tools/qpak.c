@@ -0,0 +1,215 @@
+/*
+ * Host tool : packs a directory tree into QSPI asset archive (see int/qpak.h).
+ * Build : make -C tools
+ * Usage : qpak <out.pak> <dir>   - pack, names are paths relative to <dir>
+ *         qpak -l <in.pak>       - verify and list
+ */
+
+#define _XOPEN_SOURCE 700
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ftw.h>
+#include <sys/stat.h>
+#include <qpak.h>
+
+typedef struct {
+    char *name;
+    char *path;
+    uint32_t size;
+    qpak_ent_t ent;
+} file_t;
+
+static file_t *files;
+static uint32_t nfiles, maxfiles;
+static size_t rootlen;
+
+static int
+collect (const char *path, const struct stat *st, int type, struct FTW *ftw)
+{
+    if (type != FTW_F) {
+        return 0;
+    }
+    if (st->st_size > 0xffffffffL) {
+        fprintf(stderr, "%s : too big\n", path);
+        return -1;
+    }
+    if (nfiles == maxfiles) {
+        maxfiles = maxfiles ? maxfiles * 2 : 64;
+        files = realloc(files, maxfiles * sizeof(*files));
+        if (!files) {
+            return -1;
+        }
+    }
+    files[nfiles].path = strdup(path);
+    files[nfiles].name = strdup(path + rootlen);
+    files[nfiles].size = st->st_size;
+    nfiles++;
+    return 0;
+}
+
+static int
+cmp_ent (const void *_a, const void *_b)
+{
+    const file_t *a = _a, *b = _b;
+
+    if (a->ent.hash != b->ent.hash) {
+        return a->ent.hash < b->ent.hash ? -1 : 1;
+    }
+    return strcmp(a->name, b->name);
+}
+
+static uint8_t *
+load (const char *path, long *size)
+{
+    FILE *f = fopen(path, "rb");
+    uint8_t *buf;
+
+    if (!f) {
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    *size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    buf = malloc(*size ? *size : 1);
+    if (buf && fread(buf, 1, *size, f) != (size_t)*size) {
+        free(buf);
+        buf = NULL;
+    }
+    fclose(f);
+    return buf;
+}
+
+static int
+pack (const char *out, const char *root)
+{
+    qpak_hdr_t hdr = {0};
+    uint64_t pos;
+    uint32_t i;
+    uint8_t *pak;
+    long size;
+    FILE *f;
+    int err = -1;
+
+    rootlen = strlen(root);
+    while (rootlen && root[rootlen - 1] == '/') {
+        rootlen--;
+    }
+    rootlen++;
+    if (nftw(root, collect, 16, FTW_PHYS) < 0 || !nfiles) {
+        fprintf(stderr, "%s : nothing to pack\n", root);
+        return -1;
+    }
+    for (i = 0; i < nfiles; i++) {
+        files[i].ent.hash = qpak_hash(files[i].name);
+    }
+    qsort(files, nfiles, sizeof(*files), cmp_ent);
+    for (i = 1; i < nfiles; i++) {
+        if (files[i].ent.hash == files[i - 1].ent.hash) {
+            printf("note : hash collision '%s' '%s'\n", files[i - 1].name, files[i].name);
+        }
+    }
+
+    pos = sizeof(hdr) + nfiles * sizeof(qpak_ent_t);
+    for (i = 0; i < nfiles; i++) {
+        files[i].ent.name = pos;
+        pos += strlen(files[i].name) + 1;
+    }
+    for (i = 0; i < nfiles; i++) {
+        pos = QPAK_ALIGN_UP(pos);
+        files[i].ent.offset = pos;
+        files[i].ent.size = files[i].size;
+        pos += files[i].size;
+    }
+    pos = QPAK_ALIGN_UP(pos);
+    if (pos > 0xffffffffULL) {
+        fprintf(stderr, "archive too big\n");
+        return -1;
+    }
+    pak = calloc(1, pos);
+    if (!pak) {
+        return -1;
+    }
+    for (i = 0; i < nfiles; i++) {
+        uint8_t *data = load(files[i].path, &size);
+
+        if (!data || size != files[i].size) {
+            fprintf(stderr, "%s : read failed\n", files[i].path);
+            free(data);
+            goto done;
+        }
+        memcpy(pak + files[i].ent.offset, data, size);
+        free(data);
+        strcpy((char *)pak + files[i].ent.name, files[i].name);
+        memcpy(pak + sizeof(hdr) + i * sizeof(qpak_ent_t), &files[i].ent, sizeof(qpak_ent_t));
+    }
+    hdr.magic = QPAK_MAGIC;
+    hdr.version = QPAK_VERSION;
+    hdr.align = QPAK_ALIGN;
+    hdr.count = nfiles;
+    hdr.size = pos;
+    hdr.crc = qpak_crc32(0, pak + sizeof(hdr), pos - sizeof(hdr));
+    memcpy(pak, &hdr, sizeof(hdr));
+
+    f = fopen(out, "wb");
+    if (!f || fwrite(pak, 1, pos, f) != pos) {
+        fprintf(stderr, "%s : write failed\n", out);
+        if (f) {
+            fclose(f);
+        }
+        goto done;
+    }
+    fclose(f);
+    printf("%u files, %u bytes\n", nfiles, (uint32_t)pos);
+    err = 0;
+done:
+    free(pak);
+    return err;
+}
+
+static int
+list (const char *in)
+{
+    const qpak_hdr_t *hdr;
+    const qpak_ent_t *ent;
+    uint8_t *pak;
+    long size;
+    uint32_t i;
+    int err = -1;
+
+    pak = load(in, &size);
+    if (!pak || qpak_check(pak, size) < 0) {
+        fprintf(stderr, "%s : not an archive\n", in);
+        goto done;
+    }
+    hdr = (const qpak_hdr_t *)pak;
+    if (qpak_crc32(0, pak + sizeof(*hdr), hdr->size - sizeof(*hdr)) != hdr->crc) {
+        fprintf(stderr, "%s : crc mismatch\n", in);
+        goto done;
+    }
+    ent = qpak_index(pak);
+    for (i = 0; i < hdr->count; i++, ent++) {
+        if (qpak_find(pak, qpak_name(pak, ent)) != ent) {
+            fprintf(stderr, "%s : lookup failed\n", qpak_name(pak, ent));
+            goto done;
+        }
+        printf("%08x %8u %s\n", ent->offset, ent->size, qpak_name(pak, ent));
+    }
+    err = 0;
+done:
+    free(pak);
+    return err;
+}
+
+int
+main (int argc, char **argv)
+{
+    if (argc == 3 && !strcmp(argv[1], "-l")) {
+        return list(argv[2]) < 0;
+    }
+    if (argc != 3) {
+        fprintf(stderr, "usage : %s <out.pak> <dir> | -l <in.pak>\n", argv[0]);
+        return 1;
+    }
+    return pack(argv[1], argv[2]) < 0;
+}
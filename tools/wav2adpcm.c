@@ -0,0 +1,117 @@
+/*
+ * Host tool : 16 bit pcm wav -> IMA-ADPCM asset (see int/audio_adpcm.h).
+ * Build : make -C tools
+ * Usage : wav2adpcm <in.wav> <out.adp> [loopstart frame]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <audio_adpcm.h>
+
+static uint32_t
+le32 (const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t
+le16 (const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static uint8_t *
+load (const char *path, long *size)
+{
+    FILE *f = fopen(path, "rb");
+    uint8_t *buf;
+
+    if (!f) {
+        return NULL;
+    }
+    if (fseek(f, 0, SEEK_END) < 0 || (*size = ftell(f)) <= 0 ||
+        fseek(f, 0, SEEK_SET) < 0) {
+        fclose(f);
+        return NULL;
+    }
+    buf = malloc(*size);
+    if (buf && fread(buf, 1, *size, f) != (size_t)*size) {
+        free(buf);
+        buf = NULL;
+    }
+    fclose(f);
+    return buf;
+}
+
+int
+main (int argc, char **argv)
+{
+    uint8_t *wav = NULL, *out = NULL;
+    const uint8_t *p, *data = NULL;
+    uint32_t len = 0, rate = 0, frames, size, loopstart = A_ADPCM_NOLOOP;
+    int chans = 0, bits = 0, fmt = 0, ret = 1;
+    long wavsize = 0, pos;
+    size_t wrote;
+    FILE *f;
+
+    if (argc < 3) {
+        fprintf(stderr, "usage : %s <in.wav> <out.adp> [loopstart]\n", argv[0]);
+        return 1;
+    }
+    if (argc > 3) {
+        loopstart = strtoul(argv[3], NULL, 0);
+    }
+    wav = load(argv[1], &wavsize);
+    if (!wav || wavsize < 12 || memcmp(wav, "RIFF", 4) || memcmp(wav + 8, "WAVE", 4)) {
+        fprintf(stderr, "%s : not a wav\n", argv[1]);
+        goto done;
+    }
+    for (pos = 12; pos + 8 <= wavsize; pos += 8 + ((len + 1) & ~1L)) {
+        p = wav + pos;
+        len = le32(p + 4);
+        if (len > wavsize - pos - 8) {
+            /*truncated file : take what is there*/
+            len = wavsize - pos - 8;
+        }
+        if (!memcmp(p, "fmt ", 4) && len >= 16) {
+            fmt = le16(p + 8);
+            chans = le16(p + 10);
+            rate = le32(p + 12);
+            bits = le16(p + 22);
+        } else if (!memcmp(p, "data", 4)) {
+            data = p + 8;
+            break;
+        }
+    }
+    if (!data || fmt != 1 || bits != 16 || chans < 1 || chans > 2) {
+        fprintf(stderr, "%s : only 16 bit mono/stereo pcm supported\n", argv[1]);
+        goto done;
+    }
+    frames = len / (2 * chans);
+    size = a_adpcm_encoded_size(frames, chans);
+    out = malloc(size);
+    if (!out) {
+        fprintf(stderr, "out of memory\n");
+        goto done;
+    }
+    size = a_adpcm_encode((const int16_t *)data, frames, chans, rate, loopstart, out);
+    f = fopen(argv[2], "wb");
+    if (!f) {
+        fprintf(stderr, "%s : can't create\n", argv[2]);
+        goto done;
+    }
+    wrote = fwrite(out, 1, size, f);
+    if (fclose(f) || wrote != size) {
+        fprintf(stderr, "%s : write failed\n", argv[2]);
+        remove(argv[2]);
+        goto done;
+    }
+    printf("%s : %u frames, %d ch, %u Hz, %u -> %u bytes\n",
+           argv[2], frames, chans, rate, len, size);
+    ret = 0;
+done:
+    free(out);
+    free(wav);
+    return ret;
+}